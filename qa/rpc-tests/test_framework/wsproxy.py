@@ -24,6 +24,7 @@ def __func():
 log = logging.getLogger("HorizenWebsocket")
 
 EVT_UPDATE_TIP = 0
+EVT_UPDATE_SIDECHAIN = 1
 EVT_UNDEFINED = 0xff
 
 REQ_GET_SINGLE_BLOCK = 0
@@ -32,6 +33,8 @@ REQ_GET_NEW_BLOCK_HASHES = 2
 REQ_SEND_CERTIFICATE = 3
 REQ_GET_BLOCK_HEADERS = 4
 REQ_GET_TOP_QUALITY_CERTIFICATES = 5
+REQ_SUBSCRIBE_SIDECHAIN_UPDATES = 6
+REQ_UNSUBSCRIBE_SIDECHAIN_UPDATES = 7
 REQ_UNDEFINED = 0xff
 
 MSG_EVENT = 0
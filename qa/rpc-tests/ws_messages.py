@@ -15,6 +15,8 @@ from test_framework.test_framework import MINIMAL_SC_HEIGHT, MINER_REWARD_POST_H
 from test_framework.mc_test.mc_test import *
 import os
 import json
+import struct
+import binascii
 import pprint
 from decimal import Decimal
 import threading
@@ -127,6 +129,12 @@ class ws_messages(BitcoinTestFramework):
         self.nodes[0].generate(MINIMAL_SC_HEIGHT)
         self.sync_all()
 
+        mark_logs("Checking the websocket server info of Node 1", self.nodes, DEBUG_MODE)
+        wsinfo = self.nodes[1].getwebsocketinfo()
+        assert_true(wsinfo['enabled'])
+        assert_true(wsinfo['connections'] >= 1)
+        assert_equal(wsinfo['slowconsumers'], 0)
+
         mark_logs("Sending an invalid ws message", self.nodes, DEBUG_MODE)
         try:
             self.nodes[0].ws_test("Hello World!")
@@ -240,6 +248,21 @@ class ws_messages(BitcoinTestFramework):
         assert_equal(block_hash, hash_)
         assert_equal(exp_block, block_)
 
+        mark_logs("Getting block via ws with the binary format", self.nodes, DEBUG_MODE)
+        ws = create_connection(self.nodes[0].get_wsurl())
+        ws.send(json.dumps({"msgType": 1, "requestId": "7", "requestType": 8, "requestPayload": {"format": "binary"}}))
+        assert_equal("binary", json.loads(ws.recv())['responsePayload']['format'])
+        ws.send(json.dumps({"msgType": 1, "requestId": "8", "requestType": 0, "requestPayload": {"hash": block_hash}}))
+        data = ws.recv()
+        # fixed header: msgType, requestType, requestId, payload size
+        msg_type, req_type, req_id, payload_size = struct.unpack('<BBII', data[:10])
+        assert_equal((2, 0, 8, len(data) - 10), (msg_type, req_type, req_id, payload_size))
+        # payload: height, hash, block
+        assert_equal(height, struct.unpack('<i', data[10:14])[0])
+        assert_equal(block_hash, swap_bytes(binascii.hexlify(data[14:46])))
+        assert_equal(exp_block, binascii.hexlify(data[46:]))
+        ws.close()
+
         # ----------------------------------------------------------------"
         # Test websocket requests processing performance
         # Should be able to process 100 Requests with less than 2 seconds
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amqppublishnotifier.h"
+#include "blockcache.h"
 #include "main.h"
 #include "util.h"
 
@@ -152,19 +153,13 @@ bool AMQPPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("amqp", "amqp: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex)) {
-            LogPrint("amqp", "amqp: Can't read block from disk\n");
-            return false;
-        }
-
-        ss << block;
+    std::shared_ptr<const CSerializedBlockCache::CEntry> entry = serializedBlockCache.GetOrRead(pindex);
+    if (!entry) {
+        LogPrint("amqp", "amqp: Can't read block from disk\n");
+        return false;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, entry->GetRaw().data(), entry->GetRaw().size());
 }
 
 bool AMQPPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -0,0 +1,95 @@
+#include "blockcache.h"
+
+#include "main.h"
+#include "streams.h"
+#include "utilstrencodings.h"
+#include "version.h"
+
+CSerializedBlockCache serializedBlockCache;
+
+CSerializedBlockCache::CEntry::CEntry(const CBlock& block)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    strRaw = ss.str();
+}
+
+const std::string& CSerializedBlockCache::CEntry::GetHex() const
+{
+    std::call_once(hexFlag, [this]() { strHex = HexStr(strRaw.begin(), strRaw.end()); });
+    return strHex;
+}
+
+CSerializedBlockCache::CSerializedBlockCache(size_t nCapacityIn): nCapacity(nCapacityIn), nHits(0), nMisses(0) {}
+
+std::shared_ptr<const CSerializedBlockCache::CEntry> CSerializedBlockCache::Add(const uint256& hash, const CBlock& block)
+{
+    // serialize before taking the lock
+    std::shared_ptr<const CEntry> entry = std::make_shared<const CEntry>(block);
+
+    LOCK(cs);
+    auto it = mapEntries.find(hash);
+    if (it != mapEntries.end())
+    {
+        lruList.splice(lruList.begin(), lruList, it->second);
+        return it->second->second;
+    }
+
+    lruList.push_front(std::make_pair(hash, entry));
+    mapEntries[hash] = lruList.begin();
+    while (lruList.size() > nCapacity)
+    {
+        mapEntries.erase(lruList.back().first);
+        lruList.pop_back();
+    }
+    return entry;
+}
+
+std::shared_ptr<const CSerializedBlockCache::CEntry> CSerializedBlockCache::Get(const uint256& hash)
+{
+    LOCK(cs);
+    auto it = mapEntries.find(hash);
+    if (it == mapEntries.end())
+    {
+        nMisses++;
+        return std::shared_ptr<const CEntry>();
+    }
+
+    nHits++;
+    lruList.splice(lruList.begin(), lruList, it->second);
+    return it->second->second;
+}
+
+std::shared_ptr<const CSerializedBlockCache::CEntry> CSerializedBlockCache::GetOrRead(const CBlockIndex* pindex)
+{
+    const uint256 hash = pindex->GetBlockHash();
+    std::shared_ptr<const CEntry> entry = Get(hash);
+    if (entry)
+        return entry;
+
+    CBlock block;
+    bool fNearTip = false;
+    {
+        LOCK(cs_main);
+        if (!ReadBlockFromDisk(block, pindex))
+            return std::shared_ptr<const CEntry>();
+        fNearTip = chainActive.Contains(pindex) && pindex->nHeight + int64_t(nCapacity) > chainActive.Height();
+    }
+    if (!fNearTip)
+        return std::make_shared<const CEntry>(block);
+    return Add(hash, block);
+}
+
+void CSerializedBlockCache::Clear()
+{
+    LOCK(cs);
+    lruList.clear();
+    mapEntries.clear();
+}
+
+void CSerializedBlockCache::GetStats(uint64_t& nHitsOut, uint64_t& nMissesOut) const
+{
+    LOCK(cs);
+    nHitsOut = nHits;
+    nMissesOut = nMisses;
+}
@@ -0,0 +1,69 @@
+#ifndef BITCOIN_BLOCKCACHE_H
+#define BITCOIN_BLOCKCACHE_H
+
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class CBlock;
+class CBlockIndex;
+
+/**
+ * @brief LRU of the recently connected blocks in network serialization, filled once by ConnectTip
+ * and shared by the block publishers (websocket, ZMQ, AMQP) and the REST/RPC read paths, so that
+ * a new tip is serialized once whatever the number of subscribers, and outside cs_main.
+ */
+class CSerializedBlockCache
+{
+public:
+    //! The serialization of a block, never modified once cached
+    class CEntry
+    {
+    public:
+        explicit CEntry(const CBlock& block);
+
+        const std::string& GetRaw() const { return strRaw; }
+        //! Hex encoding of the serialization, computed at the first call only
+        const std::string& GetHex() const;
+
+    private:
+        std::string strRaw;
+        mutable std::string strHex;
+        mutable std::once_flag hexFlag;
+    };
+
+    static const size_t DEFAULT_CAPACITY = 8;
+
+    explicit CSerializedBlockCache(size_t nCapacityIn = DEFAULT_CAPACITY);
+
+    std::shared_ptr<const CEntry> Add(const uint256& hash, const CBlock& block);
+    std::shared_ptr<const CEntry> Get(const uint256& hash);
+    /**
+     * The cached serialization of the block, or the one of the block read from disk (holding
+     * cs_main for the read only). The latter is cached only for a block among the last ones of
+     * the active chain, so that historical reads do not evict the tips. Null if it cannot be read.
+     */
+    std::shared_ptr<const CEntry> GetOrRead(const CBlockIndex* pindex);
+
+    void Clear();
+    void GetStats(uint64_t& nHitsOut, uint64_t& nMissesOut) const;
+
+private:
+    typedef std::list<std::pair<uint256, std::shared_ptr<const CEntry> > > CLruList;
+
+    mutable CCriticalSection cs;
+    size_t nCapacity;
+    CLruList lruList;                                   //! most recently used first
+    std::map<uint256, CLruList::iterator> mapEntries;
+    uint64_t nHits;
+    uint64_t nMisses;
+};
+
+extern CSerializedBlockCache serializedBlockCache;
+
+#endif // BITCOIN_BLOCKCACHE_H
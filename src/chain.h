@@ -152,8 +152,8 @@ public:
 
     int64_t nChainDelay;
 
-    //! Cumulative Hash Block Sidechain Transaction Commitment Tree
-    CFieldElement scCumTreeHash;
+    //! Cumulative Hash Block Sidechain Transaction Commitment Tree, kept compact since it is held for every block
+    CCompactFieldElement scCumTreeHash;
 
     //! Number of transactions in this block.
     //! Note: in a potential headers-first mode, this number cannot be relied upon
@@ -8,7 +8,9 @@
 #include "version.h"
 #include "policy/fees.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <limits>
 #include "utilmoneystr.h"
 #include <undo.h>
 #include <chainparams.h>
@@ -201,6 +203,8 @@ bool CCoinsView::GetSidechain(const uint256& scId, CSidechain& info)
 bool CCoinsView::HaveSidechainEvents(int height)                                const { return false; }
 bool CCoinsView::GetSidechainEvents(int height, CSidechainEvents& scEvent)      const { return false; }
 void CCoinsView::GetScIds(std::set<uint256>& scIdsList)                         const { scIdsList.clear(); return; }
+void CCoinsView::GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                                   std::vector<CSidechainIndexEntry>& entries) const { entries.clear(); return; }
 bool CCoinsView::CheckQuality(const CScCertificate& cert)                       const { return false; }
 uint256 CCoinsView::GetBestBlock()                                              const { return uint256(); }
 uint256 CCoinsView::GetBestAnchor()                                             const { return uint256(); }
@@ -213,6 +217,7 @@ bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock,
                             CSidechainEventsMap& mapSidechainEvents,
                             CCswNullifiersMap& cswNullifiers)                         { return false; }
 bool CCoinsView::GetStats(CCoinsStats &stats)                                   const { return false; }
+bool CCoinsView::DumpSnapshot(const std::string& fileName, CChainstateSnapshotInfo& info) const { return false; }
 
 
 CCoinsViewBacked::CCoinsViewBacked(CCoinsView *viewIn) : base(viewIn) { }
@@ -226,6 +231,11 @@ bool CCoinsViewBacked::GetSidechain(const uint256& scId, CSidechain& info)
 bool CCoinsViewBacked::HaveSidechainEvents(int height)                                 const { return base->HaveSidechainEvents(height); }
 bool CCoinsViewBacked::GetSidechainEvents(int height, CSidechainEvents& scEvents)      const { return base->GetSidechainEvents(height, scEvents); }
 void CCoinsViewBacked::GetScIds(std::set<uint256>& scIdsList)                          const { return base->GetScIds(scIdsList); }
+void CCoinsViewBacked::GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                                         std::vector<CSidechainIndexEntry>& entries) const
+{
+    return base->GetScIndexEntries(after, maxItems, bOnlyAlive, height, entries);
+}
 bool CCoinsViewBacked::CheckQuality(const CScCertificate& cert)                        const { return base->CheckQuality(cert); }
 uint256 CCoinsViewBacked::GetBestBlock()                                               const { return base->GetBestBlock(); }
 uint256 CCoinsViewBacked::GetBestAnchor()                                              const { return base->GetBestAnchor(); }
@@ -242,11 +252,158 @@ bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock,
                                                                                               mapAnchors, mapNullifiers, mapSidechains,
                                                                                               mapSidechainEvents, cswNullifiers); }
 bool CCoinsViewBacked::GetStats(CCoinsStats &stats)                                  const { return base->GetStats(stats); }
+bool CCoinsViewBacked::DumpSnapshot(const std::string& fileName, CChainstateSnapshotInfo& info) const { return base->DumpSnapshot(fileName, info); }
+
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView *viewIn) : CCoinsViewBacked(viewIn), nGeneration(0), nLookups(0), nHits(0) {}
+
+void CCoinsViewPrefetch::Prefetch(const std::vector<uint256>& vTxIds, const std::vector<uint256>& vScIds,
+                                  const std::vector<std::pair<uint256, CFieldElement> >& vCswNullifiers)
+{
+    uint64_t nGenerationStart = 0;
+    {
+        LOCK(cs_prefetch);
+        nGenerationStart = nGeneration;
+    }
+
+    // the view below is read without holding the lock, so that lookups are never blocked
+    CPrefetchBatch batch;
+    for (const uint256& txid : vTxIds)
+    {
+        CCoins coins;
+        if (base->GetCoins(txid, coins))
+            batch.coins[txid].swap(coins);
+    }
+    for (const uint256& scId : vScIds)
+    {
+        CSidechain sidechain;
+        if (base->GetSidechain(scId, sidechain))
+            batch.sidechains[scId] = sidechain;
+    }
+    for (const auto& cswNullifier : vCswNullifiers)
+        batch.cswNullifiers[cswNullifier] = base->HaveCswNullifier(cswNullifier.first, cswNullifier.second);
+
+    LOCK(cs_prefetch);
+    if (nGeneration != nGenerationStart)
+    {
+        LogPrint("bench", "%s():%d - view written while prefetching, records discarded\n", __func__, __LINE__);
+        return;
+    }
+    std::swap(previous, current);
+    std::swap(current, batch);
+}
+
+template <typename Key, typename Value>
+static bool TakePrefetched(std::map<Key, Value>& current, std::map<Key, Value>& previous, const Key& key, Value& value)
+{
+    for (std::map<Key, Value>* pmap : {&current, &previous})
+    {
+        auto it = pmap->find(key);
+        if (it != pmap->end())
+        {
+            value = it->second;
+            pmap->erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CCoinsViewPrefetch::GetCoins(const uint256 &txid, CCoins &coins) const
+{
+    {
+        LOCK(cs_prefetch);
+        nLookups++;
+        if (TakePrefetched(current.coins, previous.coins, txid, coins))
+        {
+            nHits++;
+            return true;
+        }
+    }
+    return base->GetCoins(txid, coins);
+}
+
+bool CCoinsViewPrefetch::HaveCoins(const uint256 &txid) const
+{
+    {
+        LOCK(cs_prefetch);
+        if (current.coins.count(txid) || previous.coins.count(txid))
+            return true;
+    }
+    return base->HaveCoins(txid);
+}
+
+bool CCoinsViewPrefetch::GetSidechain(const uint256& scId, CSidechain& info) const
+{
+    {
+        LOCK(cs_prefetch);
+        nLookups++;
+        if (TakePrefetched(current.sidechains, previous.sidechains, scId, info))
+        {
+            nHits++;
+            return true;
+        }
+    }
+    return base->GetSidechain(scId, info);
+}
+
+bool CCoinsViewPrefetch::HaveSidechain(const uint256& scId) const
+{
+    {
+        LOCK(cs_prefetch);
+        if (current.sidechains.count(scId) || previous.sidechains.count(scId))
+            return true;
+    }
+    return base->HaveSidechain(scId);
+}
+
+bool CCoinsViewPrefetch::HaveCswNullifier(const uint256& scId, const CFieldElement &nullifier) const
+{
+    {
+        LOCK(cs_prefetch);
+        nLookups++;
+        bool fFound = false;
+        if (TakePrefetched(current.cswNullifiers, previous.cswNullifiers, std::make_pair(scId, nullifier), fFound))
+        {
+            nHits++;
+            return fFound;
+        }
+    }
+    return base->HaveCswNullifier(scId, nullifier);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock,
+                                    const uint256 &hashAnchor, CAnchorsMap &mapAnchors,
+                                    CNullifiersMap &mapNullifiers, CSidechainsMap& mapSidechains,
+                                    CSidechainEventsMap& mapSidechainEvents,
+                                    CCswNullifiersMap& cswNullifiers)
+{
+    {
+        LOCK(cs_prefetch);
+        nGeneration++;
+        current = CPrefetchBatch();
+        previous = CPrefetchBatch();
+    }
+
+    bool ret = base->BatchWrite(mapCoins, hashBlock, hashAnchor, mapAnchors, mapNullifiers,
+                                mapSidechains, mapSidechainEvents, cswNullifiers);
+
+    // prefetches which read the view below while it was being written must be discarded too
+    LOCK(cs_prefetch);
+    nGeneration++;
+    return ret;
+}
+
+void CCoinsViewPrefetch::GetPrefetchStats(uint64_t& nLookupsOut, uint64_t& nHitsOut) const
+{
+    LOCK(cs_prefetch);
+    nLookupsOut = nLookups;
+    nHitsOut = nHits;
+}
 
 CCoinsKeyHasher::CCoinsKeyHasher() : salt(GetRandHash()) {}
 CCswNullifiersKeyHasher::CCswNullifiersKeyHasher() : salt() {GetRandBytes(reinterpret_cast<unsigned char*>(salt), BUF_LEN);}
 
-size_t CCswNullifiersKeyHasher::operator()(const std::pair<uint256, CFieldElement>& key) const {
+size_t CCswNullifiersKeyHasher::operator()(const std::pair<uint256, CCompactFieldElement>& key) const {
     uint32_t buf[BUF_LEN];
 
     // nullifiers are already checked by the caller, but let's assert it too
@@ -254,7 +411,7 @@ size_t CCswNullifiersKeyHasher::operator()(const std::pair<uint256, CFieldElemen
 
     // note: we may consider buf as a raw data, so bytes size of buf is (BUF_LEN * 4)
     memcpy(buf, key.first.begin(), sizeof(uint256));
-    memcpy((buf + sizeof(uint256)/sizeof(uint32_t)), &(key.second.GetByteArray()[0]), CFieldElement::ByteSize());
+    memcpy((buf + sizeof(uint256)/sizeof(uint32_t)), key.second.GetDataBuffer(), CFieldElement::ByteSize());
     return CalculateHash(buf, BUF_LEN, salt);
 }
 
@@ -335,6 +492,17 @@ const CSidechain* const CCoinsViewCache::AccessSidechain(const uint256& scId) co
         return &it->second.sidechain;
 }
 
+void CCoinsViewCache::RecordSidechainDelta(CSidechainDelta::Type type, const uint256& scId, CAmount amount, const uint256& refHash)
+{
+    CSidechainDelta delta(type, scId, amount, refHash);
+
+    CSidechainsMap::const_iterator it = FetchSidechains(scId);
+    if (it != cacheSidechains.end() && it->second.flag != CSidechainsCacheEntry::Flags::ERASED)
+        delta.SetState(it->second.sidechain);
+
+    vSidechainDeltas.push_back(delta);
+}
+
 CSidechainEventsMap::const_iterator CCoinsViewCache::FetchSidechainEvents(int height) const {
     CSidechainEventsMap::iterator candidateIt = cacheSidechainEvents.find(height);
     if (candidateIt != cacheSidechainEvents.end())
@@ -531,7 +699,7 @@ void CCoinsViewCache::SetBestBlock(const uint256 &hashBlockIn) {
 }
 
 bool CCoinsViewCache::HaveCswNullifier(const uint256& scId, const CFieldElement &nullifier) const {
-    std::pair<uint256, CFieldElement> key = std::make_pair(scId, nullifier);
+    std::pair<uint256, CCompactFieldElement> key = std::make_pair(scId, CCompactFieldElement{nullifier});
 
     CCswNullifiersMap::iterator it = cacheCswNullifiers.find(key);
     if (it != cacheCswNullifiers.end())
@@ -548,7 +716,7 @@ bool CCoinsViewCache::AddCswNullifier(const uint256& scId, const CFieldElement &
     if (HaveCswNullifier(scId, nullifier))
         return false;
 
-    std::pair<uint256, CFieldElement> key = std::make_pair(scId, nullifier);
+    std::pair<uint256, CCompactFieldElement> key = std::make_pair(scId, CCompactFieldElement{nullifier});
     cacheCswNullifiers.insert(std::make_pair(key, CCswNullifiersCacheEntry{CCswNullifiersCacheEntry::Flags::FRESH}));
     return true;
 }
@@ -557,7 +725,7 @@ bool CCoinsViewCache::RemoveCswNullifier(const uint256& scId, const CFieldElemen
     if (!HaveCswNullifier(scId, nullifier))
         return false;
 
-    cacheCswNullifiers.at(std::make_pair(scId, nullifier)).flag = CCswNullifiersCacheEntry::Flags::ERASED;
+    cacheCswNullifiers.at(std::make_pair(scId, CCompactFieldElement{nullifier})).flag = CCswNullifiersCacheEntry::Flags::ERASED;
     return true;
 }
 
@@ -718,6 +886,36 @@ void CCoinsViewCache::GetScIds(std::set<uint256>& scIdsList) const
     return;
 }
 
+void CCoinsViewCache::GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                                        std::vector<CSidechainIndexEntry>& entries) const
+{
+    // The sidechains in this cache override the ones of the base view: asking the base for as many
+    // extra entries as the cached sidechains guarantees a full page after dropping the overridden ones
+    size_t baseItems = (maxItems > std::numeric_limits<size_t>::max() - cacheSidechains.size()) ?
+                       std::numeric_limits<size_t>::max() : maxItems + cacheSidechains.size();
+    base->GetScIndexEntries(after, baseItems, bOnlyAlive, height, entries);
+
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+        [this](const CSidechainIndexEntry& entry) { return cacheSidechains.count(entry.scId) != 0; }), entries.end());
+
+    for (const auto& entry: cacheSidechains)
+    {
+        if (entry.second.flag == CSidechainsCacheEntry::Flags::ERASED)
+            continue;
+
+        CSidechainIndexEntry indexEntry(entry.first, entry.second.sidechain);
+        if (!(after < indexEntry))
+            continue;
+        if (bOnlyAlive && indexEntry.GetState(height) != CSidechain::State::ALIVE)
+            continue;
+        entries.push_back(indexEntry);
+    }
+
+    std::sort(entries.begin(), entries.end());
+    if (entries.size() > maxItems)
+        entries.resize(maxItems);
+}
+
 bool CCoinsViewCache::CheckQuality(const CScCertificate& cert) const
 {
     // check in blockchain if a better cert is already there for this epoch
@@ -791,6 +989,8 @@ bool CCoinsViewCache::UpdateSidechain(const CTransaction& tx, const CBlock& bloc
 
         LogPrint("sc", "%s():%d - sidechain balance decreased by CSW in scView csw_amount=%s scId=%s\n",
             __func__, __LINE__, FormatMoney(csw.nValue), csw.scId.ToString());
+
+        RecordSidechainDelta(CSidechainDelta::Type::CSW, csw.scId, csw.nValue, txHash);
     }
 
     // creation ccout
@@ -831,6 +1031,7 @@ bool CCoinsViewCache::UpdateSidechain(const CTransaction& tx, const CBlock& bloc
             __func__, __LINE__, maturityHeight, FormatMoney(cr.nValue), scId.ToString());
 
         LogPrint("sc", "%s():%d - scId[%s] added in scView\n", __func__, __LINE__, scId.ToString() );
+        RecordSidechainDelta(CSidechainDelta::Type::CREATION, scId, cr.nValue, txHash);
 
         CSidechainEventsMap::iterator scMaturingEventIt = ModifySidechainEvents(maturityHeight);
         if (scMaturingEventIt->second.flag == CSidechainEventsCacheEntry::Flags::FRESH) {
@@ -877,6 +1078,7 @@ bool CCoinsViewCache::UpdateSidechain(const CTransaction& tx, const CBlock& bloc
 
         LogPrint("sc", "%s():%d - immature balance added in scView (h=%d, amount=%s) %s\n",
             __func__, __LINE__, maturityHeight, FormatMoney(ft.GetScValue()), ft.scId.ToString());
+        RecordSidechainDelta(CSidechainDelta::Type::FORWARD_TRANSFER, ft.scId, ft.GetScValue(), txHash);
 
         CSidechainEventsMap::iterator scMaturingEventIt = ModifySidechainEvents(maturityHeight);
         if (scMaturingEventIt->second.flag == CSidechainEventsCacheEntry::Flags::FRESH) {
@@ -909,6 +1111,7 @@ bool CCoinsViewCache::UpdateSidechain(const CTransaction& tx, const CBlock& bloc
 
         LogPrint("sc", "%s():%d - immature balance added in scView (h=%d, amount=%s) %s\n",
             __func__, __LINE__, maturityHeight, FormatMoney(mbtr.GetScValue()), mbtr.scId.ToString());
+        RecordSidechainDelta(CSidechainDelta::Type::BWT_REQUEST, mbtr.scId, mbtr.GetScValue(), txHash);
 
         CSidechainEventsMap::iterator scMaturingEventIt = ModifySidechainEvents(maturityHeight);
         if (scMaturingEventIt->second.flag == CSidechainEventsCacheEntry::Flags::FRESH) {
@@ -951,6 +1154,7 @@ bool CCoinsViewCache::RevertTxOutputs(const CTransaction& tx, int nHeight)
                 __func__, __LINE__, scId.ToString(), maturityHeight);
             return false;
         }
+        RecordSidechainDelta(CSidechainDelta::Type::BWT_REQUEST, scId, entry.GetScValue(), tx.GetHash());
 
         CSidechainEventsMap::iterator scMaturingEventIt = ModifySidechainEvents(maturityHeight);
         scMaturingEventIt->second.scEvents.maturingScs.erase(entry.scId);
@@ -984,6 +1188,7 @@ bool CCoinsViewCache::RevertTxOutputs(const CTransaction& tx, int nHeight)
                 __func__, __LINE__, scId.ToString(), maturityHeight);
             return false;
         }
+        RecordSidechainDelta(CSidechainDelta::Type::FORWARD_TRANSFER, scId, entry.nValue, tx.GetHash());
 
         CSidechainEventsMap::iterator scMaturingEventIt = ModifySidechainEvents(maturityHeight);
         scMaturingEventIt->second.scEvents.maturingScs.erase(entry.scId);
@@ -1030,6 +1235,7 @@ bool CCoinsViewCache::RevertTxOutputs(const CTransaction& tx, int nHeight)
 
         scIt->second.flag = CSidechainsCacheEntry::Flags::ERASED;
         LogPrint("sc", "%s():%d - scId=%s removed from scView\n", __func__, __LINE__, scId.ToString() );
+        RecordSidechainDelta(CSidechainDelta::Type::CREATION, scId, entry.nValue, tx.GetHash());
 
 
         if (HaveSidechainEvents(maturityHeight))
@@ -1086,6 +1292,8 @@ bool CCoinsViewCache::RevertTxOutputs(const CTransaction& tx, int nHeight)
 
         LogPrint("sc", "%s():%d - sidechain balance increased by CSW in scView csw_amount=%s scId=%s\n",
             __func__, __LINE__, FormatMoney(csw.nValue), csw.scId.ToString());
+
+        RecordSidechainDelta(CSidechainDelta::Type::CSW, csw.scId, csw.nValue, tx.GetHash());
     }
 
     return true;
@@ -1629,6 +1837,7 @@ bool CCoinsViewCache::UpdateSidechain(const CScCertificate& cert, CBlockUndo& bl
     LogPrint("cert", "%s():%d - updated sc state %s\n", __func__, __LINE__, currentSc.ToString());
 
     scIt->second.flag = CSidechainsCacheEntry::Flags::DIRTY;
+    RecordSidechainDelta(CSidechainDelta::Type::CERTIFICATE, scId, bwtTotalAmount, certHash);
 
     if(cert.epochNumber != scUndoData.prevTopCommittedCertReferencedEpoch)
     {
@@ -1799,6 +2008,7 @@ bool CCoinsViewCache::RestoreSidechain(const CScCertificate& certToRevert, const
 
     scIt->second.flag = CSidechainsCacheEntry::Flags::DIRTY;
     LogPrint("cert", "%s():%d - updated sc state %s\n", __func__, __LINE__, currentSc.ToString());
+    RecordSidechainDelta(CSidechainDelta::Type::CERTIFICATE, scId, bwtTotalAmount, certHash);
 
     //we need to modify the ceasing height only if we removed the very first certificate of the epoch
     if(certToRevert.epochNumber != currentSc.lastTopQualityCertReferencedEpoch)
@@ -1882,8 +2092,10 @@ bool CCoinsViewCache::HandleSidechainEvents(int height, CBlockUndo& blockUndo, s
         LogPrint("sc", "%s():%d - SIDECHAIN-EVENT: adding immature amount %s for scId=%s in blockundo\n",
             __func__, __LINE__, FormatMoney(scMaturingIt->second.sidechain.mImmatureAmounts[height]), maturingScId.ToString());
 
+        const CAmount maturedAmount = scMaturingIt->second.sidechain.mImmatureAmounts[height];
         scMaturingIt->second.sidechain.mImmatureAmounts.erase(height);
         scMaturingIt->second.flag = CSidechainsCacheEntry::Flags::DIRTY;
+        RecordSidechainDelta(CSidechainDelta::Type::MATURED_AMOUNT, maturingScId, maturedAmount);
     }
 
     //Handle Ceasing Sidechain
@@ -1902,6 +2114,7 @@ bool CCoinsViewCache::HandleSidechainEvents(int height, CBlockUndo& blockUndo, s
             __func__, __LINE__, sidechain.lastTopQualityCertHash.ToString(), ceasingScId.ToString());
 
         blockUndo.scUndoDatabyScId[ceasingScId].contentBitMask |= CSidechainUndoData::AvailableSections::CEASED_CERT_DATA;
+        RecordSidechainDelta(CSidechainDelta::Type::CEASING, ceasingScId, 0);
 
         if (sidechain.lastTopQualityCertReferencedEpoch == CScCertificate::EPOCH_NULL) {
             assert(sidechain.lastTopQualityCertHash.IsNull());
@@ -1969,6 +2182,7 @@ bool CCoinsViewCache::RevertSidechainEvents(const CBlockUndo& blockUndo, int hei
 
             scIt->second.flag = CSidechainsCacheEntry::Flags::DIRTY;
         }
+        RecordSidechainDelta(CSidechainDelta::Type::MATURED_AMOUNT, scId, amountToRestore);
 
         recreatedScEvent.maturingScs.insert(scId);
     }
@@ -1994,6 +2208,7 @@ bool CCoinsViewCache::RevertSidechainEvents(const CBlockUndo& blockUndo, int hei
                                            CScCertificateStatusUpdateInfo::BwtState::BWT_ON));
         }
 
+        RecordSidechainDelta(CSidechainDelta::Type::CEASING, scId, 0);
         recreatedScEvent.ceasingScs.insert(scId);
     }
 
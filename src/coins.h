@@ -10,6 +10,7 @@
 #include "core_memusage.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "sync.h"
 #include "uint256.h"
 
 #include <assert.h>
@@ -297,7 +298,7 @@ public:
      * unordered_map will behave unpredictably if the custom hasher returns a
      * uint64_t, resulting in failures when syncing the chain (#4634).
      */
-    size_t operator()(const std::pair<uint256, CFieldElement>& key) const;
+    size_t operator()(const std::pair<uint256, CCompactFieldElement>& key) const;
 };
 
 struct CCoinsCacheEntry
@@ -452,7 +453,7 @@ typedef boost::unordered_map<uint256, CNullifiersCacheEntry, CCoinsKeyHasher> CN
 
 typedef boost::unordered_map<uint256, CSidechainsCacheEntry, CCoinsKeyHasher> CSidechainsMap;
 typedef boost::unordered_map<int, CSidechainEventsCacheEntry> CSidechainEventsMap;
-typedef boost::unordered_map<std::pair<uint256, CFieldElement>, CCswNullifiersCacheEntry, CCswNullifiersKeyHasher> CCswNullifiersMap;
+typedef boost::unordered_map<std::pair<uint256, CCompactFieldElement>, CCswNullifiersCacheEntry, CCswNullifiersKeyHasher> CCswNullifiersMap;
 
 struct CCoinsStats
 {
@@ -467,6 +468,18 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
 };
 
+/** Summary of a chainstate snapshot file, see CCoinsViewDB::DumpSnapshot */
+struct CChainstateSnapshotInfo
+{
+    uint256 hashBlock;
+    uint64_t nRecords;
+    uint64_t nChunks;
+    //! Hash of the header and of the checksums of all the chunks
+    uint256 hashCommitment;
+
+    CChainstateSnapshotInfo() : nRecords(0), nChunks(0) {}
+};
+
 
 /** Abstract view on the open txout dataset. */
 class CCoinsView
@@ -500,6 +513,11 @@ public:
     //! Retrieve all the known sidechain ids
     virtual void GetScIds(std::set<uint256>& scIdsList) const;
 
+    //! Retrieve at most maxItems entries of the sidechain index following the given one, in
+    //! (creation height, scId) order; if bOnlyAlive is set, only sidechains alive at the given height are returned
+    virtual void GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                                   std::vector<CSidechainIndexEntry>& entries) const;
+
     //! Check if cert has enough quality to be accepted
     virtual bool CheckQuality(const CScCertificate& cert) const;
 
@@ -527,6 +545,9 @@ public:
     //! Calculate statistics about the unspent transaction output set
     virtual bool GetStats(CCoinsStats &stats) const;
 
+    //! Writes the whole chainstate to a snapshot file
+    virtual bool DumpSnapshot(const std::string& fileName, CChainstateSnapshotInfo& info) const;
+
     //! As we use CCoinsViews polymorphically, have a virtual destructor
     virtual ~CCoinsView() {}
 };
@@ -549,6 +570,8 @@ public:
     bool HaveSidechainEvents(int height)                               const override;
     bool GetSidechainEvents(int height, CSidechainEvents& scEvents)    const override;
     void GetScIds(std::set<uint256>& scIdsList)                        const override;
+    void GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                           std::vector<CSidechainIndexEntry>& entries) const override;
     bool CheckQuality(const CScCertificate& cert)                      const override;
     uint256 GetBestBlock()                                             const override;
     uint256 GetBestAnchor()                                            const override;
@@ -564,9 +587,61 @@ public:
                     CSidechainEventsMap& mapCeasedScs,
                     CCswNullifiersMap& cswNullifiers)                  override;
     bool GetStats(CCoinsStats &stats)                                  const override;
+    bool DumpSnapshot(const std::string& fileName, CChainstateSnapshotInfo& info) const override;
 };
 
 
+
+/**
+ * @brief Layer between the coins cache and the db, holding the coins, sidechains and CSW
+ * nullifiers read in advance for the next block to connect, on a background thread.
+ * Each record is handed over to the cache above at its first lookup, the ones of the
+ * last two prefetches being kept. The records always match the view below: they are
+ * all dropped when it is written to, and a prefetch overlapping a write is discarded.
+ */
+class CCoinsViewPrefetch : public CCoinsViewBacked
+{
+public:
+    CCoinsViewPrefetch(CCoinsView *viewIn);
+
+    //! Read the given records from the view below. Thread safe.
+    void Prefetch(const std::vector<uint256>& vTxIds, const std::vector<uint256>& vScIds,
+                  const std::vector<std::pair<uint256, CFieldElement> >& vCswNullifiers);
+
+    bool GetCoins(const uint256 &txid, CCoins &coins)                  const override;
+    bool HaveCoins(const uint256 &txid)                                const override;
+    bool GetSidechain(const uint256& scId, CSidechain& info)           const override;
+    bool HaveSidechain(const uint256& scId)                            const override;
+    bool HaveCswNullifier(const uint256& scId,
+                          const CFieldElement &nullifier)              const override;
+    bool BatchWrite(CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashAnchor,
+                    CAnchorsMap &mapAnchors,
+                    CNullifiersMap &mapNullifiers,
+                    CSidechainsMap& mapSidechains,
+                    CSidechainEventsMap& mapCeasedScs,
+                    CCswNullifiersMap& cswNullifiers)                  override;
+
+    //! Number of lookups received, and of the ones served from prefetched records
+    void GetPrefetchStats(uint64_t& nLookupsOut, uint64_t& nHitsOut) const;
+
+private:
+    struct CPrefetchBatch
+    {
+        std::map<uint256, CCoins> coins;
+        std::map<uint256, CSidechain> sidechains;
+        std::map<std::pair<uint256, CFieldElement>, bool> cswNullifiers;
+    };
+
+    mutable CCriticalSection cs_prefetch;
+    mutable CPrefetchBatch current;
+    mutable CPrefetchBatch previous;
+    //! Incremented before and after each write to the view below
+    uint64_t nGeneration;
+    mutable uint64_t nLookups;
+    mutable uint64_t nHits;
+};
 class CCoinsViewCache;
 
 /** 
@@ -610,6 +685,9 @@ protected:
     mutable CNullifiersMap cacheNullifiers;
     mutable CCswNullifiersMap cacheCswNullifiers;
 
+    /* Changes applied to the sidechains by the block being connected/disconnected on this view, in order. */
+    std::vector<CSidechainDelta> vSidechainDeltas;
+
     /* Cached dynamic memory usage for the inner CCoins objects. */
     mutable size_t cachedCoinsUsage;
 
@@ -673,6 +751,8 @@ public:
     bool HaveSidechain(const uint256& scId)                           const override;
     bool GetSidechain(const uint256 & scId, CSidechain& targetSidechain) const override;
     void GetScIds(std::set<uint256>& scIdsList)                       const override;
+    void GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                           std::vector<CSidechainIndexEntry>& entries) const override;
 
     CValidationState::Code IsScTxApplicableToState(const CTransaction& tx, Sidechain::ScFeeCheckFlag scCheckType, bool* banSenderNode = nullptr) const;
     bool CheckScTxTiming(const uint256& scId) const;
@@ -707,6 +787,10 @@ public:
     bool HandleSidechainEvents(int height, CBlockUndo& blockUndo, std::vector<CScCertificateStatusUpdateInfo>* pCertsStateInfo);
     bool RevertSidechainEvents(const CBlockUndo& blockUndo, int height, std::vector<CScCertificateStatusUpdateInfo>* pCertsStateInfo);
 
+    //! Sidechain changes recorded by UpdateSidechain/RevertTxOutputs/RestoreSidechain and by (Handle|Revert)SidechainEvents
+    const std::vector<CSidechainDelta>& GetSidechainDeltas() const { return vSidechainDeltas; }
+    void ClearSidechainDeltas() { vSidechainDeltas.clear(); }
+
     //CSW NULLIFIER PUBLIC MEMBERS
     bool HaveCswNullifier(const uint256& scId, const CFieldElement &nullifier) const override;
     bool AddCswNullifier(const uint256& scId, const CFieldElement &nullifier);
@@ -759,6 +843,7 @@ private:
     static int getInitScCoinsMaturity();
 
     bool DecrementImmatureAmount(const uint256& scId, const CSidechainsMap::iterator& targetEntry, CAmount nValue, int maturityHeight);
+    void RecordSidechainDelta(CSidechainDelta::Type type, const uint256& scId, CAmount amount, const uint256& refHash = uint256());
 };
 
 #endif // BITCOIN_COINS_H
@@ -43,9 +43,15 @@
 #include <ifaddrs.h>
 #include <limits.h>
 #include <netdb.h>
+#include <poll.h>
 #include <unistd.h>
 #endif
 
+// The network thread waits on its sockets with epoll where available, see CSocketPoller
+#if defined(HAVE_SYS_EPOLL_H)
+#define USE_EPOLL 1
+#endif
+
 #ifdef WIN32
 #define MSG_DONTWAIT        0
 #else
@@ -94,7 +100,7 @@ size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
 bool static inline IsSelectableSocket(SOCKET s) {
-#ifdef WIN32
+#if defined(WIN32) || defined(USE_EPOLL)
     return true;
 #else
     return (s < FD_SETSIZE);
@@ -1,12 +1,14 @@
 #include <gtest/gtest.h>
 #include <gtest/libzendoo_test_files.h>
 
+#include "arith_uint256.h"
 #include "primitives/certificate.h"
 #include "primitives/transaction.h"
 #include "sc/asyncproofverifier.h"
 #include "coins.h"
 #include "main.h"
 #include "uint256.h"
+#include "utiltest.h"
 
 #include "tx_creation_utils.h"
 
@@ -51,6 +53,10 @@ public:
 
         sidechain.fixedParams.wCertVk = BlockchainTestManager::GetInstance().GetTestVerificationKey(testProvingSystem, TestCircuitType::Certificate);
         sidechain.fixedParams.wCeasedVk = BlockchainTestManager::GetInstance().GetTestVerificationKey(testProvingSystem, TestCircuitType::CSW);
+
+        // Empty the verified proof cache, so that no proof is skipped because of a previous test
+        CScProofVerifier::SetMaxProofCacheSize(0);
+        CScProofVerifier::SetMaxProofCacheSize(CScProofVerifier::DEFAULT_MAX_PROOF_CACHE_SIZE);
     };
 
     void TearDown() override
@@ -557,6 +563,9 @@ TEST_F(AsyncProofVerifierTestSuite, Check_One_By_One_Verification)
     ASSERT_EQ(stats.okCertCounter, 0);
     ASSERT_EQ(stats.failedCswCounter, 1);
     ASSERT_EQ(stats.okCswCounter, numberOfValidTransactions);
+
+    // Check that the sender has been penalized for the invalid proof only.
+    ASSERT_EQ(TEST_FRIEND_CScAsyncProofVerifier::GetInstance().GetPeerFailedProofs(dummyNode.GetId()), 1);
 }
 
 /**
@@ -627,3 +636,363 @@ TEST_F(AsyncProofVerifierTestSuite, Csw_Queue_Move)
         ASSERT_EQ(tempElement.at(i).scId, inputs.at(i).scId);
     }
 }
+
+/**
+ * @brief A proxy exposing the batch verification internals of the proof verifier.
+ */
+class TestShardedProofVerifier : public CScProofVerifier
+{
+public:
+    TestShardedProofVerifier() : CScProofVerifier(Verification::Strict, Priority::High) {}
+
+    using CScProofVerifier::proofQueue;
+    using CScProofVerifier::BatchVerifyInternal;
+    using CScProofVerifier::ShardedBatchVerify;
+    using CScProofVerifier::BisectVerify;
+};
+
+/**
+ * @brief Test that verifying a batch split in shards gives the same results
+ * as verifying it at once, also when one of the shards contains an invalid proof.
+ */
+TEST_F(AsyncProofVerifierTestSuite, Sharded_Batch_Verification_Matches_Unsharded)
+{
+    BlockchainTestManager& blockchain = BlockchainTestManager::GetInstance();
+    blockchain.Reset();
+
+    // A second sidechain with a different proving system, so that its proofs use a different key.
+    const ProvingSystem otherProvingSystem = ProvingSystem::CoboundaryMarlin;
+    blockchain.GenerateSidechainTestParameters(otherProvingSystem, TestCircuitType::Certificate);
+
+    uint256 otherSidechainId = uint256S("bbbb");
+    CSidechain otherSidechain = sidechain;
+    otherSidechain.fixedParams.wCertVk = blockchain.GetTestVerificationKey(otherProvingSystem, TestCircuitType::Certificate);
+
+    blockchain.StoreSidechainWithCurrentHeight(sidechainId, sidechain, sidechain.creationBlockHeight + sidechain.fixedParams.withdrawalEpochLength);
+    blockchain.StoreSidechainWithCurrentHeight(otherSidechainId, otherSidechain, sidechain.creationBlockHeight + sidechain.fixedParams.withdrawalEpochLength);
+
+    int epochNumber = 0;
+    int64_t quality = 1;
+
+    CScCertificate validCert = blockchain.GenerateCertificate(sidechainId, epochNumber, quality, testProvingSystem);
+
+    // Change the FT fee (or any other certificate field) to make the proof invalid.
+    CMutableScCertificate invalidCert = blockchain.GenerateCertificate(otherSidechainId, epochNumber, quality, otherProvingSystem);
+    invalidCert.forwardTransferScFee++;
+
+    CTransactionCreationArguments args;
+    args.nVersion = SC_TX_VERSION;
+    args.vcsw_ccin.push_back(blockchain.CreateCswInput(sidechainId, kDummyAmount, testProvingSystem));
+    CTransaction cswTx(blockchain.CreateTransaction(args));
+
+    TestShardedProofVerifier verifier;
+    verifier.LoadDataForCertVerification(*blockchain.CoinsViewCache(), validCert);
+    verifier.LoadDataForCertVerification(*blockchain.CoinsViewCache(), invalidCert);
+    verifier.LoadDataForCswVerification(*blockchain.CoinsViewCache(), cswTx);
+    ASSERT_EQ(verifier.proofQueue.size(), 3);
+
+    std::map<uint256, CProofVerifierItem> unshardedProofs = verifier.proofQueue;
+    std::map<uint256, CProofVerifierItem> shardedProofs = verifier.proofQueue;
+
+    // Every proof uses its own key, so each one goes to its own shard.
+    ASSERT_FALSE(verifier.BatchVerifyInternal(unshardedProofs));
+    ASSERT_FALSE(verifier.ShardedBatchVerify(shardedProofs, 3));
+
+    // A failed batch may leave some proofs undecided, settle them as the async verifier does.
+    verifier.BisectVerify(unshardedProofs);
+    verifier.BisectVerify(shardedProofs);
+
+    ASSERT_EQ(shardedProofs.size(), unshardedProofs.size());
+    for (const auto& proof : unshardedProofs)
+    {
+        ASSERT_EQ(shardedProofs.at(proof.first).result, proof.second.result);
+    }
+
+    ASSERT_EQ(shardedProofs.at(validCert.GetHash()).result, ProofVerificationResult::Passed);
+    ASSERT_EQ(shardedProofs.at(CScCertificate(invalidCert).GetHash()).result, ProofVerificationResult::Failed);
+    ASSERT_EQ(shardedProofs.at(cswTx.GetHash()).result, ProofVerificationResult::Passed);
+}
+
+/**
+ * @brief A proxy exposing the verified proof cache of the proof verifier.
+ */
+class TestCachingProofVerifier : public CScProofVerifier
+{
+public:
+    TestCachingProofVerifier(bool skipCachedProofs = true) : CScProofVerifier(Verification::Strict, Priority::High, skipCachedProofs) {}
+
+    using CScProofVerifier::proofQueue;
+    using CScProofVerifier::IsProofCached;
+    using CScProofVerifier::AddProofToCache;
+    using CScProofVerifier::GetProofCacheSize;
+};
+
+static CProofVerifierItem MakePassedItem(const CCertProofVerifierInput& input)
+{
+    CProofVerifierItem item;
+    item.node = nullptr;
+    item.result = ProofVerificationResult::Passed;
+    item.proofInput = input;
+    return item;
+}
+
+static CProofVerifierItem MakePassedItem(const CCswProofVerifierInput& input)
+{
+    CProofVerifierItem item;
+    item.node = nullptr;
+    item.result = ProofVerificationResult::Passed;
+    item.proofInput = std::vector<CCswProofVerifierInput>{input};
+    return item;
+}
+
+/**
+ * @brief Test that the proofs verified by the async verifier when entering the mempool
+ * are not verified again by the verifier of ConnectBlock.
+ */
+TEST_F(AsyncProofVerifierTestSuite, Proof_Verified_By_Async_Verifier_Is_Skipped_At_Block_Connection)
+{
+    BlockchainTestManager& blockchain = BlockchainTestManager::GetInstance();
+    blockchain.Reset();
+
+    blockchain.StoreSidechainWithCurrentHeight(sidechainId, sidechain, sidechain.creationBlockHeight + sidechain.fixedParams.withdrawalEpochLength);
+
+    CScCertificate cert = blockchain.GenerateCertificate(sidechainId, 0, 1, testProvingSystem);
+
+    CTransactionCreationArguments args;
+    args.nVersion = SC_TX_VERSION;
+    args.vcsw_ccin.push_back(blockchain.CreateCswInput(sidechainId, kDummyAmount, testProvingSystem));
+    CTransaction cswTx(blockchain.CreateTransaction(args));
+
+    CScAsyncProofVerifier::GetInstance().LoadDataForCertVerification(*blockchain.CoinsViewCache(), cert, &dummyNode);
+    CScAsyncProofVerifier::GetInstance().LoadDataForCswVerification(*blockchain.CoinsViewCache(), cswTx, &dummyNode);
+
+    uint32_t counter = 0;
+    const uint32_t delay = 100;
+
+    // Wait until the proofs are processed for a specific maximum time (to avoid to get stuck).
+    while (blockchain.PendingAsyncCertProofs() > 0 || blockchain.PendingAsyncCswProofs() > 0 ||
+           counter < blockchain.GetAsyncProofVerifierMaxBatchVerifyDelay() * 2)
+    {
+        MilliSleep(delay);
+        counter += delay;
+    }
+
+    AsyncProofVerifierStatistics stats = blockchain.GetAsyncProofVerifierStatistics();
+    ASSERT_EQ(stats.okCertCounter, 1);
+    ASSERT_EQ(stats.okCswCounter, 1);
+    ASSERT_EQ(TestCachingProofVerifier::GetProofCacheSize(), 2);
+
+    // The verifier of ConnectBlock (strict, high priority) finds both proofs in the cache.
+    TestCachingProofVerifier blockVerifier;
+    blockVerifier.LoadDataForCertVerification(*blockchain.CoinsViewCache(), cert);
+    blockVerifier.LoadDataForCswVerification(*blockchain.CoinsViewCache(), cswTx);
+    ASSERT_TRUE(blockVerifier.proofQueue.empty());
+    ASSERT_TRUE(blockVerifier.BatchVerify());
+
+    // Unless it is asked not to skip them.
+    TestCachingProofVerifier uncachedVerifier(/*skipCachedProofs*/false);
+    uncachedVerifier.LoadDataForCertVerification(*blockchain.CoinsViewCache(), cert);
+    uncachedVerifier.LoadDataForCswVerification(*blockchain.CoinsViewCache(), cswTx);
+    ASSERT_EQ(uncachedVerifier.proofQueue.size(), 2);
+}
+
+/**
+ * @brief Test that changing any public input of a cached proof misses the cache.
+ */
+TEST_F(AsyncProofVerifierTestSuite, Changed_Public_Inputs_Miss_The_Proof_Cache)
+{
+    BlockchainTestManager& blockchain = BlockchainTestManager::GetInstance();
+    blockchain.Reset();
+
+    blockchain.StoreSidechainWithCurrentHeight(sidechainId, sidechain, sidechain.creationBlockHeight + sidechain.fixedParams.withdrawalEpochLength);
+
+    CScCertificate cert = blockchain.GenerateCertificate(sidechainId, 0, 1, testProvingSystem);
+    const CCertProofVerifierInput certInput = CScProofVerifier::CertificateToVerifierItem(cert, sidechain.fixedParams, nullptr);
+    TestCachingProofVerifier::AddProofToCache(MakePassedItem(certInput));
+    ASSERT_TRUE(TestCachingProofVerifier::IsProofCached(MakePassedItem(certInput)));
+
+    std::vector<CCertProofVerifierInput> changedCertInputs(6, certInput);
+    changedCertInputs[0].quality++;
+    changedCertInputs[1].bt_list.push_back(backward_transfer{});
+    changedCertInputs[1].bt_list.back().amount = kDummyAmount;
+    changedCertInputs[2] = changedCertInputs[1];
+    changedCertInputs[2].bt_list.back().amount++;
+    changedCertInputs[3].vCustomFields.push_back(GetRandomNullifier());
+    changedCertInputs[4].forwardTransferScFee++;
+    changedCertInputs[5].mainchainBackwardTransferRequestScFee++;
+    TestCachingProofVerifier::AddProofToCache(MakePassedItem(changedCertInputs[1]));
+
+    for (size_t i = 0; i < changedCertInputs.size(); i++)
+    {
+        if (i == 1)
+            continue;
+        EXPECT_FALSE(TestCachingProofVerifier::IsProofCached(MakePassedItem(changedCertInputs[i]))) << "changed cert input " << i;
+    }
+
+    CTransactionCreationArguments args;
+    args.nVersion = SC_TX_VERSION;
+    args.vcsw_ccin.push_back(blockchain.CreateCswInput(sidechainId, kDummyAmount, testProvingSystem));
+    CTransaction cswTx(blockchain.CreateTransaction(args));
+    const CCswProofVerifierInput cswInput = CScProofVerifier::CswInputToVerifierItem(cswTx.GetVcswCcIn().at(0), &cswTx, sidechain.fixedParams, nullptr);
+    TestCachingProofVerifier::AddProofToCache(MakePassedItem(cswInput));
+    ASSERT_TRUE(TestCachingProofVerifier::IsProofCached(MakePassedItem(cswInput)));
+
+    CCswProofVerifierInput changedNullifier = cswInput;
+    changedNullifier.nullifier = GetRandomNullifier();
+    EXPECT_FALSE(TestCachingProofVerifier::IsProofCached(MakePassedItem(changedNullifier)));
+
+    CCswProofVerifierInput changedValue = cswInput;
+    changedValue.nValue++;
+    EXPECT_FALSE(TestCachingProofVerifier::IsProofCached(MakePassedItem(changedValue)));
+
+    // A tx is cached only when all of its CSW inputs are.
+    CProofVerifierItem bothInputs = MakePassedItem(cswInput);
+    boost::get<std::vector<CCswProofVerifierInput>>(bothInputs.proofInput).push_back(changedValue);
+    EXPECT_FALSE(TestCachingProofVerifier::IsProofCached(bothInputs));
+}
+
+/**
+ * @brief Test the size bound of the verified proof cache, 0 disabling it.
+ */
+TEST_F(AsyncProofVerifierTestSuite, Proof_Cache_Size_Is_Bounded)
+{
+    CCertProofVerifierInput input;
+    input.scId = sidechainId;
+    input.epochNumber = 0;
+    input.mainchainBackwardTransferRequestScFee = 0;
+    input.forwardTransferScFee = 0;
+
+    const size_t maxCacheSize = 3;
+    CScProofVerifier::SetMaxProofCacheSize(maxCacheSize);
+
+    for (uint64_t quality = 0; quality < 2 * maxCacheSize; quality++)
+    {
+        input.quality = quality;
+        TestCachingProofVerifier::AddProofToCache(MakePassedItem(input));
+        ASSERT_TRUE(TestCachingProofVerifier::IsProofCached(MakePassedItem(input)));
+        ASSERT_LE(TestCachingProofVerifier::GetProofCacheSize(), maxCacheSize);
+    }
+    ASSERT_EQ(TestCachingProofVerifier::GetProofCacheSize(), maxCacheSize);
+
+    // Shrinking the bound evicts the exceeding entries.
+    CScProofVerifier::SetMaxProofCacheSize(1);
+    ASSERT_EQ(TestCachingProofVerifier::GetProofCacheSize(), 1);
+
+    // -maxscproofcachesize=0 disables the cache.
+    CScProofVerifier::SetMaxProofCacheSize(0);
+    ASSERT_EQ(TestCachingProofVerifier::GetProofCacheSize(), 0);
+    input.quality = 2 * maxCacheSize;
+    TestCachingProofVerifier::AddProofToCache(MakePassedItem(input));
+    ASSERT_FALSE(TestCachingProofVerifier::IsProofCached(MakePassedItem(input)));
+    ASSERT_EQ(TestCachingProofVerifier::GetProofCacheSize(), 0);
+
+    CScProofVerifier::SetMaxProofCacheSize(CScProofVerifier::DEFAULT_MAX_PROOF_CACHE_SIZE);
+}
+
+/**
+ * @brief A proof verifier counting its verifications, whose batches fail when they contain
+ * one of the given invalid items, with no failing item reported.
+ */
+class TestCountingProofVerifier : public CScProofVerifier
+{
+public:
+    TestCountingProofVerifier(const std::set<uint256>& invalidItemsIn) :
+        CScProofVerifier(Verification::Strict, Priority::High), invalidItems(invalidItemsIn) {}
+
+    using CScProofVerifier::BisectVerify;
+
+    size_t batchVerifications = 0;
+    size_t normalVerifications = 0;
+
+protected:
+    bool BatchVerifyInternal(std::map<uint256, CProofVerifierItem>& proofs) override
+    {
+        batchVerifications++;
+        for (const auto& proof : proofs)
+        {
+            if (invalidItems.count(proof.first))
+                return false;
+        }
+        for (auto& proof : proofs)
+            proof.second.result = ProofVerificationResult::Passed;
+        return true;
+    }
+
+    void NormalVerify(std::map<uint256, CProofVerifierItem>& proofs) override
+    {
+        for (auto& proof : proofs)
+        {
+            normalVerifications++;
+            proof.second.result = invalidItems.count(proof.first) ? ProofVerificationResult::Failed : ProofVerificationResult::Passed;
+        }
+    }
+
+private:
+    const std::set<uint256> invalidItems;
+};
+
+/**
+ * @brief Test that isolating an invalid proof among N valid ones takes O(log N) batch
+ * verifications and a single normal verification, wherever the invalid proof is.
+ */
+TEST_F(AsyncProofVerifierTestSuite, Bisection_Cost_Grows_With_Invalid_Proofs)
+{
+    const size_t numberOfProofs = 64;
+    const size_t maxBatchVerifications = 2 * 6 + 1; // two per halving, plus the whole batch
+
+    std::map<uint256, CProofVerifierItem> proofs;
+    for (size_t i = 0; i < numberOfProofs; i++)
+    {
+        CProofVerifierItem item;
+        item.node = nullptr;
+        item.result = ProofVerificationResult::Unknown;
+        proofs[ArithToUint256(arith_uint256(i + 1))] = item;
+    }
+
+    for (const auto& invalidProof : proofs)
+    {
+        TestCountingProofVerifier verifier({invalidProof.first});
+        std::map<uint256, CProofVerifierItem> results = proofs;
+        verifier.BisectVerify(results);
+
+        for (const auto& proof : results)
+        {
+            ASSERT_EQ(proof.second.result, proof.first == invalidProof.first ? ProofVerificationResult::Failed : ProofVerificationResult::Passed);
+        }
+        ASSERT_LE(verifier.batchVerifications, maxBatchVerifications);
+        ASSERT_EQ(verifier.normalVerifications, 1);
+    }
+
+    // Two invalid proofs cost at most twice as much.
+    TestCountingProofVerifier verifier({proofs.begin()->first, proofs.rbegin()->first});
+    verifier.BisectVerify(proofs);
+    ASSERT_EQ(proofs.begin()->second.result, ProofVerificationResult::Failed);
+    ASSERT_EQ(proofs.rbegin()->second.result, ProofVerificationResult::Failed);
+    ASSERT_LE(verifier.batchVerifications, 2 * maxBatchVerifications);
+    ASSERT_EQ(verifier.normalVerifications, 2);
+}
+
+/**
+ * @brief Test that the penalty of a peer that sent an invalid proof expires.
+ */
+TEST_F(AsyncProofVerifierTestSuite, Peer_Penalty_Expires)
+{
+    TEST_FRIEND_CScAsyncProofVerifier& verifier = TEST_FRIEND_CScAsyncProofVerifier::GetInstance();
+    verifier.Reset();
+
+    SetMockTime(1000);
+    verifier.UpdatePeerPenalty(dummyNode.GetId());
+    ASSERT_TRUE(verifier.IsPeerPenalized(dummyNode.GetId()));
+    ASSERT_EQ(verifier.GetPeerFailedProofs(dummyNode.GetId()), 1);
+
+    SetMockTime(1000 + CScAsyncProofVerifier::PEER_PENALTY_EXPIRY);
+    ASSERT_FALSE(verifier.IsPeerPenalized(dummyNode.GetId()));
+
+    // A new invalid proof starts the penalty over.
+    verifier.UpdatePeerPenalty(dummyNode.GetId() + 1);
+    ASSERT_EQ(verifier.GetPeerFailedProofs(dummyNode.GetId()), 0);
+    ASSERT_TRUE(verifier.IsPeerPenalized(dummyNode.GetId() + 1));
+
+    SetMockTime(0);
+    verifier.Reset();
+}
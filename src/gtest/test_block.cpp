@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
 
+#include "blockcache.h"
 #include "primitives/block.h"
+#include "streams.h"
+#include "utilstrencodings.h"
+#include "version.h"
 
 
 TEST(block_tests, header_size_is_expected) {
@@ -11,3 +15,29 @@ TEST(block_tests, header_size_is_expected) {
 
     ASSERT_EQ(ss.size(), CBlockHeader::HEADER_SIZE);
 }
+
+TEST(block_tests, serialized_block_cache_evicts_least_recently_used) {
+    CSerializedBlockCache cache(2);
+    CBlock block;
+    block.nVersion = 4;
+
+    std::shared_ptr<const CSerializedBlockCache::CEntry> entry = cache.Add(uint256S("1"), block);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    EXPECT_EQ(entry->GetRaw(), ss.str());
+    EXPECT_EQ(entry->GetHex(), HexStr(ss.begin(), ss.end()));
+
+    cache.Add(uint256S("2"), block);
+    // a lookup makes the first one the most recently used
+    EXPECT_TRUE(cache.Get(uint256S("1")) != nullptr);
+    cache.Add(uint256S("3"), block);
+
+    EXPECT_TRUE(cache.Get(uint256S("1")) != nullptr);
+    EXPECT_TRUE(cache.Get(uint256S("2")) == nullptr);
+    EXPECT_TRUE(cache.Get(uint256S("3")) != nullptr);
+
+    uint64_t nHits = 0, nMisses = 0;
+    cache.GetStats(nHits, nMisses);
+    EXPECT_EQ(nHits, 3u);
+    EXPECT_EQ(nMisses, 1u);
+}
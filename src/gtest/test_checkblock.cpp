@@ -3,6 +3,7 @@
 
 #include "consensus/validation.h"
 #include "main.h"
+#include "metrics.h"
 #include "zcash/Proof.hpp"
 #include <pow.h>
 #include "base58.h"
@@ -12,6 +13,8 @@
 #include "zen/forks/fork4_nulltransactionfork.h"
 #include "zen/forks/fork5_shieldfork.h"
 #include "zen/forks/fork8_sidechainfork.h"
+
+#include <boost/thread.hpp>
 using namespace zen;
 
 TEST(CheckBlock, VersionTooLow) {
@@ -61,6 +64,96 @@ TEST(CheckBlock, BlockRejectsBadVersion) {
     EXPECT_FALSE(state.CorruptionPossible());
 }
 
+// Test that the same tx is rejected for the same reason
+// when transactions are checked on the -par threads.
+TEST(CheckBlock, BlockRejectsBadVersionWithParallelChecks) {
+    SelectParams(CBaseChainParams::MAIN);
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout.SetNull();
+    mtx.vin[0].scriptSig = CScript() << 1 << OP_0;
+    mtx.resizeOut(1);
+    mtx.getOut(0).scriptPubKey = CScript() << OP_TRUE;
+    mtx.getOut(0).nValue = 0;
+
+    mtx.nVersion = -1;
+
+    CTransaction tx {mtx};
+    CBlock block;
+    block.nVersion = MIN_BLOCK_VERSION;
+    block.vtx.push_back(tx);
+
+    int nScriptCheckThreadsBackup = nScriptCheckThreads;
+    nScriptCheckThreads = 2;
+    boost::thread worker(&ThreadScriptCheck);
+
+    CValidationState state;
+    auto verifier = libzcash::ProofVerifier::Strict();
+
+    EXPECT_FALSE(CheckBlock(block, state, verifier, flagCheckPow::OFF, flagCheckMerkleRoot::OFF, flagParallelChecks::ON));
+    EXPECT_TRUE(state.GetDoS() == 100);
+    EXPECT_TRUE(state.GetRejectCode() == CValidationState::Code::INVALID);
+    EXPECT_TRUE(state.GetRejectReason() == std::string("bad-txns-version-too-low"));
+    EXPECT_FALSE(state.CorruptionPossible());
+
+    worker.interrupt();
+    worker.join();
+    nScriptCheckThreads = nScriptCheckThreadsBackup;
+}
+
+// Test that the failure of the first invalid tx is reported, as with
+// sequential checking, when transactions are checked on the -par threads.
+TEST(CheckBlock, BlockReportsFirstFailureWithParallelChecks) {
+    SelectParams(CBaseChainParams::MAIN);
+
+    CMutableTransaction mtxNoOutputs;
+    mtxNoOutputs.nVersion = TRANSPARENT_TX_VERSION;
+    mtxNoOutputs.vin.resize(1);
+    mtxNoOutputs.vin[0].prevout.SetNull();
+    mtxNoOutputs.vin[0].scriptSig = CScript() << 1 << OP_0;
+
+    CMutableTransaction mtxBadVersion;
+    mtxBadVersion.vin.resize(1);
+    mtxBadVersion.vin[0].prevout = COutPoint(uint256S("bb"), 0);
+    mtxBadVersion.resizeOut(1);
+    mtxBadVersion.getOut(0).scriptPubKey = CScript() << OP_TRUE;
+    mtxBadVersion.getOut(0).nValue = 0;
+    mtxBadVersion.nVersion = -1;
+
+    CBlock block;
+    block.nVersion = MIN_BLOCK_VERSION;
+    block.vtx.push_back(CTransaction(mtxNoOutputs));
+    block.vtx.push_back(CTransaction(mtxBadVersion));
+
+    auto verifier = libzcash::ProofVerifier::Strict();
+    CValidationState sequentialState;
+    EXPECT_FALSE(CheckBlock(block, sequentialState, verifier, flagCheckPow::OFF, flagCheckMerkleRoot::OFF, flagParallelChecks::OFF));
+    EXPECT_TRUE(sequentialState.GetRejectReason() == std::string("bad-txns-vout-empty"));
+
+    int nScriptCheckThreadsBackup = nScriptCheckThreads;
+    nScriptCheckThreads = 2;
+    boost::thread worker(&ThreadScriptCheck);
+
+    CValidationState state;
+    EXPECT_FALSE(CheckBlock(block, state, verifier, flagCheckPow::OFF, flagCheckMerkleRoot::OFF, flagParallelChecks::ON));
+    EXPECT_TRUE(state.GetDoS() == sequentialState.GetDoS());
+    EXPECT_TRUE(state.GetRejectReason() == sequentialState.GetRejectReason());
+
+    worker.interrupt();
+    worker.join();
+
+    // With the controller alone the checks run one after the other in block order:
+    // the failure of the coinbase is found first and the check of the next tx is skipped
+    int nValidatedBefore = transactionsValidated.get();
+    CValidationState stateNoWorker;
+    EXPECT_FALSE(CheckBlock(block, stateNoWorker, verifier, flagCheckPow::OFF, flagCheckMerkleRoot::OFF, flagParallelChecks::ON));
+    EXPECT_TRUE(stateNoWorker.GetRejectReason() == sequentialState.GetRejectReason());
+    EXPECT_EQ(transactionsValidated.get(), nValidatedBefore);
+
+    nScriptCheckThreads = nScriptCheckThreadsBackup;
+}
+
 
 extern CBlockIndex* AddToBlockIndex(const CBlockHeader& block);
 extern void CleanUpAll();
@@ -63,9 +63,43 @@ TEST_F(SidechainsTxCumulativeHashTestSuite, CBlockIndexCumulativeHashCheck)
     EXPECT_TRUE(pindex->pprev == prevPindex);
 
     CFieldElement expectedHash = CFieldElement::ComputeHash(prevCumulativeHash, currentHash);
-    EXPECT_TRUE(expectedHash.GetLegacyHash() == pindex->scCumTreeHash.GetLegacyHash())
+    EXPECT_TRUE(expectedHash.GetLegacyHash() == pindex->scCumTreeHash.ToFieldElement().GetLegacyHash())
     <<expectedHash.GetLegacyHash().ToString()<<"\n"
-    <<pindex->scCumTreeHash.GetLegacyHash().ToString();
+    <<pindex->scCumTreeHash.ToFieldElement().GetLegacyHash().ToString();
 
     UnloadBlockIndex();
 }
+
+TEST_F(SidechainsTxCumulativeHashTestSuite, CompactFieldElementIsSerializedAsFieldElement)
+{
+    CFieldElement fieldElement{SAMPLE_FIELD};
+    CCompactFieldElement compact{fieldElement};
+    EXPECT_TRUE(compact == fieldElement);
+    EXPECT_TRUE(compact.ToFieldElement() == fieldElement);
+    EXPECT_TRUE(compact.GetHexRepr() == fieldElement.GetHexRepr());
+
+    CDataStream ssCompact(SER_DISK, PROTOCOL_VERSION);
+    ssCompact << compact;
+    CDataStream ssFieldElement(SER_DISK, PROTOCOL_VERSION);
+    ssFieldElement << fieldElement;
+    EXPECT_TRUE(ssCompact.str() == ssFieldElement.str());
+
+    CCompactFieldElement compactRead;
+    ssFieldElement >> compactRead;
+    EXPECT_TRUE(compactRead == compact);
+
+    // null elements are serialized as an empty byte vector
+    CCompactFieldElement nullCompact{CFieldElement{}};
+    EXPECT_TRUE(nullCompact.IsNull());
+    EXPECT_TRUE(nullCompact < compact);
+    CDataStream ssNull(SER_DISK, PROTOCOL_VERSION);
+    ssNull << nullCompact;
+    CFieldElement nullRead{SAMPLE_FIELD};
+    ssNull >> nullRead;
+    EXPECT_TRUE(nullRead.IsNull());
+
+    // any size other than the field element one is rejected
+    CDataStream ssWrongSize(SER_DISK, PROTOCOL_VERSION);
+    ssWrongSize << std::vector<unsigned char>(CFieldElement::ByteSize() - 1, 0x1);
+    EXPECT_THROW(ssWrongSize >> compactRead, std::ios_base::failure);
+}
@@ -99,6 +99,19 @@ public:
         GenerateSpendTxSet();
     }
 
+    CMutableTransaction CreateSpendTx(const COutPoint& prevout, CAmount nValueIn, CAmount nFee)
+    {
+        CMutableTransaction tx;
+        tx.nVersion = 2;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.resizeOut(1);
+        tx.getOut(0).nValue = nValueIn - nFee;
+        tx.getOut(0).scriptPubKey = GetScriptPubKey();
+        EXPECT_TRUE(SignSignature(m_keystore, GetScriptPubKey(), tx, 0));
+        return tx;
+    }
+
 private:
     void GenerateFakeCoinSet()
     {
@@ -369,3 +382,105 @@ TEST_F(GetBlockTemplateTest, TxWith100Inputs)
         throw ex;
     }
 }
+
+TEST_F(GetBlockTemplateTest, DefaultTemplateTakesFeesFromPackages)
+{
+    TxFactory txFactory(NUM_FAKE_COINS, 0, NUM_BLOCKS);
+    txFactory.Generate();
+
+    TestCCoinsViewDB dbCoins(COINS_DB_CACHE_SIZE, true);
+    ASSERT_TRUE(dbCoins.BatchWrite(txFactory.fakeCoins));
+
+    InitBlockTreeDB();
+    InitSetupCoinsViewCache(&dbCoins);
+    mempool.clear();
+
+    // a parent paying no fee and a child paying for both, none of them old enough for the priority area:
+    // the fee part of the template takes the child only if it is walked by ancestor score
+    const auto& coin = *txFactory.fakeCoins.begin();
+    const CAmount nCoinValue = coin.second.coins.vout[0].nValue;
+    CTransaction parent(txFactory.CreateSpendTx(COutPoint(coin.first, 0), nCoinValue, 0));
+    CTransaction child(txFactory.CreateSpendTx(COutPoint(parent.GetHash(), 0), nCoinValue, 10000));
+    ASSERT_TRUE(mempool.addUnchecked(parent.GetHash(), CTxMemPoolEntry(parent, 0, GetTime(), 0.0, lastBlock().nHeight)));
+    ASSERT_TRUE(mempool.addUnchecked(child.GetHash(), CTxMemPoolEntry(child, 10000, GetTime(), 0.0, lastBlock().nHeight)));
+
+    // default -blockprioritysize
+    ASSERT_EQ(mapArgs.count("-blockprioritysize"), 0U);
+    TestReserveKey reserveKey;
+    std::unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlock(*GetMinerScriptPubKey(reserveKey)));
+    ASSERT_TRUE(pblocktemplate != nullptr);
+
+    ASSERT_EQ(pblocktemplate->block.vtx.size(), 3U);
+    EXPECT_TRUE(pblocktemplate->block.vtx[1].GetHash() == parent.GetHash());
+    EXPECT_TRUE(pblocktemplate->block.vtx[2].GetHash() == child.GetHash());
+
+    mempool.clear();
+    ClearDatadirCache();
+}
+
+TEST(GetBlockTemplate, TxesAreSortedByArrival)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    mempool.clear();
+
+    CMutableTransaction mtxParent;
+    mtxParent.vin.resize(1);
+    mtxParent.vin[0].prevout = COutPoint(uint256S("aaa"), 0);
+    mtxParent.addOut(CTxOut(CAmount(100), CScript() << OP_TRUE));
+    CTransaction parent(mtxParent);
+
+    CMutableTransaction mtxChild;
+    mtxChild.vin.resize(1);
+    mtxChild.vin[0].prevout = COutPoint(parent.GetHash(), 0);
+    mtxChild.addOut(CTxOut(CAmount(90), CScript() << OP_TRUE));
+    CTransaction child(mtxChild);
+
+    CMutableTransaction mtxOther;
+    mtxOther.vin.resize(1);
+    mtxOther.vin[0].prevout = COutPoint(uint256S("bbb"), 0);
+    mtxOther.addOut(CTxOut(CAmount(80), CScript() << OP_TRUE));
+    CTransaction other(mtxOther);
+
+    // the parent re-entered the mempool after its child, as it happens on a reorg
+    ASSERT_TRUE(mempool.addUnchecked(child.GetHash(), CTxMemPoolEntry(child, 10, 100, 0.0, 1)));
+    ASSERT_TRUE(mempool.addUnchecked(other.GetHash(), CTxMemPoolEntry(other, 30, 200, 0.0, 1)));
+    ASSERT_TRUE(mempool.addUnchecked(parent.GetHash(), CTxMemPoolEntry(parent, 20, 300, 0.0, 1)));
+
+    // fee ordering
+    CBlockTemplate blocktemplate;
+    blocktemplate.block.vtx = {CTransaction(), other, parent, child};
+    blocktemplate.vTxFees = {-60, 30, 20, 10};
+    blocktemplate.vTxSigOps = {0, 3, 2, 1};
+
+    SortBlockTxsByArrival(blocktemplate);
+
+    ASSERT_EQ(blocktemplate.block.vtx.size(), 4);
+    EXPECT_TRUE(blocktemplate.block.vtx[0].GetHash() == CTransaction().GetHash());
+    EXPECT_TRUE(blocktemplate.block.vtx[1].GetHash() == other.GetHash());
+    EXPECT_TRUE(blocktemplate.block.vtx[2].GetHash() == parent.GetHash());
+    EXPECT_TRUE(blocktemplate.block.vtx[3].GetHash() == child.GetHash());
+    EXPECT_EQ(blocktemplate.vTxFees, std::vector<CAmount>({-60, 30, 20, 10}));
+    EXPECT_EQ(blocktemplate.vTxSigOps, std::vector<int64_t>({0, 3, 2, 1}));
+
+    // a newcomer paying more lands at the end
+    CMutableTransaction mtxNewcomer;
+    mtxNewcomer.vin.resize(1);
+    mtxNewcomer.vin[0].prevout = COutPoint(uint256S("ccc"), 0);
+    mtxNewcomer.addOut(CTxOut(CAmount(70), CScript() << OP_TRUE));
+    CTransaction newcomer(mtxNewcomer);
+    ASSERT_TRUE(mempool.addUnchecked(newcomer.GetHash(), CTxMemPoolEntry(newcomer, 50, 400, 0.0, 1)));
+
+    blocktemplate.block.vtx = {CTransaction(), newcomer, other, parent, child};
+    blocktemplate.vTxFees = {-110, 50, 30, 20, 10};
+    blocktemplate.vTxSigOps = {0, 4, 3, 2, 1};
+
+    SortBlockTxsByArrival(blocktemplate);
+
+    EXPECT_TRUE(blocktemplate.block.vtx[1].GetHash() == other.GetHash());
+    EXPECT_TRUE(blocktemplate.block.vtx[2].GetHash() == parent.GetHash());
+    EXPECT_TRUE(blocktemplate.block.vtx[3].GetHash() == child.GetHash());
+    EXPECT_TRUE(blocktemplate.block.vtx[4].GetHash() == newcomer.GetHash());
+    EXPECT_EQ(blocktemplate.vTxFees, std::vector<CAmount>({-110, 30, 20, 10, 50}));
+
+    mempool.clear();
+}
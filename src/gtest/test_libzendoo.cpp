@@ -3,6 +3,7 @@
 #include <sc/sidechaintypes.h>
 #include <primitives/transaction.h>
 #include <primitives/certificate.h>
+#include <primitives/block.h>
 #include <sc/sidechainTxsCommitmentBuilder.h>
 #include "tx_creation_utils.h"
 
@@ -1593,6 +1594,123 @@ TEST(CctpLibrary, CommitmentTreeBuilding_Object)
     printf("cmt = [%s]\n", cmt.ToString().c_str());
 }
 
+TEST(CctpLibrary, CommitmentTreeBuilding_Incremental)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const BlockchainTestManager& testManager = BlockchainTestManager::GetInstance();
+    const CCoinsViewCache& view = *testManager.CoinsViewCache();
+
+    CTransaction scCreationTx = CreateDefaultTx();
+    uint256 scId = scCreationTx.GetScIdFromScCcOut(0);
+    CTransaction fwdTx_1 = txCreationUtils::createFwdTransferTxWith(scId, CAmount(7));
+    CTransaction fwdTx_2 = txCreationUtils::createFwdTransferTxWith(scId, CAmount(8));
+    CScCertificate cert = CreateDefaultCert();
+
+    IncrementalScTxsCommitmentBuilder incrementalBuilder;
+
+    CBlock block;
+    block.hashPrevBlock = uint256S("aaa");
+    block.vtx.push_back(scCreationTx);
+    EXPECT_TRUE(incrementalBuilder.getCommitment(block, view) == block.BuildScTxsCommitment(view));
+    EXPECT_TRUE(incrementalBuilder.size() == 1);
+
+    // appended items extend the existing tree
+    block.vtx.push_back(fwdTx_1);
+    block.vcert.push_back(cert);
+    EXPECT_TRUE(incrementalBuilder.getCommitment(block, view) == block.BuildScTxsCommitment(view));
+    EXPECT_TRUE(incrementalBuilder.size() == 3);
+
+    // a tx placed before a cert already in the tree forces a rebuild
+    block.vtx.push_back(fwdTx_2);
+    EXPECT_TRUE(incrementalBuilder.getCommitment(block, view) == block.BuildScTxsCommitment(view));
+    EXPECT_TRUE(incrementalBuilder.size() == 4);
+
+    // an item leaving the mempool drops the tree
+    incrementalBuilder.remove(fwdTx_1.GetHash());
+    EXPECT_TRUE(incrementalBuilder.size() == 0);
+    block.vtx.erase(block.vtx.begin() + 1);
+    EXPECT_TRUE(incrementalBuilder.getCommitment(block, view) == block.BuildScTxsCommitment(view));
+    EXPECT_TRUE(incrementalBuilder.size() == 3);
+
+    // a new tip forces a rebuild as well
+    block.hashPrevBlock = uint256S("bbb");
+    block.vtx.resize(1);
+    block.vcert.clear();
+    EXPECT_TRUE(incrementalBuilder.getCommitment(block, view) == block.BuildScTxsCommitment(view));
+    EXPECT_TRUE(incrementalBuilder.size() == 1);
+}
+
+TEST(CctpLibrary, CommitmentTreeBuilding_Incremental_ReuseRate)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const BlockchainTestManager& testManager = BlockchainTestManager::GetInstance();
+    const CCoinsViewCache& view = *testManager.CoinsViewCache();
+
+    // fwds entering the mempool one at a time, fees interleaved, a new template after each arrival
+    const std::vector<CAmount> vFees = {3, 9, 1, 7, 5, 10, 2, 8};
+    std::vector<std::pair<CAmount, CTransaction> > vArrived;
+
+    IncrementalScTxsCommitmentBuilder byFeeBuilder;
+    IncrementalScTxsCommitmentBuilder byArrivalBuilder;
+
+    for (size_t i = 0; i < vFees.size(); i++)
+    {
+        vArrived.push_back(std::make_pair(vFees[i],
+            txCreationUtils::createFwdTransferTxWith(uint256S(std::to_string(i)), CAmount(i + 1))));
+
+        CBlock byArrival;
+        byArrival.hashPrevBlock = uint256S("aaa");
+        for (const auto& feeAndTx : vArrived)
+            byArrival.vtx.push_back(feeAndTx.second);
+        EXPECT_TRUE(byArrivalBuilder.getCommitment(byArrival, view) == byArrival.BuildScTxsCommitment(view));
+
+        std::vector<std::pair<CAmount, CTransaction> > vSortedByFee(vArrived);
+        std::stable_sort(vSortedByFee.begin(), vSortedByFee.end(),
+            [](const std::pair<CAmount, CTransaction>& a, const std::pair<CAmount, CTransaction>& b) { return a.first > b.first; });
+        CBlock byFee;
+        byFee.hashPrevBlock = uint256S("aaa");
+        for (const auto& feeAndTx : vSortedByFee)
+            byFee.vtx.push_back(feeAndTx.second);
+        EXPECT_TRUE(byFeeBuilder.getCommitment(byFee, view) == byFee.BuildScTxsCommitment(view));
+    }
+
+    // arrival order extends the tree at every template but the first one, while fee order
+    // does it only when the newcomer pays less than anything already there (fee 1 after 3 and 9)
+    EXPECT_EQ(byArrivalBuilder.getHits(), vFees.size() - 1);
+    EXPECT_EQ(byArrivalBuilder.getMisses(), 1U);
+    EXPECT_EQ(byFeeBuilder.getHits(), 1U);
+    EXPECT_EQ(byFeeBuilder.getMisses(), vFees.size() - 1);
+}
+
+TEST(CctpLibrary, CommitmentTreeBuilding_Parallel)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const BlockchainTestManager& testManager = BlockchainTestManager::GetInstance();
+    const CCoinsViewCache& view = *testManager.CoinsViewCache();
+
+    std::vector<CTransaction> vtx;
+    vtx.push_back(CreateDefaultTx());
+    for (int i = 0; i < 10; i++)
+        vtx.push_back(txCreationUtils::createFwdTransferTxWith(uint256S(std::to_string(i)), CAmount(i + 1)));
+
+    std::vector<CScCertificate> vcert;
+    vcert.push_back(CreateDefaultCert());
+
+    SidechainTxsCommitmentBuilder serialBuilder;
+    for (const CTransaction& tx : vtx)
+        ASSERT_TRUE(serialBuilder.add(tx));
+    for (const CScCertificate& cert : vcert)
+        ASSERT_TRUE(serialBuilder.add(cert, view));
+    uint256 serialCommitment = serialBuilder.getCommitment();
+
+    for (unsigned int nThreads : {1, 2, 4, 16})
+    {
+        SidechainTxsCommitmentBuilder parallelBuilder;
+        ASSERT_TRUE(parallelBuilder.add(vtx, vcert, view, nThreads));
+        EXPECT_TRUE(parallelBuilder.getCommitment() == serialCommitment) << nThreads;
+    }
+}
+
 static unsigned char genericArr[37] = {
     0x3e, 0x61, 0xea, 0xe3, 0x11, 0xa5, 0xe1, 0x1a,
     0x52, 0xdf, 0xb5, 0xe1, 0xc0, 0x06, 0xe1, 0x77,
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include "netpoll.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+TEST(NetPoll, PollerReportsTheWatchedEvents) {
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+    CSocketPoller poller;
+    ASSERT_TRUE(poller.IsValid());
+    int nRegistered = 0;
+
+    poller.Watch(sockets[0], SOCKET_EVENT_RECV, nRegistered);
+    EXPECT_NE(nRegistered, 0);
+    EXPECT_TRUE(poller.Wait(0));
+    EXPECT_EQ(poller.GetEvents(sockets[0]), 0);
+
+    ASSERT_EQ(write(sockets[1], "x", 1), 1);
+    poller.Watch(sockets[0], SOCKET_EVENT_RECV, nRegistered);
+    EXPECT_TRUE(poller.Wait(1000));
+    EXPECT_EQ(poller.GetEvents(sockets[0]), SOCKET_EVENT_RECV);
+
+    // the interest follows the last Watch
+    poller.Watch(sockets[0], SOCKET_EVENT_SEND, nRegistered);
+    EXPECT_TRUE(poller.Wait(1000));
+    EXPECT_EQ(poller.GetEvents(sockets[0]), SOCKET_EVENT_SEND);
+
+    close(sockets[0]);
+    close(sockets[1]);
+
+    // a descriptor reused by a new owner is registered again
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    ASSERT_EQ(write(sockets[1], "x", 1), 1);
+    int nRegisteredNew = 0;
+    poller.Watch(sockets[0], SOCKET_EVENT_RECV, nRegisteredNew);
+    EXPECT_TRUE(poller.Wait(1000));
+    EXPECT_EQ(poller.GetEvents(sockets[0]), SOCKET_EVENT_RECV);
+
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+TEST(NetPoll, WaitForSocketTimesOut) {
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+    EXPECT_EQ(WaitForSocket(sockets[0], SOCKET_EVENT_RECV, 10), 0);
+    EXPECT_EQ(WaitForSocket(sockets[0], SOCKET_EVENT_SEND, 10), SOCKET_EVENT_SEND);
+
+    close(sockets[1]);
+    EXPECT_NE(WaitForSocket(sockets[0], SOCKET_EVENT_RECV, 1000) & SOCKET_EVENT_RECV, 0);
+
+    close(sockets[0]);
+}
@@ -588,3 +588,134 @@ bool ReindexTestSuite::storeToFile(CBlock& blkToStore, CDiskBlockPos& diskBlkPos
 
     return res;
 }
+
+TEST(ChainstateSnapshot, DumpedChainstateIsLoadedIntoAnEmptyOne) {
+    SelectParams(CBaseChainParams::REGTEST);
+    boost::filesystem::path sourceDataDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::path targetDataDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(sourceDataDir);
+    boost::filesystem::create_directories(targetDataDir);
+    const unsigned int chainStateDbSize = 2 * 1024 * 1024;
+    const std::string snapshotFile = (sourceDataDir / "chainstate.snapshot").string();
+
+    const uint256 hashBlock = uint256S("bb");
+    const uint256 scId = uint256S("aa");
+    uint256 nullifierValue = uint256S("cc");
+    const CCompactFieldElement nullifier{CFieldElement{nullifierValue}};
+    CSidechainEvents scEvents;
+    scEvents.ceasingScs.insert(scId);
+
+    mapArgs["-datadir"] = sourceDataDir.string();
+    ClearDatadirCache();
+    CCoinsViewDB* pSourceDb = new CCoinsViewDB(chainStateDbSize, false, /*fWipe*/true);
+    {
+        CCoinsMap mapCoins;
+        CAnchorsMap mapAnchors;
+        CNullifiersMap mapNullifiers;
+        CSidechainsMap mapSidechains;
+        CSidechainEventsMap mapSidechainEvents;
+        CCswNullifiersMap cswNullifiers;
+
+        // more coins than fit in a chunk
+        for (size_t i = 0; i < CChainstateSnapshotHeader::MAX_CHUNK_RECORDS + 1; i++)
+        {
+            CCoinsCacheEntry& entry = mapCoins[ArithToUint256(arith_uint256(i + 1))];
+            entry.coins.nVersion = 1;
+            entry.coins.nHeight = 1;
+            entry.coins.vout.push_back(CTxOut(CAmount(i + 1), CScript() << OP_TRUE));
+            entry.flags = CCoinsCacheEntry::DIRTY;
+        }
+        mapSidechainEvents[500] = CSidechainEventsCacheEntry(scEvents, CSidechainEventsCacheEntry::Flags::FRESH);
+        cswNullifiers[std::make_pair(scId, nullifier)] = CCswNullifiersCacheEntry(CCswNullifiersCacheEntry::Flags::FRESH);
+        ASSERT_TRUE(pSourceDb->BatchWrite(mapCoins, hashBlock, uint256(), mapAnchors, mapNullifiers,
+                                          mapSidechains, mapSidechainEvents, cswNullifiers));
+    }
+
+    CChainstateSnapshotInfo dumpInfo;
+    ASSERT_TRUE(pSourceDb->DumpSnapshot(snapshotFile, dumpInfo));
+    EXPECT_TRUE(dumpInfo.hashBlock == hashBlock);
+    EXPECT_EQ(dumpInfo.nChunks, 2);
+    delete pSourceDb;
+
+    mapArgs["-datadir"] = targetDataDir.string();
+    ClearDatadirCache();
+    CCoinsViewDB* pTargetDb = new CCoinsViewDB(chainStateDbSize, false, /*fWipe*/true);
+    CChainstateSnapshotInfo loadInfo;
+
+    // a snapshot not matching the expected commitment is refused, and the records read so far wiped
+    EXPECT_FALSE(pTargetDb->LoadSnapshot(snapshotFile, uint256S("dd"), loadInfo));
+    EXPECT_TRUE(pTargetDb->GetBestBlock().IsNull());
+    EXPECT_FALSE(pTargetDb->HaveCoins(ArithToUint256(arith_uint256(1))));
+    EXPECT_FALSE(pTargetDb->HaveSidechainEvents(500));
+
+    loadInfo = CChainstateSnapshotInfo();
+    ASSERT_TRUE(pTargetDb->LoadSnapshot(snapshotFile, dumpInfo.hashCommitment, loadInfo));
+    EXPECT_TRUE(loadInfo.hashCommitment == dumpInfo.hashCommitment);
+    EXPECT_EQ(loadInfo.nRecords, dumpInfo.nRecords);
+
+    EXPECT_TRUE(pTargetDb->GetBestBlock() == hashBlock);
+    CCoins coins;
+    ASSERT_TRUE(pTargetDb->GetCoins(ArithToUint256(arith_uint256(CChainstateSnapshotHeader::MAX_CHUNK_RECORDS + 1)), coins));
+    EXPECT_EQ(coins.vout[0].nValue, CAmount(CChainstateSnapshotHeader::MAX_CHUNK_RECORDS + 1));
+    EXPECT_TRUE(pTargetDb->HaveSidechainEvents(500));
+    EXPECT_TRUE(pTargetDb->HaveCswNullifier(scId, nullifier.ToFieldElement()));
+
+    // a chainstate is never overwritten
+    EXPECT_FALSE(pTargetDb->LoadSnapshot(snapshotFile, dumpInfo.hashCommitment, loadInfo));
+    delete pTargetDb;
+
+    ClearDatadirCache();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(sourceDataDir.string(), ec);
+    boost::filesystem::remove_all(targetDataDir.string(), ec);
+}
+
+TEST(ChainstateSnapshot, CorruptedSnapshotIsRejected) {
+    SelectParams(CBaseChainParams::REGTEST);
+    boost::filesystem::path dataDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(dataDir);
+    const unsigned int chainStateDbSize = 2 * 1024 * 1024;
+    const std::string snapshotFile = (dataDir / "chainstate.snapshot").string();
+    mapArgs["-datadir"] = dataDir.string();
+    ClearDatadirCache();
+
+    CCoinsViewDB* pDb = new CCoinsViewDB(chainStateDbSize, false, /*fWipe*/true);
+    {
+        CCoinsMap mapCoins;
+        CAnchorsMap mapAnchors;
+        CNullifiersMap mapNullifiers;
+        CSidechainsMap mapSidechains;
+        CSidechainEventsMap mapSidechainEvents;
+        CCswNullifiersMap cswNullifiers;
+        CCoinsCacheEntry& entry = mapCoins[uint256S("01")];
+        entry.coins.nVersion = 1;
+        entry.coins.vout.push_back(CTxOut(CAmount(1), CScript() << OP_TRUE));
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        ASSERT_TRUE(pDb->BatchWrite(mapCoins, uint256S("bb"), uint256(), mapAnchors, mapNullifiers,
+                                    mapSidechains, mapSidechainEvents, cswNullifiers));
+    }
+    CChainstateSnapshotInfo info;
+    ASSERT_TRUE(pDb->DumpSnapshot(snapshotFile, info));
+    delete pDb;
+
+    // flip the last byte of the first chunk checksum, right before the empty chunk and the commitment
+    {
+        boost::filesystem::fstream file(snapshotFile, std::ios::in | std::ios::out | std::ios::binary);
+        const std::streamoff offset = boost::filesystem::file_size(snapshotFile) - 32 - 1 - 32 - 1;
+        file.seekg(offset);
+        char byte = file.get();
+        file.seekp(offset);
+        file.put(byte ^ 0x01);
+    }
+
+    pDb = new CCoinsViewDB(chainStateDbSize, false, /*fWipe*/true);
+    CChainstateSnapshotInfo loadInfo;
+    EXPECT_FALSE(pDb->LoadSnapshot(snapshotFile, info.hashCommitment, loadInfo));
+    EXPECT_TRUE(pDb->GetBestBlock().IsNull());
+    EXPECT_FALSE(pDb->HaveCoins(uint256S("01")));
+    delete pDb;
+
+    ClearDatadirCache();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(dataDir.string(), ec);
+}
@@ -2,6 +2,7 @@
 #include "tx_creation_utils.h"
 #include <gtest/libzendoo_test_files.h>
 #include <sc/sidechain.h>
+#include <sc/sidechainjournal.h>
 #include <boost/filesystem.hpp>
 #include <txdb.h>
 #include <chainparams.h>
@@ -1038,6 +1039,34 @@ TEST_F(SidechainsTestSuite, RevertingFwdTransferRemovesCoinsFromImmatureBalance)
     EXPECT_FALSE(revertedSc.mImmatureAmounts.count(fwdTxHeight + sidechainsView->getScCoinsMaturity()));
 }
 
+TEST_F(SidechainsTestSuite, SidechainChangesAreRecordedAsDeltas) {
+    CTransaction scCreationTx = txCreationUtils::createNewSidechainTxWith(CAmount(10));
+    const uint256& scId = scCreationTx.GetScIdFromScCcOut(0);
+    int scCreationHeight {1};
+    CBlock dummyBlock;
+    ASSERT_TRUE(sidechainsView->UpdateSidechain(scCreationTx, dummyBlock, scCreationHeight));
+
+    CTransaction fwdTx = txCreationUtils::createFwdTransferTxWith(scId, CAmount(7));
+    ASSERT_TRUE(sidechainsView->UpdateSidechain(fwdTx, dummyBlock, scCreationHeight));
+
+    //checks
+    const std::vector<CSidechainDelta>& deltas = sidechainsView->GetSidechainDeltas();
+    ASSERT_EQ(deltas.size(), 2);
+    EXPECT_TRUE(deltas[0].type == CSidechainDelta::Type::CREATION);
+    EXPECT_EQ(deltas[0].scId, scId);
+    EXPECT_EQ(deltas[0].amount, CAmount(10));
+    EXPECT_EQ(deltas[0].refHash, scCreationTx.GetHash());
+    EXPECT_TRUE(deltas[1].type == CSidechainDelta::Type::FORWARD_TRANSFER);
+    EXPECT_EQ(deltas[1].amount, CAmount(7));
+    EXPECT_EQ(deltas[1].refHash, fwdTx.GetHash());
+
+    // reverting records the undone changes as well
+    sidechainsView->ClearSidechainDeltas();
+    ASSERT_TRUE(sidechainsView->RevertTxOutputs(fwdTx, scCreationHeight));
+    ASSERT_EQ(sidechainsView->GetSidechainDeltas().size(), 1);
+    EXPECT_TRUE(sidechainsView->GetSidechainDeltas()[0].type == CSidechainDelta::Type::FORWARD_TRANSFER);
+}
+
 TEST_F(SidechainsTestSuite, ScCreationTxCannotBeRevertedIfScIsNotPreviouslyCreated) {
     CTransaction scCreationTx = txCreationUtils::createNewSidechainTxWith(CAmount(15));
     const uint256& scId = scCreationTx.GetScIdFromScCcOut(0);
@@ -1612,6 +1641,164 @@ TEST_F(SidechainsTestSuite, GetScIdsOnChainstateDbSelectOnlySidechains) {
     boost::system::error_code ec;
     boost::filesystem::remove_all(pathTemp.string(), ec);
 }
+
+TEST_F(SidechainsTestSuite, SidechainRecordsAreStoredSplitInChainstate) {
+
+    //init a tmp chainstateDb
+    boost::filesystem::path pathTemp(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+    const unsigned int      chainStateDbSize(2 * 1024 * 1024);
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+
+    CCoinsViewDB chainStateDb(chainStateDbSize,/*fWipe*/true);
+
+    const uint256 scId = uint256S("aaaa");
+    CSidechainsCacheEntry entry;
+    // a sidechain created and then modified in a cache reaches the db as dirty
+    entry.flag = CSidechainsCacheEntry::Flags::DIRTY;
+    entry.sidechain.creationBlockHeight = 100;
+    entry.sidechain.balance = CAmount(5);
+    entry.sidechain.fixedParams.withdrawalEpochLength = 10;
+    entry.sidechain.fixedParams.customData = {0x01, 0x02, 0x03};
+    entry.sidechain.InitScFees();
+
+    CCoinsMap         dummyCoinsMap;
+    CAnchorsMap       dummyAnchorsMap;
+    CNullifiersMap    dummyNullifiersMap;
+    CSidechainEventsMap dummyEventsMap;
+    CCswNullifiersMap cswNullifiers;
+    CSidechainsMap mapSidechains;
+    mapSidechains[scId] = entry;
+    ASSERT_TRUE(chainStateDb.BatchWrite(dummyCoinsMap, uint256(), uint256(), dummyAnchorsMap, dummyNullifiersMap, mapSidechains, dummyEventsMap, cswNullifiers));
+
+    CSidechain stored;
+    ASSERT_TRUE(chainStateDb.GetSidechain(scId, stored));
+    EXPECT_TRUE(stored == entry.sidechain);
+
+    //test: updating the mutable fields only
+    entry.sidechain.balance = CAmount(7);
+    mapSidechains[scId] = entry;
+    ASSERT_TRUE(chainStateDb.BatchWrite(dummyCoinsMap, uint256(), uint256(), dummyAnchorsMap, dummyNullifiersMap, mapSidechains, dummyEventsMap, cswNullifiers));
+
+    //check
+    ASSERT_TRUE(chainStateDb.GetSidechain(scId, stored));
+    EXPECT_TRUE(stored.balance == CAmount(7));
+    EXPECT_TRUE(stored.fixedParams == entry.sidechain.fixedParams);
+    EXPECT_TRUE(stored.maxSizeOfScFeesContainers == entry.sidechain.maxSizeOfScFeesContainers);
+
+    //test: erasing removes both parts
+    entry.flag = CSidechainsCacheEntry::Flags::ERASED;
+    mapSidechains[scId] = entry;
+    ASSERT_TRUE(chainStateDb.BatchWrite(dummyCoinsMap, uint256(), uint256(), dummyAnchorsMap, dummyNullifiersMap, mapSidechains, dummyEventsMap, cswNullifiers));
+
+    //check
+    EXPECT_FALSE(chainStateDb.HaveSidechain(scId));
+    EXPECT_FALSE(chainStateDb.GetSidechain(scId, stored));
+
+    ClearDatadirCache();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(pathTemp.string(), ec);
+}
+
+class CCoinsViewDBWithFormatVersion : public CCoinsViewDB
+{
+public:
+    CCoinsViewDBWithFormatVersion(size_t nCacheSize, bool fWipe) : CCoinsViewDB(nCacheSize, false, fWipe) {}
+
+    void SetFormatVersion(int nVersion) { db.Write(std::make_pair('F', std::string("formatversion")), nVersion, true); }
+};
+
+TEST_F(SidechainsTestSuite, ChainstateWithNewerFormatIsNotOpened) {
+
+    //init a tmp chainstateDb
+    boost::filesystem::path pathTemp(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+    const unsigned int      chainStateDbSize(2 * 1024 * 1024);
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+
+    std::unique_ptr<CCoinsViewDBWithFormatVersion> pChainStateDb(new CCoinsViewDBWithFormatVersion(chainStateDbSize,/*fWipe*/true));
+    pChainStateDb.reset();
+
+    //test: a chainstate written by this version is opened again
+    EXPECT_NO_THROW(pChainStateDb.reset(new CCoinsViewDBWithFormatVersion(chainStateDbSize,/*fWipe*/false)));
+
+    //test: a chainstate written by a newer version is refused
+    pChainStateDb->SetFormatVersion(1000);
+    pChainStateDb.reset();
+    EXPECT_THROW(CCoinsViewDB(chainStateDbSize, false, /*fWipe*/false), std::runtime_error);
+
+    ClearDatadirCache();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(pathTemp.string(), ec);
+}
+
+TEST_F(SidechainsTestSuite, GetScIndexEntriesIsOrderedAndPaged) {
+
+    //init a tmp chainstateDb
+    boost::filesystem::path pathTemp(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+    const unsigned int      chainStateDbSize(2 * 1024 * 1024);
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+
+    CCoinsViewDB chainStateDb(chainStateDbSize,/*fWipe*/true);
+    sidechainsView->SetBackend(chainStateDb);
+
+    //Insert in db three sidechains, created at decreasing heights
+    CSidechainsMap mapSidechains;
+    std::vector<uint256> scIds = { uint256S("aaaa"), uint256S("bbbb"), uint256S("cccc") };
+    for (unsigned int idx = 0; idx < scIds.size(); ++idx)
+    {
+        CSidechainsCacheEntry sidechain;
+        sidechain.flag = CSidechainsCacheEntry::Flags::FRESH;
+        sidechain.sidechain.creationBlockHeight = 300 - 100 * idx;
+        sidechain.sidechain.fixedParams.withdrawalEpochLength = 10;
+        mapSidechains[scIds[idx]] = sidechain;
+    }
+
+    CCoinsMap         dummyCoinsMap;
+    CAnchorsMap       dummyAnchorsMap;
+    CNullifiersMap    dummyNullifiersMap;
+    CSidechainEventsMap dummyEventsMap;
+    CCswNullifiersMap cswNullifiers;
+    chainStateDb.BatchWrite(dummyCoinsMap, uint256(), uint256(), dummyAnchorsMap, dummyNullifiersMap, mapSidechains, dummyEventsMap, cswNullifiers);
+
+    //Create a fourth sidechain in the cache only, at the same height of the first one
+    CTransaction scTx = txCreationUtils::createNewSidechainTxWith(CAmount(10), /*epochLength*/10);
+    uint256 cachedScId = scTx.GetScIdFromScCcOut(0);
+    CBlock dummyBlock;
+    ASSERT_TRUE(sidechainsView->UpdateSidechain(scTx, dummyBlock, /*height*/300));
+
+    //test: first page
+    std::vector<CSidechainIndexEntry> entries;
+    sidechainsView->GetScIndexEntries(CSidechainIndexEntry(), 2, /*bOnlyAlive*/false, /*height*/0, entries);
+
+    //check
+    ASSERT_TRUE(entries.size() == 2);
+    EXPECT_TRUE(entries[0].scId == scIds[2]);
+    EXPECT_TRUE(entries[1].scId == scIds[1]);
+
+    //test: second page, resuming from the cursor
+    CSidechainIndexEntry after;
+    ASSERT_TRUE(CSidechainIndexEntry::FromCursor(entries.back().ToCursor(), after));
+    sidechainsView->GetScIndexEntries(after, 2, /*bOnlyAlive*/false, /*height*/0, entries);
+
+    //check: height 300 entries are sorted by scId
+    ASSERT_TRUE(entries.size() == 2);
+    EXPECT_TRUE(entries[0].creationHeight == 300 && entries[1].creationHeight == 300);
+    EXPECT_TRUE(entries[0].scId < entries[1].scId);
+    EXPECT_TRUE(std::set<uint256>({entries[0].scId, entries[1].scId}) == std::set<uint256>({scIds[0], cachedScId}));
+
+    //test: only alive, at a height where the older sidechains have ceased
+    sidechainsView->GetScIndexEntries(CSidechainIndexEntry(), 10, /*bOnlyAlive*/true, /*height*/250, entries);
+
+    //check
+    ASSERT_TRUE(entries.size() == 2);
+    EXPECT_TRUE(entries[0].creationHeight == 300 && entries[1].creationHeight == 300);
+
+    ClearDatadirCache();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(pathTemp.string(), ec);
+}
 /////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////// GetSidechain /////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
@@ -2114,3 +2301,89 @@ TEST_F(SidechainsTestSuite, CertificateViewInitialization)
     CScCertificateView certView;
     ASSERT_TRUE(certView.IsNull());
 }
+
+TEST(SidechainJournal, EntriesAreFilteredAndBounded)
+{
+    CSidechainJournal journal(2);
+    const uint256 scIdA = uint256S("aaaa");
+    const uint256 scIdB = uint256S("bbbb");
+
+    std::vector<CSidechainDelta> deltas;
+    deltas.push_back(CSidechainDelta(CSidechainDelta::Type::CREATION, scIdA, CAmount(10), uint256S("01")));
+    EXPECT_EQ(journal.Append(uint256S("b1"), 1, true, deltas), 1);
+
+    deltas.clear();
+    deltas.push_back(CSidechainDelta(CSidechainDelta::Type::FORWARD_TRANSFER, scIdB, CAmount(5), uint256S("02")));
+    deltas.push_back(CSidechainDelta(CSidechainDelta::Type::FORWARD_TRANSFER, scIdA, CAmount(3), uint256S("03")));
+    EXPECT_EQ(journal.Append(uint256S("b2"), 2, true, deltas), 2);
+
+    std::vector<CSidechainJournalEntry> entries;
+    ASSERT_TRUE(journal.GetEntriesSince(0, std::set<uint256>(), entries));
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_EQ(entries[1].deltas.size(), 2);
+
+    entries.clear();
+    ASSERT_TRUE(journal.GetEntriesSince(0, std::set<uint256>{scIdB}, entries));
+    ASSERT_EQ(entries.size(), 1);
+    EXPECT_EQ(entries[0].seq, 2);
+    ASSERT_EQ(entries[0].deltas.size(), 1);
+    EXPECT_EQ(entries[0].deltas[0].scId, scIdB);
+
+    // the journal keeps only the last two entries
+    journal.Append(uint256S("b2"), 2, false, deltas);
+    EXPECT_EQ(journal.Size(), 2);
+    entries.clear();
+    EXPECT_FALSE(journal.GetEntriesSince(0, std::set<uint256>(), entries));
+    EXPECT_TRUE(journal.GetEntriesSince(1, std::set<uint256>(), entries));
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_FALSE(entries[1].fConnected);
+
+    entries.clear();
+    EXPECT_TRUE(journal.GetEntriesSince(journal.GetLastSeq(), std::set<uint256>(), entries));
+    EXPECT_TRUE(entries.empty());
+}
+
+TEST(CoinsViewPrefetch, PrefetchedSidechainIsServedOnceAndDroppedOnWrite) {
+    CInMemorySidechainDb db;
+    const uint256 scId = uint256S("aaa");
+
+    CSidechain sidechain;
+    sidechain.balance = CAmount(10);
+    CCoinsMap mapCoins;
+    CAnchorsMap mapAnchors;
+    CNullifiersMap mapNullifiers;
+    CSidechainsMap mapSidechains;
+    CSidechainEventsMap mapSidechainEvents;
+    CCswNullifiersMap mapCswNullifiers;
+    mapSidechains[scId] = CSidechainsCacheEntry(sidechain, CSidechainsCacheEntry::Flags::FRESH);
+    ASSERT_TRUE(db.BatchWrite(mapCoins, uint256(), uint256(), mapAnchors, mapNullifiers, mapSidechains, mapSidechainEvents, mapCswNullifiers));
+
+    CCoinsViewPrefetch view(&db);
+    view.Prefetch(std::vector<uint256>(), std::vector<uint256>{scId}, std::vector<std::pair<uint256, CFieldElement> >());
+
+    uint64_t nLookups = 0, nHits = 0;
+    CSidechain retrieved;
+    EXPECT_TRUE(view.GetSidechain(scId, retrieved));
+    EXPECT_EQ(retrieved.balance, CAmount(10));
+    view.GetPrefetchStats(nLookups, nHits);
+    EXPECT_EQ(nLookups, 1);
+    EXPECT_EQ(nHits, 1);
+
+    // handed over at the first lookup, then read from the view below
+    EXPECT_TRUE(view.GetSidechain(scId, retrieved));
+    view.GetPrefetchStats(nLookups, nHits);
+    EXPECT_EQ(nLookups, 2);
+    EXPECT_EQ(nHits, 1);
+
+    // a write to the view below drops the records prefetched before it
+    view.Prefetch(std::vector<uint256>(), std::vector<uint256>{scId}, std::vector<std::pair<uint256, CFieldElement> >());
+    sidechain.balance = CAmount(20);
+    mapSidechains[scId] = CSidechainsCacheEntry(sidechain, CSidechainsCacheEntry::Flags::DIRTY);
+    ASSERT_TRUE(view.BatchWrite(mapCoins, uint256(), uint256(), mapAnchors, mapNullifiers, mapSidechains, mapSidechainEvents, mapCswNullifiers));
+
+    EXPECT_TRUE(view.GetSidechain(scId, retrieved));
+    EXPECT_EQ(retrieved.balance, CAmount(20));
+    view.GetPrefetchStats(nLookups, nHits);
+    EXPECT_EQ(nLookups, 3);
+    EXPECT_EQ(nHits, 1);
+}
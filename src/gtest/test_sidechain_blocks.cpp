@@ -175,7 +175,7 @@ TEST_F(SidechainsConnectCertsBlockTestSuite, ConnectBlock_SingleCert_SameEpoch_C
     singleCert.scId        = scId;
     singleCert.epochNumber = initialScState.lastTopQualityCertReferencedEpoch;
     singleCert.quality     = initialScState.lastTopQualityCertQuality * 2;
-    singleCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash;
+    singleCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash.ToFieldElement();
     singleCert.addBwt(CTxOut(CAmount(90), dummyScriptPubKey));
     singleCert.forwardTransferScFee = 0;
     singleCert.mainchainBackwardTransferRequestScFee = 0;
@@ -250,7 +250,7 @@ TEST_F(SidechainsConnectCertsBlockTestSuite, ConnectBlock_SingleCert_DifferentEp
     singleCert.scId        = scId;
     singleCert.epochNumber = initialScState.lastTopQualityCertReferencedEpoch + 1;
     singleCert.quality     = 1;
-    singleCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash;
+    singleCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash.ToFieldElement();
     singleCert.addBwt(CTxOut(CAmount(90), dummyScriptPubKey));
     singleCert.forwardTransferScFee = 0;
     singleCert.mainchainBackwardTransferRequestScFee = 0;
@@ -326,7 +326,7 @@ TEST_F(SidechainsConnectCertsBlockTestSuite, ConnectBlock_MultipleCerts_SameEpoc
     lowQualityCert.scId        = scId;
     lowQualityCert.epochNumber = initialScState.lastTopQualityCertReferencedEpoch;
     lowQualityCert.quality     = initialScState.lastTopQualityCertQuality * 2;
-    lowQualityCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash;
+    lowQualityCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash.ToFieldElement();
     lowQualityCert.addBwt(CTxOut(CAmount(40), dummyScriptPubKey));
     lowQualityCert.forwardTransferScFee = 0;
     lowQualityCert.mainchainBackwardTransferRequestScFee = 0;
@@ -338,7 +338,7 @@ TEST_F(SidechainsConnectCertsBlockTestSuite, ConnectBlock_MultipleCerts_SameEpoc
     highQualityCert.scId        = lowQualityCert.scId;
     highQualityCert.epochNumber = lowQualityCert.epochNumber;
     highQualityCert.quality     = lowQualityCert.quality * 2;
-    highQualityCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash;
+    highQualityCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash.ToFieldElement();
     highQualityCert.addBwt(CTxOut(CAmount(50), dummyScriptPubKey));
     highQualityCert.forwardTransferScFee = 0;
     highQualityCert.mainchainBackwardTransferRequestScFee = 0;
@@ -417,7 +417,7 @@ TEST_F(SidechainsConnectCertsBlockTestSuite, ConnectBlock_MultipleCerts_Differen
     lowQualityCert.scId        = scId;
     lowQualityCert.epochNumber = initialScState.lastTopQualityCertReferencedEpoch +1;
     lowQualityCert.quality     = 1;
-    lowQualityCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash;
+    lowQualityCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash.ToFieldElement();
     lowQualityCert.addBwt(CTxOut(CAmount(40), dummyScriptPubKey));
     lowQualityCert.forwardTransferScFee = 0;
     lowQualityCert.mainchainBackwardTransferRequestScFee = 0;
@@ -429,7 +429,7 @@ TEST_F(SidechainsConnectCertsBlockTestSuite, ConnectBlock_MultipleCerts_Differen
     highQualityCert.scId        = lowQualityCert.scId;
     highQualityCert.epochNumber = lowQualityCert.epochNumber;
     highQualityCert.quality     = lowQualityCert.quality * 2;
-    highQualityCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash;
+    highQualityCert.endEpochCumScTxCommTreeRoot = chainActive.Tip()->pprev->scCumTreeHash.ToFieldElement();
     highQualityCert.addBwt(CTxOut(CAmount(50), dummyScriptPubKey));
     highQualityCert.forwardTransferScFee = 0;
     highQualityCert.mainchainBackwardTransferRequestScFee = 0;
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
 #include <chainparams.h>
 #include <coins.h>
+#include <txdb.h>
 #include "tx_creation_utils.h"
 #include <main.h>
 #include <undo.h>
@@ -1872,3 +1874,62 @@ void SidechainsEventsTestSuite::storeSidechainWithCurrentHeight(txCreationUtils:
     view.SetBestBlock(chainActive.Tip()->GetBlockHash());
     txCreationUtils::storeSidechain(view.getSidechainMap(), scId, sidechain);
 }
+
+TEST(SidechainsEventsInChainstate, EventsAreServedFromMemoryAndReloadedAtStartup) {
+    SelectParams(CBaseChainParams::REGTEST);
+    boost::filesystem::path pathTemp(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+    const unsigned int chainStateDbSize = 2 * 1024 * 1024;
+
+    CSidechainEvents scEvents;
+    scEvents.ceasingScs.insert(uint256S("aa"));
+    scEvents.maturingScs.insert(uint256S("bb"));
+
+    CCoinsViewDB* pChainStateDb = new CCoinsViewDB(chainStateDbSize, false, /*fWipe*/true);
+    {
+        CCoinsMap mapCoins;
+        CAnchorsMap mapAnchors;
+        CNullifiersMap mapNullifiers;
+        CSidechainsMap mapSidechains;
+        CSidechainEventsMap mapSidechainEvents;
+        CCswNullifiersMap cswNullifiers;
+        mapSidechainEvents[100] = CSidechainEventsCacheEntry(scEvents, CSidechainEventsCacheEntry::Flags::FRESH);
+        mapSidechainEvents[200] = CSidechainEventsCacheEntry(scEvents, CSidechainEventsCacheEntry::Flags::FRESH);
+        ASSERT_TRUE(pChainStateDb->BatchWrite(mapCoins, uint256(), uint256(), mapAnchors, mapNullifiers,
+                                              mapSidechains, mapSidechainEvents, cswNullifiers));
+    }
+
+    CSidechainEvents retrievedEvents;
+    EXPECT_TRUE(pChainStateDb->HaveSidechainEvents(100));
+    EXPECT_TRUE(pChainStateDb->GetSidechainEvents(200, retrievedEvents));
+    EXPECT_TRUE(retrievedEvents == scEvents);
+    EXPECT_FALSE(pChainStateDb->HaveSidechainEvents(150));
+
+    // the events handled at a height are erased
+    {
+        CCoinsMap mapCoins;
+        CAnchorsMap mapAnchors;
+        CNullifiersMap mapNullifiers;
+        CSidechainsMap mapSidechains;
+        CSidechainEventsMap mapSidechainEvents;
+        CCswNullifiersMap cswNullifiers;
+        mapSidechainEvents[100] = CSidechainEventsCacheEntry(scEvents, CSidechainEventsCacheEntry::Flags::ERASED);
+        ASSERT_TRUE(pChainStateDb->BatchWrite(mapCoins, uint256(), uint256(), mapAnchors, mapNullifiers,
+                                              mapSidechains, mapSidechainEvents, cswNullifiers));
+    }
+    EXPECT_FALSE(pChainStateDb->HaveSidechainEvents(100));
+
+    delete pChainStateDb;
+    pChainStateDb = new CCoinsViewDB(chainStateDbSize, false, /*fWipe*/false);
+
+    EXPECT_FALSE(pChainStateDb->HaveSidechainEvents(100));
+    retrievedEvents = CSidechainEvents();
+    EXPECT_TRUE(pChainStateDb->GetSidechainEvents(200, retrievedEvents));
+    EXPECT_TRUE(retrievedEvents == scEvents);
+
+    delete pChainStateDb;
+    ClearDatadirCache();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(pathTemp.string(), ec);
+}
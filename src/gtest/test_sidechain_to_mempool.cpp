@@ -2143,3 +2143,207 @@ void SidechainsInMempoolTestSuite::moveSidechainToNextEpoch(uint256 scId, CCoins
     chainSettingUtils::ExtendChainActiveToHeight(nextEpochHeight);
     sidechainView.SetBestBlock(chainActive.Tip()->GetBlockHash());
 }
+
+TEST_F(SidechainsInMempoolTestSuite, TrimToSizeEvictsLowestFeeRatePackagesFirst) {
+    // scCreation paying a low fee, whose fwd pays enough for both of them
+    CTransaction scTx = GenerateScTx(CAmount(10));
+    const uint256& scId = scTx.GetScIdFromScCcOut(0);
+    CTxMemPoolEntry scEntry(scTx, /*fee*/CAmount(1), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(scTx.GetHash(), scEntry);
+
+    CTransaction fwdTx = GenerateFwdTransferTx(scId, CAmount(10));
+    CTxMemPoolEntry fwdEntry(fwdTx, /*fee*/CAmount(1000), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(fwdTx.GetHash(), fwdEntry);
+
+    // unrelated tx, paying more than the scCreation alone but less than the scCreation package
+    CTransaction otherTx = GenerateFwdTransferTx(uint256S("aaa"), CAmount(10));
+    CTxMemPoolEntry otherEntry(otherTx, /*fee*/CAmount(10), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(otherTx.GetHash(), otherEntry);
+
+    std::list<CTransaction> removedTxs;
+    std::list<CScCertificate> removedCerts;
+    aMempool.TrimToSize(aMempool.DynamicMemoryUsage() - 1, removedTxs, removedCerts);
+
+    EXPECT_TRUE(removedTxs.size() == 1);
+    EXPECT_TRUE(std::count(removedTxs.begin(), removedTxs.end(), otherTx));
+    EXPECT_TRUE(aMempool.existsTx(scTx.GetHash()));
+    EXPECT_TRUE(aMempool.existsTx(fwdTx.GetHash()));
+    EXPECT_TRUE(aMempool.GetEvictedTxs() == 1);
+
+    // evicting the scCreation takes the fwd along
+    aMempool.TrimToSize(0, removedTxs, removedCerts);
+    EXPECT_TRUE(aMempool.sizeTx() == 0);
+    EXPECT_TRUE(aMempool.mapSidechains.empty());
+    EXPECT_TRUE(aMempool.GetEvictedTxs() == 3);
+}
+
+TEST_F(SidechainsInMempoolTestSuite, ExpireRemovesOldEntriesAndTheirDescendants) {
+    CTransaction scTx = GenerateScTx(CAmount(10));
+    const uint256& scId = scTx.GetScIdFromScCcOut(0);
+    CTxMemPoolEntry scEntry(scTx, /*fee*/CAmount(1), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(scTx.GetHash(), scEntry);
+
+    CTransaction fwdTx = GenerateFwdTransferTx(scId, CAmount(10));
+    CTxMemPoolEntry fwdEntry(fwdTx, /*fee*/CAmount(1), /*time*/ 5000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(fwdTx.GetHash(), fwdEntry);
+
+    CTransaction otherTx = GenerateFwdTransferTx(uint256S("aaa"), CAmount(10));
+    CTxMemPoolEntry otherEntry(otherTx, /*fee*/CAmount(1), /*time*/ 5000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(otherTx.GetHash(), otherEntry);
+
+    std::list<CTransaction> removedTxs;
+    std::list<CScCertificate> removedCerts;
+    EXPECT_TRUE(aMempool.Expire(/*time*/2000, removedTxs, removedCerts) == 2);
+
+    EXPECT_TRUE(std::count(removedTxs.begin(), removedTxs.end(), scTx));
+    EXPECT_TRUE(std::count(removedTxs.begin(), removedTxs.end(), fwdTx));
+    EXPECT_TRUE(aMempool.existsTx(otherTx.GetHash()));
+    EXPECT_TRUE(aMempool.GetExpiredTxs() == 2);
+    EXPECT_TRUE(aMempool.GetEvictedTxs() == 0);
+}
+
+TEST_F(SidechainsInMempoolTestSuite, ExpireFollowsTheUpdatedEntryTime) {
+    CTransaction fwdTx = GenerateFwdTransferTx(uint256S("aaa"), CAmount(10));
+    CTxMemPoolEntry fwdEntry(fwdTx, /*fee*/CAmount(1), /*time*/ 5000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(fwdTx.GetHash(), fwdEntry);
+
+    // as when the entry is reloaded from mempool.dat
+    aMempool.UpdateEntryTime(fwdTx.GetHash(), 1000);
+    EXPECT_TRUE(aMempool.indexByTime.size() == 1);
+    EXPECT_TRUE(aMempool.indexByTime.begin()->first == 1000);
+
+    std::list<CTransaction> removedTxs;
+    std::list<CScCertificate> removedCerts;
+    EXPECT_TRUE(aMempool.Expire(/*time*/2000, removedTxs, removedCerts) == 1);
+    EXPECT_TRUE(aMempool.indexByTime.empty());
+}
+
+TEST_F(SidechainsInMempoolTestSuite, TrimToSizeRaisesTheRollingMinimumFee) {
+    const size_t sizeLimit = 300 * 1000000;
+    SetMockTime(1000);
+    EXPECT_TRUE(aMempool.GetMinFee(sizeLimit) == CFeeRate(0));
+
+    CTransaction fwdTx = GenerateFwdTransferTx(uint256S("aaa"), CAmount(10));
+    CTxMemPoolEntry fwdEntry(fwdTx, /*fee*/CAmount(5000), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(fwdTx.GetHash(), fwdEntry);
+
+    std::list<CTransaction> removedTxs;
+    std::list<CScCertificate> removedCerts;
+    aMempool.TrimToSize(0, removedTxs, removedCerts);
+    ASSERT_TRUE(removedTxs.size() == 1);
+
+    // what is accepted next must pay more than the evicted entry did
+    const CFeeRate evictedRate(CAmount(5000), fwdEntry.GetTxSize());
+    const CFeeRate expectedMinFee(evictedRate.GetFeePerK() + ::minRelayTxFee.GetFeePerK());
+    EXPECT_TRUE(aMempool.GetMinFee(sizeLimit) == expectedMinFee);
+
+    // no decay until a block is connected
+    SetMockTime(1000 + CTxMemPool::ROLLING_FEE_HALFLIFE);
+    EXPECT_TRUE(aMempool.GetMinFee(sizeLimit) == expectedMinFee);
+
+    std::list<CTransaction> conflictingTxs;
+    std::list<CScCertificate> conflictingCerts;
+    aMempool.removeForBlock(std::vector<CTransaction>(), /*height*/1988, conflictingTxs, conflictingCerts, /*fCurrentEstimate*/true);
+
+    // the mempool being empty the rate halves every quarter of ROLLING_FEE_HALFLIFE
+    SetMockTime(1000 + CTxMemPool::ROLLING_FEE_HALFLIFE + CTxMemPool::ROLLING_FEE_HALFLIFE / 4);
+    EXPECT_TRUE(aMempool.GetMinFee(sizeLimit) < expectedMinFee);
+    EXPECT_TRUE(aMempool.GetMinFee(sizeLimit).GetFeePerK() >= ::minRelayTxFee.GetFeePerK());
+
+    // until it drops back to zero
+    SetMockTime(1000 + 100 * CTxMemPool::ROLLING_FEE_HALFLIFE);
+    EXPECT_TRUE(aMempool.GetMinFee(sizeLimit) == CFeeRate(0));
+    SetMockTime(0);
+}
+
+TEST_F(SidechainsInMempoolTestSuite, PackageAggregatesFollowSidechainDependencies) {
+    // fwd entering the mempool before the creation of its sidechain, as it happens upon block disconnection
+    CTransaction scTx = GenerateScTx(CAmount(10));
+    const uint256& scId = scTx.GetScIdFromScCcOut(0);
+    CTransaction fwdTx = GenerateFwdTransferTx(scId, CAmount(10));
+    CTxMemPoolEntry fwdEntry(fwdTx, /*fee*/CAmount(1000), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(fwdTx.GetHash(), fwdEntry);
+    EXPECT_TRUE(aMempool.mapTx.at(fwdTx.GetHash()).GetCountWithAncestors() == 1);
+
+    CTxMemPoolEntry scEntry(scTx, /*fee*/CAmount(1), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(scTx.GetHash(), scEntry);
+
+    const CTxMemPoolEntry& scInMempool  = aMempool.mapTx.at(scTx.GetHash());
+    const CTxMemPoolEntry& fwdInMempool = aMempool.mapTx.at(fwdTx.GetHash());
+    EXPECT_TRUE(scInMempool.GetCountWithDescendants() == 2);
+    EXPECT_TRUE(scInMempool.GetModFeesWithDescendants() == 1001);
+    EXPECT_TRUE(fwdInMempool.GetCountWithAncestors() == 2);
+    EXPECT_TRUE(fwdInMempool.GetSizeWithAncestors() == scInMempool.GetTxSize() + fwdInMempool.GetTxSize());
+
+    // the fwd pays for the scCreation: its ancestor score is the package fee rate, mined first anyway
+    EXPECT_TRUE(aMempool.indexByAncestorScore.size() == 2);
+    EXPECT_TRUE(aMempool.indexByAncestorScore.rbegin()->second == fwdTx.GetHash());
+    EXPECT_TRUE(aMempool.indexByAncestorScore.rbegin()->first == CFeeRate(1001, fwdInMempool.GetSizeWithAncestors()));
+
+    aMempool.PrioritiseTransaction(scTx.GetHash(), scTx.GetHash().ToString(), 0.0, CAmount(5000));
+    EXPECT_TRUE(aMempool.mapTx.at(fwdTx.GetHash()).GetModFeesWithAncestors() == 6001);
+    EXPECT_TRUE(aMempool.mapTx.at(scTx.GetHash()).GetModFeesWithDescendants() == 6001);
+
+    // scCreation mined: the fwd is left alone
+    std::list<CTransaction> removedTxs;
+    std::list<CScCertificate> removedCerts;
+    aMempool.remove(scTx, removedTxs, removedCerts, /*fRecursive*/false);
+    EXPECT_TRUE(aMempool.mapTx.at(fwdTx.GetHash()).GetCountWithAncestors() == 1);
+    EXPECT_TRUE(aMempool.mapTx.at(fwdTx.GetHash()).GetModFeesWithAncestors() == 1000);
+    EXPECT_TRUE(aMempool.indexByFeeRate.size() == 1);
+    EXPECT_TRUE(aMempool.indexByDescendantScore.size() == 1);
+}
+
+TEST_F(SidechainsInMempoolTestSuite, RecursiveRemovalUpdatesTheAncestorsLeftInMempool) {
+    CTransaction scTx = GenerateScTx(CAmount(10));
+    const uint256& scId = scTx.GetScIdFromScCcOut(0);
+    CTxMemPoolEntry scEntry(scTx, /*fee*/CAmount(1), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(scTx.GetHash(), scEntry);
+
+    CTransaction fwdTx1 = GenerateFwdTransferTx(scId, CAmount(10));
+    CTxMemPoolEntry fwdEntry1(fwdTx1, /*fee*/CAmount(10), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(fwdTx1.GetHash(), fwdEntry1);
+
+    CTransaction fwdTx2 = GenerateFwdTransferTx(scId, CAmount(20));
+    CTxMemPoolEntry fwdEntry2(fwdTx2, /*fee*/CAmount(100), /*time*/ 1000, /*priority*/1.0, /*height*/1987);
+    aMempool.addUnchecked(fwdTx2.GetHash(), fwdEntry2);
+    EXPECT_TRUE(aMempool.mapTx.at(scTx.GetHash()).GetCountWithDescendants() == 3);
+
+    std::list<CTransaction> removedTxs;
+    std::list<CScCertificate> removedCerts;
+    aMempool.remove(fwdTx1, removedTxs, removedCerts, /*fRecursive*/true);
+    EXPECT_TRUE(removedTxs.size() == 1);
+    EXPECT_TRUE(aMempool.mapTx.at(scTx.GetHash()).GetCountWithDescendants() == 2);
+    EXPECT_TRUE(aMempool.mapTx.at(scTx.GetHash()).GetModFeesWithDescendants() == 101);
+    EXPECT_TRUE(aMempool.mapTx.at(fwdTx2.GetHash()).GetCountWithAncestors() == 2);
+
+    aMempool.remove(scTx, removedTxs, removedCerts, /*fRecursive*/true);
+    EXPECT_TRUE(aMempool.sizeTx() == 0);
+    EXPECT_TRUE(aMempool.indexByAncestorScore.empty());
+    EXPECT_TRUE(aMempool.indexByDescendantScore.empty());
+}
+
+TEST(SidechainMemPoolEntry, CertsAreLaidOutByEpochAndQuality) {
+    CSidechainMemPoolEntry scEntry;
+
+    scEntry.AddCert(uint256S("a1"), /*epoch*/1, /*quality*/10);
+    scEntry.AddCert(uint256S("a3"), /*epoch*/1, /*quality*/30);
+    scEntry.AddCert(uint256S("a2"), /*epoch*/1, /*quality*/20);
+    scEntry.AddCert(uint256S("b1"), /*epoch*/2, /*quality*/5);
+
+    EXPECT_TRUE(scEntry.GetTopQualityCert()->second == uint256S("b1"));
+    ASSERT_TRUE(scEntry.GetCert(uint256S("a2")) != scEntry.mBackwardCertificates.end());
+    EXPECT_TRUE(scEntry.GetCert(uint256S("a2"))->first == std::make_pair(1, int64_t(20)));
+
+    std::vector<uint256> expected = {uint256S("a1"), uint256S("a2")};
+    EXPECT_TRUE(scEntry.GetCertsUpToQuality(1, 25) == expected);
+    EXPECT_TRUE(scEntry.GetCertsUpToQuality(2, 4).empty());
+    EXPECT_TRUE(scEntry.GetCertsUpToQuality(3, 100).empty());
+
+    scEntry.EraseCert(uint256S("a2"));
+    scEntry.EraseCert(uint256S("b1"));
+    EXPECT_FALSE(scEntry.HasCert(uint256S("a2")));
+    EXPECT_TRUE(scEntry.GetCert(uint256S("b1")) == scEntry.mBackwardCertificates.end());
+    EXPECT_TRUE(scEntry.GetTopQualityCert()->second == uint256S("a3"));
+    EXPECT_EQ(scEntry.mBackwardCertificates.size(), scEntry.mCertPositions.size());
+}
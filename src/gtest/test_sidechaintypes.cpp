@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
 
 #include "chainparams.h"
+#include "random.h"
+#include "sc/cswnullifierfilter.h"
+#include "sc/sidechaintypes.h"
+#include "utiltest.h"
 
 class SidechainTypesTestSuite: public ::testing::Test
 {
@@ -39,4 +43,90 @@ TEST_F(SidechainTypesTestSuite, CZendooBatchProofVerifierResultDestructor)
     }
 
     // Check with a memory profiler (e.g. Valgrind) that there are no memory leaks.
-}
\ No newline at end of file
+}
+///////////////////////////////////////////////////////////////////////////////
+////////////////////////////// CCctpObjectCache ///////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+TEST_F(SidechainTypesTestSuite, CCctpObjectCacheHitsAndMisses)
+{
+    CCctpObjectCache<int> cache(100);
+
+    ASSERT_EQ(cache.Get(uint256S("aa")), nullptr);
+
+    std::shared_ptr<int> obj = std::make_shared<int>(1);
+    cache.Put(uint256S("aa"), obj, 10);
+
+    ASSERT_EQ(cache.Get(uint256S("aa")), obj);
+    ASSERT_EQ(obj.use_count(), 2);
+
+    CCctpObjectCache<int>::Stats stats = cache.GetStats();
+    ASSERT_EQ(stats.hits, 1);
+    ASSERT_EQ(stats.misses, 1);
+    ASSERT_EQ(stats.entries, 1);
+    ASSERT_EQ(stats.usage, 10);
+}
+
+TEST_F(SidechainTypesTestSuite, CCctpObjectCacheLruEviction)
+{
+    CCctpObjectCache<int> cache(30);
+
+    std::shared_ptr<int> obj1 = std::make_shared<int>(1);
+    std::shared_ptr<int> obj2 = std::make_shared<int>(2);
+    std::shared_ptr<int> obj3 = std::make_shared<int>(3);
+
+    cache.Put(uint256S("01"), obj1, 10);
+    cache.Put(uint256S("02"), obj2, 10);
+
+    // Touch the first object, so that the second one is the least recently used
+    ASSERT_EQ(cache.Get(uint256S("01")), obj1);
+
+    cache.Put(uint256S("03"), obj3, 15);
+
+    ASSERT_EQ(cache.Get(uint256S("01")), obj1);
+    ASSERT_EQ(cache.Get(uint256S("02")), nullptr);
+    ASSERT_EQ(cache.Get(uint256S("03")), obj3);
+    ASSERT_EQ(cache.GetStats().usage, 25);
+
+    // Evicted objects are still valid for their owners
+    ASSERT_EQ(obj2.use_count(), 1);
+    ASSERT_EQ(*obj2, 2);
+
+    // Objects larger than the whole cache are never stored
+    cache.Put(uint256S("04"), std::make_shared<int>(4), 31);
+    ASSERT_EQ(cache.Get(uint256S("04")), nullptr);
+    ASSERT_EQ(cache.GetStats().entries, 2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////// CCswNullifierFilter /////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+TEST_F(SidechainTypesTestSuite, CswNullifierFilterHasNoFalseNegatives)
+{
+    CCswNullifierFilter filter(0);
+    const uint256 scId = uint256S("aa");
+    const uint256 otherScId = uint256S("bb");
+
+    // enough nullifiers to chain a few filters
+    std::vector<CCompactFieldElement> vNullifiers;
+    for (int i = 0; i < 30000; i++)
+    {
+        vNullifiers.push_back(GetRandomNullifier());
+        filter.Insert(scId, vNullifiers.back());
+    }
+    ASSERT_EQ(filter.Size(), vNullifiers.size());
+
+    for (const CCompactFieldElement& nullifier : vNullifiers)
+    {
+        ASSERT_TRUE(filter.MaybeContains(scId, nullifier));
+        ASSERT_FALSE(filter.MaybeContains(otherScId, nullifier));
+    }
+
+    int nFalsePositives = 0;
+    for (int i = 0; i < 30000; i++)
+        nFalsePositives += filter.MaybeContains(scId, GetRandomNullifier());
+    EXPECT_LT(nFalsePositives, 300);
+
+    filter.Clear();
+    ASSERT_EQ(filter.Size(), 0);
+    ASSERT_FALSE(filter.MaybeContains(scId, vNullifiers.front()));
+}
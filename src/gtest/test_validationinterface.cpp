@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include "chain.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "validationinterface.h"
+
+#include <thread>
+#include <vector>
+
+class CRecordingListener : public CValidationInterface
+{
+public:
+    std::vector<int> vHeights;
+    std::vector<uint256> vTxHashes;
+    std::thread::id threadId;
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindex) override {
+        vHeights.push_back(pindex->nHeight);
+        threadId = std::this_thread::get_id();
+    }
+
+    void SyncTransaction(const CTransaction &tx, const CBlock *pblock) override {
+        vTxHashes.push_back(tx.GetHash());
+    }
+};
+
+TEST(ValidationInterface, AsyncListenerIsNotifiedInOrderOnItsOwnThread) {
+    CRecordingListener listener;
+    RegisterValidationInterface(&listener, true);
+
+    std::vector<CBlockIndex> vIndexes(5);
+    for (size_t i = 0; i < vIndexes.size(); i++) {
+        vIndexes[i].nHeight = i;
+        GetMainSignals().UpdatedBlockTip(&vIndexes[i]);
+    }
+    SyncWithValidationInterfaceQueues();
+
+    EXPECT_EQ(listener.vHeights, std::vector<int>({0, 1, 2, 3, 4}));
+    EXPECT_NE(listener.threadId, std::this_thread::get_id());
+
+    UnregisterValidationInterface(&listener);
+    GetMainSignals().UpdatedBlockTip(&vIndexes[0]);
+    EXPECT_EQ(listener.vHeights.size(), vIndexes.size());
+}
+
+TEST(ValidationInterface, AsyncListenerGetsTransactionSnapshotsAndIsDrainedOnUnregister) {
+    CRecordingListener listener;
+    RegisterValidationInterface(&listener, true);
+
+    std::vector<uint256> vExpected;
+    for (int i = 0; i < 100; i++) {
+        CMutableTransaction mtx;
+        mtx.nLockTime = i;
+        CTransaction tx(mtx);
+        vExpected.push_back(tx.GetHash());
+        // the transaction is gone when the notification is delivered
+        SyncWithWallets(tx);
+    }
+
+    UnregisterValidationInterface(&listener);
+    EXPECT_EQ(listener.vTxHashes, vExpected);
+}
@@ -69,6 +69,8 @@
 #include <zen/forks/fork2_replayprotectionfork.h>
 
 #include "sc/asyncproofverifier.h"
+#include "sc/sidechainjournal.h"
+#include "sc/sidechainTxsCommitmentBuilder.h"
 
 using namespace std;
 
@@ -80,6 +82,8 @@ ZCJoinSplit* pzcashParams = NULL;
 CWallet* pwalletMain = NULL;
 #endif
 bool fFeeEstimatesInitialized = false;
+//! Set once mempool.dat has been read, so that an interrupted startup does not overwrite it with an empty mempool
+static std::atomic<bool> fDumpMempoolLater(false);
 
 #if ENABLE_ZMQ
 static CZMQNotificationInterface* pzmqNotificationInterface = NULL;
@@ -177,6 +181,7 @@ void Interrupt(boost::thread_group& threadGroup)
     InterruptRPC();
     InterruptREST();
     InterruptTorControl();
+    CScAsyncProofVerifier::GetInstance().Interrupt();
     threadGroup.interrupt_all();
 }
 
@@ -215,6 +220,9 @@ void Shutdown()
     StopTorControl();
     UnregisterNodeSignals(GetNodeSignals());
 
+    if (fDumpMempoolLater && GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL))
+        DumpMempool();
+
     if (fFeeEstimatesInitialized)
     {
         boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
@@ -226,13 +234,19 @@ void Shutdown()
         fFeeEstimatesInitialized = false;
     }
 
+    // Deliver what is still queued for the asynchronous listeners while the chain state is there
+    SyncWithValidationInterfaceQueues();
+
     {
         LOCK(cs_main);
+        WaitForBlockPrefetch();
         if (pcoinsTip != NULL) {
             FlushStateToDisk();
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
+        delete pcoinsprefetch;
+        pcoinsprefetch = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
         delete pcoinsdbview;
@@ -360,10 +374,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-exportdir=<dir>", _("Specify directory to be used when exporting data"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-loadsnapshot=<file>", _("Fills an empty chainstate with a snapshot written by dumpchainstate, instead of connecting the blocks up to the snapshot one. The block index must already contain that block") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes, evicting the lowest fee rate transactions and certificates (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
+    strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions and certificates in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
     strUsage += HelpMessageOpt("-mempooltxinputlimit=<n>", _("Set the maximum number of transparent inputs in a transaction that the mempool will accept (default: 0 = no limit applied)"));
-    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script and JoinSplit proof verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load on restart, certificates and CSW transactions included (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), "zend.pid"));
 #endif
@@ -372,6 +390,7 @@ std::string HelpMessage(HelpMessageMode mode)
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files on startup"));
     strUsage += HelpMessageOpt("-reindexfast", _("Rebuild block chain index from current blk000??.dat files on startup, skipping expensive checks for blocks below checkpoints. It is incompatible with reindex"));
+    strUsage += HelpMessageOpt("-snapshotcommitment=<hash>", _("Commitment the snapshot given to -loadsnapshot must have, as returned by dumpchainstate on a trusted node"));
     #if !defined(WIN32)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
@@ -410,7 +429,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-tlscertpath=<path>", _("Full path to a certificate"));
     strUsage += HelpMessageOpt("-tlstrustdir=<path>", _("Full path to a trusted certificates directory"));
     strUsage += HelpMessageOpt("-websocket=<0 or 1>", _("If set to 1 opens a websocket channel listening for client connections on localhost (default: 0)"));
+    strUsage += HelpMessageOpt("-wsmaxconnections=<n>", strprintf(_("If websocket=1, maximum number of ws client connections (default: %u)"), DEFAULT_WS_MAX_CONNECTIONS));
     strUsage += HelpMessageOpt("-wsport=<port>", _("If websocket=1, listen for ws connections at this ip port on localhost (default: 8888)"));
+    strUsage += HelpMessageOpt("-wsthreads=<n>", strprintf(_("If websocket=1, number of threads serving the ws client requests (default: %u)"), DEFAULT_WS_THREADS));
+    strUsage += HelpMessageOpt("-scjournalsize=<n>", strprintf(_("Number of blocks whose sidechain changes are kept for websocket subscribers (default: %u)"), CSidechainJournal::DEFAULT_MAX_ENTRIES));
 #ifdef USE_UPNP
 #if USE_UPNP
     strUsage += HelpMessageOpt("-upnp", _("Use UPnP to map the listening port (default: 1 when listening and no -proxy)"));
@@ -529,6 +551,21 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-scproofqueuesize=<size>",
         strprintf(_("The threshold size of the sc proof queue that triggers a call to the batch verification. (default: %d)"), CScAsyncProofVerifier::BATCH_VERIFICATION_MAX_SIZE));
 
+    strUsage += HelpMessageOpt("-scproofverificationthreads=<n>",
+        strprintf(_("The number of threads running sc proof batch verifications concurrently. (default: %d)"), CScAsyncProofVerifier::DEFAULT_VERIFICATION_THREADS));
+
+    strUsage += HelpMessageOpt("-scbatchverificationthreads=<n>",
+        strprintf(_("The number of threads verifying the shards of a block sc proof batch, grouped by verification key (0 = one per core, default: %d)"), CScProofVerifier::DEFAULT_BATCH_VERIFICATION_THREADS));
+
+    strUsage += HelpMessageOpt("-sccommitmenttreethreads=<n>",
+        strprintf(_("The number of threads preparing the sidechain leaves of a block sc txs commitment tree (0 = one per core, default: %d)"), SidechainTxsCommitmentBuilder::DEFAULT_COMMITMENT_TREE_THREADS));
+
+    strUsage += HelpMessageOpt("-scvkcachesize=<n>",
+        strprintf(_("Set the size in MiB of the cache of deserialized sidechain verification keys (default: %d)"), CScVKey::DEFAULT_DESERIALIZED_CACHE_SIZE));
+
+    strUsage += HelpMessageOpt("-maxscproofcachesize=<n>",
+        strprintf(_("Limit size of the verified sc proof cache to <n> entries (default: %d)"), CScProofVerifier::DEFAULT_MAX_PROOF_CACHE_SIZE));
+
     strUsage += HelpMessageOpt("-cbhsafedepth=<n>",
         "regtest only - Set safe depth for skipping checkblockatheight in txout scripts (default depends on regtest/testnet params)");
         
@@ -742,6 +779,11 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         LogPrintf("Stopping after block import\n");
         StartShutdown();
     }
+
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        LoadMempool();
+        fDumpMempoolLater = !ShutdownRequested();
+    }
 }
 
 void ThreadNotifyRecentlyAdded()
@@ -851,6 +893,7 @@ bool AppInitServers()
         return false;
     if (!StartHTTPServer())
         return false;
+    scJournal.SetMaxEntries(std::max<int64_t>(GetArg("-scjournalsize", CSidechainJournal::DEFAULT_MAX_ENTRIES), 1));
     if (GetBoolArg("-websocket", false) && !StartWsServer())
         return false;
     return true;
@@ -996,15 +1039,27 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
 
     // Make sure enough file descriptors are available
-    int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
+#ifdef USE_EPOLL
+    // the network thread waits on its sockets with epoll, which has no FD_SETSIZE limit
+    nMaxConnections = std::max(nMaxConnections, 0);
+#else
+    int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+#endif
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
     if (nFD - MIN_CORE_FILEDESCRIPTORS < nMaxConnections)
         nMaxConnections = nFD - MIN_CORE_FILEDESCRIPTORS;
 
+    // a snapshot is only loaded if it is the one the user trusts
+    if (mapArgs.count("-loadsnapshot")) {
+        std::string strCommitment = GetArg("-snapshotcommitment", "");
+        if (strCommitment.size() != 64 || !IsHex(strCommitment))
+            return InitError(_("-loadsnapshot requires -snapshotcommitment=<hash>, the commitment returned by dumpchainstate."));
+    }
+
     // if using block pruning, then disable txindex
     // also disable the wallet (for now, until SPV support is implemented in wallet)
     if (GetArg("-prune", 0)) {
@@ -1271,12 +1326,18 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
     std::ostringstream strErrors;
 
-    LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for script and JoinSplit proof verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    CScProofVerifier::SetMaxProofCacheSize(GetArg("-maxscproofcachesize", CScProofVerifier::DEFAULT_MAX_PROOF_CACHE_SIZE));
+
+    // The thread verifying a block sc proof batch verifies one of its shards too
+    for (int i = 0; i < CScProofVerifier::GetBatchVerificationThreads() - 1; i++)
+        threadGroup.create_thread(&ThreadProofShardCheck);
+
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
@@ -1410,6 +1471,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     fDiscover = GetBoolArg("-discover", true);
     fNameLookup = GetBoolArg("-dns", true);
 
+    std::string strPollerError;
+    if (!InitSocketPoller(strPollerError))
+        return InitError(strPollerError);
+
     bool fBound = false;
     if (fListen) {
         if (mapArgs.count("-bind") || mapArgs.count("-whitebind")) {
@@ -1472,7 +1537,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     pzmqNotificationInterface = CZMQNotificationInterface::CreateWithArguments(mapArgs);
 
     if (pzmqNotificationInterface) {
-        RegisterValidationInterface(pzmqNotificationInterface);
+        RegisterValidationInterface(pzmqNotificationInterface, true);
     }
 #endif
 
@@ -1487,7 +1552,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             return InitError(_("AMQP support requires -experimentalfeatures."));
         }
 
-        RegisterValidationInterface(pAMQPNotificationInterface);
+        RegisterValidationInterface(pAMQPNotificationInterface, true);
     }
 #endif
 
@@ -1551,14 +1616,28 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
+                delete pcoinsprefetch;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex || fReindexFast);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexFast);
+
+                bool fSnapshotLoaded = false;
+                if (mapArgs.count("-loadsnapshot") && !fReset && pcoinsdbview->GetBestBlock().IsNull()) {
+                    uiInterface.InitMessage(_("Loading chainstate snapshot..."));
+                    CChainstateSnapshotInfo snapshotInfo;
+                    boost::filesystem::path pathSnapshot = boost::filesystem::absolute(GetArg("-loadsnapshot", ""), GetDataDir());
+                    if (!pcoinsdbview->LoadSnapshot(pathSnapshot.string(), uint256S(GetArg("-snapshotcommitment", "")), snapshotInfo)) {
+                        strLoadError = _("Error loading chainstate snapshot");
+                        break;
+                    }
+                    fSnapshotLoaded = true;
+                }
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                pcoinsprefetch = new CCoinsViewPrefetch(pcoinscatcher);
+                pcoinsTip = new CCoinsViewCache(pcoinsprefetch);
 
                 if (fReindex || fReindexFast) {
                     if (fReindex) pblocktree->WriteReindexing(true);
@@ -1576,6 +1655,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                if (fSnapshotLoaded && mapBlockIndex.count(pcoinsTip->GetBestBlock()) == 0) {
+                    strLoadError = _("The block of the chainstate snapshot is not in the block index");
+                    break;
+                }
+
                 // If the loaded chain has a wrong genesis, bail out immediately
                 // (we're likely using a testnet datadir, or the other way around).
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus().hashGenesisBlock) == 0)
@@ -1930,13 +2014,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // SENDALERT
     threadGroup.create_thread(boost::bind(ThreadSendAlert));
 
-    // Start the thread for async sidechain proof verification
-    threadGroup.create_thread(
-            boost::bind(
-                    &CScAsyncProofVerifier::RunPeriodicVerification,
-                    &CScAsyncProofVerifier::GetInstance()
-            )
-    );
+    // Start the threads for async sidechain proof verification
+    for (int i = 0; i < CScAsyncProofVerifier::GetCustomVerificationThreads(); i++)
+    {
+        threadGroup.create_thread(
+                boost::bind(
+                        &CScAsyncProofVerifier::RunPeriodicVerification,
+                        &CScAsyncProofVerifier::GetInstance()
+                )
+        );
+    }
 
     return !fRequestShutdown;
 }
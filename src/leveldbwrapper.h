@@ -59,6 +59,23 @@ public:
 
         batch.Delete(slKey);
     }
+
+    //! Writes a record already serialized, as read from a db iterator
+    void WriteRaw(const leveldb::Slice& slKey, const leveldb::Slice& slValue)
+    {
+        batch.Put(slKey, slValue);
+    }
+
+    //! Erases a record by its key already serialized, as read from a db iterator
+    void EraseRaw(const leveldb::Slice& slKey)
+    {
+        batch.Delete(slKey);
+    }
+
+    void Clear()
+    {
+        batch.Clear();
+    }
 };
 
 class CLevelDBWrapper
@@ -10,11 +10,13 @@
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockcache.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
 #include "consensus/validation.h"
 #include "deprecation.h"
 #include "init.h"
+#include "memusage.h"
 #include "merkleblock.h"
 #include "metrics.h"
 #include "pow.h"
@@ -27,6 +29,7 @@
 #include "wallet/asyncrpcoperation_sendmany.h"
 #include "wallet/asyncrpcoperation_shieldcoinbase.h"
 
+#include <future>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -43,6 +46,7 @@
 #include "sc/asyncproofverifier.h"
 #include "sc/proofverifier.h"
 #include "sc/sidechain.h"
+#include "sc/sidechainjournal.h"
 #include "sc/sidechainTxsCommitmentBuilder.h"
 
 #include "script/sigcache.h"
@@ -587,6 +591,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewPrefetch *pcoinsprefetch = NULL;
 CBlockTreeDB *pblocktree = NULL;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1042,6 +1047,16 @@ bool CheckCertificatesOrdering(const std::vector<CScCertificate>& certList, CVal
     return true;
 }
 
+static bool CheckJoinSplitProof(const CTransaction& tx, unsigned int nJoinSplit,
+                                libzcash::ProofVerifier& verifier, CValidationState &state)
+{
+    if (!tx.GetVjoinsplit()[nJoinSplit].Verify(*pzcashParams, verifier, tx.joinSplitPubKey)) {
+        return state.DoS(100, error("CheckTransaction(): joinsplit does not verify"),
+                            CValidationState::Code::INVALID, "bad-txns-joinsplit-verification-failed");
+    }
+    return true;
+}
+
 bool CheckTransaction(const CTransaction& tx, CValidationState &state,
                       libzcash::ProofVerifier& verifier)
 {
@@ -1054,11 +1069,9 @@ bool CheckTransaction(const CTransaction& tx, CValidationState &state,
     }
 
     // Ensure that zk-SNARKs verify
-    BOOST_FOREACH(const JSDescription &joinsplit, tx.GetVjoinsplit()) {
-        if (!joinsplit.Verify(*pzcashParams, verifier, tx.joinSplitPubKey)) {
-            return state.DoS(100, error("CheckTransaction(): joinsplit does not verify"),
-                                CValidationState::Code::INVALID, "bad-txns-joinsplit-verification-failed");
-        }
+    for (unsigned int i = 0; i < tx.GetVjoinsplit().size(); i++) {
+        if (!CheckJoinSplitProof(tx, i, verifier, state))
+            return false;
     }
 
     if (!Sidechain::checkTxSemanticValidity(tx, state))
@@ -1158,6 +1171,34 @@ void RejectMemoryPoolTxBase(const CValidationState& state, const CTransactionBas
         Misbehaving(pfrom->GetId(), state.GetDoS());
 }
 
+/**
+ * Expires the mempool entries older than -mempoolexpiry and evicts the lowest fee rate ones until the mempool
+ * fits -maxmempool, telling the wallets about what has been dropped. hashAdded, the entry that has just been
+ * accepted, is not synced if dropped: the caller rejects it instead.
+ */
+static void LimitMempoolSize(CTxMemPool& pool, const uint256& hashAdded)
+{
+    std::list<CTransaction> removedTxs;
+    std::list<CScCertificate> removedCerts;
+
+    int nExpired = pool.Expire(GetTime() - GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60, removedTxs, removedCerts);
+    if (nExpired != 0)
+        LogPrint("mempool", "%s():%d - expired %d txes/certs from mempool\n", __func__, __LINE__, nExpired);
+
+    pool.TrimToSize(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, removedTxs, removedCerts);
+
+    for(const CTransaction& tx: removedTxs)
+    {
+        if (tx.GetHash() != hashAdded)
+            SyncWithWallets(tx, nullptr);
+    }
+    for(const CScCertificate& cert: removedCerts)
+    {
+        if (cert.GetHash() != hashAdded)
+            SyncWithWallets(cert, nullptr);
+    }
+}
+
 MempoolReturnValue AcceptCertificateToMemoryPool(CTxMemPool& pool, CValidationState &state, const CScCertificate &cert,
     LimitFreeFlag fLimitFree, RejectAbsurdFeeFlag fRejectAbsurdFee, MempoolProofVerificationFlag fProofVerification, CNode* pfrom)
 {
@@ -1203,7 +1244,7 @@ MempoolReturnValue AcceptCertificateToMemoryPool(CTxMemPool& pool, CValidationSt
     }
 
     // Check if cert is already in mempool or if there are conflicts with in-memory certs
-    std::pair<uint256, CAmount> conflictingCertData = pool.FindCertWithQuality(cert.GetScId(), cert.quality);
+    std::pair<uint256, CAmount> conflictingCertData = pool.FindCertWithQuality(cert.GetScId(), cert.epochNumber, cert.quality);
 
     {
         uint256 certHash = cert.GetHash();
@@ -1324,6 +1365,16 @@ MempoolReturnValue AcceptCertificateToMemoryPool(CTxMemPool& pool, CValidationSt
             return MempoolReturnValue::INVALID;
         }
 
+        // After evictions for the mempool size limit, entries must pay more than the evicted ones did
+        CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+        if (fLimitFree == LimitFreeFlag::ON && mempoolRejectFee > 0 && nFees < mempoolRejectFee)
+        {
+            LogPrint("mempool", "%s():%d - cert %s rejected, mempool min fee not met %d < %d\n",
+                __func__, __LINE__, certHash.ToString(), nFees, mempoolRejectFee);
+            state.DoS(0, false, CValidationState::Code::INSUFFICIENT_FEE, "mempool min fee not met");
+            return MempoolReturnValue::INVALID;
+        }
+
         // Continuously rate-limit free (really, very-low-fee) transactions
         // This mitigates 'penny-flooding' -- sending thousands of free transactions just to
         // be annoying or make others' transactions take longer to confirm.
@@ -1412,6 +1463,14 @@ MempoolReturnValue AcceptCertificateToMemoryPool(CTxMemPool& pool, CValidationSt
 
         // Store transaction in memory
         pool.addUnchecked(certHash, entry, !IsInitialBlockDownload());
+
+        LimitMempoolSize(pool, certHash);
+        if (!pool.existsCert(certHash))
+        {
+            LogPrint("mempool", "%s():%d - cert %s evicted, mempool full\n", __func__, __LINE__, certHash.ToString());
+            state.DoS(0, false, CValidationState::Code::INSUFFICIENT_FEE, "mempool full");
+            return MempoolReturnValue::INVALID;
+        }
     }
 
     return MempoolReturnValue::VALID;
@@ -1630,6 +1689,16 @@ MempoolReturnValue AcceptTxToMemoryPool(CTxMemPool& pool, CValidationState &stat
             return MempoolReturnValue::INVALID;
         }
 
+        // After evictions for the mempool size limit, entries must pay more than the evicted ones did
+        CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+        if (fLimitFree == LimitFreeFlag::ON && mempoolRejectFee > 0 && nFees < mempoolRejectFee)
+        {
+            LogPrint("mempool", "%s():%d - tx %s rejected, mempool min fee not met %d < %d\n",
+                __func__, __LINE__, hash.ToString(), nFees, mempoolRejectFee);
+            state.DoS(0, false, CValidationState::Code::INSUFFICIENT_FEE, "mempool min fee not met");
+            return MempoolReturnValue::INVALID;
+        }
+
         // Continuously rate-limit free (really, very-low-fee) transactions
         // This mitigates 'penny-flooding' -- sending thousands of free transactions just to
         // be annoying or make others' transactions take longer to confirm.
@@ -1713,6 +1782,14 @@ MempoolReturnValue AcceptTxToMemoryPool(CTxMemPool& pool, CValidationState &stat
         }
 
         pool.addUnchecked(hash, entry, !IsInitialBlockDownload());
+
+        LimitMempoolSize(pool, hash);
+        if (!pool.existsTx(hash))
+        {
+            LogPrint("mempool", "%s():%d - tx %s evicted, mempool full\n", __func__, __LINE__, hash.ToString());
+            state.DoS(0, false, CValidationState::Code::INSUFFICIENT_FEE, "mempool full");
+            return MempoolReturnValue::INVALID;
+        }
     }
 
     return MempoolReturnValue::VALID;
@@ -1742,6 +1819,185 @@ MempoolReturnValue AcceptTxBaseToMemoryPool(CTxMemPool& pool, CValidationState &
     return MempoolReturnValue::INVALID;
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+
+bool DumpMempool()
+{
+    int64_t nStart = GetTimeMicros();
+
+    std::vector<std::pair<CTransaction, int64_t> > vTxs;
+    std::vector<std::pair<CScCertificate, int64_t> > vCerts;
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    {
+        LOCK(mempool.cs);
+        for (const auto& entry : mempool.mapTx)
+            vTxs.push_back(std::make_pair(entry.second.GetTx(), entry.second.GetTime()));
+        for (const auto& entry : mempool.mapCertificate)
+            vCerts.push_back(std::make_pair(entry.second.GetCertificate(), entry.second.GetTime()));
+        mapDeltas = mempool.mapDeltas;
+    }
+
+    // the ones still waiting for the async proof verifier are dumped too, as if they entered the mempool now
+    std::vector<CTransaction> vQueuedTxs;
+    std::vector<CScCertificate> vQueuedCerts;
+    CScAsyncProofVerifier::GetInstance().GetQueuedTxBases(vQueuedTxs, vQueuedCerts);
+    int64_t nNow = GetTime();
+    for (const CTransaction& tx : vQueuedTxs)
+        vTxs.push_back(std::make_pair(tx, nNow));
+    for (const CScCertificate& cert : vQueuedCerts)
+        vCerts.push_back(std::make_pair(cert, nNow));
+
+    int64_t nMid = GetTimeMicros();
+
+    try {
+        boost::filesystem::path pathMempool = GetDataDir() / "mempool.dat";
+        boost::filesystem::path pathMempoolNew = GetDataDir() / "mempool.dat.new";
+        FILE* filestr = fopen(pathMempoolNew.string().c_str(), "wb");
+        if (!filestr)
+            return error("%s: failed to open %s", __func__, pathMempoolNew.string());
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        file << MEMPOOL_DUMP_VERSION;
+        file << vTxs;
+        file << vCerts;
+        file << mapDeltas;
+        FileCommit(file.Get());
+        file.fclose();
+        if (!RenameOver(pathMempoolNew, pathMempool))
+            return error("%s: failed to rename %s", __func__, pathMempoolNew.string());
+    } catch (const std::exception& e) {
+        return error("%s: failed to dump the mempool: %s", __func__, e.what());
+    }
+
+    int64_t nLast = GetTimeMicros();
+    LogPrintf("Dumped mempool: %u txes and %u certs (%u waiting for proof verification): %.2fms to copy, %.2fms to dump\n",
+        vTxs.size(), vCerts.size(), vQueuedTxs.size() + vQueuedCerts.size(), (nMid - nStart) * 0.001, (nLast - nMid) * 0.001);
+    return true;
+}
+
+bool LoadMempool()
+{
+    const int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    int64_t nStart = GetTimeMicros();
+
+    std::vector<std::pair<CTransaction, int64_t> > vTxs;
+    std::vector<std::pair<CScCertificate, int64_t> > vCerts;
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    try {
+        FILE* filestr = fopen((GetDataDir() / "mempool.dat").string().c_str(), "rb");
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+            return false;
+        }
+
+        uint64_t nVersion = 0;
+        file >> nVersion;
+        if (nVersion != MEMPOOL_DUMP_VERSION)
+            return error("%s: unknown mempool file version %d", __func__, nVersion);
+        file >> vTxs;
+        file >> vCerts;
+        file >> mapDeltas;
+    } catch (const std::exception& e) {
+        return error("%s: failed to deserialize mempool data on disk: %s. Continuing anyway.", __func__, e.what());
+    }
+
+    // deltas first, so that the txes and certs are admitted with their modified fees
+    for (const auto& delta : mapDeltas)
+        mempool.PrioritiseTransaction(delta.first, delta.first.ToString(), delta.second.first, delta.second.second);
+
+    int64_t nNow = GetTime();
+    std::vector<std::pair<std::shared_ptr<CTransactionBase>, int64_t> > vToAdmit;
+    int nExpired = 0;
+    for (const auto& entry : vTxs) {
+        if (entry.second + nExpiryTimeout > nNow)
+            vToAdmit.push_back(std::make_pair(std::make_shared<CTransaction>(entry.first), entry.second));
+        else
+            nExpired++;
+    }
+    for (const auto& entry : vCerts) {
+        if (entry.second + nExpiryTimeout > nNow)
+            vToAdmit.push_back(std::make_pair(std::make_shared<CScCertificate>(entry.first), entry.second));
+        else
+            nExpired++;
+    }
+
+    int64_t nTimeRead = GetTimeMicros();
+
+    // Verify all the cert and CSW proofs in one batch, caching the ones that pass, so that the
+    // synchronous verification done at admission skips them instead of verifying them one by one.
+    // Those of sidechains not yet in the chainstate are left to the admission.
+    // The verifier copies the data it needs, so that cs_main is only held while gathering it.
+    size_t nProofs = 0;
+    CScProofVerifier scVerifier{CScProofVerifier::Verification::Strict, CScProofVerifier::Priority::Low};
+    {
+        LOCK(cs_main);
+        CCoinsViewCache view(pcoinsTip);
+        for (const auto& entry : vToAdmit) {
+            const CTransactionBase& txBase = *entry.first;
+            if (txBase.IsCertificate()) {
+                const CScCertificate& cert = dynamic_cast<const CScCertificate&>(txBase);
+                if (!view.HaveSidechain(cert.GetScId()))
+                    continue;
+                scVerifier.LoadDataForCertVerification(view, cert);
+                nProofs++;
+            } else {
+                const CTransaction& tx = dynamic_cast<const CTransaction&>(txBase);
+                if (tx.GetVcswCcIn().empty())
+                    continue;
+                bool fKnownSidechains = true;
+                for (const CTxCeasedSidechainWithdrawalInput& csw : tx.GetVcswCcIn())
+                    fKnownSidechains = fKnownSidechains && view.HaveSidechain(csw.scId);
+                if (!fKnownSidechains)
+                    continue;
+                scVerifier.LoadDataForCswVerification(view, tx);
+                nProofs++;
+            }
+        }
+    }
+
+    if (!scVerifier.BatchVerify())
+        LogPrint("sc", "%s():%d - batch verification of the mempool proofs failed, the failing ones will be rejected at admission\n",
+            __func__, __LINE__);
+    scVerifier.CachePassedProofs();
+
+    int64_t nTimeVerify = GetTimeMicros();
+
+    // Admit in rounds, since a tx may spend the outputs of one coming later in the file
+    int nAccepted = 0, nFailed = 0;
+    bool fProgress = true;
+    while (!vToAdmit.empty() && fProgress && !ShutdownRequested()) {
+        fProgress = false;
+        std::vector<std::pair<std::shared_ptr<CTransactionBase>, int64_t> > vMissingInputs;
+        for (const auto& entry : vToAdmit) {
+            const CTransactionBase& txBase = *entry.first;
+            CValidationState state;
+            LOCK(cs_main);
+            MempoolReturnValue res = AcceptTxBaseToMemoryPool(mempool, state, txBase, LimitFreeFlag::OFF,
+                                                              RejectAbsurdFeeFlag::OFF, MempoolProofVerificationFlag::SYNC);
+            if (res == MempoolReturnValue::VALID) {
+                // restore the entry time, so that the entry expires as if the node had never been stopped
+                mempool.UpdateEntryTime(txBase.GetHash(), entry.second);
+                nAccepted++;
+                fProgress = true;
+            } else if (res == MempoolReturnValue::MISSING_INPUT) {
+                vMissingInputs.push_back(entry);
+            } else {
+                LogPrint("mempool", "%s():%d - %s [%s] not reloaded: %s\n", __func__, __LINE__,
+                    txBase.IsCertificate() ? "cert" : "tx", txBase.GetHash().ToString(), state.GetRejectReason());
+                nFailed++;
+            }
+        }
+        vToAdmit.swap(vMissingInputs);
+    }
+    nFailed += vToAdmit.size();
+
+    int64_t nLast = GetTimeMicros();
+    LogPrintf("Imported mempool: %d accepted, %d failed, %d expired; %u proofs batch verified in %.2fms, total %.2fms\n",
+        nAccepted, nFailed, nExpired, nProofs, (nTimeVerify - nTimeRead) * 0.001, (nLast - nStart) * 0.001);
+    return true;
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -2284,6 +2540,55 @@ void CScriptCheck::swap(CScriptCheck &check) {
 
 ScriptError CScriptCheck::GetScriptError() const { return error; }
 
+/** Lowers the index of the first failed check of a block to nState, unless an earlier one failed already */
+static void SetFirstFailure(std::atomic<size_t>& nFirstFailure, size_t nState)
+{
+    size_t nCurrent = nFirstFailure.load();
+    while (nState < nCurrent && !nFirstFailure.compare_exchange_weak(nCurrent, nState)) {}
+}
+
+bool CTxCheck::operator()() {
+    // A check coming earlier in the block failed, this one can not change the outcome
+    if (nState > *pnFirstFailure)
+        return true;
+
+    // Don't count coinbase transactions because mining skews the count
+    if (!ptx->IsCoinBase()) {
+        transactionsValidated.increment();
+    }
+    if (!CheckTransactionWithoutProofVerification(*ptx, pstates[nState]))
+        SetFirstFailure(*pnFirstFailure, nState);
+    else if (nStateSemantic < *pnFirstFailure && !Sidechain::checkTxSemanticValidity(*ptx, pstates[nStateSemantic]))
+        SetFirstFailure(*pnFirstFailure, nStateSemantic);
+    return true;
+}
+
+bool CJoinSplitCheck::operator()() {
+    if (nState > *pnFirstFailure)
+        return true;
+
+    if (!CheckJoinSplitProof(*ptx, nJoinSplit, *pverifier, pstates[nState]))
+        SetFirstFailure(*pnFirstFailure, nState);
+    return true;
+}
+
+bool CBlockCheck::operator()() {
+    switch (type)
+    {
+        case Type::SCRIPT:    return scriptCheck();
+        case Type::TX:        return txCheck();
+        case Type::JOINSPLIT: return joinSplitCheck();
+        default:              return true;
+    }
+}
+
+void CBlockCheck::swap(CBlockCheck &check) {
+    std::swap(type, check.type);
+    scriptCheck.swap(check.scriptCheck);
+    std::swap(txCheck, check.txCheck);
+    std::swap(joinSplitCheck, check.joinSplitCheck);
+}
+
 bool IsCommunityFund(const CCoins *coins, int nIn)
 {
     if(coins != NULL &&
@@ -2834,11 +3139,20 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CCheckQueue<CBlockCheck> blockcheckqueue(128);
 
 void ThreadScriptCheck() {
     RenameThread("horizen-scriptch");
-    scriptcheckqueue.Thread();
+    blockcheckqueue.Thread();
+}
+
+static void AddScriptChecks(CCheckQueueControl<CBlockCheck>& control, std::vector<CScriptCheck>& vScriptChecks)
+{
+    std::vector<CBlockCheck> vChecks;
+    vChecks.reserve(vScriptChecks.size());
+    for (CScriptCheck& check: vScriptChecks)
+        vChecks.emplace_back(check);
+    control.Add(vChecks);
 }
 
 //
@@ -2950,7 +3264,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Check it again to verify JoinSplit proofs, and in case a previous version let a bad block in
     if (!CheckBlock(block, state, fExpensiveChecks ? verifier : disabledVerifier,
                     processingType == flagBlockProcessingType::COMPLETE ? flagCheckPow::ON : flagCheckPow::OFF,
-                    processingType == flagBlockProcessingType::COMPLETE ? flagCheckMerkleRoot::ON: flagCheckMerkleRoot::OFF))
+                    processingType == flagBlockProcessingType::COMPLETE ? flagCheckMerkleRoot::ON: flagCheckMerkleRoot::OFF,
+                    fExpensiveChecks ? flagParallelChecks::ON : flagParallelChecks::OFF))
         return false;
 
     // verify that the view's current state corresponds to the previous block
@@ -3002,7 +3317,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     CBlockUndo blockundo(includeSc);
 
-    CCheckQueueControl<CScriptCheck> control(fExpensiveChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
+    CCheckQueueControl<CBlockCheck> control(fExpensiveChecks && nScriptCheckThreads ? &blockcheckqueue : NULL);
 
     int64_t deltaPreProcTime = GetTimeMicros() - nTime0;
     LogPrint("bench", "    - block preproc: %.2fms\n", 0.001 * deltaPreProcTime);
@@ -3091,7 +3406,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             if (!ContextualCheckTxInputs(tx, state, view, fExpensiveChecks, chain, flags, false, chainparams.GetConsensus(), nScriptCheckThreads ? &vChecks : NULL))
                 return false;
 
-            control.Add(vChecks);
+            AddScriptChecks(control, vChecks);
         }
 
         CTxUndo undoDummy;
@@ -3127,8 +3442,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
 
-        if (fScRelatedChecks == flagScRelatedChecks::ON)
-            scCommitmentBuilder.add(tx);
     }  //end of Processing transactions loop
 
 
@@ -3162,7 +3475,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!ContextualCheckCertInputs(cert, state, view, fExpensiveChecks, chain, flags, false, chainparams.GetConsensus(), nScriptCheckThreads ? &vChecks : NULL))
             return false;
 
-        control.Add(vChecks);
+        AddScriptChecks(control, vChecks);
 
         CValidationState::Code ret_code = view.IsCertApplicableToState(cert);
         if (ret_code != CValidationState::Code::OK)
@@ -3222,10 +3535,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         vPos.push_back(std::make_pair(cert.GetHash(), pos));
         pos.nTxOffset += cert.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
 
-        if (fScRelatedChecks == flagScRelatedChecks::ON)
-        {
-            scCommitmentBuilder.add(cert, view);
-        }
 
         LogPrint("cert", "%s():%d - nTxOffset=%d\n", __func__, __LINE__, pos.nTxOffset );
     } //end of Processing certificates loop
@@ -3274,6 +3583,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     if (fScRelatedChecks == flagScRelatedChecks::ON)
     {
         int64_t nCommTreeStartTime = GetTimeMicros();
+        scCommitmentBuilder.add(block.vtx, block.vcert, view, SidechainTxsCommitmentBuilder::getThreadsNumber());
         const uint256& scTxsCommitment = scCommitmentBuilder.getCommitment();
         int64_t deltaCommTreeTime = GetTimeMicros() - nCommTreeStartTime;
         LogPrint("bench", "    - txsCommTree: %.2fms\n", deltaCommTreeTime * 0.001);
@@ -3511,10 +3821,12 @@ bool static DisconnectTip(CValidationState &state) {
     uint256 anchorBeforeDisconnect = pcoinsTip->GetBestAnchor();
     int64_t nStart = GetTimeMicros();
     std::vector<CScCertificateStatusUpdateInfo> certsStateInfo;
+    std::vector<CSidechainDelta> scDeltas;
     {
         CCoinsViewCache view(pcoinsTip);
         if (!DisconnectBlock(block, state, pindexDelete, view, NULL, &certsStateInfo))
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
+        scDeltas = view.GetSidechainDeltas();
         assert(view.Flush());
     }
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
@@ -3591,6 +3903,9 @@ bool static DisconnectTip(CValidationState &state) {
         SyncCertStatusUpdate(item);
     }
 
+    if (!scDeltas.empty())
+        scJournal.Append(pindexDelete->GetBlockHash(), pindexDelete->nHeight, false, scDeltas);
+
     // Update cached incremental witnesses
     GetMainSignals().ChainTip(pindexDelete, &block, newTree, false);
     return true;
@@ -3602,6 +3917,101 @@ static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
 
+/**
+ * Reads from disk the next block to connect and prefetches into pcoinsprefetch the coins,
+ * sidechains and CSW nullifiers it looks up, on a background thread, while the current
+ * block is being connected. Used under cs_main only: the background thread never touches
+ * the block index, the block position and hash being copied when the prefetch starts.
+ */
+class CBlockPrefetcher
+{
+private:
+    const CBlockIndex* pindex;
+    std::future<std::shared_ptr<CBlock> > futureBlock;
+
+    static std::shared_ptr<CBlock> Prefetch(CDiskBlockPos pos, uint256 hash)
+    {
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblock, pos))
+            return std::shared_ptr<CBlock>();
+        if (pblock->GetHash() != hash)
+        {
+            LogPrintf("%s(): GetHash() doesn't match index for %s at %s\n", __func__, hash.ToString(), pos.ToString());
+            return std::shared_ptr<CBlock>();
+        }
+
+        if (pcoinsprefetch == NULL)
+            return pblock;
+
+        std::vector<uint256> vTxIds;
+        std::vector<uint256> vScIds;
+        std::vector<std::pair<uint256, CFieldElement> > vCswNullifiers;
+        for (const CTransaction& tx : pblock->vtx)
+        {
+            if (!tx.IsCoinBase())
+                for (const CTxIn& txin : tx.GetVin())
+                    vTxIds.push_back(txin.prevout.hash);
+            for (const CTxForwardTransferOut& ft : tx.GetVftCcOut())
+                vScIds.push_back(ft.GetScId());
+            for (const CBwtRequestOut& mbtr : tx.GetVBwtRequestOut())
+                vScIds.push_back(mbtr.GetScId());
+            for (const CTxCeasedSidechainWithdrawalInput& csw : tx.GetVcswCcIn())
+            {
+                vScIds.push_back(csw.scId);
+                vCswNullifiers.push_back(std::make_pair(csw.scId, csw.nullifier));
+            }
+        }
+        for (const CScCertificate& cert : pblock->vcert)
+        {
+            for (const CTxIn& txin : cert.GetVin())
+                vTxIds.push_back(txin.prevout.hash);
+            vScIds.push_back(cert.GetScId());
+        }
+
+        pcoinsprefetch->Prefetch(vTxIds, vScIds, vCswNullifiers);
+        return pblock;
+    }
+
+public:
+    CBlockPrefetcher(): pindex(NULL) {}
+
+    //! Start prefetching the given block, after the previous prefetch has completed
+    void Start(const CBlockIndex* pindexIn)
+    {
+        AssertLockHeld(cs_main);
+        if (pindex == pindexIn)
+            return;
+        Wait();
+        pindex = pindexIn;
+        futureBlock = std::async(std::launch::async, &CBlockPrefetcher::Prefetch,
+                                 pindexIn->GetBlockPos(), pindexIn->GetBlockHash());
+    }
+
+    //! The given block if it is the one prefetched, waiting for the prefetch to complete, NULL otherwise
+    std::shared_ptr<CBlock> Take(const CBlockIndex* pindexIn)
+    {
+        if (pindex != pindexIn)
+            return std::shared_ptr<CBlock>();
+        pindex = NULL;
+        return futureBlock.get();
+    }
+
+    void Wait()
+    {
+        if (futureBlock.valid())
+            futureBlock.wait();
+        pindex = NULL;
+    }
+};
+
+static CBlockPrefetcher blockPrefetcher;
+
+void WaitForBlockPrefetch()
+{
+    LOCK(cs_main);
+    blockPrefetcher.Wait();
+}
+
 /**
  * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -3625,10 +4035,25 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     std::vector<CScCertificateStatusUpdateInfo> certsStateInfo;
+    std::vector<CSidechainDelta> scDeltas;
     {
+        uint64_t nPrefetchLookups = 0, nPrefetchHits = 0;
+        if (pcoinsprefetch)
+            pcoinsprefetch->GetPrefetchStats(nPrefetchLookups, nPrefetchHits);
+
         CCoinsViewCache view(pcoinsTip);
         bool rv = ConnectBlock(*pblock, state, pindexNew, view, chainActive, flagBlockProcessingType::COMPLETE,
                                flagScRelatedChecks::ON, flagScProofVerification::ON, &certsStateInfo);
+
+        if (pcoinsprefetch) {
+            uint64_t nTotalLookups = 0, nTotalHits = 0;
+            pcoinsprefetch->GetPrefetchStats(nTotalLookups, nTotalHits);
+            nPrefetchLookups = nTotalLookups - nPrefetchLookups;
+            nPrefetchHits = nTotalHits - nPrefetchHits;
+            LogPrint("bench", "  - Prefetch hits: %u/%u (%.1f%%) [%.1f%%]\n", nPrefetchHits, nPrefetchLookups,
+                nPrefetchLookups ? 100.0 * nPrefetchHits / nPrefetchLookups : 0.0,
+                nTotalLookups ? 100.0 * nTotalHits / nTotalLookups : 0.0);
+        }
         GetMainSignals().BlockChecked(*pblock, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -3638,6 +4063,7 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
         mapBlockSource.erase(pindexNew->GetBlockHash());
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
+        scDeltas = view.GetSidechainDeltas();
         assert(view.Flush());
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
@@ -3648,6 +4074,10 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001, nTimeChainState * 0.000001);
 
+    // Serialize the new tip once for all the publishers and read paths, which are idle during IBD
+    if (!IsInitialBlockDownload())
+        serializedBlockCache.Add(pindexNew->GetBlockHash(), *pblock);
+
     // Remove conflicting transactions from the mempool.
     std::list<CTransaction> removedTxs;
     std::list<CScCertificate> removedCerts;
@@ -3690,6 +4120,9 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
         SyncCertStatusUpdate(item);
     }
 
+    if (!scDeltas.empty())
+        scJournal.Append(pindexNew->GetBlockHash(), pindexNew->nHeight, true, scDeltas);
+
     // Update cached incremental witnesses
     GetMainSignals().ChainTip(pindexNew, pblock, oldTree, true);
 
@@ -3806,9 +4239,15 @@ static bool ActivateBestChainStep(CValidationState &state, CBlockIndex *pindexMo
     }
     nHeight = nTargetHeight;
 
-    // Connect new blocks.
+    // Connect new blocks, reading and prefetching each one while the previous is connected.
     BOOST_REVERSE_FOREACH(CBlockIndex *pindexConnect, vpindexToConnect) {
-        if (!ConnectTip(state, pindexConnect, pindexConnect == pindexMostWork ? pblock : NULL)) {
+        std::shared_ptr<CBlock> pblockPrefetched = blockPrefetcher.Take(pindexConnect);
+        if (pindexConnect != pindexMostWork)
+            blockPrefetcher.Start(pindexMostWork->GetAncestor(pindexConnect->nHeight + 1));
+
+        // the block received may be missing even for the most work tip, e.g. when activating a chain read from disk
+        CBlock *pblockConnect = (pindexConnect == pindexMostWork && pblock) ? pblock : pblockPrefetched.get();
+        if (!ConnectTip(state, pindexConnect, pblockConnect)) {
             if (state.IsInvalid()) {
                 // The block violates a consensus rule.
                 if (!state.CorruptionPossible())
@@ -3853,6 +4292,9 @@ bool ActivateBestChain(CValidationState &state, CBlock *pblock) {
     do {
         boost::this_thread::interruption_point();
 
+        // Let the asynchronous listeners catch up before connecting more blocks, if they are too far behind
+        LimitValidationInterfaceQueues();
+
         bool fInitialDownload;
         {
             LOCK(cs_main);
@@ -4144,7 +4586,7 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
     {
         const CFieldElement& prevScCumTreeHash =
                 (pindexNew->pprev->nVersion == BLOCK_VERSION_SC_SUPPORT) ?
-                        pindexNew->pprev->scCumTreeHash : CBlockIndex::defaultScCumTreeHash;
+                        pindexNew->pprev->scCumTreeHash.ToFieldElement() : CBlockIndex::defaultScCumTreeHash;
         pindexNew->scCumTreeHash = CFieldElement::ComputeHash(prevScCumTreeHash, CFieldElement{block.hashScTxsCommitment});
     }
 
@@ -4347,7 +4789,8 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, flagCh
 
 bool CheckBlock(const CBlock& block, CValidationState& state,
                 libzcash::ProofVerifier& verifier,
-                flagCheckPow fCheckPOW, flagCheckMerkleRoot fCheckMerkleRoot)
+                flagCheckPow fCheckPOW, flagCheckMerkleRoot fCheckMerkleRoot,
+                flagParallelChecks fParallelChecks)
 {
     // These are checks that are independent of context.
 
@@ -4409,10 +4852,47 @@ bool CheckBlock(const CBlock& block, CValidationState& state,
                              CValidationState::Code::INVALID, "bad-cb-multiple");
 
     // Check transactions and certificates
-    for(const CTransaction& tx: block.vtx) {
-        if (!CheckTransaction(tx, state, verifier)) {
+    if (fParallelChecks == flagParallelChecks::ON && nScriptCheckThreads) {
+        // Each check gets its own states, laid out in the order CheckTransaction runs them for each tx:
+        // the tx checks, its JoinSplit proofs, then the sidechain semantic checks.
+        size_t nChecks = 0;
+        for(const CTransaction& tx: block.vtx)
+            nChecks += 1 + tx.GetVjoinsplit().size();
+
+        std::vector<CValidationState> vStates(nChecks + block.vtx.size());
+        std::atomic<size_t> nFirstFailure(vStates.size());
+        std::vector<CBlockCheck> vChecks;
+        vChecks.reserve(nChecks);
+        size_t nState = 0;
+        for(const CTransaction& tx: block.vtx) {
+            const size_t nTxState = nState;
+            nState += 1 + tx.GetVjoinsplit().size() + 1;
+            vChecks.emplace_back(CTxCheck(tx, vStates.data(), nTxState, nState - 1, &nFirstFailure));
+            for (unsigned int i = 0; i < tx.GetVjoinsplit().size(); i++)
+                vChecks.emplace_back(CJoinSplitCheck(tx, i, verifier, vStates.data(), nTxState + 1 + i, &nFirstFailure));
+        }
+
+        // The queue hands its checks out from the back: they are queued reversed so that they start in
+        // block order, and those coming after a failure are skipped as soon as it is found. The checks
+        // never fail, so that the queue does not drop any before it: the failure reported is then the
+        // first one in order, the same as with sequential checking.
+        std::reverse(vChecks.begin(), vChecks.end());
+        {
+            CCheckQueueControl<CBlockCheck> control(&blockcheckqueue);
+            control.Add(vChecks);
+            control.Wait();
+        }
+
+        if (nFirstFailure < vStates.size()) {
+            state = vStates[nFirstFailure];
             return error("CheckBlock(): CheckTransaction failed");
         }
+    } else {
+        for(const CTransaction& tx: block.vtx) {
+            if (!CheckTransaction(tx, state, verifier)) {
+                return error("CheckBlock(): CheckTransaction failed");
+            }
+        }
     }
 
     if(!CheckCertificatesOrdering(block.vcert, state))
@@ -4998,6 +5478,18 @@ bool static LoadBlockIndexDB()
         addToGlobalForkTips(pindex);
     }
 
+    // Report what the sc cumulative tree hashes of the block index take in memory, and what they
+    // would take as plain CFieldElement (byte vector on the heap, mutex, deserialized field handle)
+    size_t nScCumTreeHashes = 0;
+    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+    {
+        if (!item.second->scCumTreeHash.IsNull())
+            ++nScCumTreeHashes;
+    }
+    LogPrint("bench", "%s: %u block index entries, %u sc cumulative tree hashes: %u bytes compact, %u bytes as CFieldElement\n",
+        __func__, mapBlockIndex.size(), nScCumTreeHashes, mapBlockIndex.size() * sizeof(CCompactFieldElement),
+        mapBlockIndex.size() * sizeof(CFieldElement) + nScCumTreeHashes * memusage::MallocUsage(CFieldElement::ByteSize()));
+
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
     vinfoBlockFile.resize(nLastBlockFile + 1);
@@ -21,6 +21,7 @@
 #include "uint256.h"
 
 #include <algorithm>
+#include <atomic>
 #include <exception>
 #include <map>
 #include <set>
@@ -34,6 +35,7 @@
 class CTransaction;
 class CCoins;
 class CCoinsViewCache;
+class CCoinsViewPrefetch;
 class CCoinsView;
 class CBlock;
 class CBlockLocator;
@@ -70,6 +72,12 @@ static const unsigned int MAX_STANDARD_TX_SIGOPS = MAX_BLOCK_SIGOPS/5;
 static const unsigned int DEFAULT_MIN_RELAY_TX_FEE = 100;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxmempool, maximum megabytes of mempool memory usage */
+static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
+/** Default for -mempoolexpiry, expiration time for mempool transactions and certificates in hours */
+static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -321,6 +329,12 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 void Misbehaving(NodeId nodeid, int howmuch);
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
+/** Wait for the background prefetch of the next block to connect, if any is running. */
+void WaitForBlockPrefetch();
+/** Dump the mempool txes and certs, and the ones waiting for their proofs to be verified, to mempool.dat. */
+bool DumpMempool();
+/** Load mempool.dat into the mempool, verifying the proofs of its certs and CSW txes in a single batch. */
+bool LoadMempool();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 
@@ -519,6 +533,75 @@ public:
     ScriptError GetScriptError() const;
 };
 
+/**
+ * Closure representing the context-free checks of one transaction, but for the
+ * verification of its JoinSplit proofs, each one being queued as a CJoinSplitCheck.
+ * The reason of a failure is stored in the states owned by the caller, one per check laid out
+ * in the order CheckTransaction runs them: the sidechain semantic checks, run after the proofs,
+ * have their own. The lowest index of a failed state is kept in the shared counter pointed to,
+ * and checks coming after it are skipped. It always succeeds, so that the queue does not stop
+ * before a failure coming earlier in the block has been found.
+ */
+class CTxCheck
+{
+private:
+    const CTransaction *ptx;
+    CValidationState *pstates;
+    size_t nState;
+    size_t nStateSemantic;
+    std::atomic<size_t> *pnFirstFailure;
+
+public:
+    CTxCheck(): ptx(nullptr), pstates(nullptr), nState(0), nStateSemantic(0), pnFirstFailure(nullptr) {}
+    CTxCheck(const CTransaction& txIn, CValidationState* pstatesIn, size_t nStateIn, size_t nStateSemanticIn,
+             std::atomic<size_t>* pnFirstFailureIn):
+        ptx(&txIn), pstates(pstatesIn), nState(nStateIn), nStateSemantic(nStateSemanticIn), pnFirstFailure(pnFirstFailureIn) {}
+    bool operator()();
+};
+
+/** Closure representing the verification of one JoinSplit proof of a transaction, succeeding and skipped as CTxCheck is */
+class CJoinSplitCheck
+{
+private:
+    const CTransaction *ptx;
+    unsigned int nJoinSplit;
+    libzcash::ProofVerifier *pverifier;
+    CValidationState *pstates;
+    size_t nState;
+    std::atomic<size_t> *pnFirstFailure;
+
+public:
+    CJoinSplitCheck(): ptx(nullptr), nJoinSplit(0), pverifier(nullptr), pstates(nullptr), nState(0), pnFirstFailure(nullptr) {}
+    CJoinSplitCheck(const CTransaction& txIn, unsigned int nJoinSplitIn, libzcash::ProofVerifier& verifierIn,
+                    CValidationState* pstatesIn, size_t nStateIn, std::atomic<size_t>* pnFirstFailureIn):
+        ptx(&txIn), nJoinSplit(nJoinSplitIn), pverifier(&verifierIn), pstates(pstatesIn), nState(nStateIn), pnFirstFailure(pnFirstFailureIn) {}
+    bool operator()();
+};
+
+/**
+ * Any of the checks run on the -par threads while validating a block, so that
+ * a single queue spreads scripts, transactions and JoinSplit proofs over all of them.
+ */
+class CBlockCheck
+{
+private:
+    enum class Type { NONE, SCRIPT, TX, JOINSPLIT };
+
+    Type type;
+    CScriptCheck scriptCheck;
+    CTxCheck txCheck;
+    CJoinSplitCheck joinSplitCheck;
+
+public:
+    CBlockCheck(): type(Type::NONE) {}
+    //! The script check is swapped in, as CCheckQueue does with its elements
+    explicit CBlockCheck(CScriptCheck& check): type(Type::SCRIPT) { scriptCheck.swap(check); }
+    explicit CBlockCheck(const CTxCheck& check): type(Type::TX), txCheck(check) {}
+    explicit CBlockCheck(const CJoinSplitCheck& check): type(Type::JOINSPLIT), joinSplitCheck(check) {}
+    bool operator()();
+    void swap(CBlockCheck &check);
+};
+
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
@@ -540,6 +623,7 @@ enum class flagCheckPow             { ON, OFF };
 enum class flagCheckMerkleRoot      { ON, OFF };
 enum class flagScRelatedChecks      { ON, OFF };
 enum class flagScProofVerification  { ON, OFF };
+enum class flagParallelChecks       { ON, OFF };
 
 /**
  * @brief The enumeration of allowed types of block processing.
@@ -565,7 +649,8 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, flagCh
 bool CheckBlock(const CBlock& block, CValidationState& state,
                 libzcash::ProofVerifier& verifier,
                 flagCheckPow fCheckPOW = flagCheckPow::ON,
-                flagCheckMerkleRoot fCheckMerkleRoot = flagCheckMerkleRoot::ON);
+                flagCheckMerkleRoot fCheckMerkleRoot = flagCheckMerkleRoot::ON,
+                flagParallelChecks fParallelChecks = flagParallelChecks::OFF);
 
 /** Context-dependent validity checks */
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex *pindexPrev);
@@ -663,6 +748,9 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Global variable that points to the layer below pcoinsTip holding the records prefetched for the next block to connect */
+extern CCoinsViewPrefetch *pcoinsprefetch;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
@@ -116,13 +116,14 @@ bool VerifyCertificatesDependencies(const CScCertificate& cert)
         return false;
     }
 
-    if (mempool.mapSidechains.at(cert.GetScId()).mBackwardCertificates.count(cert.quality) == 0)
+    const CCertEpochAndQuality position = std::make_pair(cert.epochNumber, cert.quality);
+    if (mempool.mapSidechains.at(cert.GetScId()).mBackwardCertificates.count(position) == 0)
     {
         if (fDebug) assert("cert is in mempool but not duly registered  in mapSidechains." == 0);
         return false;
     }
 
-    if (mempool.mapSidechains.at(cert.GetScId()).mBackwardCertificates.at(cert.quality) != cert.GetHash())
+    if (mempool.mapSidechains.at(cert.GetScId()).mBackwardCertificates.at(position) != cert.GetHash())
     {
         if (fDebug) assert("a different cert with the same scId and quality is in mempool" == 0);
         return false;
@@ -386,6 +387,156 @@ void GetBlockTxPriorityData(const CCoinsViewCache& view, int nHeight, int64_t nL
     }
 }
 
+void GetBlockPackagePriorityData(int nHeight, int64_t nLockTimeCutoff, vector<TxPriority>& vecPriority)
+{
+    // No sorting here: mempool keeps its entries indexed by ancestor score, that is by the fee rate of the
+    // package made of an entry and its in-mempool ancestors. Each entry is queued right after the ancestors
+    // not queued yet, all of them at the package fee rate, so that low fee parents come along with the
+    // children paying for them (the scCreation along with the fwds to its sidechain too).
+    std::set<uint256> setQueued;
+
+    auto queuePackage = [&](const CTransactionBase& txBase, const CMemPoolEntry& mpEntry, const CFeeRate& packageFeeRate)
+    {
+        std::vector<std::pair<uint64_t, const CTxMemPoolEntry*> > ancestorsToQueue;
+        for(const uint256& ancestor: mempool.mempoolDependenciesFrom(txBase))
+        {
+            if (setQueued.count(ancestor))
+                continue;
+
+            // certificates are queued by quality only, see below
+            if (mempool.mapCertificate.count(ancestor))
+            {
+                LogPrint("sc", "%s():%d - skipping [%s]: ancestor cert [%s] not queued yet\n",
+                    __func__, __LINE__, txBase.GetHash().ToString(), ancestor.ToString());
+                return;
+            }
+
+            const CTxMemPoolEntry& ancestorEntry = mempool.mapTx.at(ancestor);
+            if (ancestorEntry.GetTx().IsCoinBase() || !IsFinalTx(ancestorEntry.GetTx(), nHeight, nLockTimeCutoff))
+                return;
+            ancestorsToQueue.push_back(std::make_pair(ancestorEntry.GetCountWithAncestors(), &ancestorEntry));
+        }
+
+        // an ancestor has strictly less ancestors than any of its descendants, hence parents go first
+        std::sort(ancestorsToQueue.begin(), ancestorsToQueue.end());
+        for(const auto& ancestor: ancestorsToQueue)
+        {
+            const CTransaction& ancestorTx = ancestor.second->GetTx();
+            setQueued.insert(ancestorTx.GetHash());
+            vecPriority.push_back(TxPriority(ancestor.second->GetPriority(nHeight), packageFeeRate, &ancestorTx));
+        }
+
+        setQueued.insert(txBase.GetHash());
+        vecPriority.push_back(TxPriority(mpEntry.GetPriority(nHeight), packageFeeRate, &txBase));
+    };
+
+    // certificates first, since they have their own block partition, by increasing quality as consensus requires
+    for(const auto& scEntry: mempool.mapSidechains)
+    {
+        for(const auto& qualityAndCert: scEntry.second.mBackwardCertificates)
+        {
+            const CCertificateMemPoolEntry& certEntry = mempool.mapCertificate.at(qualityAndCert.second);
+            if (!VerifyCertificatesDependencies(certEntry.GetCertificate()))
+                continue;
+            queuePackage(certEntry.GetCertificate(), certEntry, certEntry.GetAncestorScore());
+        }
+    }
+
+    for(auto it = mempool.indexByAncestorScore.rbegin(); it != mempool.indexByAncestorScore.rend(); ++it)
+    {
+        const uint256& hash = it->second;
+        if (setQueued.count(hash) || mempool.mapTx.count(hash) == 0)
+            continue;
+
+        const CTxMemPoolEntry& txEntry = mempool.mapTx.at(hash);
+        if (txEntry.GetTx().IsCoinBase() || !IsFinalTx(txEntry.GetTx(), nHeight, nLockTimeCutoff))
+            continue;
+        queuePackage(txEntry.GetTx(), txEntry, it->first);
+    }
+}
+
+void SortBlockTxsByArrival(CBlockTemplate& blocktemplate)
+{
+    // The sc txs commitment tree is extended across templates only while the sc txes of the previous template
+    // are a prefix of the new ones. Fee ordering puts a better paying newcomer ahead of the txes already there,
+    // while arrival ordering appends it, hence txes are sorted here by mempool entry time (hash breaking ties)
+    // with each tx kept after the txes of the block it spends and after the creation of the sidechains it targets.
+    CBlock& block = blocktemplate.block;
+    const size_t nTx = block.vtx.size();
+    if (nTx <= 2)
+        return;
+
+    std::map<uint256, size_t> mapPos;
+    for (size_t i = 1; i < nTx; ++i)
+        mapPos[block.vtx[i].GetHash()] = i;
+
+    std::vector<std::vector<size_t> > vDependers(nTx);
+    std::vector<size_t> vMissingDeps(nTx, 0);
+    for (size_t i = 1; i < nTx; ++i)
+    {
+        const CTransaction& tx = block.vtx[i];
+        std::set<uint256> setDeps;
+        for(const CTxIn& txin: tx.GetVin())
+            setDeps.insert(txin.prevout.hash);
+        for(const auto& ft: tx.GetVftCcOut())
+            if (mempool.hasSidechainCreationTx(ft.scId))
+                setDeps.insert(mempool.mapSidechains.at(ft.scId).scCreationTxHash);
+        for(const auto& btr: tx.GetVBwtRequestOut())
+            if (mempool.hasSidechainCreationTx(btr.scId))
+                setDeps.insert(mempool.mapSidechains.at(btr.scId).scCreationTxHash);
+
+        for(const uint256& dep: setDeps)
+        {
+            auto it = mapPos.find(dep);
+            if (it == mapPos.end() || it->second == i)
+                continue;
+            vDependers[it->second].push_back(i);
+            ++vMissingDeps[i];
+        }
+    }
+
+    std::set<std::pair<std::pair<int64_t, uint256>, size_t> > setReady;
+    auto readyKey = [&](size_t i)
+    {
+        const uint256& hash = block.vtx[i].GetHash();
+        auto it = mempool.mapTx.find(hash);
+        int64_t nTime = (it != mempool.mapTx.end()) ? it->second.GetTime() : 0;
+        return std::make_pair(std::make_pair(nTime, hash), i);
+    };
+    for (size_t i = 1; i < nTx; ++i)
+        if (vMissingDeps[i] == 0)
+            setReady.insert(readyKey(i));
+
+    std::vector<size_t> vOrder(1, 0);
+    vOrder.reserve(nTx);
+    while (!setReady.empty())
+    {
+        size_t i = setReady.begin()->second;
+        setReady.erase(setReady.begin());
+        vOrder.push_back(i);
+        for(size_t depender: vDependers[i])
+            if (--vMissingDeps[depender] == 0)
+                setReady.insert(readyKey(depender));
+    }
+    assert(vOrder.size() == nTx);
+
+    std::vector<CTransaction> vtx;
+    std::vector<CAmount> vTxFees;
+    std::vector<int64_t> vTxSigOps;
+    vtx.reserve(nTx);
+    vTxFees.reserve(nTx);
+    vTxSigOps.reserve(nTx);
+    for(size_t i: vOrder)
+    {
+        vtx.push_back(block.vtx[i]);
+        vTxFees.push_back(blocktemplate.vTxFees[i]);
+        vTxSigOps.push_back(blocktemplate.vTxSigOps[i]);
+    }
+    block.vtx.swap(vtx);
+    blocktemplate.vTxFees.swap(vTxFees);
+    blocktemplate.vTxSigOps.swap(vTxSigOps);
+}
+
 void GetBlockTxPriorityDataOld(const CCoinsViewCache& view, int nHeight, int64_t nLockTimeCutoff,
                                vector<TxPriority>& vecPriority, list<COrphan>& vOrphan, map<uint256, vector<COrphan*> >& mapDependers)
 {
@@ -602,12 +753,27 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
                 : pblock->GetBlockTime();
 
         bool fDeprecatedGetBlockTemplate = GetBoolArg("-deprecatedgetblocktemplate", false);
-        if (fDeprecatedGetBlockTemplate)
-            GetBlockTxPriorityDataOld(view, nHeight, nLockTimeCutoff, vecPriority, vOrphan, mapDependers);
+        bool fSortedByFee = (nBlockPrioritySize <= 0);
+
+        // The fee part of a template is a walk over the mempool ancestor score index, already in the order to be tried.
+        // Coin age priority depends on the height and can not be indexed, hence every entry is sorted here, but only
+        // to fill the priority area: past it the priority queue is dropped in favour of the index walk.
+        bool fPackageOrder = fSortedByFee && !fDeprecatedGetBlockTemplate;
+        if (fPackageOrder)
+        {
+            GetBlockPackagePriorityData(nHeight, nLockTimeCutoff, vecPriority);
+            // consumed from the back
+            std::reverse(vecPriority.begin(), vecPriority.end());
+        }
         else
-            GetBlockTxPriorityData(view, nHeight, nLockTimeCutoff, vecPriority, vOrphan, mapDependers);
+        {
+            if (fDeprecatedGetBlockTemplate)
+                GetBlockTxPriorityDataOld(view, nHeight, nLockTimeCutoff, vecPriority, vOrphan, mapDependers);
+            else
+                GetBlockTxPriorityData(view, nHeight, nLockTimeCutoff, vecPriority, vOrphan, mapDependers);
 
-        GetBlockCertPriorityData(view, nHeight, vecPriority, vOrphan, mapDependers);
+            GetBlockCertPriorityData(view, nHeight, vecPriority, vOrphan, mapDependers);
+        }
 
         // Collect transactions into block
         uint64_t nBlockSize = 1000;
@@ -616,23 +782,31 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
         uint64_t nBlockTx = 0;
         uint64_t nBlockCert = 0;
         int nBlockSigOps = 100;
-        bool fSortedByFee = (nBlockPrioritySize <= 0);
 
         TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+        if (!fPackageOrder)
+            std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+
+        // Txes and certs taken for the priority area, met again when walking the packages
+        std::set<uint256> setInPriorityArea;
 
         // considering certs having a higher priority than any possible tx.
         // An algorithm for managing tx/cert priorities could be devised
         while (!vecPriority.empty())
         {
             // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransactionBase& tx = *(vecPriority.front().get<2>());
+            const TxPriority& nextPriority = fPackageOrder ? vecPriority.back() : vecPriority.front();
+            double dPriority = nextPriority.get<0>();
+            CFeeRate feeRate = nextPriority.get<1>();
+            const CTransactionBase& tx = *(nextPriority.get<2>());
 
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
+            if (!fPackageOrder)
+                std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
             vecPriority.pop_back();
 
+            if (fPackageOrder && setInPriorityArea.count(tx.GetHash()))
+                continue;
+
             // Size limits
             unsigned int nTxBaseSize = tx.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
 
@@ -679,6 +853,15 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
             {
                 fSortedByFee = true;
                 comparer = TxPriorityCompare(fSortedByFee);
+                if (!fDeprecatedGetBlockTemplate)
+                {
+                    // the current tx is not in the block yet, it comes back along with its package
+                    vecPriority.clear();
+                    GetBlockPackagePriorityData(nHeight, nLockTimeCutoff, vecPriority);
+                    std::reverse(vecPriority.begin(), vecPriority.end());
+                    fPackageOrder = true;
+                    continue;
+                }
                 std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
             }
 
@@ -735,6 +918,9 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
                     nBlockTxPartitionSize += nTxBaseSize;
                 }
 
+                if (!fSortedByFee)
+                    setInPriorityArea.insert(hash);
+
                 nBlockSize += nTxBaseSize;
                 LogPrint("sc", "%s():%d ======> current block size                = %7d\n", __func__, __LINE__, nBlockSize);
                 LogPrint("sc", "%s():%d ======> current block tx partition size   = %7d\n", __func__, __LINE__, nBlockTxPartitionSize);
@@ -756,7 +942,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
             }
 
             // Add transactions that depend on this one to the priority queue
-            if (mapDependers.count(hash))
+            if (!fPackageOrder && mapDependers.count(hash))
             {
                 LogPrint("sc", "%s():%d - tx[%s] has %d orphans\n",
                     __func__, __LINE__, hash.ToString(), mapDependers[hash].size());
@@ -807,7 +993,12 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
 
         if (pblock->nVersion == BLOCK_VERSION_SC_SUPPORT )
         {
-            pblock->hashScTxsCommitment = pblock->BuildScTxsCommitment(view);
+            SortBlockTxsByArrival(*pblocktemplate);
+
+            int64_t nCommTreeStartTime = GetTimeMicros();
+            pblock->hashScTxsCommitment = mempool.scTxsCommitmentBuilder.getCommitment(*pblock, view);
+            LogPrint("bench", "%s():%d - txsCommTree: %.2fms\n", __func__, __LINE__,
+                (GetTimeMicros() - nCommTreeStartTime) * 0.001);
         }
 
         UpdateTime(pblock, Params().GetConsensus(), pindexPrev);
@@ -69,6 +69,12 @@ void GetBlockTxPriorityDataOld(const CCoinsViewCache& view, int nHeight, int64_t
 void GetBlockCertPriorityData(const CCoinsViewCache& view, int nHeight,
                               std::vector<TxPriority>& vecPriority, std::list<COrphan>& vOrphan, std::map<uint256, std::vector<COrphan*> >& mapDependers);
 
+/** Retrieve mempool txes and certs in the order a fee-only block template should try them, packages by ancestor score */
+void GetBlockPackagePriorityData(int nHeight, int64_t nLockTimeCutoff, std::vector<TxPriority>& vecPriority);
+
+/** Reorder the txes of a block template (coinbase aside) by mempool arrival, parents and sc creations first */
+void SortBlockTxsByArrival(CBlockTemplate& blocktemplate);
+
 /** Generate a new block, without valid proof-of-work */
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn);
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlockMaxComplexitySize);
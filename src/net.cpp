@@ -16,6 +16,7 @@
 #include "scheduler.h"
 #include "ui_interface.h"
 #include "crypto/common.h"
+#include "netpoll.h"
 #include "zen/utiltls.h"
 
 
@@ -72,8 +73,24 @@ namespace {
     struct ListenSocket {
         SOCKET socket;
         bool whitelisted;
+        int nPollRegistered;
 
-        ListenSocket(SOCKET socket, bool whitelisted) : socket(socket), whitelisted(whitelisted) {}
+        ListenSocket(SOCKET socket, bool whitelisted) : socket(socket), whitelisted(whitelisted), nPollRegistered(0) {}
+    };
+
+    /** An inbound connection whose TLS handshake is carried on by the network thread, without blocking it */
+    struct PendingTLSAccept {
+        SOCKET socket;
+        SSL* ssl;
+        CAddress addr;
+        bool whitelisted;
+        int64_t nTimeStarted; // in milliseconds
+        int nWantEvents;
+        int nPollRegistered;
+
+        PendingTLSAccept(SOCKET socket, SSL* ssl, const CAddress& addr, bool whitelisted) :
+            socket(socket), ssl(ssl), addr(addr), whitelisted(whitelisted),
+            nTimeStarted(GetTimeMillis()), nWantEvents(SOCKET_EVENT_RECV), nPollRegistered(0) {}
     };
 }
 
@@ -89,6 +106,8 @@ static bool vfLimited[NET_MAX] = {};
 static CNode* pnodeLocalHost = NULL;
 uint64_t nLocalHostNonce = 0;
 static std::vector<ListenSocket> vhListenSocket;
+static std::list<PendingTLSAccept> lPendingTLSAccepts; // only used by the network thread
+static CSocketPoller* pSocketPoller = NULL;
 CAddrMan addrman;
 int nMaxConnections = DEFAULT_MAX_PEER_CONNECTIONS;
 bool fAddressesInitialized = false;
@@ -549,8 +568,10 @@ void CNode::CloseSocketDisconnect()
 
             if (ssl)
             {
+                // send our close_notify without waiting for the peer's one, the socket is closed anyway
+                int nWantEvents = 0;
                 unsigned long err_code = 0;
-                tlsmanager.waitFor(SSL_SHUTDOWN, hSocket, ssl, (DEFAULT_CONNECT_TIMEOUT / 1000), err_code);
+                tlsmanager.stepRoutine(SSL_SHUTDOWN, hSocket, ssl, nWantEvents, err_code);
                 SSL_free(ssl);
                 ssl = NULL;
             }
@@ -845,6 +866,7 @@ void SocketSendData(CNode *pnode)
                 ERR_clear_error(); // clear the error queue, otherwise we may be reading an old error that occurred previously in the current thread
                 nBytes = SSL_write(pnode->ssl, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset);
                 nRet = SSL_get_error(pnode->ssl, nBytes);
+                pnode->fSslWriteWantsRecv = (nBytes <= 0 && nRet == SSL_ERROR_WANT_READ);
             }
             else
             {
@@ -884,12 +906,7 @@ void SocketSendData(CNode *pnode)
                         LogPrintf("ERROR: SSL_write %s; closing connection\n", ERR_error_string(nRet, NULL));
                         pnode->CloseSocketDisconnect();
                     }
-                    else
-                    {
-                        // preventive measure from exhausting CPU usage
-                        //
-                        MilliSleep(1);    // 1 msec
-                    }
+                    // otherwise SSL_write() is retried when the poller reports the event it waits for
                 }
                 else
                 {
@@ -1071,25 +1088,82 @@ static bool AttemptToEvictConnection(bool fPreferNewConnection) {
 }
 
 
+/**
+ * @brief Adds the node of an inbound connection, evicting another inbound peer when all the slots are taken.
+ * 
+ * @return false when there was no room for the node, its socket being left to the caller.
+ */
+static bool AddInboundNode(SOCKET hSocket, const CAddress& addr, SSL* ssl, bool whitelisted)
+{
+    int nInbound = 0;
+    int nMaxInbound = nMaxConnections - MAX_OUTBOUND_CONNECTIONS;
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes)
+            if (pnode->fInbound)
+                nInbound++;
+    }
+
+    if (nInbound >= nMaxInbound)
+    {
+        if (!AttemptToEvictConnection(whitelisted)) {
+            // No connection to evict, disconnect the new connection
+            LogPrint("net", "failed to find an eviction candidate - connection dropped (full)\n");
+            return false;
+        }
+    }
+
+    CNode* pnode = new CNode(hSocket, addr, "", true, ssl);
+    pnode->AddRef();
+    pnode->fWhitelisted = whitelisted;
+
+    {
+        LOCK(cs_vNodes);
+        vNodes.push_back(pnode);
+    }
+    return true;
+}
+
+#ifdef USE_TLS
+static void FailInboundTLS(const CAddress& addr, unsigned long err_code)
+{
+    if (CNode::GetTlsFallbackNonTls())
+    {
+        LOCK(cs_vNonTLSNodesInbound);
+
+        if (err_code == TLSManager::SELECT_TIMEDOUT)
+        {
+            // can fail also for timeout in select on fd, that is not a ssl error and we should not
+            // consider this node as non TLS
+            LogPrint("tls", "%s():%d - Connection from %s timedout\n", __func__, __LINE__, addr.ToStringIP());
+        }
+        else
+        {
+            // Further reconnection will be made in non-TLS (unencrypted) mode
+            vNonTLSNodesInbound.push_back(NODE_ADDR(addr.ToStringIP(), GetTimeMillis()));
+            LogPrint("tls", "%s():%d - err_code %x, adding connection from %s vNonTLSNodesInbound list (sz=%d)\n",
+                __func__, __LINE__, err_code, addr.ToStringIP(), vNonTLSNodesInbound.size());
+        }
+    }
+    else
+    {
+        LogPrint("tls", "%s():%d - err_code %x, failure accepting connection from %s\n",
+            __func__, __LINE__, err_code, addr.ToStringIP());
+    }
+}
+#endif // USE_TLS
+
 static void AcceptConnection(const ListenSocket& hListenSocket) {
     struct sockaddr_storage sockaddr;
     socklen_t len = sizeof(sockaddr);
     SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
     CAddress addr;
-    int nInbound = 0;
-    int nMaxInbound = nMaxConnections - MAX_OUTBOUND_CONNECTIONS;
 
     if (hSocket != INVALID_SOCKET)
         if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
             LogPrintf("Warning: Unknown socket family\n");
 
     bool whitelisted = hListenSocket.whitelisted || CNode::IsWhitelistedRange(addr);
-    {
-        LOCK(cs_vNodes);
-        BOOST_FOREACH(CNode* pnode, vNodes)
-            if (pnode->fInbound)
-                nInbound++;
-    }
 
     if (hSocket == INVALID_SOCKET)
     {
@@ -1113,16 +1187,6 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (nInbound >= nMaxInbound)
-    {
-        if (!AttemptToEvictConnection(whitelisted)) {
-            // No connection to evict, disconnect the new connection
-            LogPrint("net", "failed to find an eviction candidate - connection dropped (full)\n");
-            CloseSocket(hSocket);
-            return;
-        }
-    }
-
     // According to the internet TCP_NODELAY is not carried into accepted sockets
     // on all platforms.  Set it again here just to be sure.
     int set = 1;
@@ -1133,12 +1197,11 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
 #endif
 
 
-    SSL *ssl = NULL;
-    
     SetSocketNonBlocking(hSocket, true);
     
 #ifdef USE_TLS
     /* TCP connection is ready. Do server side SSL. */
+    bool bUseTLS = true;
     if (CNode::GetTlsFallbackNonTls())
     {
         LOCK(cs_vNonTLSNodesInbound);
@@ -1147,33 +1210,10 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
 
         NODE_ADDR nodeAddr(addr.ToStringIP());
         
-        bool bUseTLS = (find(vNonTLSNodesInbound.begin(),
-                             vNonTLSNodesInbound.end(),
-                             nodeAddr) == vNonTLSNodesInbound.end());
-        unsigned long err_code = 0;
-        if (bUseTLS)
-        {
-            ssl = tlsmanager.accept( hSocket, addr, err_code);
-            if(!ssl)
-            {
-                if (err_code == TLSManager::SELECT_TIMEDOUT)
-                {
-                    // can fail also for timeout in select on fd, that is not a ssl error and we should not
-                    // consider this node as non TLS
-                    LogPrint("tls", "%s():%d - Connection from %s timedout\n", __func__, __LINE__, addr.ToStringIP());
-                }
-                else
-                {
-                    // Further reconnection will be made in non-TLS (unencrypted) mode
-                    vNonTLSNodesInbound.push_back(NODE_ADDR(addr.ToStringIP(), GetTimeMillis()));
-                    LogPrint("tls", "%s():%d - err_code %x, adding connection from %s vNonTLSNodesInbound list (sz=%d)\n",
-                        __func__, __LINE__, err_code, addr.ToStringIP(), vNonTLSNodesInbound.size());
-                }
-                CloseSocket(hSocket);
-                return;
-            }
-        }
-        else
+        bUseTLS = (find(vNonTLSNodesInbound.begin(),
+                        vNonTLSNodesInbound.end(),
+                        nodeAddr) == vNonTLSNodesInbound.end());
+        if (!bUseTLS)
         {
             LogPrintf ("TLS: Connection from %s will be unencrypted\n", addr.ToStringIP());
             
@@ -1186,45 +1226,93 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
                     vNonTLSNodesInbound.end());
         }
     }
-    else
+
+    if (bUseTLS)
     {
-        unsigned long err_code = 0;
-        ssl = tlsmanager.accept( hSocket, addr, err_code);
-        if(!ssl)
+        // The handshakes have their own slots, a peer is only evicted for a connection once it is over,
+        // and stalled handshakes make room for new ones
+        if (lPendingTLSAccepts.size() >= MAX_PENDING_TLS_ACCEPTS)
         {
-            LogPrint("tls", "%s():%d - err_code %x, failure accepting connection from %s\n",
-                __func__, __LINE__, err_code, addr.ToStringIP());
-            CloseSocket(hSocket);
-            return;
+            PendingTLSAccept& oldest = lPendingTLSAccepts.front();
+            LogPrint("tls", "%s():%d - too many pending TLS handshakes, dropping the one from %s\n",
+                __func__, __LINE__, oldest.addr.ToStringIP());
+            SSL_free(oldest.ssl);
+            CloseSocket(oldest.socket);
+            lPendingTLSAccepts.pop_front();
         }
-    }
-    
-    // certificate validation is disabled by default    
-    if (CNode::GetTlsValidate())
-    {
-        if (ssl && !ValidatePeerCertificate(ssl))
+
+        unsigned long err_code = 0;
+        SSL *ssl = tlsmanager.startAccept(hSocket, addr, err_code);
+        if (!ssl)
         {
-            LogPrintf ("TLS: ERROR: Wrong client certificate from %s. Connection will be closed.\n", addr.ToString());
-        
-            SSL_shutdown(ssl);
+            FailInboundTLS(addr, err_code);
             CloseSocket(hSocket);
-            SSL_free(ssl);
             return;
         }
+        // the handshake goes on in ThreadSocketHandler, as the socket becomes ready
+        lPendingTLSAccepts.push_back(PendingTLSAccept(hSocket, ssl, addr, whitelisted));
+        return;
     }
 #endif // USE_TLS
 
-    CNode* pnode = new CNode(hSocket, addr, "", true, ssl);
-    pnode->AddRef();
-    pnode->fWhitelisted = whitelisted;
+    if (!AddInboundNode(hSocket, addr, NULL, whitelisted))
+        CloseSocket(hSocket);
+}
 
+#if defined(USE_TLS)
+/**
+ * @brief Carries on the handshake of an inbound TLS connection, adding its node once it is over.
+ * 
+ * @param pending the connection, whose socket is closed when it returns true.
+ * @param nEvents the socket events found by the poller.
+ * @return true when the handshake is over, successfully or not.
+ */
+static bool ContinueTLSAccept(PendingTLSAccept& pending, int nEvents)
+{
+    unsigned long err_code = 0;
+    int ret = 0;
+
+    if (nEvents & (pending.nWantEvents | SOCKET_EVENT_ERROR))
+        ret = tlsmanager.continueAccept(pending.socket, pending.ssl, pending.addr, pending.nWantEvents, err_code);
+
+    if (ret == 0)
     {
-        LOCK(cs_vNodes);
-        vNodes.push_back(pnode);
+        if (GetTimeMillis() - pending.nTimeStarted < DEFAULT_CONNECT_TIMEOUT)
+            return false;
+
+        LogPrint("tls", "TLS: ERROR: %s: %s():%d - handshake timeout on SSL_ACCEPT\n", __FILE__, __func__, __LINE__);
+        SSL_free(pending.ssl);
+        ret = -1;
+        err_code = TLSManager::SELECT_TIMEDOUT;
+    }
+
+    if (ret == -1)
+    {
+        FailInboundTLS(pending.addr, err_code);
+        CloseSocket(pending.socket);
+        return true;
+    }
+
+    // certificate validation is disabled by default    
+    if (CNode::GetTlsValidate() && !ValidatePeerCertificate(pending.ssl))
+    {
+        LogPrintf ("TLS: ERROR: Wrong client certificate from %s. Connection will be closed.\n", pending.addr.ToString());
+    
+        SSL_shutdown(pending.ssl);
+        CloseSocket(pending.socket);
+        SSL_free(pending.ssl);
+        return true;
     }
+
+    if (!AddInboundNode(pending.socket, pending.addr, pending.ssl, pending.whitelisted))
+    {
+        SSL_shutdown(pending.ssl);
+        CloseSocket(pending.socket);
+        SSL_free(pending.ssl);
+    }
+    return true;
 }
 
-#if defined(USE_TLS)
 void ThreadNonTLSPoolsCleaner()
 {
     while (true)
@@ -1240,6 +1328,8 @@ void ThreadNonTLSPoolsCleaner()
 
 void ThreadSocketHandler()
 {
+    assert(pSocketPoller != NULL);
+    CSocketPoller& poller = *pSocketPoller;
     unsigned int nPrevNodeCount = 0;
     while (true)
     {
@@ -1309,24 +1399,13 @@ void ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
+        int64_t nTimeoutMs = 50; // frequency to poll pnode->vSend
+
+        BOOST_FOREACH(ListenSocket& hListenSocket, vhListenSocket)
+            poller.Watch(hListenSocket.socket, SOCKET_EVENT_RECV, hListenSocket.nPollRegistered);
+
+        BOOST_FOREACH(PendingTLSAccept& pending, lPendingTLSAccepts)
+            poller.Watch(pending.socket, pending.nWantEvents, pending.nPollRegistered);
 
         {
             LOCK(cs_vNodes);
@@ -1336,19 +1415,15 @@ void ThreadSocketHandler()
                 
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
 
                 // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
+                // * If there is data to send, wait for sending data. As this only
                 //   happens when optimistic write failed, we choose to first drain the
                 //   write buffer in this case before receiving more. This avoids
                 //   needlessly queueing received data, if the remote peer is not themselves
                 //   receiving data. This means properly utilizing TCP flow control signalling.
                 // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
+                //   or there is space left in the buffer, wait for receiving data.
                 // * (if neither of the above applies, there is certainly one message
                 //   in the receiver buffer ready to be processed).
                 // Together, that means that at least one of the following is always possible,
@@ -1356,53 +1431,58 @@ void ThreadSocketHandler()
                 // * We send some data.
                 // * We wait for data to be received (and disconnect after timeout).
                 // * We process a message in the buffer (message handler thread).
-
+                // With TLS, an SSL_read or SSL_write may also have to wait for the opposite event.
+                int nEvents = 0;
                 {
                     TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
-                    }
+                    if (lockSend && !pnode->vSendMsg.empty())
+                        nEvents = pnode->fSslWriteWantsRecv ? SOCKET_EVENT_RECV : SOCKET_EVENT_SEND;
                 }
+                if (nEvents == 0)
                 {
                     TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                     if (lockRecv && (
                         pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
                         pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
+                    {
+                        nEvents = pnode->fSslReadWantsSend ? SOCKET_EVENT_SEND : SOCKET_EVENT_RECV;
+                        // records already read from the socket are not seen by the poller
+                        if (pnode->ssl && SSL_has_pending(pnode->ssl))
+                            nTimeoutMs = 0;
+                    }
                 }
+                poller.Watch(pnode->hSocket, nEvents, pnode->nPollRegistered);
             }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        if (!poller.Wait(nTimeoutMs))
+            MilliSleep(nTimeoutMs);
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec/1000);
-        }
-
         //
         // Accept new connections
         //
         BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && (poller.GetEvents(hListenSocket.socket) & SOCKET_EVENT_RECV))
             {
                 AcceptConnection(hListenSocket);
             }
         }
 
+#ifdef USE_TLS
+        //
+        // Carry on the TLS handshakes of inbound connections
+        //
+        for (std::list<PendingTLSAccept>::iterator it = lPendingTLSAccepts.begin(); it != lPendingTLSAccepts.end(); )
+        {
+            if (ContinueTLSAccept(*it, poller.GetEvents(it->socket)))
+                it = lPendingTLSAccepts.erase(it);
+            else
+                ++it;
+        }
+#endif // USE_TLS
+
         //
         // Service each socket
         //
@@ -1417,7 +1497,12 @@ void ThreadSocketHandler()
         {
             boost::this_thread::interruption_point();
 
-            if (tlsmanager.threadSocketHandler(pnode,fdsetRecv,fdsetSend,fdsetError)==-1){
+            SOCKET hSocket;
+            {
+                LOCK(pnode->cs_hSocket);
+                hSocket = pnode->hSocket;
+            }
+            if (hSocket == INVALID_SOCKET || tlsmanager.threadSocketHandler(pnode, poller.GetEvents(hSocket)) == -1){
                 continue;
             }
 
@@ -1840,6 +1925,22 @@ void ThreadMessageHandler()
 
 
 
+bool InitSocketPoller(string& strError)
+{
+    strError = "";
+    if (pSocketPoller == NULL)
+        pSocketPoller = new CSocketPoller();
+
+    // without it the network thread would never see any peer socket ready
+    if (!pSocketPoller->IsValid())
+    {
+        strError = _("Unable to wait on peer sockets, see debug.log for details.");
+        LogPrintf("%s\n", strError);
+        return false;
+    }
+    return true;
+}
+
 bool BindListenPort(const CService &addrBind, string& strError, bool fWhitelisted)
 {
     strError = "";
@@ -2096,6 +2197,11 @@ void CNode::NetCleanup()
         if (hListenSocket.socket != INVALID_SOCKET)
             if (!CloseSocket(hListenSocket.socket))
                 LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+    BOOST_FOREACH(PendingTLSAccept& pending, lPendingTLSAccepts)
+    {
+        SSL_free(pending.ssl);
+        CloseSocket(pending.socket);
+    }
 
     // clean up some globals (to help leak detection)
     BOOST_FOREACH(CNode *pnode, vNodes)
@@ -2105,6 +2211,9 @@ void CNode::NetCleanup()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+    lPendingTLSAccepts.clear();
+    delete pSocketPoller;
+    pSocketPoller = NULL;
     delete semOutbound;
     semOutbound = NULL;
     delete pnodeLocalHost;
@@ -2326,8 +2435,11 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     setInventoryKnown(SendBufferSize() / 1000)
 {
     ssl = sslIn;
+    fSslReadWantsSend = false;
+    fSslWriteWantsRecv = false;
     nServices = 0;
     hSocket = hSocketIn;
+    nPollRegistered = 0;
     nRecvVersion = INIT_PROTO_VERSION;
     nLastSend = 0;
     nLastRecv = 0;
@@ -2429,8 +2541,9 @@ CNode::~CNode()
     {
         if (ssl)
         {
+            int nWantEvents = 0;
             unsigned long err_code = 0;
-            tlsmanager.waitFor(SSL_SHUTDOWN, hSocket, ssl, (DEFAULT_CONNECT_TIMEOUT / 1000), err_code);
+            tlsmanager.stepRoutine(SSL_SHUTDOWN, hSocket, ssl, nWantEvents, err_code);
             
             SSL_free(ssl);
             ssl = NULL;
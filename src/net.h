@@ -68,6 +68,8 @@ static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 static const size_t SETASKFOR_MAX_SZ = 2 * MAX_INV_SZ;
 /** The maximum number of peer connections to maintain. */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
+/** The maximum number of inbound connections whose TLS handshake is still in progress. */
+static const unsigned int MAX_PENDING_TLS_ACCEPTS = 16;
 
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
@@ -82,6 +84,7 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest = NULL);
 bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOutbound = NULL, const char *strDest = NULL, bool fOneShot = false);
 unsigned short GetListenPort();
 bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhitelisted = false);
+bool InitSocketPoller(std::string& strError);
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
 void SocketSendData(CNode *pnode);
@@ -263,11 +266,15 @@ class CNode
 public:
     // OpenSSL
     SSL *ssl;
+    // the last SSL_read needs the socket to be writable, the last SSL_write to be readable
+    bool fSslReadWantsSend;
+    bool fSslWriteWantsRecv;
 
     // socket
     uint64_t nServices;
     SOCKET hSocket;
     CCriticalSection cs_hSocket;
+    int nPollRegistered; // socket events registered in the poller of the network thread
     CDataStream ssSend;
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
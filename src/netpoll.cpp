@@ -0,0 +1,190 @@
+#include "netpoll.h"
+
+#include "netbase.h"
+#include "util.h"
+
+#include <algorithm>
+#include <limits>
+
+int WaitForSocket(SOCKET hSocket, int nEvents, int64_t nTimeoutMs)
+{
+#ifdef WIN32
+    struct timeval timeout = MillisToTimeval(nTimeoutMs);
+    fd_set fdsetRecv, fdsetSend, fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    if (nEvents & SOCKET_EVENT_RECV)
+        FD_SET(hSocket, &fdsetRecv);
+    if (nEvents & SOCKET_EVENT_SEND)
+        FD_SET(hSocket, &fdsetSend);
+    FD_SET(hSocket, &fdsetError);
+
+    int nRet = select(hSocket + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (nRet <= 0)
+        return nRet;
+    return (FD_ISSET(hSocket, &fdsetRecv) ? SOCKET_EVENT_RECV : 0) |
+           (FD_ISSET(hSocket, &fdsetSend) ? SOCKET_EVENT_SEND : 0) |
+           (FD_ISSET(hSocket, &fdsetError) ? SOCKET_EVENT_ERROR : 0);
+#else
+    struct pollfd pfd = {};
+    pfd.fd = hSocket;
+    pfd.events = ((nEvents & SOCKET_EVENT_RECV) ? POLLIN : 0) | ((nEvents & SOCKET_EVENT_SEND) ? POLLOUT : 0);
+
+    int nRet = poll(&pfd, 1, (int)std::min<int64_t>(nTimeoutMs, std::numeric_limits<int>::max()));
+    if (nRet <= 0)
+        return nRet;
+    return ((pfd.revents & POLLIN) ? SOCKET_EVENT_RECV : 0) |
+           ((pfd.revents & POLLOUT) ? SOCKET_EVENT_SEND : 0) |
+           ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) ? SOCKET_EVENT_ERROR : 0);
+#endif
+}
+
+#ifdef USE_EPOLL
+
+CSocketPoller::CSocketPoller(): hEpoll(epoll_create1(EPOLL_CLOEXEC)), vEvents(1024)
+{
+    if (hEpoll == -1)
+        LogPrintf("socket epoll_create1 error %s\n", NetworkErrorString(errno));
+}
+
+CSocketPoller::~CSocketPoller()
+{
+    if (hEpoll != -1)
+        close(hEpoll);
+}
+
+bool CSocketPoller::IsValid() const
+{
+    return hEpoll != -1;
+}
+
+void CSocketPoller::Watch(SOCKET hSocket, int nEvents, int& nRegistered)
+{
+    if (nRegistered == (nEvents | SOCKET_EVENT_REGISTERED))
+        return;
+
+    // level triggered, errors and hang-ups are reported with no need to ask for them
+    struct epoll_event event = {};
+    event.events = ((nEvents & SOCKET_EVENT_RECV) ? EPOLLIN : 0) | ((nEvents & SOCKET_EVENT_SEND) ? EPOLLOUT : 0);
+    event.data.fd = hSocket;
+
+    int nRet = epoll_ctl(hEpoll, nRegistered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, hSocket, &event);
+    // the socket may have been registered by a previous owner, as when an inbound TLS handshake is over
+    if (nRet == -1 && errno == EEXIST)
+        nRet = epoll_ctl(hEpoll, EPOLL_CTL_MOD, hSocket, &event);
+    else if (nRet == -1 && errno == ENOENT)
+        nRet = epoll_ctl(hEpoll, EPOLL_CTL_ADD, hSocket, &event);
+
+    if (nRet == -1)
+    {
+        LogPrintf("socket epoll_ctl error %s\n", NetworkErrorString(errno));
+        return;
+    }
+    nRegistered = nEvents | SOCKET_EVENT_REGISTERED;
+}
+
+bool CSocketPoller::Wait(int64_t nTimeoutMs)
+{
+    mapReady.clear();
+    if (hEpoll == -1)
+        return false;
+
+    int nReady = epoll_wait(hEpoll, vEvents.data(), vEvents.size(), (int)nTimeoutMs);
+    if (nReady == -1)
+    {
+        if (errno == EINTR)
+            return true;
+        LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(errno));
+        return false;
+    }
+
+    for (int i = 0; i < nReady; i++)
+    {
+        const uint32_t events = vEvents[i].events;
+        mapReady[vEvents[i].data.fd] = ((events & EPOLLIN) ? SOCKET_EVENT_RECV : 0) |
+                                       ((events & EPOLLOUT) ? SOCKET_EVENT_SEND : 0) |
+                                       ((events & (EPOLLERR | EPOLLHUP)) ? SOCKET_EVENT_ERROR : 0);
+    }
+
+    // more sockets may have been ready than the events fetched, make room for them in the next waits
+    if ((size_t)nReady == vEvents.size())
+        vEvents.resize(vEvents.size() * 2);
+    return true;
+}
+
+int CSocketPoller::GetEvents(SOCKET hSocket) const
+{
+    auto it = mapReady.find(hSocket);
+    return (it != mapReady.end()) ? it->second : 0;
+}
+
+#else
+
+CSocketPoller::CSocketPoller(): hSocketMax(0), fHaveFds(false)
+{
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    FD_ZERO(&fdsetRecvReady);
+    FD_ZERO(&fdsetSendReady);
+    FD_ZERO(&fdsetErrorReady);
+}
+
+CSocketPoller::~CSocketPoller() {}
+
+bool CSocketPoller::IsValid() const
+{
+    return true;
+}
+
+void CSocketPoller::Watch(SOCKET hSocket, int nEvents, int& nRegistered)
+{
+    if (nEvents & SOCKET_EVENT_RECV)
+        FD_SET(hSocket, &fdsetRecv);
+    if (nEvents & SOCKET_EVENT_SEND)
+        FD_SET(hSocket, &fdsetSend);
+    FD_SET(hSocket, &fdsetError);
+    hSocketMax = std::max(hSocketMax, hSocket);
+    fHaveFds = true;
+    nRegistered = nEvents | SOCKET_EVENT_REGISTERED;
+}
+
+bool CSocketPoller::Wait(int64_t nTimeoutMs)
+{
+    struct timeval timeout = MillisToTimeval(nTimeoutMs);
+    fdsetRecvReady = fdsetRecv;
+    fdsetSendReady = fdsetSend;
+    fdsetErrorReady = fdsetError;
+
+    int nSelect = select(fHaveFds ? hSocketMax + 1 : 0, &fdsetRecvReady, &fdsetSendReady, &fdsetErrorReady, &timeout);
+    bool fFailed = (nSelect == SOCKET_ERROR);
+    if (fFailed)
+    {
+        if (fHaveFds)
+        {
+            LogPrintf("socket select error %s\n", NetworkErrorString(WSAGetLastError()));
+            for (unsigned int i = 0; i <= hSocketMax; i++)
+                FD_SET(i, &fdsetRecvReady);
+        }
+        FD_ZERO(&fdsetSendReady);
+        FD_ZERO(&fdsetErrorReady);
+    }
+
+    // the sets are rebuilt for every wait
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    hSocketMax = 0;
+    fHaveFds = false;
+    return !fFailed;
+}
+
+int CSocketPoller::GetEvents(SOCKET hSocket) const
+{
+    return (FD_ISSET(hSocket, &fdsetRecvReady) ? SOCKET_EVENT_RECV : 0) |
+           (FD_ISSET(hSocket, &fdsetSendReady) ? SOCKET_EVENT_SEND : 0) |
+           (FD_ISSET(hSocket, &fdsetErrorReady) ? SOCKET_EVENT_ERROR : 0);
+}
+
+#endif // USE_EPOLL
@@ -0,0 +1,70 @@
+#ifndef BITCOIN_NETPOLL_H
+#define BITCOIN_NETPOLL_H
+
+#include "compat.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+//! Socket events that can be waited for, SOCKET_EVENT_ERROR being always reported
+enum SocketEvent {
+    SOCKET_EVENT_RECV  = 1,
+    SOCKET_EVENT_SEND  = 2,
+    SOCKET_EVENT_ERROR = 4,
+};
+
+/**
+ * @brief Waits up to nTimeoutMs for nEvents on a single socket, with no FD_SETSIZE limit outside Windows.
+ * @return int the events that occurred, 0 on timeout or SOCKET_ERROR.
+ */
+int WaitForSocket(SOCKET hSocket, int nEvents, int64_t nTimeoutMs);
+
+/**
+ * @brief Waits for the readiness of all the sockets served by the network thread.
+ * With epoll the events each socket is waited for are kept by the kernel and only updated when they change,
+ * so that a wait costs the number of ready sockets rather than the number of peers; elsewhere it falls back
+ * to select(), whose sets are rebuilt for every wait.
+ * The events last registered for a socket are kept by its owner, starting from 0: a closed socket leaving
+ * the epoll set by itself, a descriptor reused by a new connection is then registered again.
+ */
+class CSocketPoller
+{
+public:
+    CSocketPoller();
+    ~CSocketPoller();
+
+    //! Waits for nEvents on hSocket in the next Wait, to be called before each of them for every socket
+    void Watch(SOCKET hSocket, int nEvents, int& nRegistered);
+
+    //! False when the poller could not be set up, no socket event being ever reported then
+    bool IsValid() const;
+
+    //! Waits up to nTimeoutMs for any of the watched events, returns false on error
+    bool Wait(int64_t nTimeoutMs);
+
+    //! Events found on hSocket by the last Wait
+    int GetEvents(SOCKET hSocket) const;
+
+private:
+    //! Set in the events kept by the owner of a registered socket, for it to be non zero
+    static const int SOCKET_EVENT_REGISTERED = 0x100;
+
+#ifdef USE_EPOLL
+    int hEpoll;
+    std::vector<struct epoll_event> vEvents;
+    std::unordered_map<SOCKET, int> mapReady;
+#else
+    fd_set fdsetRecv, fdsetSend, fdsetError;
+    // FD_ISSET takes a non const set on Windows
+    mutable fd_set fdsetRecvReady, fdsetSendReady, fdsetErrorReady;
+    SOCKET hSocketMax;
+    bool fHaveFds;
+#endif
+};
+
+#endif // BITCOIN_NETPOLL_H
@@ -154,15 +154,7 @@ uint256 CBlock::BuildScTxsCommitment(const CCoinsViewCache& view)
 {
     SidechainTxsCommitmentBuilder scCommitmentBuilder;
 
-    for (const auto& tx : vtx)
-    {
-        scCommitmentBuilder.add(tx);
-    }
-
-    for (const auto& cert : vcert)
-    {
-        scCommitmentBuilder.add(cert, view);
-    }
+    scCommitmentBuilder.add(vtx, vcert, view, SidechainTxsCommitmentBuilder::getThreadsNumber());
 
     return scCommitmentBuilder.getCommitment();
 }
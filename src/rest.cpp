@@ -5,6 +5,7 @@
 
 #include "primitives/block.h"
 #include "primitives/transaction.h"
+#include "blockcache.h"
 #include "main.h"
 #include "httpserver.h"
 #include "rpc/server.h"
@@ -214,23 +215,27 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex))
+        if (rf == RF_JSON && !ReadBlockFromDisk(block, pblockindex))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
+    // the raw formats are served from the serialization shared with the block publishers
+    std::shared_ptr<const CSerializedBlockCache::CEntry> entry;
+    if (rf == RF_BINARY || rf == RF_HEX) {
+        entry = serializedBlockCache.GetOrRead(pblockindex);
+        if (!entry)
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+    }
 
     switch (rf) {
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
         req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
+        req->WriteReply(HTTP_OK, entry->GetRaw());
         return true;
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        string strHex = entry->GetHex() + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "blockcache.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -18,6 +19,8 @@
 
 #include <stdint.h>
 
+#include <boost/filesystem.hpp>
+
 #include <univalue.h>
 
 #include <regex>
@@ -585,17 +588,17 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
 
-    if(!ReadBlockFromDisk(block, pblockindex))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
-
     if (verbosity == 0)
     {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        std::shared_ptr<const CSerializedBlockCache::CEntry> entry = serializedBlockCache.GetOrRead(pblockindex);
+        if (!entry)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        return entry->GetHex();
     }
 
+    if(!ReadBlockFromDisk(block, pblockindex))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
     return blockToJSON(block, pblockindex, verbosity >= 2);
 }
 
@@ -639,6 +642,57 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
     return ret;
 }
 
+UniValue dumpchainstate(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumpchainstate \"filename\"\n"
+            "\nWrites the chainstate at the current tip to a snapshot file: coins, anchors, nullifiers,\n"
+            "sidechains, sidechain events and csw nullifiers. A node having the same block index can load it\n"
+            "with -loadsnapshot instead of connecting all the blocks.\n"
+            "Note this call may take some time.\n"
+
+            "\nArguments:\n"
+            "1. \"filename\"    (string, required) the snapshot file, relative to the data directory if not absolute\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"filename\": \"path\",       (string) the absolute path of the snapshot file\n"
+            "  \"height\":n,                 (numeric) the height of the snapshot block\n"
+            "  \"bestblock\": \"hex\",       (string) the hash of the snapshot block\n"
+            "  \"records\": n,               (numeric) the number of chainstate records written\n"
+            "  \"chunks\": n,                (numeric) the number of checksummed chunks they are split into\n"
+            "  \"commitment\": \"hash\"      (string) the hash of the header and of the checksums of all the chunks, to be given to -snapshotcommitment when loading the snapshot\n"
+            "}\n"
+
+            "\nExamples:\n"
+            + HelpExampleCli("dumpchainstate", "\"chainstate.snapshot\"")
+            + HelpExampleRpc("dumpchainstate", "\"chainstate.snapshot\"")
+        );
+
+    boost::filesystem::path pathSnapshot = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    if (boost::filesystem::exists(pathSnapshot))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "File " + pathSnapshot.string() + " already exists");
+
+    CChainstateSnapshotInfo info;
+    FlushStateToDisk();
+    if (!pcoinsTip->DumpSnapshot(pathSnapshot.string(), info))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to write the chainstate snapshot");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filename", pathSnapshot.string());
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(info.hashBlock);
+        ret.pushKV("height", it != mapBlockIndex.end() ? it->second->nHeight : -1);
+    }
+    ret.pushKV("bestblock", info.hashBlock.GetHex());
+    ret.pushKV("records", (int64_t)info.nRecords);
+    ret.pushKV("chunks", (int64_t)info.nChunks);
+    ret.pushKV("commitment", info.hashCommitment.GetHex());
+    return ret;
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 4)
@@ -1006,6 +1060,13 @@ UniValue mempoolInfoToJSON()
     ret.pushKV("size", (int64_t) mempool.size());
     ret.pushKV("bytes", (int64_t) mempool.GetTotalSize());
     ret.pushKV("usage", (int64_t) mempool.DynamicMemoryUsage());
+    size_t maxmempool = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+    ret.pushKV("maxmempool", (int64_t) maxmempool);
+    ret.pushKV("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK()));
+    ret.pushKV("evictedtxs", (int64_t) mempool.GetEvictedTxs());
+    ret.pushKV("evictedcerts", (int64_t) mempool.GetEvictedCerts());
+    ret.pushKV("expiredtxs", (int64_t) mempool.GetExpiredTxs());
+    ret.pushKV("expiredcerts", (int64_t) mempool.GetExpiredCerts());
 
     if (Params().NetworkIDString() == "regtest") {
         ret.pushKV("fullyNotified", mempool.IsFullyNotified());
@@ -1026,6 +1087,12 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "  \"size\": xxxxx                (numeric) current tx count\n"
             "  \"bytes\": xxxxx               (numeric) sum of all tx sizes\n"
             "  \"usage\": xxxxx               (numeric) total memory usage for the mempool\n"
+            "  \"maxmempool\": xxxxx          (numeric) maximum memory usage for the mempool\n"
+            "  \"mempoolminfee\": xxxxx       (numeric) minimum fee rate in " + CURRENCY_UNIT + "/kB for an entry to be accepted, raised after evictions\n"
+            "  \"evictedtxs\": xxxxx          (numeric) txes evicted since startup to keep the mempool within maxmempool\n"
+            "  \"evictedcerts\": xxxxx        (numeric) certificates evicted since startup to keep the mempool within maxmempool\n"
+            "  \"expiredtxs\": xxxxx          (numeric) txes removed since startup for exceeding -mempoolexpiry\n"
+            "  \"expiredcerts\": xxxxx        (numeric) certificates removed since startup for exceeding -mempoolexpiry\n"
             "}\n"
             
             "\nExamples:\n"
@@ -1379,69 +1446,70 @@ bool FillScRecord(const uint256& scId, UniValue& scRecord, bool bOnlyAlive, bool
     return FillScRecordFromInfo(scId, sidechain, scState, scView, scRecord, bOnlyAlive, bVerbose);
 }
 
-int FillScList(UniValue& scItems, bool bOnlyAlive, bool bVerbose, int from=0, int to=-1)
+/**
+ * @brief Gets the entries of the sidechain index following the given one, confirmed and in mempool,
+ * without reading any sidechain record.
+ */
+static void GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive,
+                              std::vector<CSidechainIndexEntry>& entries)
 {
-    std::set<uint256> sScIds;
-    {
-        LOCK(mempool.cs);
-        CCoinsViewMemPool scView(pcoinsTip, mempool);
+    LOCK(mempool.cs);
+    CCoinsViewMemPool scView(pcoinsTip, mempool);
+    int height = CCoinsViewCache(pcoinsTip).GetHeight();
 
-        scView.GetScIds(sScIds);
-    }
+    scView.GetScIndexEntries(after, maxItems, bOnlyAlive, height, entries);
+}
+
+int FillScList(UniValue& scItems, bool bOnlyAlive, bool bVerbose, int from=0, int to=-1)
+{
+    // the state filter is applied on the index, only the records in the requested interval are read
+    std::vector<CSidechainIndexEntry> entries;
+    GetScIndexEntries(CSidechainIndexEntry(), std::numeric_limits<size_t>::max(), bOnlyAlive, entries);
 
-    if (sScIds.size() == 0)
+    if (entries.size() == 0)
         return 0;
 
+    // getscinfo lists the sidechains by scId, the index order being kept for listsidechains only
+    std::sort(entries.begin(), entries.end(),
+        [](const CSidechainIndexEntry& lhs, const CSidechainIndexEntry& rhs) { return lhs.scId < rhs.scId; });
+
     // means upper limit max
     if (to == -1)
     {
-        to = sScIds.size();
+        to = entries.size();
     }
 
     // basic check of interval parameters
     if ( from < 0 || to < 0 || from >= to)
     {
-        LogPrint("sc", "invalid interval: from[%d], to[%d] (sz=%d)\n", from, to, sScIds.size());
+        LogPrint("sc", "invalid interval: from[%d], to[%d] (sz=%d)\n", from, to, entries.size());
         throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid interval");
     }
 
-    UniValue totalResult(UniValue::VARR);
-    std::set<uint256>::iterator it = sScIds.begin();
-
-    while (it != sScIds.end())
-    {
-        UniValue scRecord(UniValue::VOBJ);
-        if (FillScRecord(*it, scRecord, bOnlyAlive, bVerbose))
-            totalResult.push_back(scRecord);
-        ++it;
-    }
-
     // check consistency of interval in the filtered results list
     // --
     // 'from' must be in the valid interval
-    if (from > totalResult.size())
+    if (from > entries.size())
     {
-        LogPrint("sc", "invalid interval: from[%d] > sz[%d]\n", from, totalResult.size());
+        LogPrint("sc", "invalid interval: from[%d] > sz[%d]\n", from, entries.size());
         throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid interval");
     }
 
     // 'to' must be a formally valid upper bound interval number (positive and greater than 'from') but it is
     // topped anyway to the upper bound value 
-    if (to > totalResult.size())
+    if (to > entries.size())
     {
-        to = totalResult.size();
+        to = entries.size();
     }
 
-    auto vec = totalResult.getValues();
-    auto first = vec.begin() + from;
-    auto last  = vec.begin() + to;
-
-    while (first != last)
+    for (int idx = from; idx < to; ++idx)
     {
-        scItems.push_back(*first++);
+        UniValue scRecord(UniValue::VOBJ);
+        if (FillScRecord(entries[idx].scId, scRecord, bOnlyAlive, bVerbose))
+            scItems.push_back(scRecord);
     }
 
-    return vec.size(); 
+    return entries.size(); 
 }
 
 void FillCertDataHash(const uint256& scid, UniValue& ret)
@@ -1615,6 +1683,71 @@ UniValue getscinfo(const UniValue& params, bool fHelp)
     return ret;
 }
 
+UniValue listsidechains(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 4)
+        throw runtime_error(
+            "listsidechains ( onlyAlive verbose count \"cursor\" )\n"
+            "\nReturns a page of sidechains info, ordered by creation height and scid. Sidechains whose creation\n"
+            "is still in mempool are listed last. Only the records of the returned page are read.\n"
+            "\nArguments:\n"
+            "1. onlyAlive (bool, optional, default=false) Retrieve only information for alive sidechains\n"
+            "2. verbose   (bool, optional, default=true) If false include only essential info in result\n"
+            "3. count     (numeric, optional, default=100) The maximum number of sidechains in the page\n"
+            "4. \"cursor\"  (string, optional) The \"nextCursor\" returned by a previous call, to get the following page\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"items\": [ ... ],                 (array) sidechain records, with the same format as getscinfo items\n"
+            "  \"nextCursor\": \"xxxxx\",           (string) cursor of the following page, only present if more sidechains follow\n"
+            "}\n"
+
+            "\nExamples\n"
+            + HelpExampleCli("listsidechains", "true false 10")
+            + HelpExampleRpc("listsidechains", "false, true, 10, \"218:1a3e7ccbfd40c4e2304c3215f76d204e4de63c578ad835510f580d529516a874\"")
+        );
+
+    bool bOnlyAlive = false;
+    if (params.size() > 0)
+        bOnlyAlive = params[0].get_bool();
+
+    bool bVerbose = true;
+    if (params.size() > 1)
+        bVerbose = params[1].get_bool();
+
+    int count = 100;
+    if (params.size() > 2)
+        count = params[2].get_int();
+    if (count <= 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "count must be positive");
+
+    CSidechainIndexEntry after;
+    if (params.size() > 3 && !CSidechainIndexEntry::FromCursor(params[3].get_str(), after))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+
+    // one more entry tells whether a following page exists
+    std::vector<CSidechainIndexEntry> entries;
+    GetScIndexEntries(after, count + 1, bOnlyAlive, entries);
+
+    bool bMore = entries.size() > count;
+    if (bMore)
+        entries.resize(count);
+
+    UniValue scItems(UniValue::VARR);
+    for (const CSidechainIndexEntry& entry : entries)
+    {
+        UniValue scRecord(UniValue::VOBJ);
+        if (FillScRecord(entry.scId, scRecord, bOnlyAlive, bVerbose))
+            scItems.push_back(scRecord);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("items", scItems);
+    if (bMore)
+        ret.pushKV("nextCursor", entries.back().ToCursor());
+
+    return ret;
+}
+
 UniValue getactivecertdatahash(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -2080,6 +2213,16 @@ UniValue getproofverifierstats(const UniValue& params, bool fHelp)
     obj.pushKV("okCerts",       static_cast<uint64_t>(stats.okCertCounter));
     obj.pushKV("okCSWs",        static_cast<uint64_t>(stats.okCswCounter));
 
+    CCctpObjectCache<sc_vk_t>::Stats vkCacheStats = CScVKey::GetDeserializedCache().GetStats();
+    obj.pushKV("vkCacheHits",   vkCacheStats.hits);
+    obj.pushKV("vkCacheMisses", vkCacheStats.misses);
+    obj.pushKV("vkCacheSize",   static_cast<uint64_t>(vkCacheStats.entries));
+
+    CCctpObjectCache<field_t>::Stats feCacheStats = CFieldElement::GetDeserializedCache().GetStats();
+    obj.pushKV("feCacheHits",   feCacheStats.hits);
+    obj.pushKV("feCacheMisses", feCacheStats.misses);
+    obj.pushKV("feCacheSize",   static_cast<uint64_t>(feCacheStats.entries));
+
     return obj;
 }
 
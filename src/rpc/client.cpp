@@ -118,6 +118,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "zcrawjoinsplit", 4 },
     { "zcbenchmark", 1 },
     { "zcbenchmark", 2 },
+    { "zcbenchmark", 3 },
     { "getblocksubsidy", 0 },
     { "getblockmerkleroots", 0 },
     { "getblockmerkleroots", 1 },
@@ -141,6 +142,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getscinfo", 2 },
     { "getscinfo", 3 },
     { "getscinfo", 4 },
+    { "listsidechains", 0 },
+    { "listsidechains", 1 },
+    { "listsidechains", 2 },
     { "sc_send", 0 },
     { "sc_send", 1 },
     { "sc_request_transfer", 0 },
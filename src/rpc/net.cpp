@@ -13,6 +13,7 @@
 #include "util.h"
 #include "version.h"
 #include "zen/utiltls.h"
+#include "zen/websocket_server.h"
 
 #include <boost/foreach.hpp>
 
@@ -405,6 +406,54 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     return obj;
 }
 
+UniValue getwebsocketinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getwebsocketinfo\n"
+            "\nReturns information about the websocket server connections and their outbound queues.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,           (boolean) if the websocket server is running\n"
+            "  \"connections\": n,               (numeric) number of connected clients\n"
+            "  \"maxconnections\": n,            (numeric) maximum number of connected clients\n"
+            "  \"workerthreads\": n,             (numeric) number of threads serving the client requests\n"
+            "  \"acceptedconnections\": n,       (numeric) total number of connections accepted\n"
+            "  \"rejectedconnections\": n,       (numeric) total number of connections refused for the maximum being reached\n"
+            "  \"slowconsumers\": n,             (numeric) total number of clients disconnected for not reading their messages\n"
+            "  \"queuedmessages\": n,            (numeric) messages waiting to be written, for all the clients\n"
+            "  \"queuedbytes\": n,               (numeric) bytes waiting to be written, for all the clients\n"
+            "  \"maxqueuedbytes\": n,            (numeric) bytes waiting to be written to the most behind client\n"
+            "  \"queuelimitbytes\": n            (numeric) bytes waiting over which a client is disconnected\n"
+            "}\n"
+
+            "\nExamples:\n"
+            + HelpExampleCli("getwebsocketinfo", "")
+            + HelpExampleRpc("getwebsocketinfo", "")
+       );
+
+    WsServerStats stats;
+    UniValue obj(UniValue::VOBJ);
+    if (!GetWsServerStats(stats))
+    {
+        obj.pushKV("enabled", false);
+        return obj;
+    }
+    obj.pushKV("enabled", true);
+    obj.pushKV("connections", stats.nConnections);
+    obj.pushKV("maxconnections", stats.nMaxConnections);
+    obj.pushKV("workerthreads", stats.nWorkerThreads);
+    obj.pushKV("acceptedconnections", stats.nAccepted);
+    obj.pushKV("rejectedconnections", stats.nRejected);
+    obj.pushKV("slowconsumers", stats.nSlowConsumers);
+    obj.pushKV("queuedmessages", (uint64_t)stats.nQueuedMessages);
+    obj.pushKV("queuedbytes", (uint64_t)stats.nQueuedBytes);
+    obj.pushKV("maxqueuedbytes", (uint64_t)stats.nMaxQueuedBytes);
+    obj.pushKV("queuelimitbytes", (uint64_t)MAX_WS_OUTBOUND_QUEUE_BYTES);
+    return obj;
+}
+
 static UniValue GetNetworksInfo()
 {
     UniValue networks(UniValue::VARR);
@@ -183,6 +183,7 @@ extern UniValue getnettotals(const UniValue& params, bool fHelp);
 extern UniValue setban(const UniValue& params, bool fHelp);
 extern UniValue listbanned(const UniValue& params, bool fHelp);
 extern UniValue clearbanned(const UniValue& params, bool fHelp);
+extern UniValue getwebsocketinfo(const UniValue& params, bool fHelp);
 
 extern UniValue dumpprivkey(const UniValue& params, bool fHelp); // in rpcdump.cpp
 extern UniValue importprivkey(const UniValue& params, bool fHelp);
@@ -276,6 +277,7 @@ extern UniValue getblock(const UniValue& params, bool fHelp);
 extern UniValue getblockfinalityindex(const UniValue& params, bool fHelp);
 extern UniValue getglobaltips(const UniValue& params, bool fHelp);
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp);
+extern UniValue dumpchainstate(const UniValue& params, bool fHelp);
 extern UniValue gettxout(const UniValue& params, bool fHelp);
 extern UniValue verifychain(const UniValue& params, bool fHelp);
 extern UniValue getchaintips(const UniValue& params, bool fHelp);
@@ -305,6 +307,7 @@ extern UniValue sc_create(const UniValue& params, bool fHelp); // in rpcwallet.c
 extern UniValue sc_send(const UniValue& params, bool fHelp); // in rpcwallet.cpp
 extern UniValue sc_request_transfer(const UniValue& params, bool fHelp); // in rpcwallet.cpp
 extern UniValue getscinfo(const UniValue& params, bool fHelp); 
+extern UniValue listsidechains(const UniValue& params, bool fHelp);
 extern UniValue getactivecertdatahash(const UniValue& params, bool fHelp);
 extern UniValue getceasingcumsccommtreehash(const UniValue& params, bool fHelp);
 extern UniValue getscgenesisinfo(const UniValue& params, bool fHelp); 
@@ -1,26 +1,53 @@
 #include "asyncproofverifier.h"
 
+#include <algorithm>
+#include <limits>
+
+#include <boost/chrono/chrono.hpp>
+
 #include "coins.h"
 #include "init.h"
 #include "main.h"
 #include "util.h"
+#include "utiltime.h"
 #include "primitives/certificate.h"
 
 const uint32_t CScAsyncProofVerifier::BATCH_VERIFICATION_MAX_DELAY = 5000;   /**< The maximum delay in milliseconds between batch verification requests */
 const uint32_t CScAsyncProofVerifier::BATCH_VERIFICATION_MAX_SIZE = 10;      /**< The threshold size of the proof queue that triggers a call to the batch verification. */
+const uint32_t CScAsyncProofVerifier::BATCH_VERIFICATION_MAX_ITEMS = 200;    /**< The maximum number of queued items taken by a single batch. */
 
 
 #ifndef BITCOIN_TX
 void CScAsyncProofVerifier::LoadDataForCertVerification(const CCoinsViewCache& view, const CScCertificate& scCert, CNode* pfrom)
 {
-    LOCK(cs_asyncQueue);
-    CScProofVerifier::LoadDataForCertVerification(view, scCert, pfrom);
+    CSidechain sidechain;
+    assert(view.GetSidechain(scCert.GetScId(), sidechain) && "Unknown sidechain at scTx proof verification stage");
+
+    // The certificate can be mined up to the end of its submission window, while the view
+    // height is the one of the current tip (the certificate would be included in the next block).
+    int deadlineHeight = sidechain.GetCertSubmissionWindowEnd(scCert.epochNumber);
+    bool urgent = deadlineHeight - (view.GetHeight() + 1) < CERT_URGENT_BLOCKS_LEFT;
+
+    {
+        boost::unique_lock<boost::mutex> lock(cs_asyncQueue);
+        CScProofVerifier::LoadDataForCertVerification(view, scCert, pfrom);
+        Enqueue(scCert.GetHash(), deadlineHeight, urgent);
+    }
+
+    cvAsyncQueue.notify_one();
 }
 
 void CScAsyncProofVerifier::LoadDataForCswVerification(const CCoinsViewCache& view, const CTransaction& scTx, CNode* pfrom)
 {
-    LOCK(cs_asyncQueue);
-    CScProofVerifier::LoadDataForCswVerification(view, scTx, pfrom);
+    {
+        boost::unique_lock<boost::mutex> lock(cs_asyncQueue);
+        CScProofVerifier::LoadDataForCswVerification(view, scTx, pfrom);
+
+        // CSW transactions have no deadline, they are always queued behind certificates
+        Enqueue(scTx.GetHash(), std::numeric_limits<int>::max(), false);
+    }
+
+    cvAsyncQueue.notify_one();
 }
 #endif
 
@@ -48,84 +75,200 @@ uint32_t CScAsyncProofVerifier::GetCustomMaxBatchVerifyMaxSize()
     return static_cast<uint32_t>(size);
 }
 
+int CScAsyncProofVerifier::GetCustomVerificationThreads()
+{
+    int threads = GetArg("-scproofverificationthreads", DEFAULT_VERIFICATION_THREADS);
+    if (threads < 1)
+    {
+        LogPrintf("%s():%d - ERROR: scproofverificationthreads=%d, must be positive, setting to default value = %d\n",
+            __func__, __LINE__, threads, DEFAULT_VERIFICATION_THREADS);
+        threads = DEFAULT_VERIFICATION_THREADS;
+    }
+    return threads;
+}
+
 /**
- * @brief A function that periodically performs batch verification over the queued proofs.
- * It should run on a dedicated thread.
+ * @brief Adds the scheduling data of an item just inserted into the proof queue.
+ * The cs_asyncQueue lock must be held by the caller.
+ * 
+ * @param txHash The hash of the transaction/certificate
+ * @param deadlineHeight The last height at which the transaction/certificate can be mined
+ * @param urgent Whether the item has to be verified without waiting for a batch to fill up
  */
-void CScAsyncProofVerifier::RunPeriodicVerification()
+void CScAsyncProofVerifier::Enqueue(const uint256& txHash, int deadlineHeight, bool urgent)
+{
+    if (proofQueue.count(txHash) == 0 || mapQueueEntries.count(txHash) != 0)
+    {
+        // Nothing was loaded or the item is already scheduled.
+        return;
+    }
+
+    CAsyncProofQueueEntry entry;
+    entry.deadlineHeight = deadlineHeight;
+    entry.sequence = sequenceCounter++;
+    entry.enqueueTime = GetTimeMillis();
+    entry.urgent = urgent;
+    entry.txHash = txHash;
+
+    priorityIndex.insert(entry);
+    arrivalIndex.insert(std::make_pair(entry.enqueueTime, txHash));
+    mapQueueEntries.insert(std::make_pair(txHash, entry));
+}
+
+/**
+ * @brief Checks whether the queued proofs should be verified right away.
+ * The cs_asyncQueue lock must be held by the caller.
+ * 
+ * The batch verification can be triggered by three events:
+ * 
+ * 1. The queue has grown up beyond the threshold size;
+ * 2. The oldest proof in the queue has waited for too long;
+ * 3. A certificate whose submission window is about to close is waiting.
+ * 
+ * @param now The current time in milliseconds
+ * @param maxDelay The maximum time in milliseconds a proof can wait in the queue
+ * @param maxSize The threshold size of the queue
+ * 
+ * @return true If a batch verification has to be started.
+ * @return false Otherwise.
+ */
+bool CScAsyncProofVerifier::IsBatchReady(int64_t now, uint32_t maxDelay, uint32_t maxSize) const
 {
-    /**
-     * The age of the queue in milliseconds.
-     * This value represents the time spent in the queue by the oldest proof in the queue.
-     */
-    uint32_t queueAge = 0;
+    if (priorityIndex.empty())
+    {
+        return false;
+    }
+
+    return priorityIndex.size() > maxSize ||
+           now - arrivalIndex.begin()->first >= maxDelay ||
+           priorityIndex.begin()->urgent;
+}
+
+/**
+ * @brief Moves the items with the highest priority out of the proof queue.
+ * The cs_asyncQueue lock must be held by the caller.
+ * 
+ * @return The map of items to be verified in the next batch.
+ */
+std::map</* Tx hash */ uint256, CProofVerifierItem> CScAsyncProofVerifier::TakeBatch()
+{
+    std::map</*scTxHash*/uint256, CProofVerifierItem> batch;
+
+    while (!priorityIndex.empty() && batch.size() < BATCH_VERIFICATION_MAX_ITEMS)
+    {
+        const CAsyncProofQueueEntry entry = *priorityIndex.begin();
+        priorityIndex.erase(priorityIndex.begin());
+        arrivalIndex.erase(std::make_pair(entry.enqueueTime, entry.txHash));
+        mapQueueEntries.erase(entry.txHash);
+
+        auto it = proofQueue.find(entry.txHash);
+        assert(it != proofQueue.end());
+        batch.insert(std::make_pair(it->first, std::move(it->second)));
+        proofQueue.erase(it);
+    }
+
+    return batch;
+}
 
+/**
+ * @brief A function that performs batch verification over the queued proofs.
+ * It should run on one or more dedicated threads; each one waits for proofs to be
+ * enqueued and verifies a batch as soon as the trigger conditions are met.
+ */
+void CScAsyncProofVerifier::RunPeriodicVerification()
+{
     uint32_t batchVerificationMaxDelay = GetCustomMaxBatchVerifyDelay();
     uint32_t batchVerificationMaxSize  = GetCustomMaxBatchVerifyMaxSize();
 
-
     while (!ShutdownRequested())
     {
-        size_t currentQueueSize = proofQueue.size();
+        std::map</*scTxHash*/uint256, CProofVerifierItem> tempProofData;
+        bool pendingProofs = false;
 
-        if (currentQueueSize > 0)
         {
-            queueAge += THREAD_WAKE_UP_PERIOD;
-
-            /**
-             * The batch verification can be triggered by two events:
-             * 
-             * 1. The queue has grown up beyond the threshold size;
-             * 2. The oldest proof in the queue has waited for too long.
-             */
-            if (queueAge > batchVerificationMaxDelay || currentQueueSize > batchVerificationMaxSize)
-            {
-                queueAge = 0;
-                std::map</*scTxHash*/uint256, CProofVerifierItem> tempProofData;
+            boost::unique_lock<boost::mutex> lock(cs_asyncQueue);
 
-                {
-                    LOCK(cs_asyncQueue);
+            int64_t now = GetTimeMillis();
 
-                    size_t proofQueueSize = proofQueue.size();
+            if (!IsBatchReady(now, batchVerificationMaxDelay, batchVerificationMaxSize))
+            {
+                // Sleep until a new proof is enqueued or the oldest queued proof has waited for too long.
+                int64_t waitTime = THREAD_WAKE_UP_PERIOD;
 
-                    LogPrint("cert", "%s():%d - Async verification triggered, %d proofs to be verified \n",
-                             __func__, __LINE__, proofQueueSize);
+                if (!arrivalIndex.empty())
+                {
+                    int64_t oldestDeadline = arrivalIndex.begin()->first + batchVerificationMaxDelay;
+                    waitTime = std::max<int64_t>(0, std::min(waitTime, oldestDeadline - now));
+                }
 
-                    // Move the queued proofs into a local map, so that we can release the lock
-                    tempProofData = std::move(proofQueue);
+                // Interrupt() notifies under the lock, so a shutdown requested before waiting is not missed.
+                if (!ShutdownRequested())
+                    cvAsyncQueue.wait_for(lock, boost::chrono::milliseconds(waitTime));
+                continue;
+            }
 
-                    assert(proofQueue.size() == 0);
-                    assert(tempProofData.size() == proofQueueSize);
-                }
+            tempProofData = TakeBatch();
+            pendingProofs = !proofQueue.empty();
 
-                bool batchResult = BatchVerifyInternal(tempProofData);
-                ProcessVerificationOutputs(tempProofData);
+            LogPrint("cert", "%s():%d - Async verification triggered, %d proofs to be verified, %d still queued \n",
+                     __func__, __LINE__, tempProofData.size(), proofQueue.size());
+        }
 
-                if (tempProofData.size() > 0)
-                {
-                    LogPrint("cert", "%s():%d - Batch verification failed, removed proofs that caused the failure and trying again... \n", __func__, __LINE__);
+        // Let another worker take care of the remaining proofs while this batch is in flight.
+        if (pendingProofs)
+        {
+            cvAsyncQueue.notify_one();
+        }
 
-                    batchResult = BatchVerifyInternal(tempProofData);
-                    ProcessVerificationOutputs(tempProofData);
+        // Proofs sent by peers that already relayed invalid proofs are verified in a separate batch,
+        // so that they cannot make the verification of the other proofs fail.
+        std::map</*scTxHash*/uint256, CProofVerifierItem> suspiciousProofData;
 
-                    if (tempProofData.size() > 0)
-                    {
-                        LogPrint("cert", "%s():%d - Batch verification failed again, verifying proofs one by one... \n", __func__, __LINE__);
+        {
+            boost::unique_lock<boost::mutex> lock(cs_asyncQueue);
 
-                        // As last attempt, verify the proofs one by one.
-                        NormalVerify(tempProofData);
-                        ProcessVerificationOutputs(tempProofData);
-                    }
+            const int64_t nowSeconds = GetTime();
+            for (auto it = tempProofData.begin(); it != tempProofData.end();)
+            {
+                if (it->second.node != nullptr && IsPeerPenalized(it->second.node->GetId(), nowSeconds))
+                {
+                    suspiciousProofData.insert(*it);
+                    it = tempProofData.erase(it);
+                }
+                else
+                {
+                    it++;
                 }
-
-                assert(tempProofData.size() == 0);
             }
         }
 
-        MilliSleep(THREAD_WAKE_UP_PERIOD);
+        if (suspiciousProofData.size() > 0)
+        {
+            LogPrint("cert", "%s():%d - %d proofs from penalized peers verified separately \n",
+                     __func__, __LINE__, suspiciousProofData.size());
+        }
+
+        BisectVerify(tempProofData);
+        ProcessVerificationOutputs(tempProofData);
+
+        BisectVerify(suspiciousProofData);
+        ProcessVerificationOutputs(suspiciousProofData);
+
+        assert(suspiciousProofData.size() == 0);
+        assert(tempProofData.size() == 0);
     }
 }
 
+/**
+ * @brief Wakes up the worker threads, for them to notice that shutdown has been requested
+ * without waiting for THREAD_WAKE_UP_PERIOD to elapse.
+ */
+void CScAsyncProofVerifier::Interrupt()
+{
+    boost::unique_lock<boost::mutex> lock(cs_asyncQueue);
+    cvAsyncQueue.notify_all();
+}
+
 /**
  * @brief Process the outputs of the batch verification.
  * This function is meant to process all the outputs having a state PASSED or FAILED;
@@ -169,6 +312,17 @@ void CScAsyncProofVerifier::ProcessVerificationOutputs(std::map</* Tx hash */ ui
             }
             // CODE USED FOR UNIT TEST ONLY [End]
 
+            // Let the block connection skip the verification of proofs already checked here
+            if (item.result == ProofVerificationResult::Passed)
+            {
+                AddProofToCache(item);
+            }
+
+            if (item.result == ProofVerificationResult::Failed && item.node != nullptr)
+            {
+                UpdatePeerPenalty(item.node->GetId());
+            }
+
             CValidationState dummyState;
             mempoolCallback(*item.parentPtr.get(), item.node,
                                             item.result == ProofVerificationResult::Passed ? BatchVerificationStateFlag::VERIFIED : BatchVerificationStateFlag::FAILED,
@@ -179,6 +333,84 @@ void CScAsyncProofVerifier::ProcessVerificationOutputs(std::map</* Tx hash */ ui
     }
 }
 
+/**
+ * @brief Gets the certificates and transactions waiting in the queue for the verification of their proofs,
+ * so that they can be persisted along with the mempool they have not entered yet.
+ * The ones whose batch is being verified are not included.
+ * 
+ * @param vTxs The CSW transactions in the queue
+ * @param vCerts The certificates in the queue
+ */
+void CScAsyncProofVerifier::GetQueuedTxBases(std::vector<CTransaction>& vTxs, std::vector<CScCertificate>& vCerts)
+{
+    boost::unique_lock<boost::mutex> lock(cs_asyncQueue);
+
+    for (const auto& entry : proofQueue)
+    {
+        const CTransactionBase& txBase = *entry.second.parentPtr;
+        if (txBase.IsCertificate())
+        {
+            vCerts.push_back(dynamic_cast<const CScCertificate&>(txBase));
+        }
+        else
+        {
+            vTxs.push_back(dynamic_cast<const CTransaction&>(txBase));
+        }
+    }
+}
+
+/**
+ * @brief Records that a peer has sent a transaction or certificate with an invalid proof.
+ * Proofs sent by penalized peers are then verified apart from the other ones, until the peer
+ * sends no invalid proof for PEER_PENALTY_EXPIRY seconds.
+ * 
+ * @param nodeId The ID of the peer that sent the invalid proof
+ */
+void CScAsyncProofVerifier::UpdatePeerPenalty(NodeId nodeId)
+{
+    boost::unique_lock<boost::mutex> lock(cs_asyncQueue);
+
+    const int64_t now = GetTime();
+
+    // Forget about the expired penalties.
+    for (auto it = mapPeerFailedProofs.begin(); it != mapPeerFailedProofs.end();)
+    {
+        if (!IsPeerPenalized(it->first, now))
+            it = mapPeerFailedProofs.erase(it);
+        else
+            it++;
+    }
+
+    CPeerPenalty& penalty = mapPeerFailedProofs[nodeId];
+    penalty.failedProofs++;
+    penalty.lastFailureTime = now;
+
+    LogPrint("cert", "%s():%d - peer [%d] has sent %d invalid proofs \n", __func__, __LINE__, nodeId, penalty.failedProofs);
+
+    // Then about the peers whose last invalid proof is the least recent.
+    while (mapPeerFailedProofs.size() > MAX_PENALIZED_PEERS)
+    {
+        auto leastRecent = std::min_element(mapPeerFailedProofs.begin(), mapPeerFailedProofs.end(),
+            [](const std::pair<const NodeId, CPeerPenalty>& lhs, const std::pair<const NodeId, CPeerPenalty>& rhs)
+            { return lhs.second.lastFailureTime < rhs.second.lastFailureTime; });
+        mapPeerFailedProofs.erase(leastRecent);
+    }
+}
+
+/**
+ * @brief Checks whether a peer has sent an invalid proof in the last PEER_PENALTY_EXPIRY seconds.
+ * To be called holding cs_asyncQueue.
+ * 
+ * @param nodeId The ID of the peer
+ * @param now The current time (in seconds)
+ * @return true If the proofs of the peer are to be verified apart from the other ones.
+ */
+bool CScAsyncProofVerifier::IsPeerPenalized(NodeId nodeId, int64_t now) const
+{
+    auto it = mapPeerFailedProofs.find(nodeId);
+    return it != mapPeerFailedProofs.end() && now - it->second.lastFailureTime < PEER_PENALTY_EXPIRY;
+}
+
 /**
  * @brief Updates the statistics of the proof verifier.
  * It is available in regression test mode only.
@@ -189,6 +421,9 @@ void CScAsyncProofVerifier::UpdateStatistics(const CProofVerifierItem& item)
 {
     assert(Params().NetworkIDString() == "regtest");
 
+    // Statistics can be updated concurrently by several verification threads
+    boost::unique_lock<boost::mutex> lock(cs_asyncQueue);
+
     if (item.parentPtr->IsCertificate())
     {
         if (item.result == ProofVerificationResult::Passed)
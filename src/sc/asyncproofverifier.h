@@ -2,6 +2,8 @@
 #define _SC_ASYNC_PROOF_VERIFIER_H
 
 #include <map>
+#include <set>
+#include <tuple>
 
 #include <boost/variant.hpp>
 
@@ -30,9 +32,41 @@ struct AsyncProofVerifierStatistics
     uint32_t failedCswCounter = 0;  /**< The number of CSW input proofs whose verification failed. */
 };
 
+/**
+ * @brief The scheduling data of an item waiting in the async proof verifier queue.
+ * 
+ * Items are ordered so that certificates come first (the ones whose submission window
+ * closes earlier before the others) and CSW transactions after them, in arrival order.
+ */
+struct CAsyncProofQueueEntry
+{
+    int deadlineHeight;     /**< The last height at which the parent can be mined (INT_MAX for CSW transactions). */
+    uint64_t sequence;      /**< The arrival order of the item. */
+    int64_t enqueueTime;    /**< The time (in milliseconds) the item has been queued at. */
+    bool urgent;            /**< Whether the item has to be verified without waiting for a batch to fill up. */
+    uint256 txHash;         /**< The hash of the transaction/certificate in the proof queue. */
+
+    bool operator<(const CAsyncProofQueueEntry& rhs) const
+    {
+        return std::tie(deadlineHeight, sequence) < std::tie(rhs.deadlineHeight, rhs.sequence);
+    }
+};
+
+/**
+ * @brief The invalid proofs received from a peer.
+ * The penalty expires when the peer sends no invalid proof for PEER_PENALTY_EXPIRY seconds.
+ */
+struct CPeerPenalty
+{
+    uint32_t failedProofs = 0;      /**< The number of invalid proofs received from the peer. */
+    int64_t lastFailureTime = 0;    /**< The time (in seconds) the last invalid proof has been received at. */
+};
+
 /**
  * @brief An asynchronous version of the sidechain Proof Verifier.
  * 
+ * Proofs are verified by a pool of worker threads (each one running RunPeriodicVerification()),
+ * woken up as soon as new proofs are enqueued; several batches may be in flight at the same time.
  */
 class CScAsyncProofVerifier : public CScProofVerifier
 {
@@ -51,20 +85,36 @@ public:
     void LoadDataForCertVerification(const CCoinsViewCache& view, const CScCertificate& scCert, CNode* pfrom = nullptr) override;
     void LoadDataForCswVerification(const CCoinsViewCache& view, const CTransaction& scTx, CNode* pfrom = nullptr) override;
     void RunPeriodicVerification();
+    void Interrupt();
+    void GetQueuedTxBases(std::vector<CTransaction>& vTxs, std::vector<CScCertificate>& vCerts);
 
     static const uint32_t BATCH_VERIFICATION_MAX_DELAY;   /**< The maximum delay in milliseconds between batch verification requests */
     static const uint32_t BATCH_VERIFICATION_MAX_SIZE;      /**< The threshold size of the proof queue that triggers a call to the batch verification. */
+    static const uint32_t BATCH_VERIFICATION_MAX_ITEMS;     /**< The maximum number of queued items taken by a single batch. */
+    static const int DEFAULT_VERIFICATION_THREADS = 2;      /**< The default number of batch verification threads. */
+    static const int64_t PEER_PENALTY_EXPIRY = 60 * 60;     /**< The seconds after the last invalid proof of a peer for its penalty to expire. */
 
     static uint32_t GetCustomMaxBatchVerifyDelay();
     static uint32_t GetCustomMaxBatchVerifyMaxSize();
+    static int GetCustomVerificationThreads();
 
 private:
 
     friend class TEST_FRIEND_CScAsyncProofVerifier;         /**< A friend class used as a proxy for private members in unit tests (Regtest mode only). */
 
-    static const uint32_t THREAD_WAKE_UP_PERIOD = 100;           /**< The period of time in milliseconds after which the thread wakes up. */
+    static const uint32_t THREAD_WAKE_UP_PERIOD = 1000;          /**< The maximum period of time in milliseconds a worker thread sleeps without checking for shutdown. */
+    static const int CERT_URGENT_BLOCKS_LEFT = 1;                /**< Certificates with fewer blocks left in their submission window (after the next one) skip batching delays. */
+
+    CWaitableCriticalSection cs_asyncQueue; /**< The lock to be used for entering the critical section in async mode only. */
+    CConditionVariable cvAsyncQueue;        /**< The condition variable used to wake up worker threads when proofs are enqueued. */
 
-    CCriticalSection cs_asyncQueue;         /**< The lock to be used for entering the critical section in async mode only. */
+    std::set<CAsyncProofQueueEntry> priorityIndex;                  /**< The queued items, sorted by verification priority. */
+    std::map</* Tx hash */ uint256, CAsyncProofQueueEntry> mapQueueEntries; /**< The scheduling data of queued items, by hash. */
+    std::set<std::pair<int64_t, uint256>> arrivalIndex;             /**< The queued items, sorted by enqueue time. */
+    uint64_t sequenceCounter = 0;                                   /**< The counter used to assign the arrival order of items. */
+
+    static const size_t MAX_PENALIZED_PEERS = 1000;                 /**< The maximum number of peers tracked in mapPeerFailedProofs. */
+    std::map<NodeId, CPeerPenalty> mapPeerFailedProofs;             /**< The invalid proofs received from each peer. */
 
     // Members used for REGTEST mode only. [Start]
     AsyncProofVerifierStatistics stats;     /**< Async proof verifier statistics. */
@@ -76,12 +126,19 @@ private:
     std::function<void(const CTransactionBase&, CNode*, BatchVerificationStateFlag, CValidationState&)> mempoolCallback;
 
     CScAsyncProofVerifier() :
-        CScProofVerifier(Verification::Strict, Priority::Low), // CScAsyncProofVerifier always executes verification with low priority
+        // CScAsyncProofVerifier always executes verification with low priority and must process every
+        // proof it is given, since the mempool is waiting for its outcome
+        CScProofVerifier(Verification::Strict, Priority::Low, false),
         mempoolCallback(ProcessTxBaseAcceptToMemoryPool)
     {
     }
 
+    void Enqueue(const uint256& txHash, int deadlineHeight, bool urgent);
+    bool IsBatchReady(int64_t now, uint32_t maxDelay, uint32_t maxSize) const;
+    std::map</* Tx hash */ uint256, CProofVerifierItem> TakeBatch();
     void ProcessVerificationOutputs(std::map</* Tx hash */ uint256, CProofVerifierItem>& proofs);
+    void UpdatePeerPenalty(NodeId nodeId);
+    bool IsPeerPenalized(NodeId nodeId, int64_t now) const;
     void UpdateStatistics(const CProofVerifierItem& item);
 };
 
@@ -119,6 +176,7 @@ public:
      */
     AsyncProofVerifierStatistics GetStatistics()
     {
+        boost::unique_lock<boost::mutex> lock(CScAsyncProofVerifier::GetInstance().cs_asyncQueue);
         return CScAsyncProofVerifier::GetInstance().stats;
     }
 
@@ -130,7 +188,7 @@ public:
      */
     size_t PendingAsyncCertProofs()
     {
-        LOCK(CScAsyncProofVerifier::GetInstance().cs_asyncQueue);
+        boost::unique_lock<boost::mutex> lock(CScAsyncProofVerifier::GetInstance().cs_asyncQueue);
 
         int counter = 0;
 
@@ -153,7 +211,7 @@ public:
      */
     size_t PendingAsyncCswProofs()
     {
-        LOCK(CScAsyncProofVerifier::GetInstance().cs_asyncQueue);
+        boost::unique_lock<boost::mutex> lock(CScAsyncProofVerifier::GetInstance().cs_asyncQueue);
 
         int counter = 0;
 
@@ -168,6 +226,43 @@ public:
         return counter;
     }
 
+    /**
+     * @brief Gets the number of invalid proofs received from a peer.
+     * 
+     * @param nodeId The ID of the peer
+     * @return uint32_t The number of invalid proofs sent by the peer.
+     */
+    uint32_t GetPeerFailedProofs(NodeId nodeId)
+    {
+        CScAsyncProofVerifier& verifier = CScAsyncProofVerifier::GetInstance();
+        boost::unique_lock<boost::mutex> lock(verifier.cs_asyncQueue);
+
+        auto it = verifier.mapPeerFailedProofs.find(nodeId);
+        return it != verifier.mapPeerFailedProofs.end() ? it->second.failedProofs : 0;
+    }
+
+    /**
+     * @brief Records an invalid proof received from a peer.
+     *
+     * @param nodeId The ID of the peer
+     */
+    void UpdatePeerPenalty(NodeId nodeId)
+    {
+        CScAsyncProofVerifier::GetInstance().UpdatePeerPenalty(nodeId);
+    }
+
+    /**
+     * @brief Checks whether the proofs of a peer are verified apart from the other ones.
+     *
+     * @param nodeId The ID of the peer
+     */
+    bool IsPeerPenalized(NodeId nodeId)
+    {
+        CScAsyncProofVerifier& verifier = CScAsyncProofVerifier::GetInstance();
+        boost::unique_lock<boost::mutex> lock(verifier.cs_asyncQueue);
+        return verifier.IsPeerPenalized(nodeId, GetTime());
+    }
+
     /**
      * @brief Get the max delay between async batch verifications.
      * 
@@ -185,7 +280,9 @@ public:
     {
         CScAsyncProofVerifier& verifier = CScAsyncProofVerifier::GetInstance();
 
+        boost::unique_lock<boost::mutex> lock(verifier.cs_asyncQueue);
         verifier.stats = AsyncProofVerifierStatistics();
+        verifier.mapPeerFailedProofs.clear();
     }
 
     /**
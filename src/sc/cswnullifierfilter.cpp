@@ -0,0 +1,92 @@
+#include "sc/cswnullifierfilter.h"
+
+#include "hash.h"
+#include "memusage.h"
+
+#include <cmath>
+
+#define LN2SQUARED 0.4804530139182014246671025263266649717305529515945455
+#define LN2 0.6931471805599453094172321214581765680755001343602552
+
+CCswNullifierFilter::CBitFilter::CBitFilter(size_t capacityIn): capacity(capacityIn), nInserted(0)
+{
+    // optimal number of bits and hash functions for the given capacity and false positive rate
+    const size_t nBits = std::max<size_t>(64, (size_t)(-1.0 / LN2SQUARED * capacity * log(FILTER_FP_RATE)));
+    vBits.assign((nBits + 63) / 64, 0);
+    nHashFuncs = std::max(1, (int)(vBits.size() * 64 / capacity * LN2));
+}
+
+CCswNullifierFilter::CCswNullifierFilter(unsigned int nTweakIn): nTweak(nTweakIn), nInserted(0), mapFilters() {}
+
+void CCswNullifierFilter::GetHashes(const CCompactFieldElement& nullifier, uint64_t& h1, uint64_t& h2) const
+{
+    const std::vector<unsigned char> vData(nullifier.GetDataBuffer(), nullifier.GetDataBuffer() + CFieldElement::ByteSize());
+    h1 = MurmurHash3(nTweak, vData);
+    // odd, so that the probes of a filter never collapse on the same bit
+    h2 = MurmurHash3(nTweak ^ 0x9e3779b9, vData) | 1;
+}
+
+void CCswNullifierFilter::Insert(const uint256& scId, const CCompactFieldElement& nullifier)
+{
+    std::vector<CBitFilter>& filters = mapFilters[scId];
+    if (filters.empty() || filters.back().nInserted >= filters.back().capacity)
+    {
+        const size_t capacity = filters.empty() ? INITIAL_CAPACITY : filters.back().capacity * FILTER_GROWTH_FACTOR;
+        filters.push_back(CBitFilter(capacity));
+    }
+
+    uint64_t h1 = 0, h2 = 0;
+    GetHashes(nullifier, h1, h2);
+
+    CBitFilter& filter = filters.back();
+    const uint64_t nBits = filter.vBits.size() * 64;
+    for (unsigned int i = 0; i < filter.nHashFuncs; i++)
+    {
+        const uint64_t nIndex = (h1 + i * h2) % nBits;
+        filter.vBits[nIndex >> 6] |= (uint64_t(1) << (nIndex & 63));
+    }
+    filter.nInserted++;
+    nInserted++;
+}
+
+bool CCswNullifierFilter::MaybeContains(const uint256& scId, const CCompactFieldElement& nullifier) const
+{
+    auto it = mapFilters.find(scId);
+    if (it == mapFilters.end())
+        return false;
+
+    uint64_t h1 = 0, h2 = 0;
+    GetHashes(nullifier, h1, h2);
+
+    for (const CBitFilter& filter : it->second)
+    {
+        const uint64_t nBits = filter.vBits.size() * 64;
+        bool fFound = true;
+        for (unsigned int i = 0; i < filter.nHashFuncs && fFound; i++)
+        {
+            const uint64_t nIndex = (h1 + i * h2) % nBits;
+            fFound = (filter.vBits[nIndex >> 6] >> (nIndex & 63)) & 1;
+        }
+        if (fFound)
+            return true;
+    }
+    return false;
+}
+
+void CCswNullifierFilter::Clear()
+{
+    mapFilters.clear();
+    nInserted = 0;
+}
+
+size_t CCswNullifierFilter::DynamicMemoryUsage() const
+{
+    size_t usage = memusage::DynamicUsage(mapFilters);
+    for (const auto& entry : mapFilters)
+    {
+        usage += memusage::DynamicUsage(entry.second);
+        for (const CBitFilter& filter : entry.second)
+            usage += memusage::DynamicUsage(filter.vBits);
+    }
+    return usage;
+}
@@ -0,0 +1,59 @@
+#ifndef SC_CSW_NULLIFIER_FILTER_H
+#define SC_CSW_NULLIFIER_FILTER_H
+
+#include "sc/sidechaintypes.h"
+#include "uint256.h"
+
+#include <map>
+#include <vector>
+
+/**
+ * @brief In-memory probabilistic set of the CSW nullifiers spent on each sidechain.
+ * It never gives false negatives, so a nullifier it does not contain is certainly not spent
+ * and the lookup in the coins db can be skipped. Each sidechain has a chain of bloom filters,
+ * a new and bigger one being added whenever the last is full, so that the memory used follows
+ * the number of nullifiers actually withdrawn from it.
+ * Nullifiers cannot be removed: the ones erased by a block disconnection stay in the filter
+ * and only cost a db lookup, until the filter is rebuilt at the next startup.
+ */
+class CCswNullifierFilter
+{
+public:
+    //! Capacity of the first filter of each sidechain, the following ones being FILTER_GROWTH_FACTOR times bigger
+    static const size_t INITIAL_CAPACITY = 1024;
+    static const size_t FILTER_GROWTH_FACTOR = 4;
+    //! False positive rate of each filter, the one of a sidechain being at most this times the number of its filters
+    static constexpr double FILTER_FP_RATE = 0.001;
+
+    explicit CCswNullifierFilter(unsigned int nTweakIn);
+
+    void Insert(const uint256& scId, const CCompactFieldElement& nullifier);
+
+    //! False if the nullifier has surely not been inserted, true if it has probably been
+    bool MaybeContains(const uint256& scId, const CCompactFieldElement& nullifier) const;
+
+    void Clear();
+
+    //! Number of nullifiers inserted, for all sidechains
+    size_t Size() const { return nInserted; }
+    size_t DynamicMemoryUsage() const;
+
+private:
+    struct CBitFilter
+    {
+        CBitFilter(size_t capacityIn);
+
+        std::vector<uint64_t> vBits;
+        unsigned int nHashFuncs;
+        size_t capacity;
+        size_t nInserted;
+    };
+
+    unsigned int nTweak;
+    size_t nInserted;
+    std::map<uint256, std::vector<CBitFilter> > mapFilters;
+
+    void GetHashes(const CCompactFieldElement& nullifier, uint64_t& h1, uint64_t& h2) const;
+};
+
+#endif // SC_CSW_NULLIFIER_FILTER_H
@@ -1,11 +1,39 @@
 #include "sc/proofverifier.h"
 
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+#include <boost/thread.hpp>
+
+#include "checkqueue.h"
 #include "coins.h"
+#include "hash.h"
 #include "main.h"
 #include "primitives/certificate.h"
+#include "random.h"
+#include "util.h"
 
 std::atomic<uint32_t> CScProofVerifier::proofIdCounter(0);
 
+static CCheckQueue<CProofShardCheck> proofshardqueue(1);
+static boost::mutex cs_proofshardqueue;    // Only one batch at a time can be split on the proof shard queue
+
+void ThreadProofShardCheck()
+{
+    RenameThread("horizen-scproof");
+    proofshardqueue.Thread();
+}
+
+bool CProofShardCheck::operator()()
+{
+    int64_t nTimeStart = GetTimeMicros();
+    *result = verifier->BatchVerifyInternal(*shard);
+    LogPrint("bench", "%s():%d - shard %d (%d proofs) verified: %.2fms\n",
+        __func__, __LINE__, index, shard->size(), (GetTimeMicros() - nTimeStart) * 0.001);
+    return true;
+}
+
 /**
  * @brief Converts a ProofVerificationResult enum to string.
  *
@@ -123,7 +151,188 @@ CCswProofVerifierInput CScProofVerifier::CswInputToVerifierItem(const CTxCeasedS
 #ifdef BITCOIN_TX
 void CScProofVerifier::LoadDataForCertVerification(const CCoinsViewCache& view, const CScCertificate& scCert, CNode* pfrom) {return;}
 void CScProofVerifier::LoadDataForCswVerification(const CCoinsViewCache& view, const CTransaction& scTx, CNode* pfrom) {return;}
+void CScProofVerifier::CachePassedProofs() const {return;}
 #else
+namespace {
+
+/**
+ * Verified proof cache, to avoid doing expensive SNARK verification
+ * twice for every certificate and CSW input (once when accepted into
+ * memory pool, and again when accepted into the block chain).
+ *
+ * Entries are salted hashes of the proof, the verification key and all the
+ * public inputs, so that they cannot be pre-computed by an attacker.
+ */
+class CVerifiedProofCache
+{
+private:
+    std::set<uint256> setValid;
+    boost::shared_mutex cs_proofcache;
+    const uint256 nonce;
+    int64_t nMaxCacheSize;
+
+public:
+    CVerifiedProofCache(): nonce(GetRandHash()), nMaxCacheSize(CScProofVerifier::DEFAULT_MAX_PROOF_CACHE_SIZE) {}
+
+    uint256 ComputeEntry(const CCertProofVerifierInput& input) const
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << nonce << input.proof << input.verificationKey << input.scId << input.constant;
+        ss << input.epochNumber << input.quality;
+        for (const backward_transfer_t& bt : input.bt_list)
+        {
+            ss.write((const char*)bt.pk_dest, sizeof(bt.pk_dest));
+            ss << bt.amount;
+        }
+        ss << input.vCustomFields << input.endEpochCumScTxCommTreeRoot;
+        ss << input.mainchainBackwardTransferRequestScFee << input.forwardTransferScFee;
+        return ss.GetHash();
+    }
+
+    uint256 ComputeEntry(const CCswProofVerifierInput& input) const
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << nonce << input.proof << input.verificationKey << input.scId << input.constant;
+        ss << input.ceasingCumScTxCommTree << input.certDataHash << input.nValue;
+        ss << input.nullifier << input.pubKeyHash;
+        return ss.GetHash();
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_proofcache);
+        return setValid.count(entry) != 0;
+    }
+
+    void Set(const uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_proofcache);
+        // DoS prevention: limit cache size (~100 bytes per entry, 2MB with the default size)
+        if (nMaxCacheSize <= 0) return;
+
+        EvictTo(nMaxCacheSize - 1);
+        setValid.insert(entry);
+    }
+
+    void SetMaxSize(int64_t nMaxSize)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_proofcache);
+        nMaxCacheSize = nMaxSize;
+        EvictTo(std::max<int64_t>(nMaxCacheSize, 0));
+    }
+
+    size_t Size()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_proofcache);
+        return setValid.size();
+    }
+
+private:
+    //! To be called holding cs_proofcache exclusively
+    void EvictTo(int64_t nSize)
+    {
+        while (static_cast<int64_t>(setValid.size()) > nSize)
+        {
+            // Evict a random entry, same rationale as the signature cache
+            std::set<uint256>::iterator it = setValid.lower_bound(GetRandHash());
+            if (it == setValid.end())
+                it = setValid.begin();
+            setValid.erase(it);
+        }
+    }
+};
+
+CVerifiedProofCache& GetVerifiedProofCache()
+{
+    static CVerifiedProofCache proofCache;
+    return proofCache;
+}
+
+}
+
+/**
+ * @brief Sets the maximum number of entries of the verified proof cache, evicting the exceeding ones.
+ * Called once at startup with -maxscproofcachesize, 0 disabling the cache.
+ *
+ * @param nMaxSize The maximum number of entries
+ */
+void CScProofVerifier::SetMaxProofCacheSize(int64_t nMaxSize)
+{
+    GetVerifiedProofCache().SetMaxSize(nMaxSize);
+}
+
+/**
+ * @brief Gets the number of entries of the verified proof cache.
+ */
+size_t CScProofVerifier::GetProofCacheSize()
+{
+    return GetVerifiedProofCache().Size();
+}
+
+/**
+ * @brief Checks whether all the proofs of an item have already been verified successfully.
+ *
+ * @param item The item to be looked up in the verified proof cache
+ *
+ * @return true If the certificate proof or all the CSW input proofs are in the cache.
+ * @return false Otherwise.
+ */
+bool CScProofVerifier::IsProofCached(const CProofVerifierItem& item)
+{
+    CVerifiedProofCache& proofCache = GetVerifiedProofCache();
+
+    if (item.proofInput.type() == typeid(CCertProofVerifierInput))
+    {
+        return proofCache.Get(proofCache.ComputeEntry(boost::get<CCertProofVerifierInput>(item.proofInput)));
+    }
+
+    for (const CCswProofVerifierInput& cswInput : boost::get<std::vector<CCswProofVerifierInput>>(item.proofInput))
+    {
+        if (!proofCache.Get(proofCache.ComputeEntry(cswInput)))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Stores the proofs of an item that passed the verification into the verified proof cache.
+ *
+ * @param item The item whose proofs have been successfully verified
+ */
+void CScProofVerifier::AddProofToCache(const CProofVerifierItem& item)
+{
+    assert(item.result == ProofVerificationResult::Passed);
+
+    CVerifiedProofCache& proofCache = GetVerifiedProofCache();
+
+    if (item.proofInput.type() == typeid(CCertProofVerifierInput))
+    {
+        proofCache.Set(proofCache.ComputeEntry(boost::get<CCertProofVerifierInput>(item.proofInput)));
+        return;
+    }
+
+    for (const CCswProofVerifierInput& cswInput : boost::get<std::vector<CCswProofVerifierInput>>(item.proofInput))
+    {
+        proofCache.Set(proofCache.ComputeEntry(cswInput));
+    }
+}
+
+/**
+ * @brief Stores the proofs that passed the last verification into the verified proof cache,
+ * so that verifying the same certificates and transactions again skips them.
+ */
+void CScProofVerifier::CachePassedProofs() const
+{
+    for (const auto& proof : proofQueue)
+    {
+        if (proof.second.result == ProofVerificationResult::Passed)
+        {
+            AddProofToCache(proof.second);
+        }
+    }
+}
+
 /**
  * @brief Loads proof data of a certificate into the proof verifier.
  * 
@@ -150,6 +359,14 @@ void CScProofVerifier::LoadDataForCertVerification(const CCoinsViewCache& view,
     item.node = pfrom;
     item.result = ProofVerificationResult::Unknown;
     item.proofInput = CertificateToVerifierItem(scCert, sidechain.fixedParams, pfrom);
+
+    if (fSkipCachedProofs && IsProofCached(item))
+    {
+        LogPrint("sc", "%s():%d - cert [%s] proof already verified, skipping\n",
+            __func__, __LINE__, scCert.GetHash().ToString());
+        return;
+    }
+
     proofQueue.insert(std::make_pair(scCert.GetHash(), item));
 }
 
@@ -185,6 +402,14 @@ void CScProofVerifier::LoadDataForCswVerification(const CCoinsViewCache& view, c
         item.result = ProofVerificationResult::Unknown;
         item.node = pfrom;
         item.proofInput = cswInputProofs;
+
+        if (fSkipCachedProofs && IsProofCached(item))
+        {
+            LogPrint("sc", "%s():%d - tx [%s] csw proofs already verified, skipping\n",
+                __func__, __LINE__, scTx.GetHash().ToString());
+            return;
+        }
+
         auto pair_ret = proofQueue.insert(std::make_pair(scTx.GetHash(), item));
 
         if (!pair_ret.second)
@@ -209,7 +434,146 @@ void CScProofVerifier::LoadDataForCswVerification(const CCoinsViewCache& view, c
  */
 bool CScProofVerifier::BatchVerify()
 {
-    return BatchVerifyInternal(proofQueue);
+    int threads = GetBatchVerificationThreads();
+
+    if (verificationMode == Verification::Loose || threads <= 1 || proofQueue.size() < 2)
+    {
+        return BatchVerifyInternal(proofQueue);
+    }
+
+    return ShardedBatchVerify(proofQueue, threads);
+}
+
+/**
+ * @brief Gets the number of threads to be used for verifying the shards of a batch.
+ * 
+ * @return int The number of threads, at least 1.
+ */
+int CScProofVerifier::GetBatchVerificationThreads()
+{
+    int threads = GetArg("-scbatchverificationthreads", DEFAULT_BATCH_VERIFICATION_THREADS);
+
+    if (threads <= 0)
+    {
+        threads = GetNumCores();
+    }
+
+    return std::max(threads, 1);
+}
+
+/**
+ * @brief Gets the hash of the verification key used by an item.
+ * CSW transactions are keyed by the verification key of their first input.
+ * 
+ * @param item The item whose proof(s) have to be verified
+ * 
+ * @return uint256 The hash of the serialized verification key.
+ */
+uint256 CScProofVerifier::GetVerificationKeyHash(const CProofVerifierItem& item)
+{
+    const CScVKey* vk = nullptr;
+
+    if (item.proofInput.type() == typeid(CCertProofVerifierInput))
+    {
+        vk = &boost::get<CCertProofVerifierInput>(item.proofInput).verificationKey;
+    }
+    else
+    {
+        const std::vector<CCswProofVerifierInput>& cswInputs = boost::get<std::vector<CCswProofVerifierInput>>(item.proofInput);
+        assert(!cswInputs.empty());
+        vk = &cswInputs.front().verificationKey;
+    }
+
+    const std::vector<unsigned char>& vkBytes = vk->GetByteArray();
+    return Hash(vkBytes.begin(), vkBytes.end());
+}
+
+/**
+ * @brief Runs the batch verification over a set of proofs split in shards verified concurrently.
+ * Proofs are grouped by verification key, and each group is assigned to the least loaded shard
+ * (largest groups first), so that proofs sharing the same key are always verified together.
+ * 
+ * @param proofs The map containing all the proofs of any kind to be verified
+ * @param maxShards The maximum number of shards to be used
+ * 
+ * @return true If the verification succeeded for all the proofs.
+ * @return false If the verification failed for at least one proof.
+ */
+bool CScProofVerifier::ShardedBatchVerify(std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>& proofs, size_t maxShards)
+{
+    std::map</* Vk hash */ uint256, std::vector</* Cert or Tx hash */ uint256>> partitions;
+
+    for (const auto& proof : proofs)
+    {
+        partitions[GetVerificationKeyHash(proof.second)].push_back(proof.first);
+    }
+
+    if (partitions.size() < 2)
+    {
+        return BatchVerifyInternal(proofs);
+    }
+
+    boost::unique_lock<boost::mutex> lock(cs_proofshardqueue, boost::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        // The shard threads are already busy with another batch
+        return BatchVerifyInternal(proofs);
+    }
+
+    std::vector<std::vector<uint256>*> sortedPartitions;
+    for (auto& partition : partitions)
+    {
+        sortedPartitions.push_back(&partition.second);
+    }
+
+    std::stable_sort(sortedPartitions.begin(), sortedPartitions.end(),
+        [](const std::vector<uint256>* lhs, const std::vector<uint256>* rhs) { return lhs->size() > rhs->size(); });
+
+    std::vector<std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>> shards(std::min(maxShards, partitions.size()));
+
+    for (const std::vector<uint256>* partition : sortedPartitions)
+    {
+        auto& shard = *std::min_element(shards.begin(), shards.end(),
+            [](const std::map<uint256, CProofVerifierItem>& lhs, const std::map<uint256, CProofVerifierItem>& rhs) { return lhs.size() < rhs.size(); });
+
+        for (const uint256& hash : *partition)
+        {
+            shard.insert(*proofs.find(hash));
+        }
+    }
+
+    LogPrint("bench", "%s():%d - verifying %d proofs with %d keys in %d shards\n",
+        __func__, __LINE__, proofs.size(), partitions.size(), shards.size());
+
+    std::vector<char> shardResults(shards.size(), false);
+
+    {
+        // This thread verifies shards as well, while waiting for the queue to be emptied.
+        CCheckQueueControl<CProofShardCheck> control(&proofshardqueue);
+        std::vector<CProofShardCheck> vChecks;
+
+        for (size_t i = 0; i < shards.size(); i++)
+        {
+            vChecks.push_back(CProofShardCheck(this, &shards[i], i, &shardResults[i]));
+        }
+
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    bool result = true;
+
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        result = result && shardResults[i];
+
+        for (const auto& proof : shards[i])
+        {
+            proofs.at(proof.first).result = proof.second.result;
+        }
+    }
+
+    return result;
 }
 
 /**
@@ -257,13 +621,13 @@ bool CScProofVerifier::BatchVerifyInternal(std::map</* Cert or Tx hash */ uint25
             {
                 proofIdMap.insert(std::make_pair(cswInput.proofId, proofEntry.first));
 
-                wrappedFieldPtr sptrScId = CFieldElement(cswInput.scId).GetFieldElement();
+                wrappedFieldPtr sptrScId = CFieldElement(cswInput.scId).GetSharedFieldElement();
                 field_t* scid_fe = sptrScId.get();
     
                 const uint160& csw_pk_hash = cswInput.pubKeyHash;
                 BufferWithSize bws_csw_pk_hash(csw_pk_hash.begin(), csw_pk_hash.size());
     
-                wrappedFieldPtr   sptrConst     = cswInput.constant.GetFieldElement();
+                wrappedFieldPtr   sptrConst     = cswInput.constant.GetSharedFieldElement();
                 wrappedFieldPtr   sptrCdh       = cswInput.certDataHash.GetFieldElement();
                 wrappedFieldPtr   sptrCum       = cswInput.ceasingCumScTxCommTree.GetFieldElement();
                 wrappedFieldPtr   sptrNullifier = cswInput.nullifier.GetFieldElement();
@@ -323,10 +687,10 @@ bool CScProofVerifier::BatchVerifyInternal(std::map</* Cert or Tx hash */ uint25
             if (bt_list_len == 0)
                 bt_list_ptr = nullptr;
 
-            wrappedFieldPtr sptrScId = CFieldElement(certInput.scId).GetFieldElement();
+            wrappedFieldPtr sptrScId = CFieldElement(certInput.scId).GetSharedFieldElement();
             field_t* scidFe = sptrScId.get();
 
-            wrappedFieldPtr   sptrConst  = certInput.constant.GetFieldElement();
+            wrappedFieldPtr   sptrConst  = certInput.constant.GetSharedFieldElement();
             wrappedFieldPtr   sptrCum    = certInput.endEpochCumScTxCommTreeRoot.GetFieldElement();
             wrappedScProofPtr sptrProof  = certInput.proof.GetProofPtr();
             wrappedScVkeyPtr  sptrCertVk = certInput.verificationKey.GetVKeyPtr();
@@ -412,6 +776,88 @@ bool CScProofVerifier::BatchVerifyInternal(std::map</* Cert or Tx hash */ uint25
     return !addFailure && verRes.Result();
 }
 
+/**
+ * @brief Runs the batch verification over a set of proofs, isolating the failing ones by bisection.
+ * When a batch fails, the proofs reported as failed are discarded and the remaining ones are
+ * verified again; if the failure cannot be attributed to any proof, the batch is split in two
+ * halves that are verified recursively. When the lower half passes, the upper one is known to
+ * fail and is split with no batch verification of its own; only single items known to fail
+ * are verified one by one.
+ * This way the number of verifications grows with the number of invalid proofs (times the
+ * logarithm of the batch size) rather than with the size of the batch.
+ * 
+ * When this function returns, the result of every item is either Passed or Failed.
+ * 
+ * @param proofs The map containing all the proofs of any kind to be verified
+ * @param fFailed True if the batch of the proofs is already known to fail
+ */
+void CScProofVerifier::BisectVerify(std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>& proofs, bool fFailed)
+{
+    std::map</* Cert or Tx hash */ uint256, CProofVerifierItem> pendingProofs;
+
+    for (const auto& proof : proofs)
+    {
+        if (proof.second.result == ProofVerificationResult::Unknown)
+        {
+            pendingProofs.insert(proof);
+        }
+    }
+
+    if (pendingProofs.empty())
+    {
+        return;
+    }
+
+    if (fFailed && pendingProofs.size() == 1)
+    {
+        NormalVerify(pendingProofs);
+    }
+    else if (fFailed || !BatchVerifyInternal(pendingProofs))
+    {
+        size_t undecidedProofs = std::count_if(pendingProofs.begin(), pendingProofs.end(),
+            [](const std::pair<const uint256, CProofVerifierItem>& proof) { return proof.second.result == ProofVerificationResult::Unknown; });
+
+        if (undecidedProofs == pendingProofs.size() && pendingProofs.size() == 1)
+        {
+            // The failure of a single item is confirmed by its normal verification.
+            NormalVerify(pendingProofs);
+        }
+        else if (undecidedProofs == pendingProofs.size())
+        {
+            // The failure cannot be attributed to any proof, split the batch in two halves.
+            std::map</* Cert or Tx hash */ uint256, CProofVerifierItem> lowerHalf, upperHalf;
+            auto middle = std::next(pendingProofs.begin(), pendingProofs.size() / 2);
+            lowerHalf.insert(pendingProofs.begin(), middle);
+            upperHalf.insert(middle, pendingProofs.end());
+
+            LogPrint("cert", "%s():%d - Batch of %d proofs failed, splitting it \n", __func__, __LINE__, pendingProofs.size());
+
+            BisectVerify(lowerHalf);
+            bool fLowerHalfPassed = std::all_of(lowerHalf.begin(), lowerHalf.end(),
+                [](const std::pair<const uint256, CProofVerifierItem>& proof) { return proof.second.result == ProofVerificationResult::Passed; });
+            BisectVerify(upperHalf, fLowerHalfPassed);
+
+            for (const auto& proof : lowerHalf)
+                pendingProofs.at(proof.first).result = proof.second.result;
+            for (const auto& proof : upperHalf)
+                pendingProofs.at(proof.first).result = proof.second.result;
+        }
+        else if (undecidedProofs > 0)
+        {
+            // Some of the proofs have been identified as failed, try again without them.
+            LogPrint("cert", "%s():%d - Batch failed, trying again without the %d failed proofs \n",
+                __func__, __LINE__, pendingProofs.size() - undecidedProofs);
+
+            BisectVerify(pendingProofs);
+        }
+    }
+
+    for (const auto& proof : pendingProofs)
+    {
+        proofs.at(proof.first).result = proof.second.result;
+    }
+}
+
 /**
  * @brief Runs the verification for a set of proofs one by one (not batched).
  * The result of the verification for each item is stored inside the 
@@ -476,10 +922,10 @@ ProofVerificationResult CScProofVerifier::NormalVerifyCertificate(CCertProofVeri
     if (bt_list_len == 0)
         bt_list_ptr = nullptr;
 
-    wrappedFieldPtr sptrScId = CFieldElement(input.scId).GetFieldElement();
+    wrappedFieldPtr sptrScId = CFieldElement(input.scId).GetSharedFieldElement();
     field_t* scidFe = sptrScId.get();
 
-    wrappedFieldPtr   sptrConst  = input.constant.GetFieldElement();
+    wrappedFieldPtr   sptrConst  = input.constant.GetSharedFieldElement();
     wrappedFieldPtr   sptrCum    = input.endEpochCumScTxCommTreeRoot.GetFieldElement();
     wrappedScProofPtr sptrProof  = input.proof.GetProofPtr();
     wrappedScVkeyPtr  sptrCertVk = input.verificationKey.GetVKeyPtr();
@@ -522,13 +968,13 @@ ProofVerificationResult CScProofVerifier::NormalVerifyCsw(std::vector<CCswProofV
 {
     for (CCswProofVerifierInput input : cswInputs)
     {
-        wrappedFieldPtr sptrScId = CFieldElement(input.scId).GetFieldElement();
+        wrappedFieldPtr sptrScId = CFieldElement(input.scId).GetSharedFieldElement();
         field_t* scid_fe = sptrScId.get();
  
         const uint160& csw_pk_hash = input.pubKeyHash;
         BufferWithSize bws_csw_pk_hash(csw_pk_hash.begin(), csw_pk_hash.size());
      
-        wrappedFieldPtr   sptrConst     = input.constant.GetFieldElement();
+        wrappedFieldPtr   sptrConst     = input.constant.GetSharedFieldElement();
         wrappedFieldPtr   sptrCdh       = input.certDataHash.GetFieldElement();
         wrappedFieldPtr   sptrCum       = input.ceasingCumScTxCommTree.GetFieldElement();
         wrappedFieldPtr   sptrNullifier = input.nullifier.GetFieldElement();
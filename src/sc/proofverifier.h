@@ -101,11 +101,14 @@ public:
         High       /**< High priority. Verification will pause low priority verification threads if running. */
     };
 
+    static const int64_t DEFAULT_MAX_PROOF_CACHE_SIZE = 20000;   /**< The default maximum number of entries of the verified proof cache. */
+    static const int DEFAULT_BATCH_VERIFICATION_THREADS = 2;     /**< The default number of threads running batch verification shards (0 = one per core). */
+
     static CCertProofVerifierInput CertificateToVerifierItem(const CScCertificate& certificate, const Sidechain::ScFixedParameters& scFixedParams, CNode* pfrom);
     static CCswProofVerifierInput CswInputToVerifierItem(const CTxCeasedSidechainWithdrawalInput& cswInput, const CTransaction* cswTransaction, const Sidechain::ScFixedParameters& scFixedParams, CNode* pfrom);
 
-    CScProofVerifier(Verification mode, Priority priority) :
-    verificationMode(mode), verificationPriority(priority)
+    CScProofVerifier(Verification mode, Priority priority, bool skipCachedProofs = true) :
+    verificationMode(mode), verificationPriority(priority), fSkipCachedProofs(skipCachedProofs)
     {
     }
     virtual ~CScProofVerifier() = default;
@@ -118,14 +121,27 @@ public:
 
     virtual void LoadDataForCswVerification(const CCoinsViewCache& view, const CTransaction& scTx, CNode* pfrom = nullptr);
     bool BatchVerify();
+    void CachePassedProofs() const;
+
+    static int GetBatchVerificationThreads();
+    static void SetMaxProofCacheSize(int64_t nMaxSize);
 
 protected:
 
-    bool BatchVerifyInternal(std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>& proofs);
-    void NormalVerify(std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>& proofs);
+    friend class CProofShardCheck;
+
+    virtual bool BatchVerifyInternal(std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>& proofs);
+    bool ShardedBatchVerify(std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>& proofs, size_t maxShards);
+    static uint256 GetVerificationKeyHash(const CProofVerifierItem& item);
+    void BisectVerify(std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>& proofs, bool fFailed = false);
+    virtual void NormalVerify(std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>& proofs);
     ProofVerificationResult NormalVerifyCertificate(CCertProofVerifierInput input) const;
     ProofVerificationResult NormalVerifyCsw(std::vector<CCswProofVerifierInput> cswInputs) const;
 
+    static bool IsProofCached(const CProofVerifierItem& item);
+    static void AddProofToCache(const CProofVerifierItem& item);
+    static size_t GetProofCacheSize();
+
     std::map</* Cert or Tx hash */ uint256, CProofVerifierItem> proofQueue;   /**< The queue of proofs to be verified. */
 
 private:
@@ -137,6 +153,40 @@ private:
     const Priority verificationPriority;    /**< Proof verification priority.
                                               If True => during BatchVerify() will pause low priority verification threads if exist.
                                               If False => BatchVerify() will run with low priority and may be paused by high priority operations.*/
+
+    const bool fSkipCachedProofs;           /**< If true, proofs found in the verified proof cache are not added to the queue. */
+};
+
+/**
+ * @brief The verification of one shard of a proof batch, run by the threads of the proof shard check queue.
+ * It always succeeds, so that the queue does not skip the other shards when one fails; the outcome
+ * of the shard is stored in its own result slot instead.
+ */
+class CProofShardCheck
+{
+private:
+    CScProofVerifier* verifier;
+    std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>* shard;
+    size_t index;
+    char* result;
+
+public:
+    CProofShardCheck() : verifier(nullptr), shard(nullptr), index(0), result(nullptr) {}
+    CProofShardCheck(CScProofVerifier* verifierIn, std::map</* Cert or Tx hash */ uint256, CProofVerifierItem>* shardIn, size_t indexIn, char* resultIn) :
+        verifier(verifierIn), shard(shardIn), index(indexIn), result(resultIn) {}
+
+    bool operator()();
+
+    void swap(CProofShardCheck& check)
+    {
+        std::swap(verifier, check.verifier);
+        std::swap(shard, check.shard);
+        std::swap(index, check.index);
+        std::swap(result, check.result);
+    }
 };
 
+/** Runs a worker of the proof shard check queue, -scbatchverificationthreads - 1 of them being started */
+void ThreadProofShardCheck();
+
 #endif // _SC_PROOF_VERIFIER_H
@@ -2,6 +2,7 @@
 #include "sc/sidechaintypes.h"
 #include "primitives/transaction.h"
 #include "utilmoneystr.h"
+#include "utilstrencodings.h"
 #include "txmempool.h"
 #include "chainparams.h"
 #include "base58.h"
@@ -126,6 +127,45 @@ std::string CSidechain::stateToString(State s)
     }
 }
 
+std::string CSidechainIndexEntry::ToCursor() const
+{
+    return strprintf("%d:%s", creationHeight, scId.GetHex());
+}
+
+bool CSidechainIndexEntry::FromCursor(const std::string& cursor, CSidechainIndexEntry& entry)
+{
+    size_t sep = cursor.find(':');
+    if (sep == std::string::npos)
+        return false;
+
+    const std::string heightStr = cursor.substr(0, sep);
+    const std::string scIdStr = cursor.substr(sep + 1);
+    if (scIdStr.size() != 64 || !IsHex(scIdStr))
+        return false;
+
+    int32_t height = 0;
+    if (!ParseInt32(heightStr, &height) || height < 0)
+        return false;
+
+    entry = CSidechainIndexEntry(height, uint256S(scIdStr), -1);
+    return true;
+}
+
+std::string CSidechainDelta::TypeToString(Type type)
+{
+    switch (type)
+    {
+        case Type::CREATION:         return "CREATION";
+        case Type::FORWARD_TRANSFER: return "FORWARD_TRANSFER";
+        case Type::BWT_REQUEST:      return "BWT_REQUEST";
+        case Type::CSW:              return "CSW";
+        case Type::CERTIFICATE:      return "CERTIFICATE";
+        case Type::MATURED_AMOUNT:   return "MATURED_AMOUNT";
+        case Type::CEASING:          return "CEASING";
+    }
+    return "UNKNOWN";
+}
+
 std::string CSidechain::ToString() const
 {
     std::string str;
@@ -511,7 +551,7 @@ bool CSidechain::GetCeasingCumTreeHash(CFieldElement& ceasedBlockCum) const
         return false;
     }
 
-    ceasedBlockCum = ceasedBlockIndex->scCumTreeHash;
+    ceasedBlockCum = ceasedBlockIndex->scCumTreeHash.ToFieldElement();
     return true;
 }
 
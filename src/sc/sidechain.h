@@ -5,6 +5,8 @@
 #include "sc/sidechaintypes.h"
 #include <primitives/certificate.h>
 
+#include <limits>
+
 class CValidationState;
 class CTransaction;
 
@@ -154,6 +156,40 @@ public:
         }
     }
 
+    /**
+     * @brief Serialization of the record without fixedParams.
+     * The chainstate keeps the creation parameters, which never change, under a key of their own,
+     * so that updating balance, immature amounts or fees does not rewrite the verification keys too.
+     */
+    class MutableFields {
+    public:
+        explicit MutableFields(const CSidechain& scIn): sc(const_cast<CSidechain&>(scIn)) {}
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+        {
+            READWRITE(sc.sidechainVersion);
+            READWRITE(VARINT(sc.creationBlockHeight));
+            READWRITE(sc.creationTxHash);
+            READWRITE(sc.pastEpochTopQualityCertView);
+            READWRITE(sc.lastTopQualityCertView);
+            READWRITE(sc.lastTopQualityCertHash);
+            READWRITE(sc.lastTopQualityCertReferencedEpoch);
+            READWRITE(sc.lastTopQualityCertQuality);
+            READWRITE(sc.lastTopQualityCertBwtAmount);
+            READWRITE(sc.balance);
+            READWRITE(sc.mImmatureAmounts);
+            READWRITE(sc.scFees);
+            // maxSizeOfScFeesContainers depends on fixedParams, the reader sets it once they are loaded
+        }
+
+    private:
+        // modified only when unserializing, which is done on a non-const record
+        CSidechain& sc;
+    };
+
     inline bool operator==(const CSidechain& rhs) const
     {
         return (this->sidechainVersion                           == rhs.sidechainVersion)                  &&
@@ -197,6 +233,94 @@ public:
     size_t DynamicMemoryUsage() const;
 };
 
+/**
+ * @brief Entry of the secondary index of the sidechains, ordered by creation height and scId.
+ * It carries the scheduled ceasing height too, so that the state of a sidechain can be told
+ * without reading its whole record.
+ */
+class CSidechainIndexEntry {
+public:
+    //! Creation height of the sidechains whose creation tx is still in the mempool, sorting them last
+    static const int UNCONFIRMED_HEIGHT = std::numeric_limits<int>::max();
+
+    CSidechainIndexEntry(): creationHeight(-1), scId(), ceasingHeight(-1) {}
+    CSidechainIndexEntry(int creationHeightIn, const uint256& scIdIn, int ceasingHeightIn):
+        creationHeight(creationHeightIn), scId(scIdIn), ceasingHeight(ceasingHeightIn) {}
+    explicit CSidechainIndexEntry(const uint256& scIdIn, const CSidechain& sidechain):
+        creationHeight(sidechain.isCreationConfirmed() ? sidechain.creationBlockHeight : UNCONFIRMED_HEIGHT),
+        scId(scIdIn), ceasingHeight(sidechain.isCreationConfirmed() ? sidechain.GetScheduledCeasingHeight() : -1) {}
+
+    int creationHeight;
+    uint256 scId;
+    int ceasingHeight;
+
+    //! Same rule as CCoinsViewCache::GetSidechainState, given the height of the view
+    CSidechain::State GetState(int height) const
+    {
+        if (creationHeight == UNCONFIRMED_HEIGHT)
+            return CSidechain::State::UNCONFIRMED;
+
+        return (height >= ceasingHeight) ? CSidechain::State::CEASED : CSidechain::State::ALIVE;
+    }
+
+    //! The opaque string handed out to rpc clients for resuming a listing after this entry
+    std::string ToCursor() const;
+    static bool FromCursor(const std::string& cursor, CSidechainIndexEntry& entry);
+
+    inline bool operator<(const CSidechainIndexEntry& rhs) const
+    {
+        return (creationHeight < rhs.creationHeight) ||
+               (creationHeight == rhs.creationHeight && scId < rhs.scId);
+    }
+};
+
+/**
+ * @brief Structured change applied to a sidechain record while connecting or disconnecting a block.
+ * Besides the amount moved by the change, it carries the values of the record fields a subscriber
+ * is usually interested in, as they are right after the change has been applied.
+ */
+class CSidechainDelta {
+public:
+    enum class Type : uint8_t {
+        CREATION = 0,
+        FORWARD_TRANSFER,
+        BWT_REQUEST,
+        CSW,
+        CERTIFICATE,
+        MATURED_AMOUNT,
+        CEASING
+    };
+
+    CSidechainDelta(): type(Type::CREATION), scId(), amount(0), refHash(),
+        balance(0), lastTopQualityCertEpoch(CScCertificate::EPOCH_NULL),
+        lastTopQualityCertQuality(CScCertificate::QUALITY_NULL) {}
+    CSidechainDelta(Type typeIn, const uint256& scIdIn, CAmount amountIn, const uint256& refHashIn):
+        type(typeIn), scId(scIdIn), amount(amountIn), refHash(refHashIn),
+        balance(0), lastTopQualityCertEpoch(CScCertificate::EPOCH_NULL),
+        lastTopQualityCertQuality(CScCertificate::QUALITY_NULL) {}
+
+    Type type;
+    uint256 scId;
+    //! Amount moved by the change: tx output/input value, bwt total of the certificate or matured amount
+    CAmount amount;
+    //! Hash of the tx or certificate causing the change, null for the scheduled events
+    uint256 refHash;
+
+    CAmount balance;
+    int32_t lastTopQualityCertEpoch;
+    int64_t lastTopQualityCertQuality;
+
+    //! Copies the tracked fields of the record the change has been applied to
+    void SetState(const CSidechain& sidechain)
+    {
+        balance                   = sidechain.balance;
+        lastTopQualityCertEpoch   = sidechain.lastTopQualityCertReferencedEpoch;
+        lastTopQualityCertQuality = sidechain.lastTopQualityCertQuality;
+    }
+
+    static std::string TypeToString(Type type);
+};
+
 namespace Sidechain {
     bool checkCertCustomFields(const CSidechain& sidechain, const CScCertificate& cert);
     bool checkCertSemanticValidity(const CScCertificate& cert, CValidationState& state);
@@ -1,9 +1,13 @@
 #include <sc/sidechainTxsCommitmentBuilder.h>
+#include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <primitives/certificate.h>
 #include <uint256.h>
+#include <util.h>
 #include <algorithm>
+#include <functional>
 #include <iostream>
+#include <thread>
 #include <zendoo/zendoo_mc.h>
 
 // TODO remove when not needed anymore
@@ -15,6 +19,9 @@ bool SidechainTxsCommitmentBuilder::add(const CScCertificate& cert, const CCoins
 uint256 SidechainTxsCommitmentBuilder::getCommitment() { return uint256(); }
 SidechainTxsCommitmentBuilder::SidechainTxsCommitmentBuilder(): _cmt(nullptr) {}
 SidechainTxsCommitmentBuilder::~SidechainTxsCommitmentBuilder(){}
+bool SidechainTxsCommitmentBuilder::add(const std::vector<CTransaction>& vtx, const std::vector<CScCertificate>& vcert,
+                                        const CCoinsViewCache& view, unsigned int nThreads) { return true; }
+unsigned int SidechainTxsCommitmentBuilder::getThreadsNumber() { return 1; }
 #else
 SidechainTxsCommitmentBuilder::SidechainTxsCommitmentBuilder(): _cmt(initPtr())
 {
@@ -32,11 +39,22 @@ SidechainTxsCommitmentBuilder::~SidechainTxsCommitmentBuilder()
     zendoo_commitment_tree_delete(const_cast<commitment_tree_t*>(_cmt));
 }
 
+wrappedFieldPtr SidechainTxsCommitmentBuilder::getScIdField(const uint256& scId)
+{
+    auto it = mapScIdFields.find(scId);
+    if (it != mapScIdFields.end())
+        return it->second;
+
+    wrappedFieldPtr sptrScId = CFieldElement(scId).GetFieldElement();
+    mapScIdFields[scId] = sptrScId;
+    return sptrScId;
+}
+
 bool SidechainTxsCommitmentBuilder::add_scc(const CTxScCreationOut& ccout, const BufferWithSize& bws_tx_hash, uint32_t out_idx, CctpErrorCode& ret_code)
 {
     LogPrint("sc", "%s():%d entering \n", __func__, __LINE__);
 
-    wrappedFieldPtr sptrScId = CFieldElement(ccout.GetScId()).GetFieldElement();
+    wrappedFieldPtr sptrScId = getScIdField(ccout.GetScId());
     field_t* scid_fe = sptrScId.get();
 
     const uint256& pub_key = ccout.address;
@@ -142,7 +160,7 @@ bool SidechainTxsCommitmentBuilder::add_fwt(const CTxForwardTransferOut& ccout,
 {
     LogPrint("sc", "%s():%d entering \n", __func__, __LINE__);
 
-    wrappedFieldPtr sptrScId = CFieldElement(ccout.GetScId()).GetFieldElement();
+    wrappedFieldPtr sptrScId = getScIdField(ccout.GetScId());
     field_t* scid_fe = sptrScId.get();
 
     const uint256& fwt_pub_key = ccout.address;
@@ -168,7 +186,7 @@ bool SidechainTxsCommitmentBuilder::add_bwtr(const CBwtRequestOut& ccout, const
 {
     LogPrint("sc", "%s():%d entering \n", __func__, __LINE__);
 
-    wrappedFieldPtr sptrScId = CFieldElement(ccout.GetScId()).GetFieldElement();
+    wrappedFieldPtr sptrScId = getScIdField(ccout.GetScId());
     field_t* scid_fe = sptrScId.get();
 
     int sc_req_data_len = ccout.vScRequestData.size(); 
@@ -205,7 +223,7 @@ bool SidechainTxsCommitmentBuilder::add_csw(const CTxCeasedSidechainWithdrawalIn
 {
     LogPrint("sc", "%s():%d entering \n", __func__, __LINE__);
 
-    wrappedFieldPtr sptrScId = CFieldElement(ccin.scId).GetFieldElement();
+    wrappedFieldPtr sptrScId = getScIdField(ccin.scId);
     field_t* scid_fe = sptrScId.get();
 
     const uint160& csw_pk_hash = ccin.pubKeyHash;
@@ -226,7 +244,7 @@ bool SidechainTxsCommitmentBuilder::add_cert(const CScCertificate& cert, const S
 {
     LogPrint("sc", "%s():%d entering \n", __func__, __LINE__);
 
-    wrappedFieldPtr sptrScId = CFieldElement(cert.GetScId()).GetFieldElement();
+    wrappedFieldPtr sptrScId = getScIdField(cert.GetScId());
     field_t* scid_fe = sptrScId.get();
 
     const backward_transfer_t* bt_list =  nullptr;
@@ -380,6 +398,145 @@ bool SidechainTxsCommitmentBuilder::add(const CScCertificate& cert, const CCoins
     return true;
 }
 
+bool SidechainTxsCommitmentBuilder::add(const std::vector<CTransaction>& vtx, const std::vector<CScCertificate>& vcert,
+                                        const CCoinsViewCache& view, unsigned int nThreads)
+{
+    assert(_cmt != nullptr);
+
+    // fixed params are read from the view upfront, since it can not be accessed concurrently
+    std::map<uint256, Sidechain::ScFixedParameters> mapFixedParams;
+    for (const CScCertificate& cert : vcert)
+    {
+        if (mapFixedParams.count(cert.GetScId()))
+            continue;
+
+        CSidechain sidechain;
+        view.GetSidechain(cert.GetScId(), sidechain);
+        mapFixedParams[cert.GetScId()] = sidechain.fixedParams;
+    }
+
+    // group the preparation of the leaves by sidechain, so that every tx output/input and certificate is
+    // handled by exactly one thread
+    std::map<uint256, std::vector<std::function<void()>>> mapScTasks;
+    for (const CTransaction& tx : vtx)
+    {
+        if (!tx.IsScVersion())
+            continue;
+
+        for (const CTxScCreationOut& ccout : tx.GetVscCcOut())
+        {
+            auto& tasks = mapScTasks[ccout.GetScId()];
+            if (ccout.constant.is_initialized())
+                tasks.push_back([&ccout]() { ccout.constant->GetFieldElement(); });
+        }
+
+        for (const CTxForwardTransferOut& ccout : tx.GetVftCcOut())
+            mapScTasks[ccout.GetScId()];
+
+        for (const CBwtRequestOut& ccout : tx.GetVBwtRequestOut())
+        {
+            mapScTasks[ccout.GetScId()].push_back([&ccout]() {
+                for (const CFieldElement& fe : ccout.vScRequestData)
+                    fe.GetFieldElement();
+            });
+        }
+
+        for (const CTxCeasedSidechainWithdrawalInput& ccin : tx.GetVcswCcIn())
+            mapScTasks[ccin.scId].push_back([&ccin]() { ccin.nullifier.GetFieldElement(); });
+    }
+
+    for (const CScCertificate& cert : vcert)
+    {
+        const Sidechain::ScFixedParameters& params = mapFixedParams.at(cert.GetScId());
+        mapScTasks[cert.GetScId()].push_back([&cert, &params]() {
+            for (unsigned int i = 0; i < cert.vFieldElementCertificateField.size() && i < params.vFieldElementCertificateFieldConfig.size(); i++)
+                cert.vFieldElementCertificateField[i].GetFieldElement(params.vFieldElementCertificateFieldConfig[i]).GetFieldElement();
+            for (unsigned int i = 0; i < cert.vBitVectorCertificateField.size() && i < params.vBitVectorCertificateFieldConfig.size(); i++)
+                cert.vBitVectorCertificateField[i].GetFieldElement(params.vBitVectorCertificateFieldConfig[i]).GetFieldElement();
+            cert.endEpochCumScTxCommTreeRoot.GetFieldElement();
+        });
+    }
+
+    std::vector<uint256> vScIds;
+    for (const auto& entry : mapScTasks)
+    {
+        if (!mapScIdFields.count(entry.first))
+            vScIds.push_back(entry.first);
+    }
+    std::vector<wrappedFieldPtr> vScIdFields(vScIds.size());
+
+    // the sidechains with more leaves are assigned first, each one to the least loaded thread
+    std::vector<size_t> vScIdxs(vScIds.size());
+    for (size_t idx = 0; idx < vScIdxs.size(); idx++)
+        vScIdxs[idx] = idx;
+    std::stable_sort(vScIdxs.begin(), vScIdxs.end(), [&](size_t lhs, size_t rhs) {
+        return mapScTasks[vScIds[lhs]].size() > mapScTasks[vScIds[rhs]].size();
+    });
+
+    nThreads = std::max(1u, std::min<unsigned int>(nThreads, vScIds.size()));
+    std::vector<std::vector<size_t>> vThreadScIdxs(nThreads);
+    std::vector<size_t> vThreadLoad(nThreads, 0);
+    for (size_t idx : vScIdxs)
+    {
+        size_t thr = std::min_element(vThreadLoad.begin(), vThreadLoad.end()) - vThreadLoad.begin();
+        vThreadScIdxs[thr].push_back(idx);
+        vThreadLoad[thr] += 1 + mapScTasks[vScIds[idx]].size();
+    }
+
+    auto prepareLeaves = [&](const std::vector<size_t>& vIdxs) {
+        for (size_t idx : vIdxs)
+        {
+            vScIdFields[idx] = CFieldElement(vScIds[idx]).GetFieldElement();
+            for (const auto& task : mapScTasks.at(vScIds[idx]))
+                task();
+        }
+    };
+
+    int64_t nPrepareStartTime = GetTimeMicros();
+
+    std::vector<std::thread> workers;
+    for (unsigned int thr = 1; thr < nThreads; thr++)
+        workers.push_back(std::thread(prepareLeaves, std::cref(vThreadScIdxs[thr])));
+    prepareLeaves(vThreadScIdxs[0]);
+    for (std::thread& worker : workers)
+        worker.join();
+
+    for (size_t idx = 0; idx < vScIds.size(); idx++)
+        mapScIdFields[vScIds[idx]] = vScIdFields[idx];
+
+    LogPrint("bench", "%s():%d - prepared leaves of %d sidechains with %d threads: %.2fms\n",
+        __func__, __LINE__, vScIds.size(), nThreads, (GetTimeMicros() - nPrepareStartTime) * 0.001);
+
+    bool fAllAdded = true;
+    for (const CTransaction& tx : vtx)
+        fAllAdded = add(tx) && fAllAdded;
+
+    for (const CScCertificate& cert : vcert)
+    {
+        CctpErrorCode ret_code = CctpErrorCode::OK;
+        if (!add_cert(cert, mapFixedParams.at(cert.GetScId()), ret_code))
+        {
+            LogPrintf("%s():%d Error adding cert[%s], ret_code[%d]\n", __func__, __LINE__,
+                cert.GetHash().ToString(), ret_code);
+            fAllAdded = false;
+        }
+    }
+
+    return fAllAdded;
+}
+
+unsigned int SidechainTxsCommitmentBuilder::getThreadsNumber()
+{
+    int threads = GetArg("-sccommitmenttreethreads", DEFAULT_COMMITMENT_TREE_THREADS);
+
+    if (threads <= 0)
+    {
+        threads = GetNumCores();
+    }
+
+    return std::max(threads, 1);
+}
+
 uint256 SidechainTxsCommitmentBuilder::getCommitment()
 {
     assert(_cmt != nullptr);
@@ -406,3 +563,126 @@ const uint256& SidechainTxsCommitmentBuilder::getEmptyCommitment()
     return value;
 }
 #endif
+
+IncrementalScTxsCommitmentBuilder::IncrementalScTxsCommitmentBuilder():
+    builder(nullptr), hashPrevBlock(), vAddedItems(), setAddedItems(), cachedCommitment(),
+    nHits(0), nMisses(0) {}
+
+uint256 IncrementalScTxsCommitmentBuilder::getCommitment(const CBlock& block, const CCoinsViewCache& view)
+{
+    LOCK(cs_builder);
+
+    // same ordering as CBlock::BuildScTxsCommitment: txes first, then certificates
+    std::vector<uint256> vItems;
+    for (const CTransaction& tx : block.vtx)
+    {
+        if (tx.IsScVersion())
+            vItems.push_back(tx.GetHash());
+    }
+    for (const CScCertificate& cert : block.vcert)
+        vItems.push_back(cert.GetHash());
+
+    bool fReuse = builder != nullptr &&
+                  hashPrevBlock == block.hashPrevBlock &&
+                  vAddedItems.size() <= vItems.size() &&
+                  std::equal(vAddedItems.begin(), vAddedItems.end(), vItems.begin());
+
+    if (fReuse)
+        ++nHits;
+    else
+        ++nMisses;
+    LogPrint("bench", "%s():%d - commitment tree %s, reused %u of %u times\n",
+        __func__, __LINE__, fReuse ? "extended" : "rebuilt", nHits, nHits + nMisses);
+
+    if (!fReuse)
+    {
+        LogPrint("sc", "%s():%d - rebuilding commitment tree on top of block[%s] (%d items, %d were in the previous tree)\n",
+            __func__, __LINE__, block.hashPrevBlock.ToString(), vItems.size(), vAddedItems.size());
+        builder.reset(new SidechainTxsCommitmentBuilder());
+        hashPrevBlock = block.hashPrevBlock;
+        vAddedItems.clear();
+        setAddedItems.clear();
+        cachedCommitment = builder->getCommitment();
+    }
+
+    if (vAddedItems.size() == vItems.size())
+        return cachedCommitment;
+
+    LogPrint("sc", "%s():%d - appending %d items to a commitment tree of %d items\n",
+        __func__, __LINE__, vItems.size() - vAddedItems.size(), vAddedItems.size());
+
+    bool fAllAdded = true;
+    if (vAddedItems.empty())
+    {
+        fAllAdded = builder->add(block.vtx, block.vcert, view, SidechainTxsCommitmentBuilder::getThreadsNumber());
+    }
+    else
+    {
+        size_t pos = 0;
+        for (const CTransaction& tx : block.vtx)
+        {
+            if (!tx.IsScVersion())
+                continue;
+            if (pos++ < vAddedItems.size())
+                continue;
+            fAllAdded = builder->add(tx) && fAllAdded;
+        }
+        for (const CScCertificate& cert : block.vcert)
+        {
+            if (pos++ < vAddedItems.size())
+                continue;
+            fAllAdded = builder->add(cert, view) && fAllAdded;
+        }
+    }
+
+    cachedCommitment = builder->getCommitment();
+    setAddedItems.insert(vItems.begin() + vAddedItems.size(), vItems.end());
+    vAddedItems = vItems;
+
+    // a tree with a partially added item can not be safely extended
+    if (!fAllAdded)
+    {
+        builder.reset();
+        vAddedItems.clear();
+        setAddedItems.clear();
+    }
+
+    return cachedCommitment;
+}
+
+void IncrementalScTxsCommitmentBuilder::remove(const uint256& hash)
+{
+    LOCK(cs_builder);
+    if (setAddedItems.count(hash))
+    {
+        builder.reset();
+        vAddedItems.clear();
+        setAddedItems.clear();
+    }
+}
+
+void IncrementalScTxsCommitmentBuilder::clear()
+{
+    LOCK(cs_builder);
+    builder.reset();
+    vAddedItems.clear();
+    setAddedItems.clear();
+}
+
+size_t IncrementalScTxsCommitmentBuilder::size() const
+{
+    LOCK(cs_builder);
+    return vAddedItems.size();
+}
+
+uint64_t IncrementalScTxsCommitmentBuilder::getHits() const
+{
+    LOCK(cs_builder);
+    return nHits;
+}
+
+uint64_t IncrementalScTxsCommitmentBuilder::getMisses() const
+{
+    LOCK(cs_builder);
+    return nMisses;
+}
@@ -2,8 +2,15 @@
 #define SIDECHAIN_TX_COMMITMENT_BUILDER
 
 #include "coins.h"
+#include "sync.h"
 #include <sc/sidechaintypes.h>
 
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+class CBlock;
 class CTransaction;
 class CScCertificate;
 class uint256;
@@ -25,13 +32,33 @@ public:
 
     bool add(const CTransaction& tx);
     bool add(const CScCertificate& cert, const CCoinsViewCache& view);
+
+    /**
+     * @brief Adds all the txes and certificates of a block.
+     * The leaves are grouped by sidechain and prepared (field elements deserialized, certificate
+     * custom fields computed) on up to nThreads threads, each sidechain being handled by a single
+     * thread; they are then inserted into the tree in the block order, which the root depends on.
+     */
+    bool add(const std::vector<CTransaction>& vtx, const std::vector<CScCertificate>& vcert,
+             const CCoinsViewCache& view, unsigned int nThreads);
+
     uint256 getCommitment();
 
     static const uint256& getEmptyCommitment();
 
+    //! Gets the number of threads preparing the leaves of a block, at least 1.
+    static unsigned int getThreadsNumber();
+
+    static const int DEFAULT_COMMITMENT_TREE_THREADS = 0;
+
 private:
     const commitment_tree_t* const _cmt;
 
+    //! Deserialized scIds, shared by all the leaves of the same sidechain
+    std::map<uint256, wrappedFieldPtr> mapScIdFields;
+
+    wrappedFieldPtr getScIdField(const uint256& scId);
+
     // private initializer for instantiating the const ptr in the ctor initializer lists
     const commitment_tree_t* const initPtr();
 
@@ -44,4 +71,66 @@ private:
 
 };
 
+/**
+ * @brief Keeps a commitment tree alive across block templates built on top of the same tip.
+ *
+ * The cctp commitment tree is append-only and its root depends on the insertion order, therefore
+ * the tree built for the previous template is reused whenever the ordered list of sc related
+ * txes/certs of the new template extends the one already added to it: only the trailing items
+ * are appended. Any other change (tip update, item evicted from the mempool or reordered in the
+ * candidate set) triggers a rebuild from scratch. CreateNewBlock lays out the template txes by
+ * mempool arrival (see SortBlockTxsByArrival) so that newcomers land after the items already added.
+ */
+class IncrementalScTxsCommitmentBuilder
+{
+public:
+    IncrementalScTxsCommitmentBuilder();
+
+    IncrementalScTxsCommitmentBuilder(const IncrementalScTxsCommitmentBuilder&) = delete;
+    IncrementalScTxsCommitmentBuilder& operator=(const IncrementalScTxsCommitmentBuilder&) = delete;
+
+    /**
+     * @brief Returns the sc txs commitment of the given block template, appending to the
+     * persistent tree only the items not already added for a previous template.
+     */
+    uint256 getCommitment(const CBlock& block, const CCoinsViewCache& view);
+
+    /**
+     * @brief Drops the persistent tree, if the given tx/cert has already been added to it.
+     * To be called when the item leaves the mempool, so that memory is released early.
+     */
+    void remove(const uint256& hash);
+
+    /** @brief Drops the persistent tree unconditionally. */
+    void clear();
+
+    /** @brief Number of items added to the persistent tree (for testing and logging). */
+    size_t size() const;
+
+    /** @brief Number of commitments served by extending (or reusing as is) the persistent tree. */
+    uint64_t getHits() const;
+
+    /** @brief Number of commitments that needed the persistent tree to be rebuilt from scratch. */
+    uint64_t getMisses() const;
+
+private:
+    mutable CCriticalSection cs_builder;
+
+    std::unique_ptr<SidechainTxsCommitmentBuilder> builder;
+
+    //! The hash of the block the persistent tree was built on top of
+    uint256 hashPrevBlock;
+
+    //! The ordered list of the hashes of the txes/certs added so far to the persistent tree
+    std::vector<uint256> vAddedItems;
+    std::set<uint256> setAddedItems;
+
+    //! The commitment of the persistent tree, valid until a new item is appended
+    uint256 cachedCommitment;
+
+    //! Reuse statistics, reported in the bench log
+    uint64_t nHits;
+    uint64_t nMisses;
+};
+
 #endif
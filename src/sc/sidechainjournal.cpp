@@ -0,0 +1,93 @@
+#include <sc/sidechainjournal.h>
+#include <util.h>
+
+CSidechainJournal scJournal;
+
+CSidechainJournal::CSidechainJournal(size_t maxEntriesIn):
+    entries(), lastSeq(0), maxEntries(std::max<size_t>(maxEntriesIn, 1)) {}
+
+uint64_t CSidechainJournal::Append(const uint256& blockHash, int height, bool fConnected, const std::vector<CSidechainDelta>& deltas)
+{
+    LOCK(cs_journal);
+
+    CSidechainJournalEntry entry;
+    entry.seq        = ++lastSeq;
+    entry.blockHash  = blockHash;
+    entry.height     = height;
+    entry.fConnected = fConnected;
+    entry.deltas     = deltas;
+    entries.push_back(entry);
+
+    while (entries.size() > maxEntries)
+        entries.pop_front();
+
+    LogPrint("sc", "%s():%d - journal entry %d: block %s (h=%d) %s, %d deltas\n", __func__, __LINE__,
+        lastSeq, blockHash.ToString(), height, fConnected ? "connected" : "disconnected", deltas.size());
+    return lastSeq;
+}
+
+bool CSidechainJournal::GetEntriesSince(uint64_t afterSeq, const std::set<uint256>& scIds, std::vector<CSidechainJournalEntry>& entriesOut) const
+{
+    LOCK(cs_journal);
+
+    if (afterSeq >= lastSeq)
+        return true;
+
+    // sequence numbers are contiguous, so the first entry to return is found by offset
+    const uint64_t firstSeq = entries.empty() ? lastSeq + 1 : entries.front().seq;
+    if (afterSeq + 1 < firstSeq)
+        return false;
+
+    for (auto it = entries.begin() + (afterSeq + 1 - firstSeq); it != entries.end(); ++it)
+    {
+        if (scIds.empty())
+        {
+            entriesOut.push_back(*it);
+            continue;
+        }
+
+        CSidechainJournalEntry filtered;
+        for (const CSidechainDelta& delta : it->deltas)
+        {
+            if (scIds.count(delta.scId))
+                filtered.deltas.push_back(delta);
+        }
+
+        if (filtered.deltas.empty())
+            continue;
+
+        filtered.seq        = it->seq;
+        filtered.blockHash  = it->blockHash;
+        filtered.height     = it->height;
+        filtered.fConnected = it->fConnected;
+        entriesOut.push_back(filtered);
+    }
+    return true;
+}
+
+uint64_t CSidechainJournal::GetLastSeq() const
+{
+    LOCK(cs_journal);
+    return lastSeq;
+}
+
+void CSidechainJournal::SetMaxEntries(size_t maxEntriesIn)
+{
+    LOCK(cs_journal);
+    maxEntries = std::max<size_t>(maxEntriesIn, 1);
+    while (entries.size() > maxEntries)
+        entries.pop_front();
+}
+
+size_t CSidechainJournal::Size() const
+{
+    LOCK(cs_journal);
+    return entries.size();
+}
+
+void CSidechainJournal::Clear()
+{
+    // lastSeq is kept, so that subscribers never see a sequence number reused
+    LOCK(cs_journal);
+    entries.clear();
+}
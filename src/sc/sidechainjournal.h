@@ -0,0 +1,71 @@
+#ifndef SIDECHAIN_JOURNAL_H
+#define SIDECHAIN_JOURNAL_H
+
+#include "sc/sidechain.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <deque>
+#include <set>
+#include <vector>
+
+/**
+ * @brief The sidechain changes of a single block connection or disconnection.
+ * The sequence number is assigned by the journal and grows by one at each entry appended.
+ */
+class CSidechainJournalEntry {
+public:
+    CSidechainJournalEntry(): seq(0), blockHash(), height(-1), fConnected(true), deltas() {}
+
+    uint64_t seq;
+    uint256 blockHash;
+    int height;
+    //! false if the deltas have been undone by disconnecting the block
+    bool fConnected;
+    std::vector<CSidechainDelta> deltas;
+};
+
+/**
+ * @brief Append-only, bounded journal of the per-block sidechain changes of the active chain.
+ * Subscribers keep the sequence number of the last entry they consumed and fetch what has been
+ * appended afterwards, instead of polling the whole sidechain records.
+ */
+class CSidechainJournal {
+public:
+    static const size_t DEFAULT_MAX_ENTRIES = 1000;
+
+    explicit CSidechainJournal(size_t maxEntriesIn = DEFAULT_MAX_ENTRIES);
+
+    CSidechainJournal(const CSidechainJournal&) = delete;
+    CSidechainJournal& operator=(const CSidechainJournal&) = delete;
+
+    /**
+     * @brief Appends the deltas of a block, dropping the oldest entry if the journal is full.
+     * @return the sequence number of the new entry
+     */
+    uint64_t Append(const uint256& blockHash, int height, bool fConnected, const std::vector<CSidechainDelta>& deltas);
+
+    /**
+     * @brief Collects the entries appended after afterSeq, keeping only the deltas of the given
+     * sidechains (all of them if scIds is empty). Entries left without deltas are skipped.
+     * @return false if some entry following afterSeq has already been dropped from the journal
+     */
+    bool GetEntriesSince(uint64_t afterSeq, const std::set<uint256>& scIds, std::vector<CSidechainJournalEntry>& entries) const;
+
+    //! Sequence number of the last entry appended, 0 if none
+    uint64_t GetLastSeq() const;
+
+    void SetMaxEntries(size_t maxEntriesIn);
+    size_t Size() const;
+    void Clear();
+
+private:
+    mutable CCriticalSection cs_journal;
+    std::deque<CSidechainJournalEntry> entries;
+    uint64_t lastSeq;
+    size_t maxEntries;
+};
+
+extern CSidechainJournal scJournal;
+
+#endif // SIDECHAIN_JOURNAL_H
@@ -1,5 +1,6 @@
 #include "sc/sidechaintypes.h"
 #include "util.h"
+#include "utilstrencodings.h"
 #include <consensus/consensus.h>
 
 CZendooLowPrioThreadGuard::CZendooLowPrioThreadGuard(bool pauseThreads): _pause(pauseThreads)
@@ -129,6 +130,9 @@ std::string CZendooCctpObject::GetHexRepr() const
 }
 
 ///////////////////////////////// Field types //////////////////////////////////
+static const size_t FIELD_CACHE_ENTRY_USAGE = 128;         /**< The estimated memory used by a cached field element (including the cache overhead). */
+static const size_t FIELD_CACHE_MAX_USAGE   = 4 << 20;     /**< The maximum memory used by the cache of deserialized field elements. */
+
 #ifdef BITCOIN_TX
 void CFieldPtrDeleter::operator()(field_t* p) const {};
 CFieldElement::CFieldElement(const std::vector<unsigned char>& byteArrayIn) {};
@@ -139,6 +143,8 @@ uint256 CFieldElement::GetLegacyHash() const { return uint256(); };
 wrappedFieldPtr CFieldElement::GetFieldElement() const {return nullptr;};
 bool CFieldElement::IsValid() const {return false;};
 CFieldElement CFieldElement::ComputeHash(const CFieldElement& lhs, const CFieldElement& rhs) { return CFieldElement{}; }
+wrappedFieldPtr CFieldElement::GetSharedFieldElement() const {return nullptr;};
+CCctpObjectCache<field_t>& CFieldElement::GetDeserializedCache() { static CCctpObjectCache<field_t> cache(0); return cache; }
 #else
 void CFieldPtrDeleter::operator()(field_t* p) const
 {
@@ -214,6 +220,53 @@ wrappedFieldPtr CFieldElement::GetFieldElement() const
     return fieldData;
 }
 
+/**
+ * @brief Same as GetFieldElement(), but the deserialized element is shared process-wide
+ * through the cache of hot field elements, so that elements used over and over (e.g. the
+ * sidechain IDs and constants of certificates and CSW inputs being verified) are
+ * deserialized only once.
+ */
+wrappedFieldPtr CFieldElement::GetSharedFieldElement() const
+{
+    if (byteVector.size() != ByteSize())
+    {
+        return GetFieldElement();
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+        if (fieldData != nullptr)
+            return fieldData;
+    }
+
+    // Field elements are exactly as large as their key, their content is used as it is.
+    const uint256 key(byteVector);
+    wrappedFieldPtr cached = GetDeserializedCache().Get(key);
+
+    if (cached != nullptr)
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+        if (fieldData == nullptr)
+            fieldData.swap(cached);
+        return fieldData;
+    }
+
+    wrappedFieldPtr ret = GetFieldElement();
+    GetDeserializedCache().Put(key, ret, FIELD_CACHE_ENTRY_USAGE);
+    return ret;
+}
+
+/**
+ * @brief Gets the process-wide cache of deserialized field elements.
+ * It is mainly useful for the elements used over and over (e.g. the sidechain IDs and constants
+ * of certificates and CSW inputs being verified).
+ */
+CCctpObjectCache<field_t>& CFieldElement::GetDeserializedCache()
+{
+    static CCctpObjectCache<field_t> cache(FIELD_CACHE_MAX_USAGE);
+    return cache;
+}
+
 uint256 CFieldElement::GetLegacyHash() const
 {
     std::vector<unsigned char> tmp(this->byteVector.begin(), this->byteVector.begin()+32);
@@ -278,6 +331,29 @@ const CFieldElement& CFieldElement::GetPhantomHash()
 #endif
 ///////////////////////////// End of CFieldElement /////////////////////////////
 
+/////////////////////////////// CCompactFieldElement ///////////////////////////
+CCompactFieldElement::CCompactFieldElement(const CFieldElement& fieldElement): data(), fNull(fieldElement.IsNull())
+{
+    if (!fNull)
+    {
+        assert(fieldElement.GetByteArray().size() == data.size());
+        std::copy(fieldElement.GetByteArray().begin(), fieldElement.GetByteArray().end(), data.begin());
+    }
+}
+
+CFieldElement CCompactFieldElement::ToFieldElement() const
+{
+    if (fNull)
+        return CFieldElement{};
+    return CFieldElement{std::vector<unsigned char>(data.begin(), data.end())};
+}
+
+std::string CCompactFieldElement::GetHexRepr() const
+{
+    return fNull ? std::string() : HexStr(data.begin(), data.end());
+}
+/////////////////////////// End of CCompactFieldElement ////////////////////////
+
 /////////////////////////////////// CScProof ///////////////////////////////////
 CScProof::CScProof(const std::vector<unsigned char>& byteArrayIn): CZendooCctpObject(byteArrayIn)
 {
@@ -399,6 +475,17 @@ wrappedScVkeyPtr CScVKey::GetVKeyPtr() const
             return vkData;
         }
 
+        // Verification keys are shared by all the certificates (or CSW inputs) of a sidechain,
+        // look for an already deserialized instance first.
+        const uint256 key = Hash(byteVector.begin(), byteVector.end());
+        wrappedScVkeyPtr cached = GetDeserializedCache().Get(key);
+
+        if (cached != nullptr)
+        {
+            vkData.swap(cached);
+            return vkData;
+        }
+
         BufferWithSize result{(unsigned char*)&byteVector[0], byteVector.size()}; 
         CctpErrorCode code;
 
@@ -409,11 +496,24 @@ wrappedScVkeyPtr CScVKey::GetVKeyPtr() const
             assert(vkData == nullptr);
             return vkData;
         }
+        // The deserialized key size is not known, the serialized one is used as an estimate.
+        GetDeserializedCache().Put(key, ret, byteVector.size());
         vkData.swap(ret);
     }
     return vkData;
 }
 
+/**
+ * @brief Gets the process-wide cache of deserialized verification keys, keyed by the hash
+ * of the serialized key. Its size can be set through the -scvkcachesize option.
+ */
+CCctpObjectCache<sc_vk_t>& CScVKey::GetDeserializedCache()
+{
+    static CCctpObjectCache<sc_vk_t> cache(
+        std::max<int64_t>(0, GetArg("-scvkcachesize", DEFAULT_DESERIALIZED_CACHE_SIZE)) << 20);
+    return cache;
+}
+
 bool CScVKey::IsValid() const
 {
     if (this->GetVKeyPtr() == nullptr)
@@ -1,6 +1,10 @@
 #ifndef _SIDECHAIN_TYPES_H
 #define _SIDECHAIN_TYPES_H
 
+#include <array>
+#include <list>
+#include <map>
+#include <memory>
 #include <vector>
 #include <string>
 #include <mutex>
@@ -86,6 +90,101 @@ class CZendooCctpLibraryChecker
     static void CheckTypeSizes();
 };
 
+/**
+ * @brief A thread safe, memory bounded LRU cache of objects deserialized by the CCTP library.
+ * 
+ * Cached objects are reference counted: evicting an entry only releases the reference held by
+ * the cache, so objects still in use elsewhere stay valid.
+ */
+template <typename T>
+class CCctpObjectCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;      /**< The number of lookups that found the object. */
+        uint64_t misses = 0;    /**< The number of lookups that did not find the object. */
+        size_t entries = 0;     /**< The number of cached objects. */
+        size_t usage = 0;       /**< The (estimated) memory used by the cached objects, in bytes. */
+    };
+
+    explicit CCctpObjectCache(size_t maxUsageIn): maxUsage(maxUsageIn), currentUsage(0) {}
+
+    CCctpObjectCache(const CCctpObjectCache&) = delete;
+    CCctpObjectCache& operator=(const CCctpObjectCache&) = delete;
+
+    std::shared_ptr<T> Get(const uint256& key)
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+
+        auto it = mapEntries.find(key);
+        if (it == mapEntries.end())
+        {
+            stats.misses++;
+            return nullptr;
+        }
+
+        stats.hits++;
+        lruList.splice(lruList.begin(), lruList, it->second.lruPos);
+        return it->second.ptr;
+    }
+
+    void Put(const uint256& key, const std::shared_ptr<T>& ptr, size_t usage)
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+
+        if (ptr == nullptr || usage > maxUsage || mapEntries.count(key) != 0)
+            return;
+
+        while (currentUsage + usage > maxUsage)
+        {
+            auto it = mapEntries.find(lruList.back());
+            currentUsage -= it->second.usage;
+            mapEntries.erase(it);
+            lruList.pop_back();
+        }
+
+        lruList.push_front(key);
+        mapEntries.insert(std::make_pair(key, Entry{ptr, usage, lruList.begin()}));
+        currentUsage += usage;
+    }
+
+    Stats GetStats() const
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+
+        Stats ret = stats;
+        ret.entries = mapEntries.size();
+        ret.usage = currentUsage;
+        return ret;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+
+        mapEntries.clear();
+        lruList.clear();
+        currentUsage = 0;
+        stats = Stats();
+    }
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<T> ptr;
+        size_t usage;
+        typename std::list<uint256>::iterator lruPos;
+    };
+
+    mutable std::mutex _mutex;
+    const size_t maxUsage;
+    size_t currentUsage;
+    std::map<uint256, Entry> mapEntries;
+    std::list<uint256> lruList;     /**< The keys of cached objects, most recently used first. */
+    Stats stats;
+};
+
 class CZendooCctpObject
 {
 public:
@@ -141,6 +240,7 @@ public:
     uint256 GetLegacyHash() const;
 
     wrappedFieldPtr GetFieldElement() const;
+    wrappedFieldPtr GetSharedFieldElement() const;
     bool IsValid() const override final;
     bool operator<(const CFieldElement& rhs)  const { return this->byteVector < rhs.byteVector; } // FOR STD::MAP ONLY
 
@@ -151,6 +251,8 @@ public:
     static CFieldElement ComputeHash(const CFieldElement& lhs, const CFieldElement& rhs);
     static const CFieldElement& GetPhantomHash();
 
+    static CCctpObjectCache<field_t>& GetDeserializedCache();
+
     // SERIALIZATION SECTION
     ADD_SERIALIZE_METHODS;
 
@@ -171,6 +273,75 @@ private:
 typedef CFieldElement ScConstant;
 ///////////////////////////// End of CFieldElement /////////////////////////////
 
+/////////////////////////////// CCompactFieldElement ///////////////////////////
+/**
+ * @brief Fixed-size value type keeping the bytes of a field element inline.
+ * It is meant for long lived containers (block index, nullifier sets), where the byte vector,
+ * the mutex and the deserialized handle of a CFieldElement cost an extra heap allocation and
+ * about a hundred bytes per item. The CFieldElement, and its deserialized field, is built on demand.
+ * It serializes exactly as a CFieldElement does.
+ */
+class CCompactFieldElement
+{
+public:
+    CCompactFieldElement(): data(), fNull(true) {}
+    //! Implicit, so that the containers keyed by it can be looked up with a CFieldElement
+    CCompactFieldElement(const CFieldElement& fieldElement);
+
+    CFieldElement ToFieldElement() const;
+
+    bool IsNull() const { return fNull; }
+    void SetNull() { data.fill(0); fNull = true; }
+    const unsigned char* GetDataBuffer() const { return data.data(); }
+
+    std::string GetHexRepr() const;
+
+    bool operator==(const CCompactFieldElement& rhs) const { return fNull == rhs.fNull && data == rhs.data; }
+    bool operator!=(const CCompactFieldElement& rhs) const { return !(*this == rhs); }
+    // same order as CFieldElement, the null element coming first
+    bool operator<(const CCompactFieldElement& rhs) const
+    {
+        return (fNull != rhs.fNull) ? fNull : (data < rhs.data);
+    }
+
+    size_t GetSerializeSize(int nType, int nVersion) const
+    {
+        return fNull ? GetSizeOfCompactSize(0) : GetSizeOfCompactSize(CFieldElement::ByteSize()) + CFieldElement::ByteSize();
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        if (fNull)
+        {
+            WriteCompactSize(s, 0);
+            return;
+        }
+        WriteCompactSize(s, CFieldElement::ByteSize());
+        s.write((const char*)data.data(), data.size());
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        uint64_t nSize = ReadCompactSize(s);
+        if (nSize == 0)
+        {
+            SetNull();
+            return;
+        }
+        if (nSize != CFieldElement::ByteSize())
+            throw std::ios_base::failure("CCompactFieldElement::Unserialize(): unexpected field element size");
+        s.read((char*)data.data(), data.size());
+        fNull = false;
+    }
+
+private:
+    std::array<unsigned char, Sidechain::SC_FE_SIZE_IN_BYTES> data;
+    bool fNull;
+};
+/////////////////////////// End of CCompactFieldElement ////////////////////////
+
 /////////////////////////////////// CScProof ///////////////////////////////////
 struct CProofPtrDeleter
 { // deleter
@@ -243,6 +414,9 @@ public:
     wrappedScVkeyPtr GetVKeyPtr() const;
     bool IsValid() const override final;
 
+    static const int64_t DEFAULT_DESERIALIZED_CACHE_SIZE = 64; /**< The default size (in MiB) of the cache of deserialized verification keys. */
+    static CCctpObjectCache<sc_vk_t>& GetDeserializedCache();
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
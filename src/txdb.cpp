@@ -6,13 +6,19 @@
 #include "txdb.h"
 
 #include "chainparams.h"
+#include "compat/endian.h"
 #include "hash.h"
 #include "main.h"
 #include "pow.h"
+#include "random.h"
+#include "streams.h"
 #include "uint256.h"
 
+#include <future>
+#include <limits>
 #include <stdint.h>
 
+#include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 #include <sc/sidechaintypes.h>
 #include "utilmoneystr.h"
@@ -35,6 +41,55 @@ static const char DB_REINDEX_FLAG = 'R';
 static const char DB_FAST_REINDEX_FLAG = 'S';
 static const char DB_LAST_BLOCK = 'l';
 static const char DB_CSW_NULLIFIER = 'n';
+static const char DB_SIDECHAINS_INDEX = 'I';
+static const char DB_SIDECHAINS_PARAMS = 'p';
+
+//! Flag set in the coins db once the sidechain index has been built
+static const std::string SIDECHAINS_INDEX_FLAG = "sidechainindex";
+//! Flag set in the coins db once the sidechain records have been split into mutable fields and fixed params
+static const std::string SIDECHAINS_SPLIT_FLAG = "sidechainsplit";
+//! Key of the version of the coins db format, kept among the flags
+static const std::string FORMAT_VERSION_FLAG = "formatversion";
+//! Version of the coins db format written by this code, to be bumped whenever a previous version could not read it
+static const int COINS_DB_FORMAT_VERSION = 1;
+//! Flag set in the coins db while a snapshot is being loaded, the records written so far being wiped if it is found on startup
+static const std::string SNAPSHOT_LOADING_FLAG = "snapshotloading";
+
+/**
+ * Key of the sidechain index. The creation height is serialized as big endian, so that
+ * leveldb keeps the entries sorted by creation height first and by scId then.
+ */
+class CSidechainIndexKey
+{
+public:
+    int creationHeight;
+    uint256 scId;
+
+    CSidechainIndexKey(): creationHeight(0), scId() {}
+    CSidechainIndexKey(int creationHeightIn, const uint256& scIdIn): creationHeight(creationHeightIn), scId(scIdIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return sizeof(uint32_t) + scId.GetSerializeSize(nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        uint32_t heightBE = htobe32((uint32_t)creationHeight);
+        s.write((char*)&heightBE, sizeof(heightBE));
+        scId.Serialize(s, nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        uint32_t heightBE = 0;
+        s.read((char*)&heightBE, sizeof(heightBE));
+        creationHeight = (int)be32toh(heightBE);
+        scId.Unserialize(s, nType, nVersion);
+    }
+};
 
 
 void static BatchWriteAnchor(CLevelDBBatch &batch,
@@ -63,15 +118,28 @@ void static BatchWriteCoins(CLevelDBBatch &batch, const uint256 &hash, const CCo
         batch.Write(make_pair(DB_COINS, hash), coins);
 }
 
-void static BatchSidechains(CLevelDBBatch &batch, const uint256 &scId, const CSidechainsCacheEntry &sidechain) {
+void static BatchSidechains(CLevelDBBatch &batch, const CLevelDBWrapper &db, const uint256 &scId, const CSidechainsCacheEntry &sidechain,
+                            bool fWriteFixedParams) {
     switch (sidechain.flag) {
         case CSidechainsCacheEntry::Flags::FRESH:
         case CSidechainsCacheEntry::Flags::DIRTY:
-            batch.Write(make_pair(DB_SIDECHAINS, scId), sidechain.sidechain);
+            batch.Write(make_pair(DB_SIDECHAINS, scId), CSidechain::MutableFields(sidechain.sidechain));
+            if (fWriteFixedParams)
+                batch.Write(make_pair(DB_SIDECHAINS_PARAMS, scId), sidechain.sidechain.fixedParams);
+            // the creation height of a sidechain never changes, only the ceasing height is updated here
+            batch.Write(make_pair(DB_SIDECHAINS_INDEX, CSidechainIndexKey(sidechain.sidechain.creationBlockHeight, scId)),
+                        sidechain.sidechain.GetScheduledCeasingHeight());
             break;
         case CSidechainsCacheEntry::Flags::ERASED:
+        {
+            CSidechain erased;
+            CSidechain::MutableFields erasedFields(erased);
+            if (db.Read(make_pair(DB_SIDECHAINS, scId), erasedFields))
+                batch.Erase(make_pair(DB_SIDECHAINS_INDEX, CSidechainIndexKey(erased.creationBlockHeight, scId)));
             batch.Erase(make_pair(DB_SIDECHAINS, scId));
+            batch.Erase(make_pair(DB_SIDECHAINS_PARAMS, scId));
             break;
+        }
         case CSidechainsCacheEntry::Flags::DEFAULT:
         default:
             break;
@@ -103,8 +171,8 @@ void static BatchWriteHashBestAnchor(CLevelDBBatch &batch, const uint256 &hash)
     batch.Write(DB_BEST_ANCHOR, hash);
 }
 
-void static BatchWriteCswNullifier(CLevelDBBatch &batch, const uint256 &scId, const CFieldElement &nullifier, CCswNullifiersCacheEntry state) {
-    std::pair<uint256, CFieldElement> position = std::make_pair(scId, nullifier);
+void static BatchWriteCswNullifier(CLevelDBBatch &batch, const uint256 &scId, const CCompactFieldElement &nullifier, CCswNullifiersCacheEntry state) {
+    std::pair<uint256, CCompactFieldElement> position = std::make_pair(scId, nullifier);
 
     switch(state.flag) {
         case CCswNullifiersCacheEntry::Flags::FRESH:
@@ -119,10 +187,159 @@ void static BatchWriteCswNullifier(CLevelDBBatch &batch, const uint256 &scId, co
     }
 }
 
-CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe) {
+CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe),
+    cswNullifierFilter(GetRand(std::numeric_limits<unsigned int>::max())) {
+    CheckFormatVersion();
+    if (db.Exists(make_pair(DB_FLAG, SNAPSHOT_LOADING_FLAG)))
+        WipeSnapshotRecords();
+    SplitSidechainRecords();
+    BuildSidechainIndex();
+    WriteFormatVersion();
+    LoadCswNullifierFilter();
+    LoadSidechainEvents();
+}
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe),
+    cswNullifierFilter(GetRand(std::numeric_limits<unsigned int>::max())) {
+    CheckFormatVersion();
+    if (db.Exists(make_pair(DB_FLAG, SNAPSHOT_LOADING_FLAG)))
+        WipeSnapshotRecords();
+    SplitSidechainRecords();
+    BuildSidechainIndex();
+    WriteFormatVersion();
+    LoadCswNullifierFilter();
+    LoadSidechainEvents();
+}
+
+void CCoinsViewDB::CheckFormatVersion() const
+{
+    // a db written by a previous version has no format version, and is upgraded when opened
+    int nVersion = 0;
+    if (db.Exists(make_pair(DB_FLAG, FORMAT_VERSION_FLAG)) && !db.Read(make_pair(DB_FLAG, FORMAT_VERSION_FLAG), nVersion))
+        throw std::runtime_error("CCoinsViewDB: unable to read the chainstate format version");
+
+    if (nVersion > COINS_DB_FORMAT_VERSION)
+        throw std::runtime_error(strprintf("CCoinsViewDB: the chainstate format version %d is newer than the supported one %d",
+            nVersion, COINS_DB_FORMAT_VERSION));
+}
+
+void CCoinsViewDB::WriteFormatVersion()
+{
+    int nVersion = 0;
+    if (db.Read(make_pair(DB_FLAG, FORMAT_VERSION_FLAG), nVersion) && nVersion == COINS_DB_FORMAT_VERSION)
+        return;
+
+    db.Write(make_pair(DB_FLAG, FORMAT_VERSION_FLAG), COINS_DB_FORMAT_VERSION, true);
+    LogPrintf("%s: chainstate format version %d\n", __func__, COINS_DB_FORMAT_VERSION);
+}
+
+void CCoinsViewDB::SplitSidechainRecords()
+{
+    if (db.Exists(make_pair(DB_FLAG, SIDECHAINS_SPLIT_FLAG)))
+        return;
+
+    // chainstate written by a previous version: each sidechain is stored as a single record
+    CLevelDBBatch batch;
+    int count = 0;
+    std::unique_ptr<leveldb::Iterator> it(db.NewIterator());
+    static const std::string scIdsPrefix = std::string(1,DB_SIDECHAINS);
+
+    for(it->Seek(scIdsPrefix); it->Valid() && it->key().starts_with(scIdsPrefix); it->Next())
+    {
+        leveldb::Slice slKey = it->key();
+        CDataStream ssKey(slKey.data() + sizeof(char), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+        uint256 keyScId;
+        ssKey >> keyScId;
+
+        leveldb::Slice slValue = it->value();
+        CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+        CSidechain info;
+        ssValue >> info;
+
+        batch.Write(make_pair(DB_SIDECHAINS, keyScId), CSidechain::MutableFields(info));
+        batch.Write(make_pair(DB_SIDECHAINS_PARAMS, keyScId), info.fixedParams);
+        count++;
+    }
+
+    batch.Write(make_pair(DB_FLAG, SIDECHAINS_SPLIT_FLAG), '1');
+    db.WriteBatch(batch, true);
+    LogPrintf("%s: split %d sidechain records\n", __func__, count);
+}
+
+void CCoinsViewDB::LoadCswNullifierFilter()
+{
+    std::unique_ptr<leveldb::Iterator> it(db.NewIterator());
+    static const std::string cswNullifiersPrefix = std::string(1,DB_CSW_NULLIFIER);
+
+    LOCK(cs_cswNullifierFilter);
+    cswNullifierFilter.Clear();
+    for(it->Seek(cswNullifiersPrefix); it->Valid() && it->key().starts_with(cswNullifiersPrefix); it->Next())
+    {
+        leveldb::Slice slKey = it->key();
+        // serialize key, skipping prefix
+        CDataStream ssKey(slKey.data() + sizeof(char), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+        std::pair<uint256, CCompactFieldElement> position;
+        ssKey >> position;
+        cswNullifierFilter.Insert(position.first, position.second);
+    }
+
+    LogPrint("coindb", "%s: loaded %d csw nullifiers, %d bytes\n", __func__,
+        cswNullifierFilter.Size(), cswNullifierFilter.DynamicMemoryUsage());
+}
+
+void CCoinsViewDB::LoadSidechainEvents()
+{
+    std::unique_ptr<leveldb::Iterator> it(db.NewIterator());
+    static const std::string scEventsPrefix = std::string(1,DB_CEASEDSCS);
+
+    LOCK(cs_scEvents);
+    mapSidechainEventsByHeight.clear();
+    for(it->Seek(scEventsPrefix); it->Valid() && it->key().starts_with(scEventsPrefix); it->Next())
+    {
+        leveldb::Slice slKey = it->key();
+        // serialize key, skipping prefix
+        CDataStream ssKey(slKey.data() + sizeof(char), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+        int height;
+        ssKey >> height;
+
+        leveldb::Slice slValue = it->value();
+        CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> mapSidechainEventsByHeight[height];
+    }
+
+    LogPrint("sc", "%s: loaded sidechain events at %d heights\n", __func__, mapSidechainEventsByHeight.size());
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe) {
+void CCoinsViewDB::BuildSidechainIndex()
+{
+    if (db.Exists(make_pair(DB_FLAG, SIDECHAINS_INDEX_FLAG)))
+        return;
+
+    // chainstate written by a previous version: index all the sidechains once
+    CLevelDBBatch batch;
+    int count = 0;
+    std::unique_ptr<leveldb::Iterator> it(db.NewIterator());
+    static const std::string scIdsPrefix = std::string(1,DB_SIDECHAINS);
+
+    for(it->Seek(scIdsPrefix); it->Valid() && it->key().starts_with(scIdsPrefix); it->Next())
+    {
+        leveldb::Slice slKey = it->key();
+        CDataStream ssKey(slKey.data() + sizeof(char), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+        uint256 keyScId;
+        ssKey >> keyScId;
+
+        CSidechain info;
+        if (!GetSidechain(keyScId, info))
+            continue;
+
+        batch.Write(make_pair(DB_SIDECHAINS_INDEX, CSidechainIndexKey(info.creationBlockHeight, keyScId)),
+                    info.GetScheduledCeasingHeight());
+        count++;
+    }
+
+    batch.Write(make_pair(DB_FLAG, SIDECHAINS_INDEX_FLAG), '1');
+    db.WriteBatch(batch, true);
+    LogPrintf("%s: indexed %d sidechains\n", __func__, count);
 }
 
 
@@ -155,7 +372,43 @@ bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
 
 bool CCoinsViewDB::GetSidechain(const uint256& scId, CSidechain& info) const
 {
-    return db.Read(std::make_pair(DB_SIDECHAINS, scId), info);
+    CSidechain::MutableFields fields(info);
+    if (!db.Read(std::make_pair(DB_SIDECHAINS, scId), fields))
+        return false;
+
+    if (!GetScFixedParams(scId, info.fixedParams))
+        return error("%s():%d - ERROR: missing creation parameters for scId=%s\n", __func__, __LINE__, scId.ToString());
+
+    if (!info.scFees.empty())
+        info.maxSizeOfScFeesContainers = info.getMaxSizeOfScFeesContainers();
+    return true;
+}
+
+bool CCoinsViewDB::GetScFixedParams(const uint256& scId, Sidechain::ScFixedParameters& params) const
+{
+    {
+        LOCK(cs_fixedParams);
+        auto it = mapFixedParams.find(scId);
+        if (it != mapFixedParams.end())
+        {
+            params = it->second;
+            return true;
+        }
+    }
+
+    if (!db.Read(std::make_pair(DB_SIDECHAINS_PARAMS, scId), params))
+        return false;
+
+    CacheScFixedParams(scId, params);
+    return true;
+}
+
+void CCoinsViewDB::CacheScFixedParams(const uint256& scId, const Sidechain::ScFixedParameters& params) const
+{
+    LOCK(cs_fixedParams);
+    if (mapFixedParams.size() >= MAX_CACHED_SC_FIXED_PARAMS && !mapFixedParams.count(scId))
+        mapFixedParams.erase(mapFixedParams.begin());
+    mapFixedParams[scId] = params;
 }
 
 bool CCoinsViewDB::HaveSidechain(const uint256& scId) const
@@ -165,12 +418,19 @@ bool CCoinsViewDB::HaveSidechain(const uint256& scId) const
 
 bool CCoinsViewDB::HaveSidechainEvents(int height) const
 {
-    return db.Exists(std::make_pair(DB_CEASEDSCS, height));
+    LOCK(cs_scEvents);
+    return mapSidechainEventsByHeight.count(height) != 0;
 }
 
 bool CCoinsViewDB::GetSidechainEvents(int height, CSidechainEvents& ceasingScs) const
 {
-    return db.Read(std::make_pair(DB_CEASEDSCS, height), ceasingScs);
+    LOCK(cs_scEvents);
+    auto it = mapSidechainEventsByHeight.find(height);
+    if (it == mapSidechainEventsByHeight.end())
+        return false;
+
+    ceasingScs = it->second;
+    return true;
 }
 
 void CCoinsViewDB::GetScIds(std::set<uint256>& scIdsList) const
@@ -193,6 +453,50 @@ void CCoinsViewDB::GetScIds(std::set<uint256>& scIdsList) const
     return;
 }
 
+void CCoinsViewDB::GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                                     std::vector<CSidechainIndexEntry>& entries) const
+{
+    entries.clear();
+
+    std::unique_ptr<leveldb::Iterator> it(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
+    static const std::string indexPrefix = std::string(1,DB_SIDECHAINS_INDEX);
+
+    if (after.creationHeight < 0)
+    {
+        it->Seek(indexPrefix);
+    }
+    else
+    {
+        CDataStream ssStart(SER_DISK, CLIENT_VERSION);
+        ssStart << make_pair(DB_SIDECHAINS_INDEX, CSidechainIndexKey(after.creationHeight, after.scId));
+        it->Seek(leveldb::Slice(&ssStart[0], ssStart.size()));
+    }
+
+    for(; it->Valid() && it->key().starts_with(indexPrefix) && entries.size() < maxItems; it->Next())
+    {
+        boost::this_thread::interruption_point();
+
+        leveldb::Slice slKey = it->key();
+        // serialize key, skipping prefix
+        CDataStream ssKey(slKey.data() + sizeof(char), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+        CSidechainIndexKey key;
+        ssKey >> key;
+
+        leveldb::Slice slValue = it->value();
+        CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+        int ceasingHeight;
+        ssValue >> ceasingHeight;
+
+        CSidechainIndexEntry entry(key.creationHeight, key.scId, ceasingHeight);
+        if (!(after < entry))
+            continue;
+        if (bOnlyAlive && entry.GetState(height) != CSidechain::State::ALIVE)
+            continue;
+
+        entries.push_back(entry);
+    }
+}
+
 uint256 CCoinsViewDB::GetBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
@@ -208,7 +512,12 @@ uint256 CCoinsViewDB::GetBestAnchor() const {
 }
 
 bool CCoinsViewDB::HaveCswNullifier(const uint256& scId, const CFieldElement &nullifier) const {
-    std::pair<uint256, CFieldElement> position = std::make_pair(scId, nullifier);
+    std::pair<uint256, CCompactFieldElement> position = std::make_pair(scId, CCompactFieldElement{nullifier});
+    {
+        LOCK(cs_cswNullifierFilter);
+        if (!cswNullifierFilter.MaybeContains(position.first, position.second))
+            return false;
+    }
     return db.Exists(make_pair(DB_CSW_NULLIFIER, position));
 }
 
@@ -251,21 +560,52 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
         mapNullifiers.erase(itOld);
     }
 
+    // fixed params are written along with the creation only, the cache tells the ones already persisted
+    std::vector<std::pair<uint256, Sidechain::ScFixedParameters>> vWrittenParams;
+    std::vector<uint256> vErasedParams;
     for (CSidechainsMap::iterator it = mapSidechains.begin(); it != mapSidechains.end();) {
-        BatchSidechains(batch, it->first, it->second);
+        bool fWriteFixedParams = false;
+        if (it->second.flag == CSidechainsCacheEntry::Flags::FRESH)
+        {
+            fWriteFixedParams = true;
+        }
+        else if (it->second.flag == CSidechainsCacheEntry::Flags::DIRTY)
+        {
+            // an entry created in a cache and then modified reaches the db as dirty: the params are
+            // written again unless cached, rewriting the same value being cheaper than looking it up
+            LOCK(cs_fixedParams);
+            fWriteFixedParams = !mapFixedParams.count(it->first);
+        }
+
+        BatchSidechains(batch, db, it->first, it->second, fWriteFixedParams);
+
+        if (fWriteFixedParams)
+            vWrittenParams.push_back(std::make_pair(it->first, it->second.sidechain.fixedParams));
+        else if (it->second.flag == CSidechainsCacheEntry::Flags::ERASED)
+            vErasedParams.push_back(it->first);
+
         CSidechainsMap::iterator itOld = it++;
         mapSidechains.erase(itOld);
     }
 
+    std::vector<std::pair<int, CSidechainEventsCacheEntry>> vScEvents;
     for (CSidechainEventsMap::iterator it = mapSidechainEvents.begin(); it != mapSidechainEvents.end();) {
         BatchCeasedScs(batch, it->first, it->second);
+        if (it->second.flag != CSidechainEventsCacheEntry::Flags::DEFAULT)
+            vScEvents.push_back(*it);
         CSidechainEventsMap::iterator itOld = it++;
         mapSidechainEvents.erase(itOld);
     }
     
     for (CCswNullifiersMap::iterator it = cswNullifies.begin(); it != cswNullifies.end();) {
-        const std::pair<uint256, CFieldElement>& position = it->first;
+        const std::pair<uint256, CCompactFieldElement>& position = it->first;
         BatchWriteCswNullifier(batch, position.first, position.second, it->second);
+        // added before the write, the filter must never miss a nullifier in the db
+        if (it->second.flag == CCswNullifiersCacheEntry::Flags::FRESH)
+        {
+            LOCK(cs_cswNullifierFilter);
+            cswNullifierFilter.Insert(position.first, position.second);
+        }
         CCswNullifiersMap::iterator itOld = it++;
         cswNullifies.erase(itOld);
     }
@@ -276,7 +616,28 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
         BatchWriteHashBestAnchor(batch, hashAnchor);
 
     LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
-    return db.WriteBatch(batch);
+    if (!db.WriteBatch(batch))
+        return false;
+
+    {
+        LOCK(cs_fixedParams);
+        for (const uint256& scId : vErasedParams)
+            mapFixedParams.erase(scId);
+    }
+    for (const auto& entry : vWrittenParams)
+        CacheScFixedParams(entry.first, entry.second);
+
+    {
+        LOCK(cs_scEvents);
+        for (const auto& entry : vScEvents)
+        {
+            if (entry.second.flag == CSidechainEventsCacheEntry::Flags::ERASED)
+                mapSidechainEventsByHeight.erase(entry.first);
+            else
+                mapSidechainEventsByHeight[entry.first] = entry.second.scEvents;
+        }
+    }
+    return true;
 }
 
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
@@ -382,6 +743,267 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
     return true;
 }
 
+//! Records of the chainstate db as stored by leveldb, serialized key and value
+typedef std::vector<std::pair<std::vector<unsigned char>, std::vector<unsigned char> > > CSnapshotChunk;
+
+static void WriteSnapshotChunk(CAutoFile& fileout, const CSnapshotChunk& chunk, CHashWriter& hasherCommitment)
+{
+    const uint256 checksum = SerializeHash(chunk);
+    fileout << chunk << checksum;
+    hasherCommitment << checksum;
+}
+
+static bool LoadSnapshotChunk(CLevelDBWrapper& db, const CSnapshotChunk& chunk, const uint256& checksum)
+{
+    if (SerializeHash(chunk) != checksum)
+        return error("%s: chunk checksum mismatch", __func__);
+
+    CLevelDBBatch batch;
+    for (const auto& record : chunk)
+    {
+        // the best block and anchor are written once the whole snapshot is in
+        if (record.first.size() == 1 && (record.first[0] == DB_BEST_BLOCK || record.first[0] == DB_BEST_ANCHOR))
+            continue;
+        batch.WriteRaw(leveldb::Slice((const char*)record.first.data(), record.first.size()),
+                       leveldb::Slice((const char*)record.second.data(), record.second.size()));
+    }
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::DumpSnapshot(const std::string& fileName, CChainstateSnapshotInfo& info) const
+{
+    // leveldb iterators read from an implicit snapshot of the db, which can keep changing meanwhile
+    std::unique_ptr<leveldb::Iterator> it(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
+
+    CChainstateSnapshotHeader header;
+    auto readHash = [&it](char key, uint256& value)
+    {
+        it->Seek(leveldb::Slice(&key, 1));
+        if (!it->Valid() || it->key() != leveldb::Slice(&key, 1))
+            return false;
+        CDataStream ssValue(it->value().data(), it->value().data() + it->value().size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> value;
+        return true;
+    };
+    if (!readHash(DB_BEST_BLOCK, header.hashBlock))
+        return error("%s: no best block in chainstate", __func__);
+    if (!readHash(DB_BEST_ANCHOR, header.hashAnchor))
+        header.hashAnchor = ZCIncrementalMerkleTree::empty_root();
+
+    // written aside and renamed once complete, not to leave a truncated snapshot around
+    boost::filesystem::path pathSnapshot(fileName);
+    boost::filesystem::path pathTmp = pathSnapshot;
+    pathTmp += ".new";
+
+    CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: failed to open file %s", __func__, pathTmp.string());
+
+    CHashWriter hasherCommitment(SER_GETHASH, PROTOCOL_VERSION);
+    try {
+        fileout << FLATDATA(Params().MessageStart()) << header;
+        hasherCommitment << header;
+
+        CSnapshotChunk chunk;
+        for (it->SeekToFirst(); it->Valid(); it->Next())
+        {
+            boost::this_thread::interruption_point();
+
+            const leveldb::Slice slKey = it->key();
+            const leveldb::Slice slValue = it->value();
+            chunk.push_back(std::make_pair(std::vector<unsigned char>(slKey.data(), slKey.data() + slKey.size()),
+                                           std::vector<unsigned char>(slValue.data(), slValue.data() + slValue.size())));
+            info.nRecords++;
+
+            if (chunk.size() == CChainstateSnapshotHeader::MAX_CHUNK_RECORDS)
+            {
+                WriteSnapshotChunk(fileout, chunk, hasherCommitment);
+                info.nChunks++;
+                chunk.clear();
+            }
+        }
+        if (!chunk.empty())
+        {
+            WriteSnapshotChunk(fileout, chunk, hasherCommitment);
+            info.nChunks++;
+        }
+
+        // an empty chunk closes the sequence
+        WriteSnapshotChunk(fileout, CSnapshotChunk(), hasherCommitment);
+        info.hashCommitment = hasherCommitment.GetHash();
+        fileout << info.hashCommitment;
+    } catch (const std::exception& e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    if (!RenameOver(pathTmp, pathSnapshot))
+        return error("%s: rename of %s failed", __func__, pathTmp.string());
+
+    info.hashBlock = header.hashBlock;
+    LogPrintf("%s: %d records in %d chunks for block %s, commitment %s\n", __func__,
+        info.nRecords, info.nChunks, info.hashBlock.ToString(), info.hashCommitment.ToString());
+    return true;
+}
+
+/**
+ * Reads the chunks of a snapshot file and writes their records to the db, with the exception of the best block
+ * and anchor. It returns the header of the snapshot and sets the commitment computed over the file in info.
+ */
+static bool LoadSnapshotChunks(CLevelDBWrapper& db, const std::string& fileName, CChainstateSnapshotHeader& header, CChainstateSnapshotInfo& info)
+{
+    CAutoFile filein(fopen(fileName.c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: failed to open file %s", __func__, fileName);
+
+    CHashWriter hasherCommitment(SER_GETHASH, PROTOCOL_VERSION);
+    const size_t nThreads = std::max(1, GetNumCores());
+    uint256 hashFileCommitment;
+    try {
+        unsigned char pchMsgTmp[4];
+        filein >> FLATDATA(pchMsgTmp);
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            return error("%s: snapshot of a different network", __func__);
+
+        filein >> header;
+        if (header.nVersion != CChainstateSnapshotHeader::CURRENT_VERSION)
+            return error("%s: unsupported snapshot version %d", __func__, header.nVersion);
+        hasherCommitment << header;
+
+        bool fLastChunk = false;
+        while (!fLastChunk)
+        {
+            boost::this_thread::interruption_point();
+
+            // the file is read in sequence, then the chunks are checked and written in parallel,
+            // leveldb grouping the concurrent batches in its log
+            std::vector<std::pair<CSnapshotChunk, uint256> > vChunks;
+            while (vChunks.size() < nThreads)
+            {
+                CSnapshotChunk chunk;
+                uint256 checksum;
+                filein >> chunk >> checksum;
+                hasherCommitment << checksum;
+                if (chunk.empty())
+                {
+                    fLastChunk = true;
+                    break;
+                }
+                vChunks.push_back(std::make_pair(std::move(chunk), checksum));
+            }
+
+            std::vector<std::future<bool> > vResults;
+            for (const auto& chunk : vChunks)
+                vResults.push_back(std::async(std::launch::async, LoadSnapshotChunk, std::ref(db), std::cref(chunk.first), std::cref(chunk.second)));
+
+            bool fOk = true;
+            for (auto& result : vResults)
+                fOk = result.get() && fOk;
+            if (!fOk)
+                return error("%s: corrupted snapshot", __func__);
+
+            for (const auto& chunk : vChunks)
+                info.nRecords += chunk.first.size();
+            info.nChunks += vChunks.size();
+        }
+
+        filein >> hashFileCommitment;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    info.hashCommitment = hasherCommitment.GetHash();
+    if (hashFileCommitment != info.hashCommitment)
+        return error("%s: snapshot commitment mismatch", __func__);
+    return true;
+}
+
+bool CCoinsViewDB::LoadSnapshot(const std::string& fileName, const uint256& hashExpectedCommitment, CChainstateSnapshotInfo& info)
+{
+    {
+        // nothing but the flags written when the db is opened
+        std::unique_ptr<leveldb::Iterator> it(db.NewIterator());
+        for (it->SeekToFirst(); it->Valid(); it->Next())
+        {
+            if (it->key()[0] != DB_FLAG)
+                return error("%s: the chainstate is not empty", __func__);
+        }
+    }
+
+    // if the node stops before the load is over, the records written so far are wiped on the next start
+    if (!db.Write(make_pair(DB_FLAG, SNAPSHOT_LOADING_FLAG), '1', true))
+        return error("%s: failed to write the loading flag", __func__);
+
+    CChainstateSnapshotHeader header;
+    if (!LoadSnapshotChunks(db, fileName, header, info))
+    {
+        WipeSnapshotRecords();
+        return false;
+    }
+
+    // the commitment of the file only proves its integrity, the one of the expected chainstate comes from elsewhere
+    if (info.hashCommitment != hashExpectedCommitment)
+    {
+        WipeSnapshotRecords();
+        return error("%s: snapshot commitment %s, expected %s", __func__,
+            info.hashCommitment.ToString(), hashExpectedCommitment.ToString());
+    }
+
+    // from now on the chainstate is at the snapshot block
+    CLevelDBBatch batch;
+    BatchWriteHashBestChain(batch, header.hashBlock);
+    BatchWriteHashBestAnchor(batch, header.hashAnchor);
+    batch.Erase(make_pair(DB_FLAG, SNAPSHOT_LOADING_FLAG));
+    if (!db.WriteBatch(batch, true))
+    {
+        WipeSnapshotRecords();
+        return error("%s: failed to write the best block", __func__);
+    }
+
+    {
+        LOCK(cs_fixedParams);
+        mapFixedParams.clear();
+    }
+    LoadCswNullifierFilter();
+    LoadSidechainEvents();
+
+    info.hashBlock = header.hashBlock;
+    LogPrintf("%s: %d records in %d chunks for block %s, commitment %s\n", __func__,
+        info.nRecords, info.nChunks, info.hashBlock.ToString(), info.hashCommitment.ToString());
+    return true;
+}
+
+bool CCoinsViewDB::WipeSnapshotRecords()
+{
+    LogPrintf("%s: wiping the records of an incomplete chainstate snapshot\n", __func__);
+
+    // the iterator reads from an implicit snapshot of the db, unaffected by the erasures
+    std::unique_ptr<leveldb::Iterator> it(db.NewIterator());
+    CLevelDBBatch batch;
+    size_t count = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next())
+    {
+        if (it->key()[0] == DB_FLAG)
+            continue;
+
+        batch.EraseRaw(it->key());
+        if (++count % CChainstateSnapshotHeader::MAX_CHUNK_RECORDS == 0)
+        {
+            if (!db.WriteBatch(batch))
+                return error("%s: failed to erase the records", __func__);
+            batch.Clear();
+        }
+    }
+
+    batch.Erase(make_pair(DB_FLAG, SNAPSHOT_LOADING_FLAG));
+    if (!db.WriteBatch(batch, true))
+        return error("%s: failed to erase the records", __func__);
+
+    LogPrintf("%s: erased %d records\n", __func__, count);
+    return true;
+}
+
 void CCoinsViewDB::Dump_info()  const
 {
     // dump leveldb contents on stdout
@@ -397,10 +1019,9 @@ void CCoinsViewDB::Dump_info()  const
 
         if (chType == DB_SIDECHAINS)
         {
-            leveldb::Slice slValue = it->value();
-            CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
             CSidechain info;
-            ssValue >> info;
+            if (!GetSidechain(keyScId, info))
+                continue;
 
             std::cout
                 << "scId[" << keyScId.ToString() << "]" << std::endl
@@ -8,6 +8,8 @@
 
 #include "coins.h"
 #include "leveldbwrapper.h"
+#include "sc/cswnullifierfilter.h"
+#include "sync.h"
 
 #include <map>
 #include <string>
@@ -26,6 +28,33 @@ static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
 
+/**
+ * Header of a chainstate snapshot file. It is followed by chunks of db records, each one with the hash of
+ * its records, by an empty chunk and by the hash of the header and of the checksums of all the chunks.
+ */
+class CChainstateSnapshotHeader
+{
+public:
+    static const uint32_t CURRENT_VERSION = 1;
+    //! Max number of db records in a chunk
+    static const size_t MAX_CHUNK_RECORDS = 10000;
+
+    uint32_t nVersion;
+    uint256 hashBlock;
+    uint256 hashAnchor;
+
+    CChainstateSnapshotHeader() : nVersion(CURRENT_VERSION) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(this->nVersion);
+        READWRITE(hashBlock);
+        READWRITE(hashAnchor);
+    }
+};
+
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
@@ -44,6 +73,8 @@ public:
     bool HaveSidechainEvents(int height)                                 const override;
     bool GetSidechainEvents(int height, CSidechainEvents& ceasingScs)    const override;
     void GetScIds(std::set<uint256>& scIdsList)                          const override;
+    void GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                           std::vector<CSidechainIndexEntry>& entries) const override;
     uint256 GetBestBlock()                                               const override;
     uint256 GetBestAnchor()                                              const override;
     bool HaveCswNullifier(const uint256& scId,
@@ -58,7 +89,46 @@ public:
                     CSidechainEventsMap& mapSidechainEvents,
                     CCswNullifiersMap& cswNullifies)                           override;
     bool GetStats(CCoinsStats &stats)                                    const override;
+    bool DumpSnapshot(const std::string& fileName, CChainstateSnapshotInfo& info) const override;
     void Dump_info() const;
+
+    //! Fills an empty chainstate with the content of a snapshot file written by DumpSnapshot, if its commitment is the expected one
+    bool LoadSnapshot(const std::string& fileName, const uint256& hashExpectedCommitment, CChainstateSnapshotInfo& info);
+
+private:
+    //! Throws if the chainstate was written with a newer format than the one of this version
+    void CheckFormatVersion() const;
+    //! Stores the format of this version, once the chainstate has been upgraded to it
+    void WriteFormatVersion();
+    //! Erases all the records but the flags, as left by a snapshot load that did not complete
+    bool WipeSnapshotRecords();
+    //! Builds the sidechain index, if missing in a chainstate written by a previous version
+    void BuildSidechainIndex();
+    //! Moves the fixed params of the sidechains to their own key, if the chainstate was written by a previous version
+    void SplitSidechainRecords();
+    //! Fills the CSW nullifiers prefilter with the nullifiers already in the db
+    void LoadCswNullifierFilter();
+    //! Loads the sidechain events scheduled at the heights to come
+    void LoadSidechainEvents();
+
+    //! Max number of sidechain creation parameters kept in memory
+    static const size_t MAX_CACHED_SC_FIXED_PARAMS = 1000;
+
+    //! Creation parameters read from or written to the db. They never change, so they can be served from here
+    mutable CCriticalSection cs_fixedParams;
+    mutable std::map<uint256, Sidechain::ScFixedParameters> mapFixedParams;
+
+    bool GetScFixedParams(const uint256& scId, Sidechain::ScFixedParameters& params) const;
+    void CacheScFixedParams(const uint256& scId, const Sidechain::ScFixedParameters& params) const;
+
+    //! Sidechain events by height, a copy of the ones in the db. They are looked up at each block connection
+    //! and there are few of them, since the events of a height are erased once the block at that height is connected
+    mutable CCriticalSection cs_scEvents;
+    std::map<int, CSidechainEvents> mapSidechainEventsByHeight;
+
+    //! Every CSW nullifier in the db is in the filter, so the db is looked up only for the ones it may contain
+    mutable CCriticalSection cs_cswNullifierFilter;
+    CCswNullifierFilter cswNullifierFilter;
 };
 
 /** Access to the block database (blocks/index/) */
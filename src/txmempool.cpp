@@ -17,15 +17,63 @@
 #include "validationinterface.h"
 #include <undo.h>
 
+#include <cmath>
+#include <limits>
+
 CMemPoolEntry::CMemPoolEntry():
-    nFee(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0)
+    nFee(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0), nFeeDelta(0)
 {
     nHeight = MEMPOOL_HEIGHT;
+    InitAggregates(0);
 }
 
 CMemPoolEntry::CMemPoolEntry(const CAmount& _nFee, int64_t _nTime, double _dPriority, unsigned int _nHeight) :
-    nFee(_nFee), nModSize(0), nUsageSize(0), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight)
+    nFee(_nFee), nModSize(0), nUsageSize(0), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight), nFeeDelta(0)
+{
+    InitAggregates(0);
+}
+
+void CMemPoolEntry::InitAggregates(size_t nSize)
+{
+    nCountWithAncestors     = 1;
+    nSizeWithAncestors      = nSize;
+    nModFeesWithAncestors   = GetModifiedFee();
+    nCountWithDescendants   = 1;
+    nSizeWithDescendants    = nSize;
+    nModFeesWithDescendants = GetModifiedFee();
+}
+
+CFeeRate CMemPoolEntry::GetAncestorScore() const
+{
+    return std::min(GetModifiedFeeRate(), CFeeRate(nModFeesWithAncestors, nSizeWithAncestors));
+}
+
+CFeeRate CMemPoolEntry::GetDescendantScore() const
+{
+    return std::max(GetModifiedFeeRate(), CFeeRate(nModFeesWithDescendants, nSizeWithDescendants));
+}
+
+void CMemPoolEntry::UpdateFeeDelta(CAmount newFeeDelta)
+{
+    nModFeesWithAncestors   += newFeeDelta - nFeeDelta;
+    nModFeesWithDescendants += newFeeDelta - nFeeDelta;
+    nFeeDelta = newFeeDelta;
+}
+
+void CMemPoolEntry::UpdateAncestorState(int64_t modifyCount, int64_t modifySize, CAmount modifyFee)
 {
+    nCountWithAncestors   += modifyCount;
+    nSizeWithAncestors    += modifySize;
+    nModFeesWithAncestors += modifyFee;
+    assert(int64_t(nCountWithAncestors) > 0);
+}
+
+void CMemPoolEntry::UpdateDescendantState(int64_t modifyCount, int64_t modifySize, CAmount modifyFee)
+{
+    nCountWithDescendants   += modifyCount;
+    nSizeWithDescendants    += modifySize;
+    nModFeesWithDescendants += modifyFee;
+    assert(int64_t(nCountWithDescendants) > 0);
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(): nTxSize(0), hadNoDependencies(false)
@@ -41,6 +89,7 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     nTxSize = tx.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
     nModSize = tx.CalculateModifiedSize(nTxSize);
     nUsageSize = RecursiveDynamicUsage(tx);
+    InitAggregates(nTxSize);
 }
 
 double CTxMemPoolEntry::GetPriority(unsigned int currentHeight) const
@@ -66,6 +115,7 @@ CCertificateMemPoolEntry::CCertificateMemPoolEntry(const CScCertificate& _cert,
     nCertificateSize = cert.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
     nModSize = cert.CalculateModifiedSize(nCertificateSize);
     nUsageSize = RecursiveDynamicUsage(cert);
+    InitAggregates(nCertificateSize);
 }
 
 double CCertificateMemPoolEntry::GetPriority(unsigned int currentHeight) const
@@ -78,40 +128,56 @@ double CCertificateMemPoolEntry::GetPriority(unsigned int currentHeight) const
     return dResult;
 }
 
-const std::map<int64_t, uint256>::const_reverse_iterator CSidechainMemPoolEntry::GetTopQualityCert() const
+const std::map<CCertEpochAndQuality, uint256>::const_reverse_iterator CSidechainMemPoolEntry::GetTopQualityCert() const
 {
     return mBackwardCertificates.crbegin();
 }
 
+void CSidechainMemPoolEntry::AddCert(const uint256& hash, int32_t epoch, int64_t quality)
+{
+    const CCertEpochAndQuality position = std::make_pair(epoch, quality);
+    assert(mBackwardCertificates.count(position) == 0);
+    mBackwardCertificates[position] = hash;
+    mCertPositions[hash] = position;
+}
+
 void CSidechainMemPoolEntry::EraseCert(const uint256& hash)
 {
-    for(auto it = mBackwardCertificates.begin(); it != mBackwardCertificates.end(); )
-    {
-        if(it->second == hash)
-        {
-            LogPrint("mempool", "%s():%d - removing cert [%s] from mBackwardCertificates\n",
-                __func__, __LINE__, hash.ToString());
-            it = mBackwardCertificates.erase(it);
-        }
-        else
-            ++it;
-    }
+    auto it = mCertPositions.find(hash);
+    if (it == mCertPositions.end())
+        return;
+
+    LogPrint("mempool", "%s():%d - removing cert [%s] from mBackwardCertificates\n",
+        __func__, __LINE__, hash.ToString());
+    mBackwardCertificates.erase(it->second);
+    mCertPositions.erase(it);
 }
 
-const std::map<int64_t, uint256>::const_iterator CSidechainMemPoolEntry::GetCert(const uint256& hash) const
+const std::map<CCertEpochAndQuality, uint256>::const_iterator CSidechainMemPoolEntry::GetCert(const uint256& hash) const
 {
-    // Find certificate with given hash in mapSidechains
-    return std::find_if(mBackwardCertificates.begin( ), mBackwardCertificates.end(),
-        [&hash](const std::map<int64_t, uint256>::value_type& item) { return hash == item.second; });
+    auto it = mCertPositions.find(hash);
+    if (it == mCertPositions.end())
+        return mBackwardCertificates.end();
+    return mBackwardCertificates.find(it->second);
 }
 
 bool CSidechainMemPoolEntry::HasCert(const uint256& hash) const
 {
-    return GetCert(hash) != mBackwardCertificates.end();
+    return mCertPositions.count(hash) != 0;
+}
+
+std::vector<uint256> CSidechainMemPoolEntry::GetCertsUpToQuality(int32_t epoch, int64_t quality) const
+{
+    std::vector<uint256> res;
+    auto itBegin = mBackwardCertificates.lower_bound(std::make_pair(epoch, std::numeric_limits<int64_t>::min()));
+    auto itEnd   = mBackwardCertificates.upper_bound(std::make_pair(epoch, quality));
+    for(auto it = itBegin; it != itEnd; ++it)
+        res.push_back(it->second);
+    return res;
 }
 
 CTxMemPool::CTxMemPool(const CFeeRate& _minRelayFee) :
-    nTransactionsUpdated(0), nCertificatesUpdated(0), cachedInnerUsage(0)
+    nTransactionsUpdated(0), nCertificatesUpdated(0), cachedInnerUsage(0), minReasonableRelayFee(_minRelayFee)
 {
     // Sanity checks off by default for performance, because otherwise
     // accepting transactions becomes O(N^2) where N is the number
@@ -203,6 +269,11 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     cachedInnerUsage += entry.DynamicMemoryUsage();
     minerPolicyEstimator->processTransaction(entry, fCurrentEstimate);
 
+    // the tx may have been prioritised before entering the mempool
+    if (mapDeltas.count(hash))
+        mapTx[hash].UpdateFeeDelta(mapDeltas.at(hash).second);
+    UpdateForAdd(hash);
+
     return true;
 }
 
@@ -221,13 +292,15 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CCertificateMemPoolEntr
     LogPrint("mempool", "%s():%d - adding cert [%s] q=%d in mapSidechain\n", __func__, __LINE__,
         cert.GetHash().ToString(), cert.quality);
 
-    if (mapSidechains.count(cert.GetScId())!= 0)
-        assert(mapSidechains.at(cert.GetScId()).mBackwardCertificates.count(cert.quality) == 0);
-    mapSidechains[cert.GetScId()].mBackwardCertificates[cert.quality] = hash;
+    mapSidechains[cert.GetScId()].AddCert(hash, cert.epochNumber, cert.quality);
            
     nCertificatesUpdated++;
     totalCertificateSize += entry.GetCertificateSize();
     cachedInnerUsage += entry.DynamicMemoryUsage();
+
+    if (mapDeltas.count(hash))
+        mapCertificate[hash].UpdateFeeDelta(mapDeltas.at(hash).second);
+    UpdateForAdd(hash);
     // TODO cert: for the time being skip the part on policy estimator, certificates currently have maximum priority
     // minerPolicyEstimator->processTransaction(entry, fCurrentEstimate);
     LogPrint("mempool", "%s():%d - cert [%s] added in mempool\n", __func__, __LINE__, hash.ToString() );
@@ -275,6 +348,8 @@ std::vector<uint256> CTxMemPool::mempoolDependenciesFrom(const CTransactionBase&
     AssertLockHeld(cs);
     std::vector<uint256> res = mempoolDirectDependenciesFrom(originTx);
     std::deque<uint256> toVisit{res.begin(), res.end()};
+    // every node ever queued, so that each one is visited once with no linear lookup
+    std::set<uint256> queued{res.begin(), res.end()};
     res.clear();
 
     while(!toVisit.empty())
@@ -289,13 +364,11 @@ std::vector<uint256> CTxMemPool::mempoolDependenciesFrom(const CTransactionBase&
             assert(pCurrentNode);
 
         toVisit.pop_back();
-        if (std::find(res.begin(), res.end(), pCurrentNode->GetHash()) == res.end())
-            res.push_back(pCurrentNode->GetHash());
+        res.push_back(pCurrentNode->GetHash());
 
         std::vector<uint256> directAncestors = mempoolDirectDependenciesFrom(*pCurrentNode);
         for(const uint256& ancestor : directAncestors) {
-            if ( (std::find(toVisit.begin(), toVisit.end(), ancestor) == toVisit.end()) &&
-                 (std::find(res.begin(), res.end(), ancestor) == res.end()))
+            if (queued.insert(ancestor).second)
                 toVisit.push_front(ancestor);
         }
     }
@@ -349,6 +422,8 @@ std::vector<uint256> CTxMemPool::mempoolDependenciesOf(const CTransactionBase& o
     AssertLockHeld(cs);
     std::vector<uint256> res = mempoolDirectDependenciesOf(origTx);
     std::deque<uint256> toVisit{res.begin(), res.end()};
+    // every node ever queued, so that each one is visited once with no linear lookup
+    std::set<uint256> queued{res.begin(), res.end()};
     res.clear();
 
     while(!toVisit.empty())
@@ -363,13 +438,11 @@ std::vector<uint256> CTxMemPool::mempoolDependenciesOf(const CTransactionBase& o
             assert(pCurrentRoot);
 
         toVisit.pop_front();
-        if (std::find(res.begin(), res.end(), pCurrentRoot->GetHash()) == res.end())
-            res.push_back(pCurrentRoot->GetHash());
+        res.push_back(pCurrentRoot->GetHash());
 
         std::vector<uint256> directDescendants = mempoolDirectDependenciesOf(*pCurrentRoot);
         for(const uint256& dep : directDescendants)
-            if ((std::find(toVisit.begin(), toVisit.end(),dep) == toVisit.end()) &&
-                (std::find(res.begin(), res.end(),dep) == res.end()))
+            if (queued.insert(dep).second)
                 toVisit.push_front(dep);
     }
 
@@ -386,6 +459,8 @@ void CTxMemPool::remove(const CTransactionBase& origTx, std::list<CTransaction>&
         objToRemove = mempoolDependenciesOf(origTx);
 
     objToRemove.insert(objToRemove.begin(), origTx.GetHash());
+    // a recursive removal takes along all the descendants, no entry staying in mempool has its ancestors changed
+    UpdateForRemove(objToRemove, /*fUpdateDescendants*/!fRecursive);
 
     for(const uint256& hash : objToRemove)
     {
@@ -454,6 +529,7 @@ void CTxMemPool::remove(const CTransactionBase& origTx, std::list<CTransaction>&
 
             LogPrint("mempool", "%s():%d - removing tx [%s] from mempool\n", __func__, __LINE__, hash.ToString() );
             mapTx.erase(hash);
+            scTxsCommitmentBuilder.remove(hash);
 
             nTransactionsUpdated++;
             minerPolicyEstimator->removeTx(hash);
@@ -482,6 +558,7 @@ void CTxMemPool::remove(const CTransactionBase& origTx, std::list<CTransaction>&
             cachedInnerUsage -= mapCertificate[hash].DynamicMemoryUsage();
             LogPrint("mempool", "%s():%d - removing cert [%s] from mempool\n", __func__, __LINE__, hash.ToString() );
             mapCertificate.erase(hash);
+            scTxsCommitmentBuilder.remove(hash);
             nCertificatesUpdated++;
         }
     }
@@ -817,6 +894,10 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
                                 std::list<CTransaction>& conflictingTxs, std::list<CScCertificate>& conflictingCerts, bool fCurrentEstimate)
 {
     LOCK(cs);
+    // the rolling minimum fee rate starts decaying
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = true;
+
     std::vector<CTxMemPoolEntry> entries;
     for(const CTransaction& tx: vtx)
     {
@@ -860,27 +941,16 @@ void CTxMemPool::removeConflicts(const CScCertificate &cert, std::list<CTransact
 
     // cert has been confirmed in a block, therefore any other cert in mempool for this scid
     // with equal or lower quality is deemed conflicting and must be removed
-    std::set<uint256> lowerQualCerts;
-    for (auto entry :  mapSidechains.at(cert.GetScId()).mBackwardCertificates)
-    {
-        const uint256& memPoolCertHash = entry.second;
-        const CScCertificate& memPoolCert = mapCertificate.at(memPoolCertHash).GetCertificate();
-
-        if (memPoolCert.epochNumber == cert.epochNumber && memPoolCert.quality <= cert.quality)
-        {
-            LogPrint("mempool", "%s():%d - mempool cert[%s] q=%d conflicting with cert[%s] q=%d\n",
-                __func__, __LINE__, memPoolCertHash.ToString(), memPoolCert.quality, cert.GetHash().ToString(), cert.quality);
-            lowerQualCerts.insert(memPoolCert.GetHash());
-        }
-    }
-
+    std::vector<uint256> lowerQualCerts = mapSidechains.at(scId).GetCertsUpToQuality(cert.epochNumber, cert.quality);
     for(const auto& hash: lowerQualCerts)
     {
         // there can be dependancy also between certs, so check that a cert is still in map during the loop
         if (mapCertificate.count(hash))
         {
-            const CScCertificate& cert = mapCertificate.at(hash).GetCertificate();
-            remove(cert, removedTxs, removedCerts, true);
+            const CScCertificate& memPoolCert = mapCertificate.at(hash).GetCertificate();
+            LogPrint("mempool", "%s():%d - mempool cert[%s] q=%d conflicting with cert[%s] q=%d\n",
+                __func__, __LINE__, hash.ToString(), memPoolCert.quality, cert.GetHash().ToString(), cert.quality);
+            remove(memPoolCert, removedTxs, removedCerts, true);
         }
     }
 }
@@ -902,6 +972,259 @@ void CTxMemPool::removeForBlock(const std::vector<CScCertificate>& vcert, unsign
     }
 }
 
+CMemPoolEntry* CTxMemPool::GetEntry(const uint256& hash)
+{
+    AssertLockHeld(cs);
+    std::map<uint256, CTxMemPoolEntry>::iterator itTx = mapTx.find(hash);
+    if (itTx != mapTx.end())
+        return &itTx->second;
+    std::map<uint256, CCertificateMemPoolEntry>::iterator itCert = mapCertificate.find(hash);
+    if (itCert != mapCertificate.end())
+        return &itCert->second;
+    return nullptr;
+}
+
+void CTxMemPool::IndexEntry(const uint256& hash, const CMemPoolEntry& entry)
+{
+    indexByFeeRate.insert(std::make_pair(entry.GetModifiedFeeRate(), hash));
+    indexByAncestorScore.insert(std::make_pair(entry.GetAncestorScore(), hash));
+    indexByDescendantScore.insert(std::make_pair(entry.GetDescendantScore(), hash));
+    indexByTime.insert(std::make_pair(entry.GetTime(), hash));
+}
+
+void CTxMemPool::UnindexEntry(const uint256& hash, const CMemPoolEntry& entry)
+{
+    // keys must be computed from the very same aggregates used upon indexing
+    indexByFeeRate.erase(std::make_pair(entry.GetModifiedFeeRate(), hash));
+    indexByAncestorScore.erase(std::make_pair(entry.GetAncestorScore(), hash));
+    indexByDescendantScore.erase(std::make_pair(entry.GetDescendantScore(), hash));
+    indexByTime.erase(std::make_pair(entry.GetTime(), hash));
+}
+
+void CTxMemPool::RecomputeAggregates(const uint256& hash, bool fAncestors, bool fDescendants)
+{
+    AssertLockHeld(cs);
+    CMemPoolEntry* pEntry = GetEntry(hash);
+    assert(pEntry != nullptr);
+    const CTransactionBase& obj = mapTx.count(hash) ? static_cast<const CTransactionBase&>(mapTx.at(hash).GetTx()) :
+                                                      static_cast<const CTransactionBase&>(mapCertificate.at(hash).GetCertificate());
+
+    UnindexEntry(hash, *pEntry);
+    if (fAncestors)
+    {
+        pEntry->UpdateAncestorState(1 - int64_t(pEntry->GetCountWithAncestors()),
+                                    int64_t(pEntry->GetSize()) - int64_t(pEntry->GetSizeWithAncestors()),
+                                    pEntry->GetModifiedFee() - pEntry->GetModFeesWithAncestors());
+        for(const uint256& ancestor: mempoolDependenciesFrom(obj))
+        {
+            const CMemPoolEntry* pAncestor = GetEntry(ancestor);
+            pEntry->UpdateAncestorState(1, pAncestor->GetSize(), pAncestor->GetModifiedFee());
+        }
+    }
+    if (fDescendants)
+    {
+        pEntry->UpdateDescendantState(1 - int64_t(pEntry->GetCountWithDescendants()),
+                                      int64_t(pEntry->GetSize()) - int64_t(pEntry->GetSizeWithDescendants()),
+                                      pEntry->GetModifiedFee() - pEntry->GetModFeesWithDescendants());
+        for(const uint256& descendant: mempoolDependenciesOf(obj))
+        {
+            const CMemPoolEntry* pDescendant = GetEntry(descendant);
+            pEntry->UpdateDescendantState(1, pDescendant->GetSize(), pDescendant->GetModifiedFee());
+        }
+    }
+    IndexEntry(hash, *pEntry);
+}
+
+void CTxMemPool::UpdateForAdd(const uint256& hash)
+{
+    AssertLockHeld(cs);
+    CMemPoolEntry* pEntry = GetEntry(hash);
+    assert(pEntry != nullptr);
+    const CTransactionBase& obj = mapTx.count(hash) ? static_cast<const CTransactionBase&>(mapTx.at(hash).GetTx()) :
+                                                      static_cast<const CTransactionBase&>(mapCertificate.at(hash).GetCertificate());
+
+    const std::vector<uint256> ancestors   = mempoolDependenciesFrom(obj);
+    const std::vector<uint256> descendants = mempoolDependenciesOf(obj);
+
+    if (!descendants.empty())
+    {
+        // the entry links entries already in mempool (e.g. a scCreation re-added upon block disconnection, whose fwds
+        // stayed in mempool): ancestors may gain more than one descendant and descendants more than one ancestor,
+        // while the ancestors of the former and the descendants of the latter are left as they are
+        IndexEntry(hash, *pEntry);
+        RecomputeAggregates(hash, /*fAncestors*/true, /*fDescendants*/true);
+        for(const uint256& ancestor: ancestors)
+            RecomputeAggregates(ancestor, /*fAncestors*/false, /*fDescendants*/true);
+        for(const uint256& descendant: descendants)
+            RecomputeAggregates(descendant, /*fAncestors*/true, /*fDescendants*/false);
+        return;
+    }
+
+    for(const uint256& ancestor: ancestors)
+    {
+        CMemPoolEntry* pAncestor = GetEntry(ancestor);
+        pEntry->UpdateAncestorState(1, pAncestor->GetSize(), pAncestor->GetModifiedFee());
+
+        UnindexEntry(ancestor, *pAncestor);
+        pAncestor->UpdateDescendantState(1, pEntry->GetSize(), pEntry->GetModifiedFee());
+        IndexEntry(ancestor, *pAncestor);
+    }
+    IndexEntry(hash, *pEntry);
+}
+
+void CTxMemPool::UpdateForRemove(const std::vector<uint256>& objToRemove, bool fUpdateDescendants)
+{
+    // Must be called while all of objToRemove are still in mempool: the entries staying in mempool lose
+    // the removed ones from their ancestors/descendants aggregates
+    AssertLockHeld(cs);
+    const std::set<uint256> setToRemove(objToRemove.begin(), objToRemove.end());
+
+    for(const uint256& hash : setToRemove)
+    {
+        const CMemPoolEntry* pEntry = GetEntry(hash);
+        if (pEntry == nullptr)
+            continue;
+        const CTransactionBase& obj = mapTx.count(hash) ? static_cast<const CTransactionBase&>(mapTx.at(hash).GetTx()) :
+                                                          static_cast<const CTransactionBase&>(mapCertificate.at(hash).GetCertificate());
+
+        for(const uint256& ancestor: mempoolDependenciesFrom(obj))
+        {
+            if (setToRemove.count(ancestor))
+                continue;
+            CMemPoolEntry* pAncestor = GetEntry(ancestor);
+            UnindexEntry(ancestor, *pAncestor);
+            pAncestor->UpdateDescendantState(-1, -int64_t(pEntry->GetSize()), -pEntry->GetModifiedFee());
+            IndexEntry(ancestor, *pAncestor);
+        }
+
+        if (fUpdateDescendants)
+        {
+            for(const uint256& descendant: mempoolDependenciesOf(obj))
+            {
+                if (setToRemove.count(descendant))
+                    continue;
+                CMemPoolEntry* pDescendant = GetEntry(descendant);
+                UnindexEntry(descendant, *pDescendant);
+                pDescendant->UpdateAncestorState(-1, -int64_t(pEntry->GetSize()), -pEntry->GetModifiedFee());
+                IndexEntry(descendant, *pDescendant);
+            }
+        }
+
+        UnindexEntry(hash, *pEntry);
+    }
+}
+
+void CTxMemPool::removeIfPresent(const uint256& hash, std::list<CTransaction>& removedTxs, std::list<CScCertificate>& removedCerts)
+{
+    AssertLockHeld(cs);
+    // there can be dependancy between entries, so the entry may have already been removed along with an ancestor
+    if (mapTx.count(hash))
+        remove(mapTx.at(hash).GetTx(), removedTxs, removedCerts, true);
+    else if (mapCertificate.count(hash))
+        remove(mapCertificate.at(hash).GetCertificate(), removedTxs, removedCerts, true);
+}
+
+int CTxMemPool::Expire(int64_t time, std::list<CTransaction>& removedTxs, std::list<CScCertificate>& removedCerts)
+{
+    LOCK(cs);
+    std::vector<uint256> toExpire;
+    for(CTimeIndex::const_iterator it = indexByTime.begin(); it != indexByTime.end() && it->first < time; ++it)
+        toExpire.push_back(it->second);
+
+    const size_t nTxsBefore   = removedTxs.size();
+    const size_t nCertsBefore = removedCerts.size();
+    for(const uint256& hash : toExpire)
+        removeIfPresent(hash, removedTxs, removedCerts);
+
+    nExpiredTxs   += removedTxs.size() - nTxsBefore;
+    nExpiredCerts += removedCerts.size() - nCertsBefore;
+
+    LogPrint("mempool", "%s():%d - expired %d txes and %d certs\n", __func__, __LINE__,
+        removedTxs.size() - nTxsBefore, removedCerts.size() - nCertsBefore);
+    return (removedTxs.size() - nTxsBefore) + (removedCerts.size() - nCertsBefore);
+}
+
+void CTxMemPool::TrimToSize(size_t sizelimit, std::list<CTransaction>& removedTxs, std::list<CScCertificate>& removedCerts)
+{
+    LOCK(cs);
+    if (DynamicMemoryUsage() <= sizelimit)
+        return;
+
+    const size_t nTxsBefore   = removedTxs.size();
+    const size_t nCertsBefore = removedCerts.size();
+    while (!indexByDescendantScore.empty() && DynamicMemoryUsage() > sizelimit)
+    {
+        const std::pair<CFeeRate, uint256> candidate = *indexByDescendantScore.begin();
+        if (GetEntry(candidate.second) == nullptr)
+        {
+            // should never happen
+            LogPrintf("%s():%d - ERROR: [%s] indexed but not in mempool\n", __func__, __LINE__, candidate.second.ToString());
+            indexByDescendantScore.erase(indexByDescendantScore.begin());
+            continue;
+        }
+        LogPrint("mempool", "%s():%d - evicting [%s] with descendant score %s and its descendants\n",
+            __func__, __LINE__, candidate.second.ToString(), candidate.first.ToString());
+        // what is accepted from now on must pay more than what has just been evicted
+        trackPackageRemoved(CFeeRate(candidate.first.GetFeePerK() + minReasonableRelayFee.GetFeePerK()));
+        removeIfPresent(candidate.second, removedTxs, removedCerts);
+    }
+
+    nEvictedTxs   += removedTxs.size() - nTxsBefore;
+    nEvictedCerts += removedCerts.size() - nCertsBefore;
+
+    LogPrint("mempool", "%s():%d - evicted %d txes and %d certs, usage is now %d (limit %d)\n", __func__, __LINE__,
+        removedTxs.size() - nTxsBefore, removedCerts.size() - nCertsBefore, DynamicMemoryUsage(), sizelimit);
+}
+
+void CTxMemPool::trackPackageRemoved(const CFeeRate& rate)
+{
+    AssertLockHeld(cs);
+    if (rate.GetFeePerK() > rollingMinimumFeeRate)
+    {
+        rollingMinimumFeeRate = rate.GetFeePerK();
+        blockSinceLastRollingFeeBump = false;
+    }
+}
+
+CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const
+{
+    LOCK(cs);
+    if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
+        return CFeeRate(llround(rollingMinimumFeeRate));
+
+    int64_t time = GetTime();
+    if (time > lastRollingFeeUpdate + 10)
+    {
+        double halflife = ROLLING_FEE_HALFLIFE;
+        if (DynamicMemoryUsage() < sizelimit / 4)
+            halflife /= 4;
+        else if (DynamicMemoryUsage() < sizelimit / 2)
+            halflife /= 2;
+
+        rollingMinimumFeeRate = rollingMinimumFeeRate / pow(2.0, (time - lastRollingFeeUpdate) / halflife);
+        lastRollingFeeUpdate = time;
+
+        if (rollingMinimumFeeRate < (double)minReasonableRelayFee.GetFeePerK() / 2)
+        {
+            rollingMinimumFeeRate = 0;
+            return CFeeRate(0);
+        }
+    }
+    return std::max(CFeeRate(llround(rollingMinimumFeeRate)), minReasonableRelayFee);
+}
+
+void CTxMemPool::UpdateEntryTime(const uint256& hash, int64_t nTime)
+{
+    LOCK(cs);
+    CMemPoolEntry* pEntry = GetEntry(hash);
+    if (pEntry == nullptr)
+        return;
+
+    UnindexEntry(hash, *pEntry);
+    pEntry->UpdateTime(nTime);
+    IndexEntry(hash, *pEntry);
+}
+
 void CTxMemPool::clear()
 {
     LOCK(cs);
@@ -910,9 +1233,17 @@ void CTxMemPool::clear()
     mapDeltas.clear();
     mapNextTx.clear();
     mapSidechains.clear();
+    indexByFeeRate.clear();
+    indexByAncestorScore.clear();
+    indexByDescendantScore.clear();
+    indexByTime.clear();
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = false;
+    rollingMinimumFeeRate = 0;
     totalTxSize = 0;
     totalCertificateSize = 0;
     cachedInnerUsage = 0;
+    scTxsCommitmentBuilder.clear();
     ++nTransactionsUpdated;
 }
 
@@ -1121,6 +1452,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         //certificate must be duly recorded in mapSidechain
         assert(mapSidechains.count(cert.GetScId()) != 0);
         assert(mapSidechains.at(cert.GetScId()).HasCert(cert.GetHash()) );
+        assert(mapSidechains.at(cert.GetScId()).GetCert(cert.GetHash())->first == std::make_pair(cert.epochNumber, cert.quality));
 
         bool fDependsWait = false;
         BOOST_FOREACH(const CTxIn &txin, cert.GetVin()) {
@@ -1450,6 +1782,32 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const std::string& s
         std::pair<double, CAmount> &deltas = mapDeltas[hash];
         deltas.first += dPriorityDelta;
         deltas.second += nFeeDelta;
+
+        // the fee delta reaches the aggregates of the entry and of its ancestors/descendants
+        CMemPoolEntry* pEntry = GetEntry(hash);
+        if (pEntry != nullptr && nFeeDelta != 0)
+        {
+            const CTransactionBase& obj = mapTx.count(hash) ? static_cast<const CTransactionBase&>(mapTx.at(hash).GetTx()) :
+                                                              static_cast<const CTransactionBase&>(mapCertificate.at(hash).GetCertificate());
+            UnindexEntry(hash, *pEntry);
+            pEntry->UpdateFeeDelta(deltas.second);
+            IndexEntry(hash, *pEntry);
+
+            for(const uint256& ancestor: mempoolDependenciesFrom(obj))
+            {
+                CMemPoolEntry* pAncestor = GetEntry(ancestor);
+                UnindexEntry(ancestor, *pAncestor);
+                pAncestor->UpdateDescendantState(0, 0, nFeeDelta);
+                IndexEntry(ancestor, *pAncestor);
+            }
+            for(const uint256& descendant: mempoolDependenciesOf(obj))
+            {
+                CMemPoolEntry* pDescendant = GetEntry(descendant);
+                UnindexEntry(descendant, *pDescendant);
+                pDescendant->UpdateAncestorState(0, 0, nFeeDelta);
+                IndexEntry(descendant, *pDescendant);
+            }
+        }
     }
     LogPrintf("PrioritiseTransaction: %s priority += %f, fee += %d\n", strHash, dPriorityDelta, FormatMoney(nFeeDelta));
 }
@@ -1613,6 +1971,29 @@ void CCoinsViewMemPool::GetScIds(std::set<uint256>& scIds) const {
     }
 }
 
+void CCoinsViewMemPool::GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                                          std::vector<CSidechainIndexEntry>& entries) const
+{
+    base->GetScIndexEntries(after, maxItems, bOnlyAlive, height, entries);
+
+    // sidechains whose creation is still in mempool are neither alive nor indexed: they follow the confirmed ones
+    if (bOnlyAlive || entries.size() >= maxItems)
+        return;
+
+    for (const auto& entry : mempool.mapSidechains)
+    {
+        if (entry.second.scCreationTxHash.IsNull())
+            continue;
+
+        CSidechainIndexEntry indexEntry(CSidechainIndexEntry::UNCONFIRMED_HEIGHT, entry.first, -1);
+        if (after < indexEntry)
+            entries.push_back(indexEntry);
+
+        if (entries.size() >= maxItems)
+            break;
+    }
+}
+
 bool CCoinsViewMemPool::HaveSidechain(const uint256& scId) const {
     return mempool.hasSidechainCreationTx(scId) || base->HaveSidechain(scId);
 }
@@ -1630,10 +2011,14 @@ size_t CTxMemPool::DynamicMemoryUsage() const {
           memusage::DynamicUsage(mapDeltas) +
           memusage::DynamicUsage(mapCertificate) +
           memusage::DynamicUsage(mapSidechains) +
+          memusage::DynamicUsage(indexByFeeRate) +
+          memusage::DynamicUsage(indexByAncestorScore) +
+          memusage::DynamicUsage(indexByDescendantScore) +
+          memusage::DynamicUsage(indexByTime) +
           cachedInnerUsage);
 }
 
-std::pair<uint256, CAmount> CTxMemPool::FindCertWithQuality(const uint256& scId, int64_t certQuality)
+std::pair<uint256, CAmount> CTxMemPool::FindCertWithQuality(const uint256& scId, int32_t epoch, int64_t certQuality)
 {
     LOCK(cs);
     std::pair<uint256, CAmount> res = std::make_pair(uint256(),CAmount(-1));
@@ -1641,14 +2026,12 @@ std::pair<uint256, CAmount> CTxMemPool::FindCertWithQuality(const uint256& scId,
     if (mapSidechains.count(scId) == 0)
         return res;
 
-    for(const auto& mempoolCertEntry : mapSidechains.at(scId).mBackwardCertificates)
+    const auto& certs = mapSidechains.at(scId).mBackwardCertificates;
+    auto it = certs.find(std::make_pair(epoch, certQuality));
+    if (it != certs.end())
     {
-        const CScCertificate& mempoolCert = mapCertificate.at(mempoolCertEntry.second).GetCertificate();
-        if (mempoolCert.quality == certQuality) {
-            res.first  = mempoolCert.GetHash();
-            res.second = mapCertificate.at(mempoolCertEntry.second).GetFee();
-            break;
-        }
+        res.first  = it->second;
+        res.second = mapCertificate.at(it->second).GetFee();
     }
 
     return res;
@@ -7,12 +7,14 @@
 #define BITCOIN_TXMEMPOOL_H
 
 #include <list>
+#include <set>
 
 #include "amount.h"
 #include "coins.h"
 #include "primitives/transaction.h"
 #include "primitives/certificate.h"
 #include "sync.h"
+#include "sc/sidechainTxsCommitmentBuilder.h"
 
 class CAutoFile;
 
@@ -43,15 +45,48 @@ protected:
     int64_t nTime; //! Local time when entering the mempool
     double dPriority; //! Priority when entering the mempool
     unsigned int nHeight; //! Chain height when entering the mempool
+    CAmount nFeeDelta; //! Fee delta set via prioritisetransaction
+
+    // Aggregates over the entry and its in-mempool ancestors (the txes/certs it spends from and the
+    // creation of the sidechains it sends to), and over the entry and its in-mempool descendants.
+    // They are kept up to date by CTxMemPool, which indexes the entries by them.
+    uint64_t nCountWithAncestors;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
+    uint64_t nCountWithDescendants;
+    uint64_t nSizeWithDescendants;
+    CAmount nModFeesWithDescendants;
+
+    void InitAggregates(size_t nSize);
 public:
     CMemPoolEntry();
     CMemPoolEntry(const CAmount& _nFee, int64_t _nTime, double _dPriority, unsigned int _nHeight);
     virtual ~CMemPoolEntry() = default;
     virtual double GetPriority(unsigned int currentHeight) const = 0;
+    virtual size_t GetSize() const = 0;
     CAmount GetFee() const { return nFee; }
+    CAmount GetModifiedFee() const { return nFee + nFeeDelta; }
     int64_t GetTime() const { return nTime; }
     unsigned int GetHeight() const { return nHeight; }
     size_t DynamicMemoryUsage() const { return nUsageSize; }
+
+    uint64_t GetCountWithAncestors() const { return nCountWithAncestors; }
+    uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
+    CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
+    uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
+    uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
+    CAmount GetModFeesWithDescendants() const { return nModFeesWithDescendants; }
+
+    CFeeRate GetModifiedFeeRate() const { return CFeeRate(GetModifiedFee(), GetSize()); }
+    //! Lower of the own and the ancestors package fee rates: what mining the entry actually yields
+    CFeeRate GetAncestorScore() const;
+    //! Higher of the own and the descendants package fee rates: what evicting the entry actually loses
+    CFeeRate GetDescendantScore() const;
+
+    void UpdateFeeDelta(CAmount newFeeDelta);
+    void UpdateTime(int64_t newTime) { nTime = newTime; }
+    void UpdateAncestorState(int64_t modifyCount, int64_t modifySize, CAmount modifyFee);
+    void UpdateDescendantState(int64_t modifyCount, int64_t modifySize, CAmount modifyFee);
 };
 
 /**
@@ -70,6 +105,7 @@ public:
 
     const CTransaction& GetTx() const { return this->tx; }
     double GetPriority(unsigned int currentHeight) const override;
+    size_t GetSize() const override { return nTxSize; }
     size_t GetTxSize() const { return nTxSize; }
     bool WasClearAtEntry() const { return hadNoDependencies; }
 };
@@ -87,6 +123,7 @@ public:
 
     const CScCertificate& GetCertificate() const { return this->cert; }
     double GetPriority(unsigned int currentHeight) const override;
+    size_t GetSize() const override { return nCertificateSize; }
     size_t GetCertificateSize() const { return nCertificateSize; }
 };
 
@@ -106,13 +143,18 @@ public:
     size_t DynamicMemoryUsage() const { return 0; }
 };
 
+//! Epoch and quality of a certificate, the order of the certificates of a sidechain in mempool
+typedef std::pair<int32_t, int64_t> CCertEpochAndQuality;
+
 struct CSidechainMemPoolEntry
 {
     uint256 scCreationTxHash;
     std::set<uint256> fwdTxHashes; 
-    std::map<int64_t, uint256> mBackwardCertificates; //quality -> certHash
+    // quality ladder of each epoch, the last cert being the top quality one of the latest epoch
+    std::map<CCertEpochAndQuality, uint256> mBackwardCertificates; //(epoch, quality) -> certHash
+    std::map<uint256, CCertEpochAndQuality> mCertPositions;        //certHash -> (epoch, quality)
     std::set<uint256> mcBtrsTxHashes;
-    std::map<CFieldElement, uint256> cswNullifiers; // csw nullifier -> containing Tx hash
+    std::map<CCompactFieldElement, uint256> cswNullifiers; // csw nullifier -> containing Tx hash
     CAmount cswTotalAmount;
 
     // Note: in fwdTxHashes and mcBtrsTxHashes, a tx is registered only once,
@@ -127,11 +169,15 @@ struct CSidechainMemPoolEntry
                 cswTotalAmount == 0;
     }
 
-    const std::map<int64_t, uint256>::const_reverse_iterator GetTopQualityCert() const;
-    const std::map<int64_t, uint256>::const_iterator GetCert(const uint256& hash) const;
+    const std::map<CCertEpochAndQuality, uint256>::const_reverse_iterator GetTopQualityCert() const;
+    const std::map<CCertEpochAndQuality, uint256>::const_iterator GetCert(const uint256& hash) const;
 
+    void AddCert(const uint256& hash, int32_t epoch, int64_t quality);
     void EraseCert(const uint256& hash);
     bool HasCert(const uint256& hash) const;
+
+    //! Hashes of the certs of the given epoch with quality up to the given one, by increasing quality
+    std::vector<uint256> GetCertsUpToQuality(int32_t epoch, int64_t quality) const;
 };
 
 /**
@@ -163,7 +209,30 @@ private:
     uint64_t nRecentlyAddedSequence = 0;
     uint64_t nNotifiedSequence = 0;
 
+    CFeeRate minReasonableRelayFee; //! the fee rate added to the one of evicted entries, to set the rolling minimum fee rate
+
+    mutable int64_t lastRollingFeeUpdate = 0;         //! time the rolling minimum fee rate was last decayed
+    mutable bool blockSinceLastRollingFeeBump = false; //! the rolling minimum fee rate only decays after a block
+    mutable double rollingMinimumFeeRate = 0;         //! satoshis per 1000 bytes, raised by TrimToSize
+
+    uint64_t nEvictedTxs = 0;   //! txes removed by TrimToSize, descendants included
+    uint64_t nEvictedCerts = 0; //! certs removed by TrimToSize, descendants included
+    uint64_t nExpiredTxs = 0;   //! txes removed by Expire, descendants included
+    uint64_t nExpiredCerts = 0; //! certs removed by Expire, descendants included
+
+    CMemPoolEntry* GetEntry(const uint256& hash);
+    void IndexEntry(const uint256& hash, const CMemPoolEntry& entry);
+    void UnindexEntry(const uint256& hash, const CMemPoolEntry& entry);
+    void RecomputeAggregates(const uint256& hash, bool fAncestors, bool fDescendants);
+    void UpdateForAdd(const uint256& hash);
+    //! fUpdateDescendants false when all the descendants of the removed entries are removed along with them
+    void UpdateForRemove(const std::vector<uint256>& objToRemove, bool fUpdateDescendants);
+    void removeIfPresent(const uint256& hash, std::list<CTransaction>& removedTxs, std::list<CScCertificate>& removedCerts);
+    void trackPackageRemoved(const CFeeRate& rate);
+
 public:
+    static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; //! seconds for the rolling minimum fee rate to halve
+
     mutable CCriticalSection cs;
     std::map<uint256, CTxMemPoolEntry> mapTx;
     std::map<uint256, CCertificateMemPoolEntry> mapCertificate;
@@ -172,6 +241,20 @@ public:
     std::map<uint256, const CTransaction*> mapNullifiers;
     std::map<uint256, std::pair<double, CAmount> > mapDeltas;
 
+    //! Txes and certs sorted by fee rate, lowest first, hash breaking ties
+    typedef std::set<std::pair<CFeeRate, uint256> > CFeeRateIndex;
+    CFeeRateIndex indexByFeeRate;         //! by modified fee rate
+    CFeeRateIndex indexByAncestorScore;   //! by CMemPoolEntry::GetAncestorScore(), walked backwards for block templates
+    CFeeRateIndex indexByDescendantScore; //! by CMemPoolEntry::GetDescendantScore(), walked forward for eviction
+
+    //! Txes and certs sorted by entry time, oldest first, walked forward for expiry
+    typedef std::set<std::pair<int64_t, uint256> > CTimeIndex;
+    CTimeIndex indexByTime;
+
+    //! Commitment tree of the last block template, extended incrementally by CreateNewBlock
+    //! and dropped as soon as one of its txes/certs leaves the mempool
+    IncrementalScTxsCommitmentBuilder scTxsCommitmentBuilder;
+
     CTxMemPool(const CFeeRate& _minRelayFee);
     ~CTxMemPool();
 
@@ -193,7 +276,7 @@ public:
 
     void setSanityCheck(bool _fSanityCheck) { fSanityCheck = _fSanityCheck; }
 
-    std::pair<uint256, CAmount> FindCertWithQuality(const uint256& scId, int64_t certQuality);
+    std::pair<uint256, CAmount> FindCertWithQuality(const uint256& scId, int32_t epoch, int64_t certQuality);
     bool RemoveCertAndSync(const uint256& certToRmHash);
 
     bool addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry, bool fCurrentEstimate = true);
@@ -229,6 +312,29 @@ public:
                                  std::list<CScCertificate>& outdatedCerts);
     // END OF UNCONFIRMED CERTIFICATES CLEANUP METHODS
 
+    // MEMPOOL SIZE LIMITING METHODS
+    /**
+     * @brief Removes the txes and certs that entered the mempool before time, together with their
+     * in-mempool descendants (txes spending their outputs, fwts/btrs to sidechains they create).
+     * @return the number of txes and certs removed
+     */
+    int Expire(int64_t time, std::list<CTransaction>& removedTxs, std::list<CScCertificate>& removedCerts);
+    /**
+     * @brief Evicts txes and certs, lowest descendant score first, until the dynamic memory usage is within sizelimit.
+     * Each eviction takes the in-mempool descendants along, and since the score of an entry is raised to the fee rate
+     * of its descendants package when higher, parents paid for by their children are kept.
+     */
+    void TrimToSize(size_t sizelimit, std::list<CTransaction>& removedTxs, std::list<CScCertificate>& removedCerts);
+    /**
+     * @brief The minimum fee rate to get into the mempool: after an eviction, the descendant score of the evicted
+     * entry plus the minimum relay fee rate, halving every ROLLING_FEE_HALFLIFE once a block is connected (faster
+     * when the mempool is well below sizelimit), down to 0 once it is under half the minimum relay fee rate.
+     */
+    CFeeRate GetMinFee(size_t sizelimit) const;
+    //! Sets the entry time of a tx or cert, as when reloading it from disk
+    void UpdateEntryTime(const uint256& hash, int64_t nTime);
+    // END OF MEMPOOL SIZE LIMITING METHODS
+
     void clear();
     void queryHashes(std::vector<uint256>& vtxid) const;
     void pruneSpent(const uint256& hash, CCoins &coins);
@@ -284,6 +390,11 @@ public:
         return (totalTxSize + totalCertificateSize);
     }
 
+    uint64_t GetEvictedTxs() const   { LOCK(cs); return nEvictedTxs; }
+    uint64_t GetEvictedCerts() const { LOCK(cs); return nEvictedCerts; }
+    uint64_t GetExpiredTxs() const   { LOCK(cs); return nExpiredTxs; }
+    uint64_t GetExpiredCerts() const { LOCK(cs); return nExpiredCerts; }
+
     bool existsTx(const uint256& hash) const
     {
         LOCK(cs);
@@ -367,6 +478,8 @@ public:
     bool GetSidechain(const uint256& scId, CSidechain& info)            const override;
     bool HaveSidechain(const uint256& scId)                             const override;
     void GetScIds(std::set<uint256>& scIdsList)                         const override;
+    void GetScIndexEntries(const CSidechainIndexEntry& after, size_t maxItems, bool bOnlyAlive, int height,
+                           std::vector<CSidechainIndexEntry>& entries) const override;
     bool HaveCswNullifier(const uint256& scId,
                           const CFieldElement &nullifier) const override;
 };
@@ -169,3 +169,10 @@ CWalletTx GetValidSpend(ZCJoinSplit& params,
     CWalletTx wtx {NULL, tx};
     return wtx;
 }
+
+CFieldElement GetRandomNullifier() {
+    // clear the most significant byte to get a valid field element
+    uint256 value = GetRandHash();
+    *(value.end() - 1) = 0x0;
+    return CFieldElement{value};
+}
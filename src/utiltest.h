@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "sc/sidechaintypes.h"
 #include "wallet/wallet.h"
 #include "zcash/JoinSplit.hpp"
 #include "zcash/Note.hpp"
@@ -24,3 +25,6 @@ CWalletTx GetValidSpend(ZCJoinSplit& params,
                               const libzcash::SpendingKey& sk,
                               const libzcash::Note& note,
                               CAmount value);
+
+//! A random valid field element, as the nullifier of a CSW input
+CFieldElement GetRandomNullifier();
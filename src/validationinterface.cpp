@@ -5,6 +5,17 @@
 
 #include "validationinterface.h"
 #include <primitives/certificate.h>
+#include "consensus/validation.h"
+#include "primitives/block.h"
+#include "util.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 static CMainSignals g_signals;
 
@@ -13,7 +24,284 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
+/**
+ * @brief The notifications pending for an asynchronous listener, delivered in order by a dedicated thread.
+ */
+class CValidationInterfaceQueue
+{
+public:
+    explicit CValidationInterfaceQueue(CValidationInterface* pListenerIn):
+        pListener(pListenerIn), fDelivering(false), fStopping(false)
+    {
+        thread = std::thread(&CValidationInterfaceQueue::ThreadDeliver, this);
+    }
+
+    ~CValidationInterfaceQueue() { Stop(); }
+
+    void Push(const std::function<void (CValidationInterface*)>& notification)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.push_back(notification);
+        }
+        condPushed.notify_one();
+    }
+
+    //! Wait until fewer than nSize notifications are pending, the one being delivered included
+    void WaitUntilBelow(size_t nSize)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        condDelivered.wait(lock, [this, nSize] { return queue.size() + (fDelivering ? 1 : 0) < nSize; });
+    }
+
+    //! Deliver the pending notifications and terminate the thread
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            fStopping = true;
+        }
+        condPushed.notify_one();
+        if (thread.joinable())
+            thread.join();
+    }
+
+private:
+    CValidationInterface* pListener;
+    std::deque<std::function<void (CValidationInterface*)> > queue;
+    bool fDelivering;
+    bool fStopping;
+    std::mutex mtx;
+    std::condition_variable condPushed;
+    std::condition_variable condDelivered;
+    std::thread thread;
+
+    void ThreadDeliver()
+    {
+        RenameThread("horizen-notify");
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true)
+        {
+            condPushed.wait(lock, [this] { return !queue.empty() || fStopping; });
+            if (queue.empty())
+                break;
+
+            std::function<void (CValidationInterface*)> notification = std::move(queue.front());
+            queue.pop_front();
+            fDelivering = true;
+            lock.unlock();
+            try {
+                notification(pListener);
+            } catch (const std::exception& e) {
+                LogPrintf("%s: exception delivering a notification: %s\n", __func__, e.what());
+            } catch (...) {
+                LogPrintf("%s: unknown exception delivering a notification\n", __func__);
+            }
+            lock.lock();
+            fDelivering = false;
+            condDelivered.notify_all();
+        }
+    }
+};
+
+/**
+ * @brief Single listener of the main signals on behalf of all the asynchronous listeners: it takes one immutable
+ * snapshot of the notified data, shared by the queues of all of them, so that emitting a signal costs a copy
+ * whatever the number of asynchronous listeners and never waits for them.
+ */
+class CAsyncValidationDispatcher
+{
+public:
+    CAsyncValidationDispatcher(): fConnected(false), pLastBlock(nullptr) {}
+
+    void Add(CValidationInterface* pListener)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (mapQueues.count(pListener))
+            return;
+        if (!fConnected)
+            Connect();
+        mapQueues[pListener] = std::make_shared<CValidationInterfaceQueue>(pListener);
+    }
+
+    //! False if the listener is not an asynchronous one
+    bool Remove(CValidationInterface* pListener)
+    {
+        std::shared_ptr<CValidationInterfaceQueue> pQueue;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = mapQueues.find(pListener);
+            if (it == mapQueues.end())
+                return false;
+            pQueue = it->second;
+            mapQueues.erase(it);
+        }
+        pQueue->Stop();
+        return true;
+    }
+
+    //! Stop all the queues, once delivered, and forget about the main signals, which have been disconnected
+    void RemoveAll()
+    {
+        std::map<CValidationInterface*, std::shared_ptr<CValidationInterfaceQueue> > mapStopping;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            mapStopping.swap(mapQueues);
+            fConnected = false;
+            lastBlock.reset();
+            pLastBlock = nullptr;
+        }
+        for (const auto& entry : mapStopping)
+            entry.second->Stop();
+    }
+
+    void WaitUntilBelow(size_t nSize)
+    {
+        for (const auto& pQueue : GetQueues())
+            pQueue->WaitUntilBelow(nSize);
+    }
+
+    void UpdatedBlockTip(const CBlockIndex *pindex)
+    {
+        Push([pindex](CValidationInterface* p) { p->UpdatedBlockTip(pindex); });
+    }
+
+    void SyncTransaction(const CTransaction &tx, const CBlock *pblock)
+    {
+        if (!HasListeners())
+            return;
+        std::shared_ptr<const CTransaction> ptx = std::make_shared<const CTransaction>(tx);
+        std::shared_ptr<const CBlock> block = SnapshotBlock(pblock);
+        Push([ptx, block](CValidationInterface* p) { p->SyncTransaction(*ptx, block.get()); });
+    }
+
+    void SyncCertificate(const CScCertificate &cert, const CBlock *pblock, int bwtMaturityDepth)
+    {
+        if (!HasListeners())
+            return;
+        std::shared_ptr<const CScCertificate> pcert = std::make_shared<const CScCertificate>(cert);
+        std::shared_ptr<const CBlock> block = SnapshotBlock(pblock);
+        Push([pcert, block, bwtMaturityDepth](CValidationInterface* p) { p->SyncCertificate(*pcert, block.get(), bwtMaturityDepth); });
+    }
+
+    void SyncCertStatusInfo(const CScCertificateStatusUpdateInfo& certStatusInfo)
+    {
+        Push([certStatusInfo](CValidationInterface* p) { p->SyncCertStatusInfo(certStatusInfo); });
+    }
+
+    void EraseFromWallet(const uint256 &hash)
+    {
+        Push([hash](CValidationInterface* p) { p->EraseFromWallet(hash); });
+    }
+
+    void ChainTip(const CBlockIndex *pindex, const CBlock *pblock, const ZCIncrementalMerkleTree& tree, bool added)
+    {
+        if (!HasListeners())
+            return;
+        std::shared_ptr<const ZCIncrementalMerkleTree> ptree = std::make_shared<const ZCIncrementalMerkleTree>(tree);
+        std::shared_ptr<const CBlock> block = SnapshotBlock(pblock);
+        Push([pindex, block, ptree, added](CValidationInterface* p) { p->ChainTip(pindex, block.get(), *ptree, added); });
+    }
+
+    void SetBestChain(const CBlockLocator &locator)
+    {
+        Push([locator](CValidationInterface* p) { p->SetBestChain(locator); });
+    }
+
+    void UpdatedTransaction(const uint256 &hash)
+    {
+        Push([hash](CValidationInterface* p) { p->UpdatedTransaction(hash); });
+    }
+
+    void Inventory(const uint256 &hash)
+    {
+        Push([hash](CValidationInterface* p) { p->Inventory(hash); });
+    }
+
+    void ResendWalletTransactions(int64_t nBestBlockTime)
+    {
+        Push([nBestBlockTime](CValidationInterface* p) { p->ResendWalletTransactions(nBestBlockTime); });
+    }
+
+    void BlockChecked(const CBlock& block, const CValidationState& state)
+    {
+        if (!HasListeners())
+            return;
+        std::shared_ptr<const CBlock> pblock = SnapshotBlock(&block);
+        Push([pblock, state](CValidationInterface* p) { p->BlockChecked(*pblock, state); });
+    }
+
+private:
+    std::mutex mtx;
+    std::map<CValidationInterface*, std::shared_ptr<CValidationInterfaceQueue> > mapQueues;
+    bool fConnected;
+
+    //! The snapshot of the last notified block, shared by the notifications of all its transactions
+    std::mutex mtxLastBlock;
+    std::shared_ptr<const CBlock> lastBlock;
+    const CBlock* pLastBlock;
+
+    void Connect()
+    {
+        g_signals.UpdatedBlockTip.connect(boost::bind(&CAsyncValidationDispatcher::UpdatedBlockTip, this, _1));
+        g_signals.SyncTransaction.connect(boost::bind(&CAsyncValidationDispatcher::SyncTransaction, this, _1, _2));
+        g_signals.EraseTransaction.connect(boost::bind(&CAsyncValidationDispatcher::EraseFromWallet, this, _1));
+        g_signals.UpdatedTransaction.connect(boost::bind(&CAsyncValidationDispatcher::UpdatedTransaction, this, _1));
+        g_signals.ChainTip.connect(boost::bind(&CAsyncValidationDispatcher::ChainTip, this, _1, _2, _3, _4));
+        g_signals.SetBestChain.connect(boost::bind(&CAsyncValidationDispatcher::SetBestChain, this, _1));
+        g_signals.Inventory.connect(boost::bind(&CAsyncValidationDispatcher::Inventory, this, _1));
+        g_signals.Broadcast.connect(boost::bind(&CAsyncValidationDispatcher::ResendWalletTransactions, this, _1));
+        g_signals.BlockChecked.connect(boost::bind(&CAsyncValidationDispatcher::BlockChecked, this, _1, _2));
+        g_signals.SyncCertificate.connect(boost::bind(&CAsyncValidationDispatcher::SyncCertificate, this, _1, _2, _3));
+        g_signals.SyncCertStatus.connect(boost::bind(&CAsyncValidationDispatcher::SyncCertStatusInfo, this, _1));
+        fConnected = true;
+    }
+
+    bool HasListeners()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return !mapQueues.empty();
+    }
+
+    std::vector<std::shared_ptr<CValidationInterfaceQueue> > GetQueues()
+    {
+        std::vector<std::shared_ptr<CValidationInterfaceQueue> > vQueues;
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& entry : mapQueues)
+            vQueues.push_back(entry.second);
+        return vQueues;
+    }
+
+    std::shared_ptr<const CBlock> SnapshotBlock(const CBlock* pblock)
+    {
+        if (pblock == nullptr)
+            return std::shared_ptr<const CBlock>();
+
+        std::lock_guard<std::mutex> lock(mtxLastBlock);
+        if (pblock != pLastBlock || lastBlock->GetHash() != pblock->GetHash())
+        {
+            lastBlock = std::make_shared<const CBlock>(*pblock);
+            pLastBlock = pblock;
+        }
+        return lastBlock;
+    }
+
+    //! Queue the notification for all the asynchronous listeners, in the order the signals are emitted
+    void Push(const std::function<void (CValidationInterface*)>& notification)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& entry : mapQueues)
+            entry.second->Push(notification);
+    }
+};
+
+static CAsyncValidationDispatcher g_asyncDispatcher;
+
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fAsync) {
+    if (fAsync) {
+        g_asyncDispatcher.Add(pwalletIn);
+        return;
+    }
     g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
     g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
     g_signals.EraseTransaction.connect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
@@ -28,6 +316,8 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    if (g_asyncDispatcher.Remove(pwalletIn))
+        return;
     g_signals.SyncCertStatus.disconnect(boost::bind(&CValidationInterface::SyncCertStatusInfo, pwalletIn, _1));
     g_signals.SyncCertificate.disconnect(boost::bind(&CValidationInterface::SyncCertificate, pwalletIn, _1, _2, _3));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
@@ -53,6 +343,7 @@ void UnregisterAllValidationInterfaces() {
     g_signals.EraseTransaction.disconnect_all_slots();
     g_signals.SyncTransaction.disconnect_all_slots();
     g_signals.UpdatedBlockTip.disconnect_all_slots();
+    g_asyncDispatcher.RemoveAll();
 }
 
 void SyncWithWallets(const CTransaction &tx, const CBlock *pblock) {
@@ -66,3 +357,11 @@ void SyncWithWallets(const CScCertificate &cert, const CBlock *pblock, int bwtMa
 void SyncCertStatusUpdate(const CScCertificateStatusUpdateInfo& certStatusInfo) {
     g_signals.SyncCertStatus(certStatusInfo);
 }
+
+void LimitValidationInterfaceQueues() {
+    g_asyncDispatcher.WaitUntilBelow(MAX_ASYNC_VALIDATION_QUEUE_SIZE + 1);
+}
+
+void SyncWithValidationInterfaceQueues() {
+    g_asyncDispatcher.WaitUntilBelow(1);
+}
@@ -23,12 +23,23 @@ struct CScCertificateStatusUpdateInfo;
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
-/** Unregister a wallet from core */
+/** Notifications that can be queued for an asynchronous listener before block connection waits for it to catch up */
+static const size_t MAX_ASYNC_VALIDATION_QUEUE_SIZE = 10000;
+
+/**
+ * Register a wallet to receive updates from core. An asynchronous listener is notified in order by a thread
+ * of its own, out of the critical path of validation: it gets snapshots of the notified data, but must not
+ * expect the chain state to still be the one of the notification when it runs.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fAsync = false);
+/** Unregister a wallet from core, after the notifications queued for it have been delivered */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/** Wait until no asynchronous listener has more than MAX_ASYNC_VALIDATION_QUEUE_SIZE pending notifications. Must not be called holding cs_main */
+void LimitValidationInterfaceQueues();
+/** Wait until all the notifications queued so far have been delivered to the asynchronous listeners */
+void SyncWithValidationInterfaceQueues();
 /** Push an updated transaction to all registered wallets */
 void SyncWithWallets(const CTransaction& tx, const CBlock* pblock = NULL);
 /** Push an updated certificate to all registered wallets */
@@ -44,15 +55,16 @@ protected:
     virtual void SyncCertificate(const CScCertificate &tx, const CBlock *pblock, int bwtMaturityDepth) {}
     virtual void SyncCertStatusInfo(const CScCertificateStatusUpdateInfo& certStatusInfo) {}
     virtual void EraseFromWallet(const uint256 &hash) {}
-    virtual void ChainTip(const CBlockIndex *pindex, const CBlock *pblock, ZCIncrementalMerkleTree tree, bool added) {}
+    virtual void ChainTip(const CBlockIndex *pindex, const CBlock *pblock, const ZCIncrementalMerkleTree& tree, bool added) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual void UpdatedTransaction(const uint256 &hash) {}
     virtual void Inventory(const uint256 &hash) {}
     virtual void ResendWalletTransactions(int64_t nBestBlockTime) {}
     virtual void BlockChecked(const CBlock&, const CValidationState&) {}
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, bool);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
+    friend class CAsyncValidationDispatcher;
 };
 
 struct CMainSignals {
@@ -65,7 +77,7 @@ struct CMainSignals {
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
     boost::signals2::signal<void (const uint256 &)> UpdatedTransaction;
     /** Notifies listeners of a change to the tip of the active block chain. */
-    boost::signals2::signal<void (const CBlockIndex *, const CBlock *, ZCIncrementalMerkleTree, bool)> ChainTip;
+    boost::signals2::signal<void (const CBlockIndex *, const CBlock *, const ZCIncrementalMerkleTree&, bool)> ChainTip;
     /** Notifies listeners of a new active block chain. */
     boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
     /** Notifies listeners about an inventory item being seen on the network. */
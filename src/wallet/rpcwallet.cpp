@@ -4351,6 +4351,8 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
             "sendtoaddress\n"
             "loadwallet\n"
             "listunspent\n"
+            "sctxscommitment\n"
+            "cswnullifierlookup\n"
             
             "\nResult:\n"
             "[\n"
@@ -4448,6 +4450,16 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
             sample_times.push_back(benchmark_loadwallet());
         } else if (benchmarktype == "listunspent") {
             sample_times.push_back(benchmark_listunspent());
+        } else if (benchmarktype == "sctxscommitment") {
+            // the serial builder is used unless a number of threads is given
+            size_t nOutputs = params[2].get_int();
+            int nThreads = params.size() < 4 ? 0 : params[3].get_int();
+            sample_times.push_back(benchmark_sc_txs_commitment(nOutputs, nThreads));
+        } else if (benchmarktype == "cswnullifierlookup") {
+            // 1M nullifiers by default, the prefilter is skipped if the fourth argument is false
+            size_t nNullifiers = params.size() < 3 ? 1000000 : params[2].get_int();
+            bool fPrefilter = params.size() < 4 ? true : params[3].get_bool();
+            sample_times.push_back(benchmark_csw_nullifier_lookup(nNullifiers, fPrefilter));
         } else {
             throw JSONRPCError(RPC_TYPE_ERROR, "Invalid benchmarktype");
         }
@@ -412,10 +412,12 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
 }
 
 void CWallet::ChainTip(const CBlockIndex *pindex, const CBlock *pblock,
-                       ZCIncrementalMerkleTree tree, bool added)
+                       const ZCIncrementalMerkleTree& tree, bool added)
 {
     if (added) {
-        IncrementNoteWitnesses(pindex, pblock, tree);
+        // the block commitments are appended to the tree, which is shared with the other listeners
+        ZCIncrementalMerkleTree walletTree(tree);
+        IncrementNoteWitnesses(pindex, pblock, walletTree);
     } else {
         DecrementNoteWitnesses(pindex);
     }
@@ -1145,7 +1145,7 @@ public:
                       bool& fCanBeCached, bool keepImmatureVoutsOnly) const;
     CAmount GetChange(const CTransactionBase& txBase) const;
 
-    void ChainTip(const CBlockIndex *pindex, const CBlock *pblock, ZCIncrementalMerkleTree tree, bool added) override;
+    void ChainTip(const CBlockIndex *pindex, const CBlock *pblock, const ZCIncrementalMerkleTree& tree, bool added) override;
     /** Saves witness caches and best block locator to disk. */
     void SetBestChain(const CBlockLocator& loc) override;
 
@@ -19,6 +19,7 @@
 #include "pow.h"
 #include "rpc/server.h"
 #include "script/sign.h"
+#include "sc/sidechainTxsCommitmentBuilder.h"
 #include "sodium.h"
 #include "streams.h"
 #include "txdb.h"
@@ -443,6 +444,54 @@ double benchmark_connectblock_slow()
     return duration;
 }
 
+// Chainstate of a ceased sidechain, with its withdrawn nullifiers
+class CswNullifiersCoinsViewDB : public CCoinsViewDB {
+public:
+    CswNullifiersCoinsViewDB(std::string dbName) : CCoinsViewDB(dbName, 100 * 1024 * 1024, false, true) {}
+
+    //! The lookup done before the prefilter, 'n' being the key prefix of the CSW nullifiers
+    bool HaveCswNullifierInDb(const uint256& scId, const CFieldElement& nullifier) const {
+        return db.Exists(std::make_pair('n', std::make_pair(scId, CCompactFieldElement{nullifier})));
+    }
+};
+
+double benchmark_csw_nullifier_lookup(size_t nNullifiers, bool fPrefilter)
+{
+    static const size_t NULLIFIERS_PER_BATCH = 100000;
+    static const size_t LOOKUPS = 10000;
+
+    const uint256 scId = GetRandHash();
+    CswNullifiersCoinsViewDB db("benchmark/cswnullifiers");
+    for (size_t i = 0; i < nNullifiers; i += NULLIFIERS_PER_BATCH)
+    {
+        CCoinsMap mapCoins;
+        CAnchorsMap mapAnchors;
+        CNullifiersMap mapNullifiers;
+        CSidechainsMap mapSidechains;
+        CSidechainEventsMap mapSidechainEvents;
+        CCswNullifiersMap cswNullifiers;
+        for (size_t j = i; j < std::min(nNullifiers, i + NULLIFIERS_PER_BATCH); j++)
+            cswNullifiers[std::make_pair(scId, CCompactFieldElement{GetRandomNullifier()})] =
+                CCswNullifiersCacheEntry(CCswNullifiersCacheEntry::Flags::FRESH);
+        bool fWritten = db.BatchWrite(mapCoins, uint256(), uint256(), mapAnchors, mapNullifiers, mapSidechains, mapSidechainEvents, cswNullifiers);
+        assert(fWritten);
+    }
+
+    // fresh nullifiers, as in the CSW inputs of the txes entering the mempool
+    std::vector<CFieldElement> vLookups;
+    for (size_t i = 0; i < LOOKUPS; i++)
+        vLookups.push_back(GetRandomNullifier());
+
+    size_t nFound = 0;
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (const CFieldElement& nullifier : vLookups)
+        nFound += fPrefilter ? db.HaveCswNullifier(scId, nullifier) : db.HaveCswNullifierInDb(scId, nullifier);
+    double elapsed = timer_stop(tv_start);
+    assert(nFound == 0);
+    return elapsed;
+}
+
 double benchmark_sendtoaddress(CAmount amount)
 {
     UniValue params(UniValue::VARR);
@@ -478,3 +527,65 @@ double benchmark_listunspent()
     auto unspent = listunspent(params, false);
     return timer_stop(tv_start);
 }
+
+double benchmark_sc_txs_commitment(size_t nOutputs, int nThreads)
+{
+    // Synthetic block: forward transfers and backward transfer requests, 10 per tx,
+    // spread over one sidechain every 100 outputs
+    static const size_t OUTPUTS_PER_TX = 10;
+    static const size_t OUTPUTS_PER_SIDECHAIN = 100;
+
+    std::vector<uint256> vScIds(std::max<size_t>(1, nOutputs / OUTPUTS_PER_SIDECHAIN));
+    for (uint256& scId : vScIds)
+        scId = GetRandHash();
+
+    std::vector<CTransaction> vtx;
+    CMutableTransaction mtx;
+    mtx.nVersion = SC_TX_VERSION;
+    for (size_t i = 0; i < nOutputs; i++)
+    {
+        const uint256& scId = vScIds[i % vScIds.size()];
+        if (i % 2 == 0)
+        {
+            mtx.vft_ccout.push_back(CTxForwardTransferOut(scId, CAmount(1 + i), GetRandHash(), uint160()));
+        }
+        else
+        {
+            // clear the most significant byte to get a valid field element
+            uint256 requestData = GetRandHash();
+            *(requestData.end() - 1) = 0x0;
+
+            CBwtRequestOut bwtr;
+            bwtr.scId = scId;
+            bwtr.vScRequestData.push_back(CFieldElement{requestData});
+            bwtr.scFee = CAmount(1 + i);
+            mtx.vmbtr_out.push_back(bwtr);
+        }
+
+        if ((i + 1) % OUTPUTS_PER_TX == 0 || i + 1 == nOutputs)
+        {
+            vtx.push_back(mtx);
+            mtx.vft_ccout.clear();
+            mtx.vmbtr_out.clear();
+            mtx.nLockTime++;
+        }
+    }
+
+    CCoinsView dummy;
+    CCoinsViewCache view(&dummy);
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    SidechainTxsCommitmentBuilder builder;
+    if (nThreads <= 0)
+    {
+        for (const CTransaction& tx : vtx)
+            builder.add(tx);
+    }
+    else
+    {
+        builder.add(vtx, std::vector<CScCertificate>(), view, nThreads);
+    }
+    builder.getCommitment();
+    return timer_stop(tv_start);
+}
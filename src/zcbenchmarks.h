@@ -19,5 +19,7 @@ extern double benchmark_connectblock_slow();
 extern double benchmark_sendtoaddress(CAmount amount);
 extern double benchmark_loadwallet();
 extern double benchmark_listunspent();
+extern double benchmark_sc_txs_commitment(size_t nOutputs, int nThreads);
+extern double benchmark_csw_nullifier_lookup(size_t nNullifiers, bool fPrefilter);
 
 #endif
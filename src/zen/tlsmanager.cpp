@@ -11,6 +11,7 @@
 
 #include "tlsmanager.h"
 #include "utiltls.h"
+#include "../netpoll.h"
 
 using namespace std;
 namespace zen
@@ -178,150 +179,152 @@ int tlsCertVerificationCallback(int preverify_ok, X509_STORE_CTX* chainContext)
     return 1;
 }
 /**
- * @brief Wait for a given SSL connection event.
+ * @brief Runs a given SSL connection routine as far as it can go without blocking.
  * 
  * @param eRoutine a SSLConnectionRoutine value which determines the type of the event.
  * @param hSocket 
  * @param ssl pointer to an SSL instance.
- * @param timeoutSec timeout in seconds.
- * @return int returns nError corresponding to the connection event.
+ * @param nWantEvents set to the socket events to wait for before running the routine again, 0 when it is over.
+ * @return int returns the result of the routine when it is over, -1 on failure.
  */
-int TLSManager::waitFor(SSLConnectionRoutine eRoutine, SOCKET hSocket, SSL* ssl, int timeoutSec, unsigned long& err_code)
+int TLSManager::stepRoutine(SSLConnectionRoutine eRoutine, SOCKET hSocket, SSL* ssl, int& nWantEvents, unsigned long& err_code)
 {
     int retOp = 0;
+    nWantEvents = 0;
     err_code = 0;
 
-    while (true) {
-        // clear the current thread's error queue
-        ERR_clear_error();
+    // clear the current thread's error queue
+    ERR_clear_error();
 
-        switch (eRoutine) {
-            case SSL_CONNECT:
+    switch (eRoutine) {
+        case SSL_CONNECT:
+        {
+            retOp = SSL_connect(ssl);
+            if (retOp == 0)
             {
-                retOp = SSL_connect(ssl);
-                if (retOp == 0)
-                {
-                    err_code = ERR_get_error();
-                    const char* error_str = ERR_error_string(err_code, NULL);
-                    LogPrint("tls", "TLS: WARNING: %s: %s():%d - SSL_CONNECT err: %s\n",
-                        __FILE__, __func__, __LINE__, error_str);
-                    return -1;
-                }
+                err_code = ERR_get_error();
+                const char* error_str = ERR_error_string(err_code, NULL);
+                LogPrint("tls", "TLS: WARNING: %s: %s():%d - SSL_CONNECT err: %s\n",
+                    __FILE__, __func__, __LINE__, error_str);
+                return -1;
             }
-            break;
-         
-            case SSL_ACCEPT:
+        }
+        break;
+     
+        case SSL_ACCEPT:
+        {
+            retOp = SSL_accept(ssl);
+            if (retOp == 0)
             {
-                retOp = SSL_accept(ssl);
-                if (retOp == 0)
-                {
-                    err_code = ERR_get_error();
-                    const char* error_str = ERR_error_string(err_code, NULL);
-                    LogPrint("tls", "TLS: WARNING: %s: %s():%d - SSL_ACCEPT err: %s\n",
-                        __FILE__, __func__, __LINE__, error_str);
-                    return -1;
-                }
+                err_code = ERR_get_error();
+                const char* error_str = ERR_error_string(err_code, NULL);
+                LogPrint("tls", "TLS: WARNING: %s: %s():%d - SSL_ACCEPT err: %s\n",
+                    __FILE__, __func__, __LINE__, error_str);
+                return -1;
             }
-            break;
-         
-            case SSL_SHUTDOWN:
+        }
+        break;
+     
+        case SSL_SHUTDOWN:
+        {
+            if (hSocket != INVALID_SOCKET)
             {
-                if (hSocket != INVALID_SOCKET)
+                std::string disconnectedPeer("no info");
+                struct sockaddr_in addr;
+                socklen_t serv_len = sizeof(addr);
+                int ret = getpeername(hSocket, (struct sockaddr *)&addr, &serv_len);
+                if (ret == 0)
                 {
-                    std::string disconnectedPeer("no info");
-                    struct sockaddr_in addr;
-                    socklen_t serv_len = sizeof(addr);
-                    int ret = getpeername(hSocket, (struct sockaddr *)&addr, &serv_len);
-                    if (ret == 0)
-                    {
-                        disconnectedPeer = std::string(inet_ntoa(addr.sin_addr)) + ":" + std::to_string(ntohs(addr.sin_port));
-                    }
-                    LogPrint("tls", "TLS: shutting down fd=%d, peer=%s\n", hSocket, disconnectedPeer);
+                    disconnectedPeer = std::string(inet_ntoa(addr.sin_addr)) + ":" + std::to_string(ntohs(addr.sin_port));
                 }
-                retOp = SSL_shutdown(ssl);
+                LogPrint("tls", "TLS: shutting down fd=%d, peer=%s\n", hSocket, disconnectedPeer);
             }
-            break;
-         
-            default:
-                return -1;
+            retOp = SSL_shutdown(ssl);
         }
+        break;
+     
+        default:
+            return -1;
+    }
 
-        if (eRoutine == SSL_SHUTDOWN) {
-            if (retOp == 0)
-            {
-                LogPrint("tls", "TLS: WARNING: %s: %s():%d - SSL_SHUTDOWN: The close_notify was sent but the peer did not send it back yet.\n",
-                        __FILE__, __func__, __LINE__);
-                // do not call SSL_get_error() because it may misleadingly indicate an error even though no error occurred.
-                break;
-            }
-            else
-            if (retOp == 1)
-            {
-                LogPrint("tls", "TLS: %s: %s():%d - SSL_SHUTDOWN completed\n", __FILE__, __func__, __LINE__);
-                break;
-            }
-            else
-            {
-                LogPrint("tls", "TLS: %s: %s():%d - SSL_SHUTDOWN failed\n", __FILE__, __func__, __LINE__);
-                // the error will be read afterwards
-            }
-        } else {
-            if (retOp == 1)
-            {
-                LogPrint("tls", "TLS: %s: %s():%d - %s completed\n", __FILE__, __func__, __LINE__,
-                    eRoutine == SSL_CONNECT ? "SSL_CONNECT" : "SSL_ACCEPT");
-                break;
-            }
+    if (eRoutine == SSL_SHUTDOWN) {
+        if (retOp == 0)
+        {
+            LogPrint("tls", "TLS: WARNING: %s: %s():%d - SSL_SHUTDOWN: The close_notify was sent but the peer did not send it back yet.\n",
+                    __FILE__, __func__, __LINE__);
+            // do not call SSL_get_error() because it may misleadingly indicate an error even though no error occurred.
+            return retOp;
+        }
+        else
+        if (retOp == 1)
+        {
+            LogPrint("tls", "TLS: %s: %s():%d - SSL_SHUTDOWN completed\n", __FILE__, __func__, __LINE__);
+            return retOp;
+        }
+        else
+        {
+            LogPrint("tls", "TLS: %s: %s():%d - SSL_SHUTDOWN failed\n", __FILE__, __func__, __LINE__);
+            // the error will be read afterwards
         }
+    } else {
+        if (retOp == 1)
+        {
+            LogPrint("tls", "TLS: %s: %s():%d - %s completed\n", __FILE__, __func__, __LINE__,
+                eRoutine == SSL_CONNECT ? "SSL_CONNECT" : "SSL_ACCEPT");
+            return retOp;
+        }
+    }
 
-        int sslErr = SSL_get_error(ssl, retOp);
+    int sslErr = SSL_get_error(ssl, retOp);
 
-        if (sslErr != SSL_ERROR_WANT_READ && sslErr != SSL_ERROR_WANT_WRITE) {
-            err_code = ERR_get_error();
-            const char* error_str = ERR_error_string(err_code, NULL);
-            LogPrint("tls", "TLS: WARNING: %s: %s():%d - routine(%d), sslErr[0x%x], retOp[%d], errno[0x%x], lib[0x%x], func[0x%x], reas[0x%x]-> err: %s\n",
-                __FILE__, __func__, __LINE__,
-                eRoutine, sslErr, retOp, errno, ERR_GET_LIB(err_code), ERR_GET_FUNC(err_code), ERR_GET_REASON(err_code), error_str);
-            retOp = -1;
+    if (sslErr != SSL_ERROR_WANT_READ && sslErr != SSL_ERROR_WANT_WRITE) {
+        err_code = ERR_get_error();
+        const char* error_str = ERR_error_string(err_code, NULL);
+        LogPrint("tls", "TLS: WARNING: %s: %s():%d - routine(%d), sslErr[0x%x], retOp[%d], errno[0x%x], lib[0x%x], func[0x%x], reas[0x%x]-> err: %s\n",
+            __FILE__, __func__, __LINE__,
+            eRoutine, sslErr, retOp, errno, ERR_GET_LIB(err_code), ERR_GET_FUNC(err_code), ERR_GET_REASON(err_code), error_str);
+        return -1;
+    }
+
+    nWantEvents = (sslErr == SSL_ERROR_WANT_READ) ? SOCKET_EVENT_RECV : SOCKET_EVENT_SEND;
+    return retOp;
+
+
+}
+
+/**
+ * @brief Wait for a given SSL connection event.
+ * 
+ * @param eRoutine a SSLConnectionRoutine value which determines the type of the event.
+ * @param hSocket 
+ * @param ssl pointer to an SSL instance.
+ * @param timeoutSec timeout in seconds.
+ * @return int returns nError corresponding to the connection event.
+ */
+int TLSManager::waitFor(SSLConnectionRoutine eRoutine, SOCKET hSocket, SSL* ssl, int timeoutSec, unsigned long& err_code)
+{
+    int retOp = 0;
+
+    while (true) {
+        int nWantEvents = 0;
+        retOp = stepRoutine(eRoutine, hSocket, ssl, nWantEvents, err_code);
+        if (nWantEvents == 0)
             break;
-        }
 
-        fd_set socketSet;
-        FD_ZERO(&socketSet);
-        FD_SET(hSocket, &socketSet);
-
-        struct timeval timeout = {timeoutSec, 0};
-
-        if (sslErr == SSL_ERROR_WANT_READ) {
-            int result = select(hSocket + 1, &socketSet, NULL, NULL, &timeout);
-            if (result == 0) {
-                LogPrint("tls", "TLS: ERROR: %s: %s():%d - WANT_READ timeout on %s\n", __FILE__, __func__, __LINE__,
-                    (eRoutine == SSL_CONNECT ? "SSL_CONNECT" : 
-                        (eRoutine == SSL_ACCEPT ? "SSL_ACCEPT" : "SSL_SHUTDOWN" )));
-                err_code = SELECT_TIMEDOUT;
-                retOp = -1;
-                break;
-            } else if (result == -1) {
-                LogPrint("tls", "TLS: ERROR: %s: %s: WANT_READ ssl_err_code: 0x%x; errno: %s\n",
-                    __FILE__, __func__, sslErr, strerror(errno));
-                retOp = -1;
-                break;
-            }
-        } else {
-            int result = select(hSocket + 1, NULL, &socketSet, NULL, &timeout);
-            if (result == 0) {
-                LogPrint("tls", "TLS: ERROR: %s: %s():%d - WANT_WRITE timeout on %s\n", __FILE__, __func__, __LINE__,
-                    (eRoutine == SSL_CONNECT ? "SSL_CONNECT" : 
-                        (eRoutine == SSL_ACCEPT ? "SSL_ACCEPT" : "SSL_SHUTDOWN" )));
-                err_code = SELECT_TIMEDOUT;
-                retOp = -1;
-                break;
-            } else if (result == -1) {
-                LogPrint("tls", "TLS: ERROR: %s: %s: WANT_WRITE ssl_err_code: 0x%x; errno: %s\n",
-                    __FILE__, __func__, sslErr, strerror(errno));
-                retOp = -1;
-                break;
-            }
+        int result = WaitForSocket(hSocket, nWantEvents, timeoutSec * 1000);
+        if (result == 0) {
+            LogPrint("tls", "TLS: ERROR: %s: %s():%d - %s timeout on %s\n", __FILE__, __func__, __LINE__,
+                (nWantEvents == SOCKET_EVENT_RECV ? "WANT_READ" : "WANT_WRITE"),
+                (eRoutine == SSL_CONNECT ? "SSL_CONNECT" : 
+                    (eRoutine == SSL_ACCEPT ? "SSL_ACCEPT" : "SSL_SHUTDOWN" )));
+            err_code = SELECT_TIMEDOUT;
+            retOp = -1;
+            break;
+        } else if (result == SOCKET_ERROR) {
+            LogPrint("tls", "TLS: ERROR: %s: %s: %s errno: %s\n",
+                __FILE__, __func__, (nWantEvents == SOCKET_EVENT_RECV ? "WANT_READ" : "WANT_WRITE"), strerror(errno));
+            retOp = -1;
+            break;
         }
     }
 
@@ -520,39 +523,51 @@ bool TLSManager::prepareCredentials()
     return bPrepared;
 }
 /**
- * @brief accept a TLS connection
+ * @brief start accepting a TLS connection, the handshake being carried on by continueAccept without blocking
  * 
  * @param hSocket the TLS socket.
  * @param addr incoming address.
- * @param tls_ctx_server TLS server context.
  * @return SSL* returns pointer to the ssl object if successful, otherwise returns NULL
  */
-SSL* TLSManager::accept(SOCKET hSocket, const CAddress& addr, unsigned long& err_code)
+SSL* TLSManager::startAccept(SOCKET hSocket, const CAddress& addr, unsigned long& err_code)
 {
     LogPrint("tls", "TLS: accepting connection from %s (tid = %X)\n", addr.ToString(), pthread_self());
 
     err_code = 0; 
-    SSL* ssl = NULL;
-    bool bAcceptedTLS = false;
+    SSL* ssl = SSL_new(tls_ctx_server);
 
-    if ((ssl = SSL_new(tls_ctx_server))) {
-        if (SSL_set_fd(ssl, hSocket)) {
-            int ret = TLSManager::waitFor(SSL_ACCEPT, hSocket, ssl, (DEFAULT_CONNECT_TIMEOUT / 1000), err_code);
-            if (ret == 1)
-            {
-                bAcceptedTLS = true;
-            }
-        }
-    }
-    else
+    if (!ssl)
     {
         err_code = ERR_get_error();
         const char* error_str = ERR_error_string(err_code, NULL);
         LogPrint("tls", "TLS: %s: %s():%d - SSL_new failed err: %s\n",
             __FILE__, __func__, __LINE__, error_str);
     }
+    else if (!SSL_set_fd(ssl, hSocket))
+    {
+        err_code = ERR_get_error();
+        SSL_free(ssl);
+        ssl = NULL;
+    }
+
+    return ssl;
+}
+/**
+ * @brief carry on the handshake of a connection from startAccept as far as the socket allows
+ * 
+ * @param hSocket the TLS socket.
+ * @param ssl the ssl object returned by startAccept, freed on failure.
+ * @param addr incoming address.
+ * @param nWantEvents set to the socket events the handshake waits for, 0 when it is over.
+ * @return int returns 1 when the connection has been accepted, 0 while the handshake goes on, -1 on failure.
+ */
+int TLSManager::continueAccept(SOCKET hSocket, SSL* ssl, const CAddress& addr, int& nWantEvents, unsigned long& err_code)
+{
+    int ret = stepRoutine(SSL_ACCEPT, hSocket, ssl, nWantEvents, err_code);
+    if (nWantEvents != 0)
+        return 0;
 
-    if (bAcceptedTLS) {
+    if (ret == 1) {
         LogPrintf("TLS: connection from %s has been accepted (tlsv = %s 0x%04x / ssl = %s 0x%x ). Using cipher: %s\n",
             addr.ToString(), SSL_get_version(ssl), SSL_version(ssl), OpenSSL_version(OPENSSL_VERSION), OpenSSL_version_num(), SSL_get_cipher(ssl));
 
@@ -561,17 +576,13 @@ SSL* TLSManager::accept(SOCKET hSocket, const CAddress& addr, unsigned long& err
             const SSL_CIPHER *c = sk_SSL_CIPHER_value(sk, i);
             LogPrint("tls", "TLS: supporting cipher: %s\n", SSL_CIPHER_get_name(c));
         }
-    } else {
-        LogPrintf("TLS: %s: %s():%d - TLS connection from %s failed (err_code 0x%X)\n",
-            __FILE__, __func__, __LINE__, addr.ToString(), err_code);
-
-        if (ssl) {
-            SSL_free(ssl);
-            ssl = NULL;
-        }
+        return 1;
     }
 
-    return ssl;
+    LogPrintf("TLS: %s: %s():%d - TLS connection from %s failed (err_code 0x%X)\n",
+        __FILE__, __func__, __LINE__, addr.ToString(), err_code);
+    SSL_free(ssl);
+    return -1;
 }
 /**
  * @brief Determines whether a string exists in the non-TLS address pool.
@@ -620,12 +631,10 @@ void TLSManager::cleanNonTLSPool(std::vector<NODE_ADDR>& vPool, CCriticalSection
  * @brief Handles send and recieve functionality in TLS Sockets.
  * 
  * @param pnode reference to the CNode object.
- * @param fdsetRecv 
- * @param fdsetSend 
- * @param fdsetError 
+ * @param nEvents the socket events found by the poller.
  * @return int returns -1 when socket is invalid. returns 0 otherwise.
  */
-int TLSManager::threadSocketHandler(CNode* pnode, fd_set& fdsetRecv, fd_set& fdsetSend, fd_set& fdsetError)
+int TLSManager::threadSocketHandler(CNode* pnode, int nEvents)
 {
     //
     // Receive
@@ -638,9 +647,18 @@ int TLSManager::threadSocketHandler(CNode* pnode, fd_set& fdsetRecv, fd_set& fds
         if (pnode->hSocket == INVALID_SOCKET)
             return -1;
 
-        recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-        sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-        errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+        recvSet = (nEvents & SOCKET_EVENT_RECV);
+        sendSet = (nEvents & SOCKET_EVENT_SEND);
+        errorSet = (nEvents & SOCKET_EVENT_ERROR);
+
+        if (pnode->ssl) {
+            // records already read from the socket are not seen by the poller
+            recvSet = recvSet || SSL_has_pending(pnode->ssl);
+            // an SSL_read that had to write, as on a renegotiation, is retried once the socket is writable
+            // and an SSL_write that had to read once it is readable
+            recvSet = recvSet || (pnode->fSslReadWantsSend && (nEvents & SOCKET_EVENT_SEND));
+            sendSet = sendSet || (pnode->fSslWriteWantsRecv && (nEvents & SOCKET_EVENT_RECV));
+        }
     }
 
     if (recvSet || errorSet) {
@@ -667,6 +685,7 @@ int TLSManager::threadSocketHandler(CNode* pnode, fd_set& fdsetRecv, fd_set& fds
                         ERR_clear_error(); // clear the error queue, otherwise we may be reading an old error that occurred previously in the current thread
                         nBytes = SSL_read(pnode->ssl, pchBuf, sizeof(pchBuf));
                         nRet = SSL_get_error(pnode->ssl, nBytes);
+                        pnode->fSslReadWantsSend = (nBytes <= 0 && nRet == SSL_ERROR_WANT_WRITE);
                     } else {
                         nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
                         nRet = WSAGetLastError();
@@ -709,11 +728,8 @@ int TLSManager::threadSocketHandler(CNode* pnode, fd_set& fdsetRecv, fd_set& fds
                             LogPrint("tls", "TLS: WARNING: %s: %s():%d - SSL_read - code[0x%x], err: %s\n",
                                 __FILE__, __func__, __LINE__, nRet, error_str);
 
-                        } else {
-                            // preventive measure from exhausting CPU usage
-                            //
-                            MilliSleep(1); // 1 msec
                         }
+                        // otherwise SSL_read() is retried when the poller reports the event it waits for
                     } else {
                         if (nRet != WSAEWOULDBLOCK && nRet != WSAEMSGSIZE && nRet != WSAEINTR && nRet != WSAEINPROGRESS) {
                             if (!pnode->fDisconnect)
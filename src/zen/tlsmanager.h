@@ -43,6 +43,7 @@ public:
         function code and reason code. */
      static const long SELECT_TIMEDOUT = 0xFFFFFFFF;
 
+     int stepRoutine(SSLConnectionRoutine eRoutine, SOCKET hSocket, SSL* ssl, int& nWantEvents, unsigned long& err_code);
      int waitFor(SSLConnectionRoutine eRoutine, SOCKET hSocket, SSL* ssl, int timeoutSec, unsigned long& err_code);
 
      SSL* connect(SOCKET hSocket, const CAddress& addrConnect, unsigned long& err_code);
@@ -53,10 +54,11 @@ public:
         const std::vector<boost::filesystem::path>& trustedDirs);
 
      bool prepareCredentials();
-     SSL* accept(SOCKET hSocket, const CAddress& addr, unsigned long& err_code);
+     SSL* startAccept(SOCKET hSocket, const CAddress& addr, unsigned long& err_code);
+     int continueAccept(SOCKET hSocket, SSL* ssl, const CAddress& addr, int& nWantEvents, unsigned long& err_code);
      bool isNonTLSAddr(const string& strAddr, const vector<NODE_ADDR>& vPool, CCriticalSection& cs);
      void cleanNonTLSPool(std::vector<NODE_ADDR>& vPool, CCriticalSection& cs);
-     int threadSocketHandler(CNode* pnode, fd_set& fdsetRecv, fd_set& fdsetSend, fd_set& fdsetError);
+     int threadSocketHandler(CNode* pnode, int nEvents);
      bool initialize();
 };
 }
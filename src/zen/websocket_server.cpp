@@ -12,15 +12,19 @@
 #include <thread>
 #include <boost/thread.hpp>
 #include <boost/asio.hpp>
-#include <boost/lockfree/queue.hpp>
-#include <boost/lockfree/spsc_queue.hpp>
-#include <queue>
+#include <boost/asio/thread_pool.hpp>
+#include <deque>
+#include <memory>
 #include "validationinterface.h"
+#include "blockcache.h"
 #include "main.h"
 #include "consensus/validation.h"
 #include <univalue.h>
 #include "uint256.h"
 #include "utilmoneystr.h"
+#include "sc/sidechainjournal.h"
+#include "crypto/common.h"
+#include "zen/websocket_server.h"
 
 extern UniValue sc_send_certificate(const UniValue& params, bool fHelp);
 extern CAmount AmountFromValue(const UniValue& value);
@@ -31,21 +35,33 @@ namespace websocket = boost::beast::websocket;
 namespace http = boost::beast::http;
 
 namespace net = boost::asio;
+
+// all the socket operations are run by the single thread of this io context, the client
+// requests are processed by the worker pool and their responses posted back to it
 net::io_context ioc;
+static std::unique_ptr<net::thread_pool> wsWorkers;
+//! Keeps ioc.run() going on shutdown until the workers have posted back the completion of their requests
+static std::unique_ptr<net::executor_work_guard<net::io_context::executor_type> > wsWorkGuard;
+static int nWsWorkerThreads = 0;
 
 static int MAX_BLOCKS_REQUEST = 100;
 static int MAX_HEADERS_REQUEST = 50;
-static int tot_connections = 0;
+static std::atomic<int> tot_connections{0};
+static int max_connections = DEFAULT_WS_MAX_CONNECTIONS;
+static std::atomic<uint64_t> tot_accepted{0};
+static std::atomic<uint64_t> tot_rejected{0};
+static std::atomic<uint64_t> tot_slow_consumers{0};
 
 class WsNotificationInterface;
 class WsHandler;
 
-static int getblock(const CBlockIndex *pindex, std::string& blockHexStr);
+static int getblock(const CBlockIndex *pindex, std::shared_ptr<const CSerializedBlockCache::CEntry>& entry);
 static int getheader(const CBlockIndex *pindex, std::string& blockHexStr);
 static void ws_updatetip(const CBlockIndex *pindex);
+static void ws_updatesidechains();
 
 static boost::shared_ptr<WsNotificationInterface> wsNotificationInterface;
-static std::list< boost::shared_ptr<WsHandler> > listWsHandler;
+static std::list< std::shared_ptr<WsHandler> > listWsHandler;
 
 std::atomic<bool> exit_ws_thread{false};
 boost::thread ws_thread;
@@ -81,6 +97,7 @@ class WsNotificationInterface: public CValidationInterface
 protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindex) {
         ws_updatetip(pindex);
+        ws_updatesidechains();
     };
 public:
     ~WsNotificationInterface() 
@@ -89,11 +106,21 @@ public:
     }
 };
 
+//! A message ready to be written to the clients, in a text frame for JSON and in a binary frame otherwise
+struct WsMessage
+{
+    WsMessage(std::string&& dataIn, bool fBinaryIn): data(std::move(dataIn)), fBinary(fBinaryIn) {}
+
+    const std::string data;
+    const bool fBinary;
+};
+
 class WsEvent
 {
 public:
     enum WsEventType {
         UPDATE_TIP = 0,
+        UPDATE_SIDECHAIN = 1,
         EVT_UNDEFINED = 0xff
     };
     enum WsRequestType {
@@ -103,6 +130,9 @@ public:
         SEND_CERTIFICATE = 3,
         GET_MULTIPLE_BLOCK_HEADERS = 4,
         GET_TOP_QUALITY_CERTIFICATES = 5,
+        SUBSCRIBE_SIDECHAIN_UPDATES = 6,
+        UNSUBSCRIBE_SIDECHAIN_UPDATES = 7,
+        SET_MESSAGE_FORMAT = 8,
         REQ_UNDEFINED = 0xff
     };
     
@@ -125,40 +155,133 @@ public:
         return &payload;
     }
 
+    std::shared_ptr<const WsMessage> serialize() const {
+        return std::make_shared<const WsMessage>(payload.write(), false);
+    }
+
 private:
     WsMsgType type;
     UniValue payload;
 };
 
+/**
+ * @brief Binary counterpart of the JSON messages carrying blocks, headers, hashes and certificates, for the clients
+ * having asked for it with SET_MESSAGE_FORMAT. It starts with a fixed header:
+ *   uint8 msgType, uint8 eventType or requestType, uint32 requestId (0 for events), uint32 payload size,
+ * all the integers being little endian, followed by the payload in network serialization.
+ */
+class WsBinaryEvent
+{
+public:
+    static const size_t HEADER_SIZE = 10;
+
+    WsBinaryEvent(WsEvent::WsMsgType msgType, int type, uint32_t requestId): ss(SER_NETWORK, PROTOCOL_VERSION)
+    {
+        ss << (uint8_t)msgType << (uint8_t)type << requestId << (uint32_t)0;
+    }
+
+    CDataStream& getPayload() {
+        return ss;
+    }
+
+    std::shared_ptr<const WsMessage> serialize() {
+        WriteLE32((unsigned char*)&ss[HEADER_SIZE - 4], ss.size() - HEADER_SIZE);
+        return std::make_shared<const WsMessage>(std::string(ss.begin(), ss.end()), true);
+    }
+
+private:
+    CDataStream ss;
+};
+
 
 
-class WsHandler
+class WsHandler: public std::enable_shared_from_this<WsHandler>
 {
 private:
-    std::condition_variable writeCV;
-    std::mutex writeMutex;
+    // only accessed by the io context thread
+    websocket::stream<tcp::socket> localWs;
+    boost::beast::flat_buffer readBuffer;
+    std::deque<std::shared_ptr<const WsMessage> > outQueue;
+    bool fWriting = false;
+    bool fAccepted = false;
+    bool fClosed = false;
+
+    // read by the stats
+    std::atomic<size_t> nQueuedMessages { 0 };
+    std::atomic<size_t> nQueuedBytes { 0 };
+
+    // sidechain updates subscription, written by the worker pool and read on tip update
+    std::mutex scSubscriptionMutex;
+    bool fScSubscribed = false;
+    std::set<uint256> subscribedScIds;
+    uint64_t lastScJournalSeq = 0;
+
+    // set by SET_MESSAGE_FORMAT, blocks, headers, hashes and certificates are then sent as WsBinaryEvent
+    std::atomic<bool> fBinaryFormat { false };
+
+    static bool isBinaryRequestId(const std::string& clientRequestId)
+    {
+        int32_t id = 0;
+        return ParseInt32(clientRequestId, &id) && id >= 0;
+    }
 
-    boost::shared_ptr< websocket::stream<tcp::socket>> localWs;
-    boost::lockfree::queue<WsEvent*, boost::lockfree::capacity<1024>> wsq;
-    std::atomic<bool> exit_rwhandler_thread_flag { false };
+    //! The request id of a binary message, checked by isBinaryRequestId when the request is parsed
+    static uint32_t binaryRequestId(const std::string& clientRequestId)
+    {
+        int32_t id = 0;
+        ParseInt32(clientRequestId, &id);
+        return id;
+    }
 
     void write(WsEvent* wse)
     {
-        wsq.push(wse);
-        writeCV.notify_one();
+        std::shared_ptr<const WsMessage> msg = wse->serialize();
+        LogPrint("ws", "%s():%d - deleting %p\n", __func__, __LINE__, wse);
+        delete wse;
+        send(msg);
     }
-    void sendBlockEvent(int height, const std::string& strHash, const std::string& blockHex, WsEvent::WsEventType eventType)
+
+    static UniValue sidechainJournalEntryToJSON(const CSidechainJournalEntry& entry)
     {
-        // Send a message to the client:  type = eventType
+        UniValue deltas(UniValue::VARR);
+        for (const CSidechainDelta& delta : entry.deltas)
+        {
+            UniValue d(UniValue::VOBJ);
+            d.pushKV("scid", delta.scId.GetHex());
+            d.pushKV("type", CSidechainDelta::TypeToString(delta.type));
+            d.pushKV("amount", FormatMoney(delta.amount));
+            if (!delta.refHash.IsNull())
+                d.pushKV("hash", delta.refHash.GetHex());
+            d.pushKV("balance", FormatMoney(delta.balance));
+            d.pushKV("lastCertificateEpoch", delta.lastTopQualityCertEpoch);
+            d.pushKV("lastCertificateQuality", delta.lastTopQualityCertQuality);
+            deltas.push_back(d);
+        }
+
+        UniValue rv(UniValue::VOBJ);
+        rv.pushKV("seq", entry.seq);
+        rv.pushKV("height", entry.height);
+        rv.pushKV("hash", entry.blockHash.GetHex());
+        rv.pushKV("connected", entry.fConnected);
+        rv.pushKV("deltas", deltas);
+        return rv;
+    }
+
+    void sendSidechainEvent(const std::vector<CSidechainJournalEntry>& entries, bool fResyncRequired)
+    {
+        // Send a message to the client:  type = UPDATE_SIDECHAIN
         WsEvent* wse = new WsEvent(WsEvent::MSG_EVENT);
         LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
         UniValue rspPayload(UniValue::VOBJ);
-        rspPayload.pushKV("height", height);
-        rspPayload.pushKV("hash", strHash);
-        rspPayload.pushKV("block", blockHex);
+        UniValue arr(UniValue::VARR);
+        for (const CSidechainJournalEntry& entry : entries)
+            arr.push_back(sidechainJournalEntryToJSON(entry));
+        rspPayload.pushKV("entries", arr);
+        if (fResyncRequired)
+            rspPayload.pushKV("resyncRequired", true);
 
         UniValue* rv = wse->getPayload();
-        rv->pushKV("eventType", eventType);
+        rv->pushKV("eventType", WsEvent::UPDATE_SIDECHAIN);
         rv->pushKV("eventPayload", rspPayload);
         write(wse);
     }
@@ -182,8 +305,20 @@ private:
     }
 
     void sendHashes(int height, std::list<CBlockIndex*>& listBlock,
-            WsEvent::WsMsgType msgType, std::string clientRequestId = "")
+            WsEvent::WsMsgType msgType, WsEvent::WsRequestType reqType, std::string clientRequestId = "")
     {
+        if (fBinaryFormat)
+        {
+            // payload: int32 height, vector<uint256> hashes
+            std::vector<uint256> hashes;
+            for (const CBlockIndex* pindex : listBlock)
+                hashes.push_back(pindex->GetBlockHash());
+            WsBinaryEvent wse(msgType, reqType, binaryRequestId(clientRequestId));
+            wse.getPayload() << (int32_t)height << hashes;
+            send(wse.serialize());
+            return;
+        }
+
         // Send a message to the client:  type = eventType
         WsEvent* wse = new WsEvent(msgType);
         LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
@@ -303,13 +438,19 @@ private:
             LogPrint("ws", "%s():%d - block index not found for hash[%s]\n", __func__, __LINE__, strHash);
             return INVALID_PARAMETER;
         }
-        std::string block;
+        std::shared_ptr<const CSerializedBlockCache::CEntry> block;
         int ret = getblock(pblockindex, block);
         if (ret != OK)
         {
             return ret;
         }
-        sendBlock(pblockindex->nHeight, strHash, block, WsEvent::MSG_RESPONSE, clientRequestId);
+        if (fBinaryFormat)
+        {
+            send(makeBinaryBlock(pblockindex->nHeight, pblockindex->GetBlockHash(), block->GetRaw(),
+                WsEvent::MSG_RESPONSE, WsEvent::GET_SINGLE_BLOCK, binaryRequestId(clientRequestId)));
+            return OK;
+        }
+        sendBlock(pblockindex->nHeight, strHash, block->GetHex(), WsEvent::MSG_RESPONSE, clientRequestId);
         return OK;
     }
 
@@ -371,7 +512,7 @@ private:
                 n++;
             }
         }
-        sendHashes(listBlock.front()->nHeight, listBlock, WsEvent::MSG_RESPONSE, clientRequestId);
+        sendHashes(listBlock.front()->nHeight, listBlock, WsEvent::MSG_RESPONSE, WsEvent::GET_MULTIPLE_BLOCK_HASHES, clientRequestId);
         return OK;
     }
 
@@ -445,7 +586,7 @@ private:
                 n++;
             }
         }
-        sendHashes(listBlock.front()->nHeight, listBlock, WsEvent::MSG_RESPONSE, clientRequestId);
+        sendHashes(listBlock.front()->nHeight, listBlock, WsEvent::MSG_RESPONSE, WsEvent::GET_NEW_BLOCK_HASHES, clientRequestId);
         return OK;
     }
 
@@ -476,6 +617,7 @@ private:
         }
             
         UniValue headers(UniValue::VARR);
+        std::vector<CBlockHeader> vHeaders;
             
         for (const UniValue& o : hashes.getValues()) {
             if (o.isObject()) {
@@ -501,6 +643,13 @@ private:
                 return INVALID_PARAMETER;
             }
 
+            if (fBinaryFormat)
+            {
+                LOCK(cs_main);
+                vHeaders.push_back(pblockindex->GetBlockHeader());
+                continue;
+            }
+
             std::string header;
             int ret = getheader(pblockindex, header);
             if (ret != OK)
@@ -511,6 +660,15 @@ private:
             headers.push_back(header);
         }
 
+        if (fBinaryFormat)
+        {
+            // payload: vector<CBlockHeader> headers
+            WsBinaryEvent wse(WsEvent::MSG_RESPONSE, WsEvent::GET_MULTIPLE_BLOCK_HEADERS, binaryRequestId(clientRequestId));
+            wse.getPayload() << vHeaders;
+            send(wse.serialize());
+            return OK;
+        }
+
         sendBlockHeaders(headers, WsEvent::MSG_RESPONSE, clientRequestId);
 
         return OK;
@@ -526,6 +684,12 @@ private:
         UniValue mempoolTopQualityCert(UniValue::VOBJ);
         UniValue chainTopQualityCert(UniValue::VOBJ);
 
+        // payload: bool inMempool, [int64 quality, int32 epoch, uint256 certHash, int64 fee, CScCertificate cert],
+        //          bool inChain, [int64 quality, int32 epoch, uint256 certHash, CScCertificate cert]
+        const bool fBinary = fBinaryFormat;
+        WsBinaryEvent binWse(WsEvent::MSG_RESPONSE, WsEvent::GET_TOP_QUALITY_CERTIFICATES, fBinary ? binaryRequestId(clientRequestId) : 0);
+        CDataStream& binPayload = binWse.getPayload();
+
         {
             LOCK(cs_main);
             if (!view.HaveSidechain(scId)) {
@@ -533,30 +697,51 @@ private:
                 return INVALID_PARAMETER;
             }
         
-            if (mempool.hasSidechainCertificate(scId))
+            const bool fMempoolCert = mempool.hasSidechainCertificate(scId);
+            if (fBinary)
+                binPayload << fMempoolCert;
+            if (fMempoolCert)
             {
                 const uint256& topQualCertHash = mempool.mapSidechains.at(scId).GetTopQualityCert()->second;
                 const CScCertificate& topQualCert = mempool.mapCertificate.at(topQualCertHash).GetCertificate();
                 const CAmount certFee = mempool.mapCertificate.at(topQualCertHash).GetFee();
-                CDataStream ssCert(SER_NETWORK, PROTOCOL_VERSION);
-                ssCert << topQualCert;
-                std::string certHex = HexStr(ssCert.begin(), ssCert.end());
+                if (fBinary)
+                {
+                    binPayload << topQualCert.quality << topQualCert.epochNumber << topQualCertHash << certFee << topQualCert;
+                }
+                else
+                {
+                    CDataStream ssCert(SER_NETWORK, PROTOCOL_VERSION);
+                    ssCert << topQualCert;
+                    std::string certHex = HexStr(ssCert.begin(), ssCert.end());
      
-                mempoolTopQualityCert.push_back(Pair("quality", topQualCert.quality));
-                mempoolTopQualityCert.push_back(Pair("epoch", topQualCert.epochNumber));
-                mempoolTopQualityCert.push_back(Pair("certHash", topQualCertHash.GetHex()));
-                mempoolTopQualityCert.push_back(Pair("rawCertificateHex", certHex));
-                mempoolTopQualityCert.push_back(Pair("fee", FormatMoney(certFee)));
+                    mempoolTopQualityCert.push_back(Pair("quality", topQualCert.quality));
+                    mempoolTopQualityCert.push_back(Pair("epoch", topQualCert.epochNumber));
+                    mempoolTopQualityCert.push_back(Pair("certHash", topQualCertHash.GetHex()));
+                    mempoolTopQualityCert.push_back(Pair("rawCertificateHex", certHex));
+                    mempoolTopQualityCert.push_back(Pair("fee", FormatMoney(certFee)));
+                }
             }
 
             CSidechain sidechainInfo;
 
-            if (view.GetSidechain(scId, sidechainInfo) && !sidechainInfo.lastTopQualityCertHash.IsNull()) {
+            const bool fChainCert = view.GetSidechain(scId, sidechainInfo) && !sidechainInfo.lastTopQualityCertHash.IsNull();
+            if (fBinary)
+                binPayload << fChainCert;
+            if (fChainCert) {
                 const int topQualityCertQuality = sidechainInfo.lastTopQualityCertQuality;
                 CScCertificate topQualCert;
                 uint256 blockHash;
 
-                if (GetCertificate(sidechainInfo.lastTopQualityCertHash, topQualCert, blockHash, true)) {
+                if (!GetCertificate(sidechainInfo.lastTopQualityCertHash, topQualCert, blockHash, true)) {
+                    LogPrint("ws", "%s():%d - unable to retrieve last top quality certificate[%s]\n", __func__, __LINE__, sidechainInfo.lastTopQualityCertHash.GetHex());
+                    return INVALID_PARAMETER;
+                }
+
+                if (fBinary) {
+                    binPayload << sidechainInfo.lastTopQualityCertQuality << topQualCert.epochNumber
+                               << sidechainInfo.lastTopQualityCertHash << topQualCert;
+                } else {
                     CDataStream ssCert(SER_NETWORK, PROTOCOL_VERSION);
                     ssCert << topQualCert;
                     std::string certHex = HexStr(ssCert.begin(), ssCert.end());
@@ -565,18 +750,138 @@ private:
                     chainTopQualityCert.push_back(Pair("epoch", topQualCert.epochNumber));
                     chainTopQualityCert.push_back(Pair("certHash", sidechainInfo.lastTopQualityCertHash.GetHex()));
                     chainTopQualityCert.push_back(Pair("rawCertificateHex", certHex));
-                } else {
-                    LogPrint("ws", "%s():%d - unable to retrieve last top quality certificate[%s]\n", __func__, __LINE__, sidechainInfo.lastTopQualityCertHash.GetHex());
-                    return INVALID_PARAMETER;
                 }
             }
         }
 
+        if (fBinary)
+        {
+            send(binWse.serialize());
+            return OK;
+        }
+
         sendTopQualityCertificates(mempoolTopQualityCert, chainTopQualityCert, WsEvent::MSG_RESPONSE, clientRequestId);
 
         return OK;
     }
 
+    int subscribeSidechainUpdates(const UniValue& reqPayload, const std::string& clientRequestId, std::string& outMsg)
+    {
+        std::set<uint256> scIds;
+        const UniValue& scIdArray = find_value(reqPayload, "scids");
+        if (!scIdArray.isNull())
+        {
+            if (!scIdArray.isArray())
+            {
+                outMsg = "scids must be an array";
+                return INVALID_PARAMETER;
+            }
+            for (const UniValue& item : scIdArray.getValues())
+            {
+                if (!item.isStr() || item.get_str().size() != 64 || !IsHex(item.get_str()))
+                {
+                    outMsg = "Invalid scid format: " + item.write();
+                    return INVALID_PARAMETER;
+                }
+                scIds.insert(uint256S(item.get_str()));
+            }
+        }
+
+        std::vector<CSidechainJournalEntry> entries;
+        uint64_t lastSeq = scJournal.GetLastSeq();
+
+        // optional, the client can ask for the entries appended after a given one, e.g. after a reconnection
+        const UniValue& fromSeqVal = find_value(reqPayload, "fromSeq");
+        if (!fromSeqVal.isNull())
+        {
+            if (!fromSeqVal.isNum() || fromSeqVal.get_int64() < 0)
+            {
+                outMsg = "fromSeq must be a non negative number";
+                return INVALID_PARAMETER;
+            }
+            const uint64_t fromSeq = fromSeqVal.get_int64();
+            if (!scJournal.GetEntriesSince(fromSeq, scIds, entries))
+            {
+                outMsg = strprintf("Entries following %d are no longer in the journal", fromSeq);
+                return INVALID_PARAMETER;
+            }
+            if (!entries.empty())
+                lastSeq = std::max(lastSeq, entries.back().seq);
+        }
+
+        {
+            std::unique_lock<std::mutex> lck(scSubscriptionMutex);
+            fScSubscribed = true;
+            subscribedScIds = scIds;
+            lastScJournalSeq = lastSeq;
+        }
+
+        WsEvent* wse = new WsEvent(WsEvent::MSG_RESPONSE);
+        LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
+        UniValue rspPayload(UniValue::VOBJ);
+        UniValue subscribed(UniValue::VARR);
+        for (const uint256& scId : scIds)
+            subscribed.push_back(scId.GetHex());
+        rspPayload.pushKV("scids", subscribed);
+        rspPayload.pushKV("lastSeq", lastSeq);
+
+        UniValue* rv = wse->getPayload();
+        rv->pushKV("requestId", clientRequestId);
+        rv->pushKV("responsePayload", rspPayload);
+        write(wse);
+
+        if (!entries.empty())
+            sendSidechainEvent(entries, false);
+
+        return OK;
+    }
+
+    int setMessageFormat(const std::string& format, const std::string& clientRequestId, std::string& outMsg)
+    {
+        if (format != "json" && format != "binary")
+        {
+            outMsg = "format must be json or binary";
+            return INVALID_PARAMETER;
+        }
+        if (format == "binary" && !isBinaryRequestId(clientRequestId))
+        {
+            outMsg = "requestId must be a non negative 32 bits number with the binary format";
+            return INVALID_PARAMETER;
+        }
+
+        // the acknowledgement is a JSON message anyway, the format applies to the following ones
+        WsEvent* wse = new WsEvent(WsEvent::MSG_RESPONSE);
+        LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
+        UniValue rspPayload(UniValue::VOBJ);
+        rspPayload.pushKV("format", format);
+
+        UniValue* rv = wse->getPayload();
+        rv->pushKV("requestId", clientRequestId);
+        rv->pushKV("responsePayload", rspPayload);
+        write(wse);
+
+        fBinaryFormat = (format == "binary");
+        LogPrint("ws", "%s():%d - connection[%u] switched to %s format\n", __func__, __LINE__, t_id, format);
+        return OK;
+    }
+
+    int unsubscribeSidechainUpdates(const std::string& clientRequestId)
+    {
+        {
+            std::unique_lock<std::mutex> lck(scSubscriptionMutex);
+            fScSubscribed = false;
+            subscribedScIds.clear();
+        }
+
+        WsEvent* wse = new WsEvent(WsEvent::MSG_RESPONSE);
+        LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
+        UniValue* rv = wse->getPayload();
+        rv->pushKV("requestId", clientRequestId);
+        rv->pushKV("responsePayload", UniValue(UniValue::VOBJ));
+        write(wse);
+        return OK;
+    }
+
     /* this is not necessary boost/beast is handling the pong automatically,
      * the client should send a ping message the server will reply with a pong message (same payload)
     void sendPong(std::string payload) {
@@ -587,77 +892,107 @@ private:
         wsq->push(wse);
     }*/
 
-    void writeLoop()
+    //! Run by the io context thread
+    void enqueue(const std::shared_ptr<const WsMessage>& msg)
     {
-        localWs->text(localWs->got_text());
+        if (fClosed)
+            return;
 
-        while (!exit_rwhandler_thread_flag)
+        // a single message is queued anyway, whatever its size
+        if (!outQueue.empty() && nQueuedBytes + msg->data.size() > MAX_WS_OUTBOUND_QUEUE_BYTES)
         {
-            std::unique_lock<std::mutex> lk(writeMutex);
-            // Wait upto 1 sec and check the queue in any case
-            writeCV.wait_for(lk, std::chrono::seconds(1));
+            LogPrint("ws", "%s():%d - connection[%u] not reading its messages (%u queued, %u bytes), disconnecting it\n",
+                __func__, __LINE__, t_id, outQueue.size(), nQueuedBytes.load());
+            tot_slow_consumers++;
+            close();
+            return;
+        }
+        outQueue.push_back(msg);
+        nQueuedMessages++;
+        nQueuedBytes += msg->data.size();
+        doWrite();
+    }
 
-            WsEvent* wse;
-            while (wsq.pop(wse) && wse != NULL)
+    //! Run by the io context thread
+    void doWrite()
+    {
+        if (fWriting || !fAccepted || fClosed || outQueue.empty())
+            return;
+
+        fWriting = true;
+        localWs.binary(outQueue.front()->fBinary);
+        std::shared_ptr<WsHandler> self = shared_from_this();
+        localWs.async_write(net::buffer(outQueue.front()->data),
+            [self](boost::beast::error_code ec, std::size_t)
             {
-                std::string msg = wse->getPayload()->write();
-                LogPrint("ws", "%s():%d - deleting %p\n", __func__, __LINE__, wse);
-                delete wse;
-                if (localWs->is_open())
+                self->fWriting = false;
+                if (ec)
                 {
-                    boost::beast::error_code ec;
-                    localWs->write(boost::asio::buffer(msg), ec);
+                    LogPrint("ws", "%s():%d - err[%d]: %s\n", __func__, __LINE__, ec.value(), ec.message());
+                    self->close();
+                    return;
+                }
+                if (self->outQueue.empty())
+                    return;
+                LogPrint("ws", "%s():%d - %s msg of size=%d written on client socket\n", __func__, __LINE__,
+                    self->outQueue.front()->fBinary ? "binary" : "text", self->outQueue.front()->data.size());
+                self->nQueuedMessages--;
+                self->nQueuedBytes -= self->outQueue.front()->data.size();
+                self->outQueue.pop_front();
+                self->doWrite();
+            });
+    }
 
-                    if (ec == websocket::error::closed)
-                    {
-                        LogPrint("ws", "%s():%d - err[%d]: %s\n", __func__, __LINE__,ec.value(), ec.message());
-                        break;
-                    }
-                    else
-                    if (ec.value() != boost::system::errc::success)
-                    {
-                        LogPrint("ws", "%s():%d - err[%d]: %s\n", __func__, __LINE__, ec.value(), ec.message());
-                        break;
-                    }
-                    LogPrint("ws", "%s():%d - msg[%s] written on client socket\n", __func__, __LINE__, msg);
+    //! Run by the io context thread. The next message is read once the previous one has been processed,
+    //! so that a client has at most one request on the worker pool
+    void doRead()
+    {
+        if (fClosed)
+            return;
+
+        std::shared_ptr<WsHandler> self = shared_from_this();
+        localWs.async_read(readBuffer,
+            [self](boost::beast::error_code ec, std::size_t)
+            {
+                if (ec == websocket::error::closed || ec == websocket::error::no_connection)
+                {
+                    // graceful disconnection
+                    LogPrint("ws", "%s():%d - code[%d]: %s\n", __func__, __LINE__, ec.value(), ec.message());
+                    self->close();
+                    return;
                 }
-                else
+                if (ec)
                 {
-                    LogPrint("ws", "%s():%d - ws is closed\n", __func__, __LINE__);
-                    break;
+                    LogPrint("ws", "%s():%d - connection is open[%s], err[%d]: %s\n", __func__, __LINE__,
+                        (self->localWs.is_open()?"Y":"N"), ec.value(), ec.message());
+                    self->close();
+                    return;
                 }
-            }
-        }
-        LogPrint("ws", "%s():%d - write thread exit (this=%p)\n", __func__, __LINE__, this);
+                LogPrint("ws", "%s():%d - client message received of size=%d\n", __func__, __LINE__, self->readBuffer.size());
+
+                std::string msg = boost::beast::buffers_to_string(self->readBuffer.data());
+                self->readBuffer.consume(self->readBuffer.size());
+                net::post(*wsWorkers, [self, msg]()
+                    {
+                        bool fContinue = self->processClientMessage(msg);
+                        net::post(ioc, [self, fContinue]()
+                            {
+                                if (fContinue)
+                                    self->doRead();
+                                else
+                                    self->close();
+                            });
+                    });
+            });
     }
 
-    int parseClientMessage(WsEvent::WsRequestType& reqType, std::string& clientRequestId, std::string& outMsg) 
+    int parseClientMessage(const std::string& msg, WsEvent::WsRequestType& reqType, std::string& clientRequestId, std::string& outMsg)
     {
         try
         {
             std::string msgType;
             std::string requestType;
-            boost::beast::multi_buffer buffer;
-            boost::beast::error_code ec;
-
-            localWs->read(buffer, ec);
-            if (ec == websocket::error::closed || ec == websocket::error::no_connection)
-            {
-                // graceful disconnection
-                LogPrint("ws", "%s():%d - code[%d]: %s\n", __func__, __LINE__,ec.value(), ec.message());
-                return READ_ERROR;
-            }
-            else
-            if (ec.value() != boost::system::errc::success)
-            {
-                // any other error but success
-                LogPrint("ws", "%s():%d - connection is open[%s], err[%d]: %s\n", __func__, __LINE__,
-                    (localWs->is_open()?"Y":"N") , ec.value(), ec.message());
-                return READ_ERROR;
-            }
-            LogPrint("ws", "%s():%d - client message received of size=%d\n", __func__, __LINE__, buffer.size());
 
-            std::string msg = boost::beast::buffers_to_string(buffer.data());
             UniValue request;
             if (!request.read(msg)) {
                 LogPrint("ws", "%s():%d - error parsing message from websocket: [%s]\n", __func__, __LINE__, msg);
@@ -680,6 +1015,13 @@ private:
             }
             LogPrint("ws", "%s():%d - got msg[%s]\n", __func__, __LINE__, msg);
 
+            // binary messages carry the request id as a number in their fixed header
+            if (fBinaryFormat && !clientRequestId.empty() && !isBinaryRequestId(clientRequestId)) {
+                outMsg = "requestId must be a non negative 32 bits number with the binary format";
+                LogPrint("ws", "%s():%d - %s: msg[%s]\n", __func__, __LINE__, outMsg, msg);
+                return INVALID_PARAMETER;
+            }
+
             if (requestType == std::to_string(WsEvent::GET_SINGLE_BLOCK))
             {
                 reqType = WsEvent::GET_SINGLE_BLOCK;
@@ -981,6 +1323,52 @@ private:
                 return sendTopQualityCertificatesForScid(scId, clientRequestId);
             }
 
+            if (requestType == std::to_string(WsEvent::SUBSCRIBE_SIDECHAIN_UPDATES))
+            {
+                reqType = WsEvent::SUBSCRIBE_SIDECHAIN_UPDATES;
+                if (clientRequestId.empty()) {
+                    LogPrint("ws", "%s():%d - clientRequestId empty: msg[%s]\n", __func__, __LINE__, msg);
+                    return MISSING_REQID;
+                }
+
+                // the payload is optional, no scid means all sidechains
+                const UniValue& reqPayload = find_value(request, "requestPayload");
+                return subscribeSidechainUpdates(reqPayload, clientRequestId, outMsg);
+            }
+
+            if (requestType == std::to_string(WsEvent::UNSUBSCRIBE_SIDECHAIN_UPDATES))
+            {
+                reqType = WsEvent::UNSUBSCRIBE_SIDECHAIN_UPDATES;
+                if (clientRequestId.empty()) {
+                    LogPrint("ws", "%s():%d - clientRequestId empty: msg[%s]\n", __func__, __LINE__, msg);
+                    return MISSING_REQID;
+                }
+                return unsubscribeSidechainUpdates(clientRequestId);
+            }
+
+            if (requestType == std::to_string(WsEvent::SET_MESSAGE_FORMAT))
+            {
+                reqType = WsEvent::SET_MESSAGE_FORMAT;
+                if (clientRequestId.empty()) {
+                    LogPrint("ws", "%s():%d - clientRequestId empty: msg[%s]\n", __func__, __LINE__, msg);
+                    return MISSING_REQID;
+                }
+                const UniValue& reqPayload = find_value(request, "requestPayload");
+                if (reqPayload.isNull())
+                {
+                    LogPrint("ws", "%s():%d - requestPayload null: msg[%s]\n", __func__, __LINE__, msg);
+                    return INVALID_JSON_FORMAT;
+                }
+
+                std::string format = findFieldValue("format", reqPayload);
+                if (format.empty())
+                {
+                    LogPrint("ws", "%s():%d - format empty: msg[%s]\n", __func__, __LINE__, msg);
+                    return MISSING_PARAMETER;
+                }
+                return setMessageFormat(format, clientRequestId, outMsg);
+            }
+
             // if we are here that means it is no valid request type, and reqType is an enum defaulting to 255
             *((int*)(&reqType)) = std::stoi(requestType);
 
@@ -1004,58 +1392,56 @@ private:
         }
     }
 
-    void readLoop()
+    //! Run by the worker pool, false if the connection has to be closed
+    bool processClientMessage(const std::string& msg)
     {
-        while (!exit_rwhandler_thread_flag)
+        WsEvent::WsRequestType reqType = WsEvent::REQ_UNDEFINED;
+        std::string clientRequestId = "";
+        std::string outMsg;
+        int res = parseClientMessage(msg, reqType, clientRequestId, outMsg);
+        if (res == READ_ERROR)
         {
-            WsEvent::WsRequestType reqType = WsEvent::REQ_UNDEFINED;
-            std::string clientRequestId = "";
-            std::string outMsg;
-            int res = parseClientMessage(reqType, clientRequestId, outMsg);
-            if (res == READ_ERROR)
-            {
-                LogPrint("ws", "%s():%d - websocket closed exit reading loop\n", __func__, __LINE__);
-                break;
-            }
+            LogPrint("ws", "%s():%d - closing the connection\n", __func__, __LINE__);
+            return false;
+        }
 
-            if (res != OK)
+        if (res != OK)
+        {
+            std::string msgError = "On requestType[" + std::to_string(reqType) + "]: ";
+            switch (res)
             {
-                std::string msgError = "On requestType[" + std::to_string(reqType) + "]: ";
-                switch (res)
-                {
-                case INVALID_PARAMETER:
-                    msgError += "Invalid parameter";
-                    break;
-                case MISSING_PARAMETER:
-                    msgError += "Missing parameter";
-                    break;
-                case MISSING_REQID:
-                    msgError += "Missing requestId";
-                    break;
-                case INVALID_COMMAND:
-                    msgError += "Invalid command";
-                    break;
-                case INVALID_JSON_FORMAT:
-                    msgError += "Invalid JSON format";
-                    break;
-                default:
-                    msgError += "Generic error";
-                }
-                if (!outMsg.empty())
-                    msgError += " - Details: " + outMsg;
-
-                // Send a message error to the client:  type = -1
-                WsEvent* wse = new WsEvent(WsEvent::MSG_ERROR);
-                LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
-                UniValue* rv = wse->getPayload();
-                if (!clientRequestId.empty())
-                    rv->pushKV("requestId", clientRequestId);
-                rv->pushKV("errorCode", res);
-                rv->pushKV("message", msgError);
-                write(wse);
+            case INVALID_PARAMETER:
+                msgError += "Invalid parameter";
+                break;
+            case MISSING_PARAMETER:
+                msgError += "Missing parameter";
+                break;
+            case MISSING_REQID:
+                msgError += "Missing requestId";
+                break;
+            case INVALID_COMMAND:
+                msgError += "Invalid command";
+                break;
+            case INVALID_JSON_FORMAT:
+                msgError += "Invalid JSON format";
+                break;
+            default:
+                msgError += "Generic error";
             }
+            if (!outMsg.empty())
+                msgError += " - Details: " + outMsg;
+
+            // Send a message error to the client:  type = -1
+            WsEvent* wse = new WsEvent(WsEvent::MSG_ERROR);
+            LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
+            UniValue* rv = wse->getPayload();
+            if (!clientRequestId.empty())
+                rv->pushKV("requestId", clientRequestId);
+            rv->pushKV("errorCode", res);
+            rv->pushKV("message", msgError);
+            write(wse);
         }
-        LogPrint("ws", "%s():%d - exit reading loop\n", __func__, __LINE__);
+        return true;
     }
 
 public:
@@ -1072,7 +1458,7 @@ public:
 
     unsigned int t_id = 0;
 
-    WsHandler() {}
+    WsHandler(tcp::socket&& socket, unsigned int t_id): localWs(std::move(socket)), t_id(t_id) {}
     ~WsHandler() {
         LogPrint("ws", "%s():%d - called this=%p\n", __func__, __LINE__, this);
     }
@@ -1082,124 +1468,143 @@ public:
 
     static void getPeerIdentity(const tcp::socket& socket, std::string& id)
     { 
-        auto peer = socket.remote_endpoint();
+        boost::system::error_code ec;
+        auto peer = socket.remote_endpoint(ec);
         std::string addr = peer.address().to_string();
         std::string port = std::to_string(peer.port());
         id = addr + ":" + port;
     }
 
-    void do_session(tcp::socket& socket, unsigned int t_id)
+    //! Run by the io context thread, the handler is kept alive by the pending operations
+    void start()
     {
-        // will be referenced when shutting down in order not destroying ptr while executing this thread
-        boost::shared_ptr<WsHandler> thisRef;
-
-        this->t_id = t_id;
-
-        try
-        {
-            localWs.reset(new websocket::stream<tcp::socket> { std::move(socket) });
-            LogPrint("ws", "%s():%d - allocated localWs %p\n", __func__, __LINE__, localWs.get());
-
-            localWs->set_option(
-                websocket::stream_base::decorator(
-                    [](websocket::response_type& res)
-                        {
-                            res.set(http::field::server,
-                            std::string(BOOST_BEAST_VERSION_STRING) + " Horizen-sidechain-connector");
-                        }));
-
-            localWs->control_callback(
-                [](websocket::frame_type kind, boost::string_view payload)
-                {
-                    if (kind == websocket::frame_type::ping)
+        localWs.set_option(
+            websocket::stream_base::decorator(
+                [](websocket::response_type& res)
                     {
-                        std::string payl(payload);
-                        LogPrint("ws", "%s():%d - ping received... payload[%s]\n", __func__, __LINE__, payl);
-                    }
-                    // Do something with the payload
-                    boost::ignore_unused(kind, payload);
-                });
-
-            localWs->accept();
+                        res.set(http::field::server,
+                        std::string(BOOST_BEAST_VERSION_STRING) + " Horizen-sidechain-connector");
+                    }));
 
-            std::thread write_t(&WsHandler::writeLoop, this);
-            readLoop();
-            exit_rwhandler_thread_flag = true;
-            write_t.join();
-            socket.close();
-        }
-        catch (boost::system::system_error const& se)
-        {
-            if (se.code() != websocket::error::closed)
+        localWs.control_callback(
+            [](websocket::frame_type kind, boost::string_view payload)
             {
-                LogPrint("ws", "%s():%d - boost error %s\n", __func__, __LINE__, se.code().message());
-            }
-            LogPrint("ws", "%s():%d - websocket close\n", __func__, __LINE__);
-        }
-        catch (std::exception const& e)
-        {
-            LogPrint("ws", "%s():%d - error: %s\n", __func__, __LINE__, std::string(e.what()));
-        }
-        LogPrint("ws", "%s():%d - exit thread final\n", __func__, __LINE__);
-        {
-            std::unique_lock<std::mutex> lck(wsmtx);
-            this->shutdown();
-            tot_connections--;
-            LogPrint("ws", "%s():%d - connection[%u] closed: tot[%d]\n", __func__, __LINE__, t_id, tot_connections);
-
-            auto it = listWsHandler.begin();
-            while (it != listWsHandler.end())
-            {
-                if (this == (*it).get() )
+                if (kind == websocket::frame_type::ping)
                 {
-                    thisRef = (*it);
-                    LogPrint("ws", "%s():%d - removing handler obj from list\n", __func__, __LINE__);
-                    listWsHandler.erase(it++);
+                    std::string payl(payload);
+                    LogPrint("ws", "%s():%d - ping received... payload[%s]\n", __func__, __LINE__, payl);
                 }
-                else
+                // Do something with the payload
+                boost::ignore_unused(kind, payload);
+            });
+
+        std::shared_ptr<WsHandler> self = shared_from_this();
+        localWs.async_accept(
+            [self](boost::beast::error_code ec)
+            {
+                if (ec)
                 {
-                    ++it;
+                    LogPrint("ws", "%s():%d - handshake error: %s\n", __func__, __LINE__, ec.message());
+                    self->close();
+                    return;
                 }
-            }
-        }
+                self->fAccepted = true;
+                self->doRead();
+                self->doWrite();
+            });
     }
 
-    void send_tip_update(int height, const std::string& strHash, const std::string& blockHex)
+    //! Queue a message for the client, from any thread
+    void send(const std::shared_ptr<const WsMessage>& msg)
     {
-        sendBlockEvent(height, strHash, blockHex, WsEvent::UPDATE_TIP);
+        std::shared_ptr<WsHandler> self = shared_from_this();
+        net::post(ioc, [self, msg]() { self->enqueue(msg); });
     }
 
-    void shutdown()
+    //! Run by the io context thread
+    void close()
     {
-        try
+        if (fClosed)
+            return;
+        fClosed = true;
+
+        boost::system::error_code ec;
+        localWs.next_layer().shutdown(tcp::socket::shutdown_both, ec);
+        localWs.next_layer().close(ec);
+        outQueue.clear();
+        nQueuedMessages = 0;
+        nQueuedBytes = 0;
+
+        std::unique_lock<std::mutex> lck(wsmtx);
+        listWsHandler.remove(shared_from_this());
+        tot_connections--;
+        LogPrint("ws", "%s():%d - connection[%u] closed: tot[%d]\n", __func__, __LINE__, t_id, tot_connections.load());
+    }
+
+    bool isBinaryFormat() const { return fBinaryFormat; }
+    size_t getQueuedMessages() const { return nQueuedMessages; }
+    size_t getQueuedBytes() const { return nQueuedBytes; }
+
+    //! The UPDATE_TIP event, the same for all the clients
+    static std::shared_ptr<const WsMessage> makeTipUpdate(int height, const std::string& strHash, const std::string& blockHex)
+    {
+        WsEvent wse(WsEvent::MSG_EVENT);
+        UniValue rspPayload(UniValue::VOBJ);
+        rspPayload.pushKV("height", height);
+        rspPayload.pushKV("hash", strHash);
+        rspPayload.pushKV("block", blockHex);
+
+        UniValue* rv = wse.getPayload();
+        rv->pushKV("eventType", WsEvent::UPDATE_TIP);
+        rv->pushKV("eventPayload", rspPayload);
+        return wse.serialize();
+    }
+
+    //! Binary block message, payload: int32 height, uint256 hash, CBlock block
+    static std::shared_ptr<const WsMessage> makeBinaryBlock(int height, const uint256& hash, const std::string& rawBlock,
+            WsEvent::WsMsgType msgType, int type, uint32_t requestId)
+    {
+        WsBinaryEvent wse(msgType, type, requestId);
+        wse.getPayload() << (int32_t)height << hash;
+        wse.getPayload().write(rawBlock.data(), rawBlock.size());
+        return wse.serialize();
+    }
+
+    void send_sidechain_updates()
+    {
+        std::vector<CSidechainJournalEntry> entries;
+        bool fResyncRequired = false;
         {
-            exit_rwhandler_thread_flag = true;
-            if (this->localWs)
+            std::unique_lock<std::mutex> lck(scSubscriptionMutex);
+            if (!fScSubscribed)
+                return;
+
+            // entries filtered out count as consumed too
+            uint64_t journalSeq = scJournal.GetLastSeq();
+            if (!scJournal.GetEntriesSince(lastScJournalSeq, subscribedScIds, entries))
             {
-                LogPrint("ws", "%s():%d - closing socket\n", __func__, __LINE__);
-                this->localWs->next_layer().close();
+                // the client fell behind the journal bound, it has to reload the sidechain records
+                LogPrint("ws", "%s():%d - connection[%u] missed journal entries after %d\n", __func__, __LINE__, t_id, lastScJournalSeq);
+                fResyncRequired = true;
+                entries.clear();
             }
+            if (!entries.empty())
+                journalSeq = std::max(journalSeq, entries.back().seq);
+            lastScJournalSeq = journalSeq;
         }
-        catch (std::exception const& e)
-        {
-            LogPrint("ws", "%s():%d - error: %s\n", __func__, __LINE__, e.what());
-        }
+
+        if (!entries.empty() || fResyncRequired)
+            sendSidechainEvent(entries, fResyncRequired);
     }
 };
 
 
-static int getblock(const CBlockIndex *pindex, std::string& strHex)
+static int getblock(const CBlockIndex *pindex, std::shared_ptr<const CSerializedBlockCache::CEntry>& entry)
 {
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if (!ReadBlockFromDisk(block, pindex)) {
-            LogPrint("ws", "%s():%d - error: could not read block from disk\n", __func__, __LINE__);
-            return WsHandler::READ_ERROR;
-        }
-        ss << block;
-        strHex = HexStr(ss.begin(), ss.end());
+    entry = serializedBlockCache.GetOrRead(pindex);
+    if (!entry) {
+        LogPrint("ws", "%s():%d - error: could not read block from disk\n", __func__, __LINE__);
+        return WsHandler::READ_ERROR;
     }
     return WsHandler::OK;
 }
@@ -1219,8 +1624,8 @@ static int getheader(const CBlockIndex *pindex, std::string& strHex)
 
 static void ws_updatetip(const CBlockIndex *pindex)
 {
-    std::string strHex;
-    int ret = getblock(pindex, strHex);
+    std::shared_ptr<const CSerializedBlockCache::CEntry> block;
+    int ret = getblock(pindex, block);
     if (ret != WsHandler::OK)
     {
         // should not happen
@@ -1232,11 +1637,26 @@ static void ws_updatetip(const CBlockIndex *pindex)
         if (listWsHandler.size() )
         {
             LogPrint("ws", "%s():%d - update tip loop on ws clients\n", __func__, __LINE__);
+            // each format is written once, for the first client using it, and shared by the queues of all of them
+            std::shared_ptr<const WsMessage> jsonMsg;
+            std::shared_ptr<const WsMessage> binaryMsg;
             auto it = listWsHandler.begin();
             while (it != listWsHandler.end())
             {
-                LogPrint("ws", "%s():%d - call wshandler_send_tip_update to connection[%u]\n", __func__, __LINE__, (*it)->t_id);
-                (*it)->send_tip_update(pindex->nHeight, pindex->GetBlockHash().GetHex(), strHex);
+                LogPrint("ws", "%s():%d - send tip update to connection[%u]\n", __func__, __LINE__, (*it)->t_id);
+                if ((*it)->isBinaryFormat())
+                {
+                    if (!binaryMsg)
+                        binaryMsg = WsHandler::makeBinaryBlock(pindex->nHeight, pindex->GetBlockHash(), block->GetRaw(),
+                            WsEvent::MSG_EVENT, WsEvent::UPDATE_TIP, 0);
+                    (*it)->send(binaryMsg);
+                }
+                else
+                {
+                    if (!jsonMsg)
+                        jsonMsg = WsHandler::makeTipUpdate(pindex->nHeight, pindex->GetBlockHash().GetHex(), block->GetHex());
+                    (*it)->send(jsonMsg);
+                }
                 ++it;
             }
         }
@@ -1248,50 +1668,70 @@ static void ws_updatetip(const CBlockIndex *pindex)
 }
 
 
+static void ws_updatesidechains()
+{
+    std::unique_lock<std::mutex> lck(wsmtx);
+    for (auto it = listWsHandler.begin(); it != listWsHandler.end(); ++it)
+    {
+        (*it)->send_sidechain_updates();
+    }
+}
+
+
 //------------------------------------------------------------------------------
 
-static tcp::acceptor* acceptor = NULL;
-void ws_main(std::string strAddressWs, int portWs)
+static std::unique_ptr<tcp::acceptor> acceptor;
+static unsigned int next_t_id = 0;
+
+static void ws_newsession(tcp::socket&& socket)
 {
     std::string peerId;
+    WsHandler::getPeerIdentity(socket, peerId);
 
-    try {
-        LogPrint("ws", "start websocket service address: %s \n", strAddressWs);
-        LogPrint("ws", "start websocket service port: %s \n", portWs);
+    if (tot_connections >= max_connections)
+    {
+        LogPrint("ws", "%s():%d - connection from %s refused, already %d connected\n", __func__, __LINE__, peerId, tot_connections.load());
+        tot_rejected++;
+        boost::system::error_code ec;
+        socket.close(ec);
+        return;
+    }
 
-        auto const address = boost::asio::ip::make_address(strAddressWs);
-        auto const port = static_cast<unsigned short>(portWs);
+    std::shared_ptr<WsHandler> w = std::make_shared<WsHandler>(std::move(socket), next_t_id++);
+    LogPrint("ws", "%s():%d - allocated ws handler %p\n", __func__, __LINE__, w.get());
+    {
+        std::unique_lock<std::mutex> lck(wsmtx);
+        listWsHandler.push_back(w);
+        tot_connections++;
+    }
+    tot_accepted++;
+    w->start();
 
-        net::io_context ioc { 1 };
-        tcp::acceptor _acceptor = tcp::acceptor { ioc, { address, port } };
-        acceptor = &_acceptor;
-        LogPrint("ws", "%s():%d - assigned %p\n", __func__, __LINE__, acceptor);
-        unsigned int t_id = 0;
+    LogPrint("ws", "%s():%d - new connection[%u] received from %s: tot[%d]\n",
+        __func__, __LINE__, w->t_id, peerId, tot_connections.load());
+}
 
-        while (!exit_ws_thread)
+static void ws_accept()
+{
+    LogPrint("ws", "%s():%d - waiting to get a new connection\n", __func__, __LINE__);
+    acceptor->async_accept(
+        [](boost::system::error_code ec, tcp::socket socket)
         {
-            tcp::socket socket { ioc };
-
-            // TODO //  - possible DoS, limit number of connections
-            LogPrint("ws", "%s():%d - waiting to get a new connection\n", __func__, __LINE__);
-            acceptor->accept(socket);
-            WsHandler::getPeerIdentity(socket, peerId);
-
-            boost::shared_ptr<WsHandler> w(new WsHandler());
-            LogPrint("ws", "%s():%d - allocated ws handler %p\n", __func__, __LINE__, w.get());
-
-            std::thread { std::bind(&WsHandler::do_session, w.get(),
-                    std::move(socket), t_id) }.detach();
-            {
-                std::unique_lock<std::mutex> lck(wsmtx);
-                listWsHandler.push_back(w);
-                tot_connections++;
-            }
-            t_id++;
+            if (ec == net::error::operation_aborted || exit_ws_thread)
+                return;
+            if (ec)
+                LogPrint("ws", "%s():%d - error: %s\n", __func__, __LINE__, ec.message());
+            else
+                ws_newsession(std::move(socket));
+            ws_accept();
+        });
+}
 
-            LogPrint("ws", "%s():%d - new connection[%u] received from %s: tot[%d]\n",
-                __func__, __LINE__, t_id, peerId, tot_connections);
-        }
+static void ws_main()
+{
+    RenameThread("horizen-ws");
+    try {
+        ioc.run();
     }
     catch (const std::exception& e)
     {
@@ -1300,20 +1740,26 @@ void ws_main(std::string strAddressWs, int portWs)
     LogPrint("ws", "%s():%d - websocket service stop\n", __func__, __LINE__);
 }
 
-static void shutdown()
+//! Run by the io context thread
+static void ws_shutdown()
 {
-    if (listWsHandler.size() != 0)
+    if (acceptor)
+    {
+        LogPrint("ws", "%s():%d - closing acceptor\n", __func__, __LINE__);
+        boost::system::error_code ec;
+        acceptor->close(ec);
+    }
+
+    std::list< std::shared_ptr<WsHandler> > listClosing;
     {
-        // list objects are smart_ptrs and will clean up when they go out of scope
-        LogPrint("ws", "%s():%d - shutdown %d threads/sockets thread... \n", __func__, __LINE__, listWsHandler.size());
         std::unique_lock<std::mutex> lck(wsmtx);
-        auto it = listWsHandler.begin();
-        while (it != listWsHandler.end())
-        {
-            LogPrint("ws", "%s():%d - calling shutdown on handler connection[%u]\n", __func__, __LINE__, (*it)->t_id);
-            (*it)->shutdown();
-            ++it;
-        }
+        listClosing = listWsHandler;
+    }
+    LogPrint("ws", "%s():%d - shutdown %d connections\n", __func__, __LINE__, listClosing.size());
+    for (const std::shared_ptr<WsHandler>& w : listClosing)
+    {
+        LogPrint("ws", "%s():%d - calling close on handler connection[%u]\n", __func__, __LINE__, w->t_id);
+        w->close();
     }
 }
 
@@ -1325,14 +1771,25 @@ bool StartWsServer()
         //std::string strAddress = GetArg("-wsaddress", "127.0.0.1");
         std::string strAddress = "127.0.0.1";
         int port = GetArg("-wsport", 8888);
+        nWsWorkerThreads = std::max<int>(GetArg("-wsthreads", DEFAULT_WS_THREADS), 1);
+        max_connections = std::max<int>(GetArg("-wsmaxconnections", DEFAULT_WS_MAX_CONNECTIONS), 1);
+
+        LogPrint("ws", "start websocket service address: %s \n", strAddress);
+        LogPrint("ws", "start websocket service port: %s \n", port);
 
-        ws_thread = boost::thread(ws_main, strAddress, port);
-        ws_thread.detach();
+        auto const address = boost::asio::ip::make_address(strAddress);
+        acceptor.reset(new tcp::acceptor(ioc, { address, static_cast<unsigned short>(port) }));
+        LogPrint("ws", "%s():%d - assigned %p\n", __func__, __LINE__, acceptor.get());
+        wsWorkers.reset(new net::thread_pool(nWsWorkerThreads));
+        wsWorkGuard.reset(new net::executor_work_guard<net::io_context::executor_type>(ioc.get_executor()));
+
+        ws_accept();
+        ws_thread = boost::thread(ws_main);
 
         wsNotificationInterface.reset(new WsNotificationInterface());
-        LogPrint("ws", "%s():%d - starting server at %s:%d, allocated notif if %p\n",
-            __func__, __LINE__, strAddress, port, wsNotificationInterface.get());
-        RegisterValidationInterface(wsNotificationInterface.get());
+        LogPrint("ws", "%s():%d - starting server at %s:%d with %d worker threads, allocated notif if %p\n",
+            __func__, __LINE__, strAddress, port, nWsWorkerThreads, wsNotificationInterface.get());
+        RegisterValidationInterface(wsNotificationInterface.get(), true);
     }
     catch (const std::exception& e)
     {
@@ -1346,18 +1803,26 @@ bool StopWsServer()
 {
     try
     {
-        shutdown();
-        exit_ws_thread = true;
-        if (acceptor != NULL)
-        {
-            LogPrint("ws", "%s():%d - closing static acceptor %p\n", __func__, __LINE__, acceptor);
-            acceptor->close();
-            acceptor = NULL;
-        }
         if (wsNotificationInterface.get() != NULL)
         {
+            // delivers the pending notifications to the clients still connected
             UnregisterValidationInterface(wsNotificationInterface.get());
         }
+        exit_ws_thread = true;
+        net::post(ioc, ws_shutdown);
+
+        // a worker still processing a client message posts its completion to ioc, which must not have
+        // drained yet: the io loop is released only once the workers have been joined
+        if (wsWorkers)
+            wsWorkers->join();
+        if (wsWorkGuard)
+            wsWorkGuard->reset();
+        if (ws_thread.joinable())
+            ws_thread.join();
+
+        wsWorkGuard.reset();
+        wsWorkers.reset();
+        acceptor.reset();
     }
     catch (const std::exception& e)
     {
@@ -1367,5 +1832,25 @@ bool StopWsServer()
     return true;
 }
 
+bool GetWsServerStats(WsServerStats& stats)
+{
+    if (!wsWorkers)
+        return false;
 
+    stats.nConnections = tot_connections;
+    stats.nMaxConnections = max_connections;
+    stats.nWorkerThreads = nWsWorkerThreads;
+    stats.nAccepted = tot_accepted;
+    stats.nRejected = tot_rejected;
+    stats.nSlowConsumers = tot_slow_consumers;
 
+    std::unique_lock<std::mutex> lck(wsmtx);
+    for (const std::shared_ptr<WsHandler>& w : listWsHandler)
+    {
+        const size_t nBytes = w->getQueuedBytes();
+        stats.nQueuedMessages += w->getQueuedMessages();
+        stats.nQueuedBytes += nBytes;
+        stats.nMaxQueuedBytes = std::max(stats.nMaxQueuedBytes, nBytes);
+    }
+    return true;
+}
@@ -9,11 +9,34 @@
 
 //------------------------------------------------------------------------------
 //
-// Example: WebSocket server, synchronous
+// Example: WebSocket server, asynchronous
 //
 //------------------------------------------------------------------------------
 
 
+#include <cstddef>
+#include <cstdint>
+
+static const int DEFAULT_WS_THREADS = 2;
+static const int DEFAULT_WS_MAX_CONNECTIONS = 1000;
+//! Bytes that can be waiting to be written to a client, over which it is disconnected as a slow consumer
+static const size_t MAX_WS_OUTBOUND_QUEUE_BYTES = 64 * 1024 * 1024;
+
+struct WsServerStats
+{
+    int nConnections = 0;
+    int nMaxConnections = 0;
+    int nWorkerThreads = 0;
+    uint64_t nAccepted = 0;
+    uint64_t nRejected = 0;
+    uint64_t nSlowConsumers = 0;
+    //! Messages and bytes waiting to be written, for all clients and for the most behind one
+    size_t nQueuedMessages = 0;
+    size_t nQueuedBytes = 0;
+    size_t nMaxQueuedBytes = 0;
+};
 
 bool StartWsServer();
 bool StopWsServer();
+//! False if the server is not running
+bool GetWsServerStats(WsServerStats& stats);